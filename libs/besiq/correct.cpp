@@ -102,6 +102,49 @@ run_bonferroni(metaresultfile *result, float alpha, uint64_t num_tests, size_t c
     }
 }
 
+void
+run_permutation(metaresultfile *result, const std::vector<double> &null_min, float alpha, size_t column, const std::string &output_path)
+{
+    std::vector<double> sorted_null( null_min );
+    std::sort( sorted_null.begin( ), sorted_null.end( ) );
+
+    std::ostream &output = std::cout;
+    std::vector<std::string> header = result->get_header( );
+    output << "snp1 snp2";
+    for(int i = 0; i < header.size( ); i++)
+    {
+        output << "\t" << header[ i ];
+    }
+    output << "\tP_adjusted\n";
+
+    std::pair<std::string, std::string> pair;
+    float *values = new float[ header.size( ) ];
+    while( result->read( &pair, values ) )
+    {
+        float p = values[ column ];
+        if( p == result_get_missing( ) )
+        {
+            continue;
+        }
+
+        /* The fraction of permutations where some pair was at least as extreme */
+        size_t num_extreme = std::upper_bound( sorted_null.begin( ), sorted_null.end( ), (double) p ) - sorted_null.begin( );
+        float adjusted_p = ( 1.0 + num_extreme ) / ( 1.0 + sorted_null.size( ) );
+
+        if( adjusted_p <= alpha )
+        {
+            output << pair.first << " " << pair.second;
+            for(int i = 0; i < header.size( ); i++)
+            {
+                output << "\t" << values[ i ];
+            }
+            output << "\t" << adjusted_p << "\n";
+        }
+    }
+
+    delete[] values;
+}
+
 resultfile *
 do_common_stages(metaresultfile *result, const std::vector<std::string> &snp_names, const correction_options &options, const std::string &output_path)
 {
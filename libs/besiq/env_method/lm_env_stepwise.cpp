@@ -2,6 +2,7 @@
 
 #include <glm/models/normal.hpp>
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 
 lm_env_stepwise::lm_env_stepwise(method_data_ptr data, const arma::mat &E)
 : method_env_type::method_env_type( data ),
@@ -109,16 +110,16 @@ void lm_env_stepwise::run(const snp_row &row, std::ostream &output)
         try
         {
             double LR_null = -2 *( null_info.logl - alt_info.logl );
-            double p_null = 1.0 - chi_square_cdf( LR_null, m_alt_matrix.n_cols - m_null_matrix.n_cols );
+            double p_null = chi_square_upper( LR_null, m_alt_matrix.n_cols - m_null_matrix.n_cols );
 
             double LR_snp = -2 *( snp_info.logl - alt_info.logl );
-            double p_snp = 1.0 - chi_square_cdf( LR_snp, m_alt_matrix.n_cols - m_snp_matrix.n_cols );
+            double p_snp = chi_square_upper( LR_snp, m_alt_matrix.n_cols - m_snp_matrix.n_cols );
 
             double LR_env = -2 *( env_info.logl - alt_info.logl );
-            double p_env = 1.0 - chi_square_cdf( LR_env, m_alt_matrix.n_cols - m_env_matrix.n_cols );
+            double p_env = chi_square_upper( LR_env, m_alt_matrix.n_cols - m_env_matrix.n_cols );
 
             double LR_add = -2 *( add_info.logl - alt_info.logl );
-            double p_add = 1.0 - chi_square_cdf( LR_add, m_alt_matrix.n_cols - m_add_matrix.n_cols );
+            double p_add = chi_square_upper( LR_add, m_alt_matrix.n_cols - m_add_matrix.n_cols );
 
             output << p_null << "\t" << p_snp << "\t" << p_env << "\t" << p_add << "\t";
         }
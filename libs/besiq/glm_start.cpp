@@ -0,0 +1,137 @@
+#include <vector>
+
+#include <besiq/glm_start.hpp>
+
+glm_start::glm_start(size_t capacity)
+    : m_capacity( capacity )
+{
+}
+
+glm_start::glm_start(const glm_start &other)
+    : m_capacity( other.m_capacity )
+{
+}
+
+glm_start &
+glm_start::operator=(const glm_start &other)
+{
+    m_capacity = other.m_capacity;
+    m_previous = arma::vec( );
+    m_start = arma::vec( );
+    m_snps.clear( );
+    m_index.clear( );
+
+    return *this;
+}
+
+const arma::vec &
+glm_start::get_null(model_matrix &matrix, const snp_row &row1, const snp_row &row2)
+{
+    m_start = m_previous;
+    if( m_start.n_elem != matrix.get_null( ).n_cols )
+    {
+        m_start = arma::vec( );
+        return m_start;
+    }
+
+    const snp_row *rows[ 2 ] = { &row1, &row2 };
+    const arma::mat &null = matrix.get_null( );
+    size_t num_main = matrix.num_null( ) - 1;
+    for(unsigned int s = 0; s < 2; s++)
+    {
+        const arma::vec *main = find( snp_key( rows[ s ], s ) );
+        if( main == NULL )
+        {
+            continue;
+        }
+
+        /* Move the intercept so that the mean of the linear predictor
+         * does not change, the intercept depends on the coding of the
+         * main effects */
+        size_t k = 0;
+        for(size_t j = 0; j < num_main; j++)
+        {
+            if( matrix.main_effect_snp( j ) == s && k < main->n_elem )
+            {
+                double diff = m_start[ j ] - (*main)[ k++ ];
+                m_start[ num_main ] += diff * arma::mean( null.col( j ) );
+                m_start[ j ] -= diff;
+            }
+        }
+    }
+
+    return m_start;
+}
+
+const arma::vec &
+glm_start::get_null() const
+{
+    return m_previous;
+}
+
+void
+glm_start::add_null(model_matrix &matrix, const snp_row &row1, const snp_row &row2, const arma::vec &beta)
+{
+    add_null( beta );
+
+    const snp_row *rows[ 2 ] = { &row1, &row2 };
+    size_t num_main = matrix.num_null( ) - 1;
+    for(unsigned int s = 0; s < 2; s++)
+    {
+        std::vector<double> main;
+        for(size_t j = 0; j < num_main && j < beta.n_elem; j++)
+        {
+            if( matrix.main_effect_snp( j ) == s )
+            {
+                main.push_back( beta[ j ] );
+            }
+        }
+
+        insert( snp_key( rows[ s ], s ), arma::vec( main ) );
+    }
+}
+
+void
+glm_start::add_null(const arma::vec &beta)
+{
+    m_previous = beta;
+}
+
+const arma::vec *
+glm_start::find(const snp_key &key)
+{
+    std::map<snp_key, snp_list::iterator>::iterator it = m_index.find( key );
+    if( it == m_index.end( ) )
+    {
+        return NULL;
+    }
+
+    m_snps.splice( m_snps.begin( ), m_snps, it->second );
+
+    return &it->second->second;
+}
+
+void
+glm_start::insert(const snp_key &key, const arma::vec &beta)
+{
+    std::map<snp_key, snp_list::iterator>::iterator it = m_index.find( key );
+    if( it != m_index.end( ) )
+    {
+        it->second->second = beta;
+        m_snps.splice( m_snps.begin( ), m_snps, it->second );
+        return;
+    }
+
+    if( m_capacity == 0 )
+    {
+        return;
+    }
+
+    m_snps.push_front( std::make_pair( key, beta ) );
+    m_index[ key ] = m_snps.begin( );
+    if( m_index.size( ) > m_capacity )
+    {
+        m_index.erase( m_snps.back( ).first );
+        m_snps.pop_back( );
+    }
+}
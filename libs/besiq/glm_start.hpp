@@ -0,0 +1,155 @@
+#ifndef __GLM_START_H__
+#define __GLM_START_H__
+
+#include <list>
+#include <map>
+#include <utility>
+
+#include <armadillo>
+
+#include <plink/snp_row.hpp>
+#include <besiq/model_matrix.hpp>
+
+/**
+ * Default number of snps whose main effects are kept by glm_start.
+ */
+const size_t GLM_START_CACHE_SIZE = 1024;
+
+/**
+ * Starting points for the IRLS fits of consecutive pairs, so that
+ * each fit starts close to its estimate instead of from the default
+ * starting point.
+ *
+ * The null model of a pair starts from the null estimate of the
+ * previous pair, with the main effects replaced by the latest
+ * estimate of each snp when it is known. The estimates of the
+ * main effects are kept for the most recently used snps, which
+ * are found again when pairs are traversed in tiles or batches.
+ * The alternative model starts from the null estimate of the same
+ * pair, see model_matrix::null_to_alt.
+ *
+ * The starting points do not change the estimates, only the
+ * number of iterations needed to reach them.
+ */
+class glm_start
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param capacity The number of snps whose main effects are kept.
+     */
+    glm_start(size_t capacity = GLM_START_CACHE_SIZE);
+
+    /**
+     * Copy constructor, the copy starts without any estimates, since
+     * the cache can not share its index with another instance.
+     *
+     * @param other The instance to copy.
+     */
+    glm_start(const glm_start &other);
+
+    /**
+     * Assignment, forgets all estimates, see the copy constructor.
+     *
+     * @param other The instance to copy.
+     *
+     * @return This instance.
+     */
+    glm_start &operator=(const glm_start &other);
+
+    /**
+     * Returns the starting point of the null model of a pair.
+     *
+     * @param matrix The model matrix of the pair.
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     *
+     * @return The starting point, empty if no null model has been
+     *         fitted yet. Valid until the next call.
+     */
+    const arma::vec &get_null(model_matrix &matrix, const snp_row &row1, const snp_row &row2);
+
+    /**
+     * Returns the starting point of the null model when the snps
+     * of the pair are not known, which is the previous estimate.
+     *
+     * @return The starting point, may be empty.
+     */
+    const arma::vec &get_null() const;
+
+    /**
+     * Records the estimate of a null model that was fitted successfully.
+     *
+     * @param matrix The model matrix of the pair.
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param beta The estimated coefficients.
+     */
+    void add_null(model_matrix &matrix, const snp_row &row1, const snp_row &row2, const arma::vec &beta);
+
+    /**
+     * Records the estimate of a null model when the snps of the pair
+     * are not known.
+     *
+     * @param beta The estimated coefficients.
+     */
+    void add_null(const arma::vec &beta);
+
+private:
+    /**
+     * A snp, and whether it was the first (0) or second (1) snp
+     * of the pair, since the coding of the main effects can differ.
+     */
+    typedef std::pair<const snp_row *, unsigned int> snp_key;
+
+    /**
+     * The main effects of the snps, most recently used first.
+     */
+    typedef std::list< std::pair<snp_key, arma::vec> > snp_list;
+
+    /**
+     * Finds the main effects of a snp and marks them as used.
+     *
+     * @param key The snp.
+     *
+     * @return The main effects, or NULL if they are not known.
+     */
+    const arma::vec *find(const snp_key &key);
+
+    /**
+     * Stores the main effects of a snp, and forgets the least
+     * recently used snp if the cache is full.
+     *
+     * @param key The snp.
+     * @param beta The main effects.
+     */
+    void insert(const snp_key &key, const arma::vec &beta);
+
+    /**
+     * The number of snps whose main effects are kept.
+     */
+    size_t m_capacity;
+
+    /**
+     * The null estimate of the previous pair, may be empty.
+     */
+    arma::vec m_previous;
+
+    /**
+     * The starting point returned by get_null.
+     */
+    arma::vec m_start;
+
+    /**
+     * The main effects of the most recently used snps.
+     */
+    snp_list m_snps;
+
+    /**
+     * Position of each snp in m_snps.
+     */
+    std::map<snp_key, snp_list::iterator> m_index;
+};
+
+#endif /* End of __GLM_START_H__ */
@@ -0,0 +1,670 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <besiq/io/pair_generator.hpp>
+
+pair_generator::pair_generator(const std::vector<std::string> &snp_names, const std::vector<pio_locus_t> &loci, const std::vector<double> &maf, const pair_filter &filter)
+    : m_snp_names( snp_names ),
+      m_maf( maf ),
+      m_filter( filter ),
+      m_all_group_pairs( false ),
+      m_ignore_in_set( false ),
+      m_segment_index( 0 ),
+      m_tile_i( 0 ),
+      m_tile_j( 0 ),
+      m_i( 0 ),
+      m_j( 0 ),
+      m_num_candidates( 0 ),
+      m_candidates_left( 0 )
+{
+    for(size_t i = 0; i < loci.size( ); i++)
+    {
+        m_chromosome.push_back( loci[ i ].chromosome );
+        m_position.push_back( loci[ i ].bp_position );
+    }
+
+    m_segment.first = 0;
+    m_segment.second = 0;
+    m_segment.triangle = true;
+}
+
+void
+pair_generator::clear()
+{
+    m_groups.clear( );
+    m_segments.clear( );
+    m_all_group_pairs = false;
+    m_in_set.clear( );
+    m_ignore_in_set = false;
+}
+
+size_t
+pair_generator::add_group(const std::vector<size_t> &snps)
+{
+    std::vector<size_t> group;
+    for(size_t i = 0; i < snps.size( ); i++)
+    {
+        /* Snps without any genotypes have a NaN maf and are left out */
+        double maf = snps[ i ] < m_maf.size( ) ? m_maf[ snps[ i ] ] : -1.0;
+        if( maf == maf && maf >= m_filter.maf_threshold )
+        {
+            group.push_back( snps[ i ] );
+        }
+    }
+
+    m_groups.push_back( group );
+    return m_groups.size( ) - 1;
+}
+
+void
+pair_generator::set_all()
+{
+    clear( );
+
+    std::vector<size_t> all_snps;
+    for(size_t i = 0; i < m_snp_names.size( ); i++)
+    {
+        all_snps.push_back( i );
+    }
+
+    pair_segment segment;
+    segment.first = segment.second = add_group( all_snps );
+    segment.triangle = true;
+    m_segments.push_back( segment );
+}
+
+void
+pair_generator::set_within(const std::map< std::string, std::vector<size_t> > &gene_locus)
+{
+    clear( );
+
+    std::map< std::string, std::vector<size_t> >::const_iterator it;
+    for(it = gene_locus.begin( ); it != gene_locus.end( ); ++it)
+    {
+        pair_segment segment;
+        segment.first = segment.second = add_group( it->second );
+        segment.triangle = true;
+        m_segments.push_back( segment );
+    }
+}
+
+void
+pair_generator::set_between(const std::map< std::string, std::vector<size_t> > &gene_locus)
+{
+    clear( );
+
+    std::map< std::string, std::vector<size_t> >::const_iterator it;
+    for(it = gene_locus.begin( ); it != gene_locus.end( ); ++it)
+    {
+        add_group( it->second );
+    }
+
+    /* Too many to store for large gene sets, so enumerated in next_segment */
+    m_all_group_pairs = true;
+}
+
+void
+pair_generator::set_between(const std::map< std::string, std::vector<size_t> > &gene_locus, const name_pair_vector &gene_gene)
+{
+    clear( );
+
+    std::map<std::string, size_t> gene_group;
+    for(size_t g = 0; g < gene_gene.size( ); g++)
+    {
+        std::string genes[] = { gene_gene[ g ].first, gene_gene[ g ].second };
+        size_t groups[ 2 ];
+        for(int k = 0; k < 2; k++)
+        {
+            if( gene_group.count( genes[ k ] ) == 0 )
+            {
+                std::map< std::string, std::vector<size_t> >::const_iterator it = gene_locus.find( genes[ k ] );
+                gene_group[ genes[ k ] ] = add_group( it != gene_locus.end( ) ? it->second : std::vector<size_t>( ) );
+            }
+            groups[ k ] = gene_group[ genes[ k ] ];
+        }
+
+        pair_segment segment;
+        segment.first = groups[ 0 ];
+        segment.second = groups[ 1 ];
+        segment.triangle = false;
+        m_segments.push_back( segment );
+    }
+}
+
+void
+pair_generator::set_set(const std::set<size_t> &snp_set, bool ignore_in_set)
+{
+    clear( );
+
+    std::vector<size_t> set_snps( snp_set.begin( ), snp_set.end( ) );
+    std::vector<size_t> all_snps;
+    for(size_t i = 0; i < m_snp_names.size( ); i++)
+    {
+        all_snps.push_back( i );
+    }
+
+    pair_segment segment;
+    segment.first = add_group( set_snps );
+    segment.second = add_group( all_snps );
+    segment.triangle = false;
+    m_segments.push_back( segment );
+
+    m_in_set.assign( m_snp_names.size( ), 0 );
+    for(size_t i = 0; i < set_snps.size( ); i++)
+    {
+        if( set_snps[ i ] < m_in_set.size( ) )
+        {
+            m_in_set[ set_snps[ i ] ] = 1;
+        }
+    }
+    m_ignore_in_set = ignore_in_set;
+}
+
+bool
+pair_generator::first_segment()
+{
+    if( m_all_group_pairs )
+    {
+        m_segment.first = 0;
+        m_segment.second = 1;
+        m_segment.triangle = false;
+
+        return m_groups.size( ) >= 2;
+    }
+
+    m_segment_index = 0;
+    if( m_segments.empty( ) )
+    {
+        return false;
+    }
+
+    m_segment = m_segments[ 0 ];
+    return true;
+}
+
+bool
+pair_generator::next_segment()
+{
+    if( m_all_group_pairs )
+    {
+        m_segment.second++;
+        if( m_segment.second >= m_groups.size( ) )
+        {
+            m_segment.first++;
+            m_segment.second = m_segment.first + 1;
+        }
+
+        return m_segment.second < m_groups.size( );
+    }
+
+    m_segment_index++;
+    if( m_segment_index >= m_segments.size( ) )
+    {
+        return false;
+    }
+
+    m_segment = m_segments[ m_segment_index ];
+    return true;
+}
+
+size_t
+pair_generator::tile_end(size_t begin, size_t n) const
+{
+    if( m_filter.tile_size > 0 )
+    {
+        return std::min( begin + m_filter.tile_size, n );
+    }
+    else
+    {
+        return n;
+    }
+}
+
+bool
+pair_generator::first_tile()
+{
+    m_tile_i = 0;
+    m_tile_j = 0;
+
+    return first_segment( );
+}
+
+bool
+pair_generator::next_tile()
+{
+    size_t n1 = m_groups[ m_segment.first ].size( );
+    size_t n2 = m_groups[ m_segment.second ].size( );
+
+    m_tile_j = tile_end( m_tile_j, n2 );
+    if( m_tile_j >= n2 )
+    {
+        m_tile_i = tile_end( m_tile_i, n1 );
+        m_tile_j = m_segment.triangle ? m_tile_i : 0;
+    }
+
+    if( m_tile_i < n1 && m_tile_j < n2 )
+    {
+        return true;
+    }
+
+    m_tile_i = 0;
+    m_tile_j = 0;
+
+    return next_segment( );
+}
+
+bool
+pair_generator::is_diagonal_tile() const
+{
+    return m_segment.triangle && m_tile_i == m_tile_j;
+}
+
+uint64_t
+pair_generator::tile_pairs() const
+{
+    uint64_t rows = tile_end( m_tile_i, m_groups[ m_segment.first ].size( ) ) - m_tile_i;
+    uint64_t cols = tile_end( m_tile_j, m_groups[ m_segment.second ].size( ) ) - m_tile_j;
+    if( is_diagonal_tile( ) )
+    {
+        return rows > 0 ? rows * ( rows - 1 ) / 2 : 0;
+    }
+    else
+    {
+        return rows * cols;
+    }
+}
+
+void
+pair_generator::seek(uint64_t index)
+{
+    bool has_tile = first_tile( );
+    while( has_tile && index >= tile_pairs( ) )
+    {
+        index -= tile_pairs( );
+        has_tile = next_tile( );
+    }
+
+    if( is_diagonal_tile( ) )
+    {
+        uint64_t n = tile_end( m_tile_i, m_groups[ m_segment.first ].size( ) ) - m_tile_i;
+        uint64_t i = 0;
+        while( index >= n - 1 - i )
+        {
+            index -= n - 1 - i;
+            i++;
+        }
+
+        m_i = m_tile_i + i;
+        m_j = m_i + 1 + index;
+    }
+    else
+    {
+        uint64_t cols = tile_end( m_tile_j, m_groups[ m_segment.second ].size( ) ) - m_tile_j;
+        m_i = m_tile_i + index / cols;
+        m_j = m_tile_j + index % cols;
+    }
+}
+
+void
+pair_generator::advance()
+{
+    size_t i_end = tile_end( m_tile_i, m_groups[ m_segment.first ].size( ) );
+    size_t j_end = tile_end( m_tile_j, m_groups[ m_segment.second ].size( ) );
+
+    m_j++;
+    if( m_j < j_end )
+    {
+        return;
+    }
+
+    m_i++;
+    m_j = is_diagonal_tile( ) ? m_i + 1 : m_tile_j;
+    if( m_i < i_end && m_j < j_end )
+    {
+        return;
+    }
+
+    while( next_tile( ) )
+    {
+        if( tile_pairs( ) > 0 )
+        {
+            m_i = m_tile_i;
+            m_j = is_diagonal_tile( ) ? m_i + 1 : m_tile_j;
+            return;
+        }
+    }
+}
+
+bool
+pair_generator::keep(size_t snp1, size_t snp2) const
+{
+    if( !m_in_set.empty( ) && m_in_set[ snp2 ] && ( m_ignore_in_set || snp2 <= snp1 ) )
+    {
+        return false;
+    }
+
+    if( m_chromosome[ snp1 ] == m_chromosome[ snp2 ] && !( std::abs( m_position[ snp1 ] - m_position[ snp2 ] ) >= m_filter.pos_threshold ) )
+    {
+        return false;
+    }
+
+    return m_maf[ snp1 ] * m_maf[ snp2 ] >= m_filter.combined_threshold;
+}
+
+bool
+pair_generator::open(size_t split, size_t num_splits)
+{
+    if( split == 0 || num_splits == 0 || split > num_splits )
+    {
+        return false;
+    }
+
+    uint64_t total = 0;
+    for(bool has_tile = first_tile( ); has_tile; has_tile = next_tile( ))
+    {
+        total += tile_pairs( );
+    }
+
+    uint64_t pairs_per_split = ( total + num_splits - 1 ) / num_splits;
+    uint64_t start = pairs_per_split * ( split - 1 );
+    m_num_candidates = start < total ? std::min( pairs_per_split, total - start ) : 0;
+    m_candidates_left = m_num_candidates;
+
+    if( m_candidates_left > 0 )
+    {
+        seek( start );
+    }
+
+    return true;
+}
+
+void
+pair_generator::close()
+{
+    m_candidates_left = 0;
+}
+
+bool
+pair_generator::read(std::pair<size_t, size_t> &pair)
+{
+    while( m_candidates_left > 0 )
+    {
+        size_t snp1 = m_groups[ m_segment.first ][ m_i ];
+        size_t snp2 = m_groups[ m_segment.second ][ m_j ];
+
+        m_candidates_left--;
+        if( m_candidates_left > 0 )
+        {
+            advance( );
+        }
+
+        if( keep( snp1, snp2 ) )
+        {
+            pair.first = snp1;
+            pair.second = snp2;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+pair_generator::read(std::pair<std::string, std::string> &pair)
+{
+    std::pair<size_t, size_t> index_pair;
+    if( !read( index_pair ) )
+    {
+        return false;
+    }
+
+    pair.first = m_snp_names[ index_pair.first ];
+    pair.second = m_snp_names[ index_pair.second ];
+
+    return true;
+}
+
+const std::vector<std::string> &
+pair_generator::get_snp_names()
+{
+    return m_snp_names;
+}
+
+bool
+pair_generator::write(size_t snp1_id1, size_t snp2_id2)
+{
+    return false;
+}
+
+size_t
+pair_generator::num_pairs()
+{
+    return m_num_candidates;
+}
+
+name_pair_vector
+parse_genes(const std::string &path)
+{
+    name_pair_vector pairs;
+    std::ifstream gene_file( path.c_str( ) );
+    while( gene_file.good( ) )
+    {
+        std::string gene1;
+        std::string gene2;
+
+        if( ( gene_file >> gene1 ) && ( gene_file >> gene2 ) )
+        {
+            pairs.push_back( std::make_pair( gene1, gene2 ) );
+        }
+    }
+
+    return pairs;
+}
+
+/**
+ * Creates an opposite map of a vector, which is
+ * indexed by the value and maps to the key, in this
+ * case the index of the vector.
+ *
+ * @param loci A list of locus names.
+ *
+ * @return A map from locus name to its index.
+ */
+std::map< std::string, size_t >
+create_loci_index(const std::vector<std::string> &loci)
+{
+    std::map< std::string, size_t > index;
+    for(int i = 0; i < loci.size( ); i++)
+    {
+        index[ loci[ i ] ] = i;
+    }
+
+    return index;
+}
+
+std::set<size_t>
+parse_set(const std::string &path, const std::vector<std::string> &loci)
+{
+    std::ifstream set_file( path.c_str( ) );
+    std::map< std::string, size_t > index = create_loci_index( loci );
+    std::set< size_t > snp_set;
+    while( set_file.good( ) )
+    {
+        std::string snp_name;
+        if( ( set_file >> snp_name ) && index.count( snp_name ) > 0 )
+        {
+            snp_set.insert( index[ snp_name ] );
+        }
+    }
+
+    return snp_set;
+}
+
+std::map< std::string, std::vector<size_t> >
+parse_gene_locus(const std::string &path, const std::vector<std::string> &loci)
+{
+    std::map< std::string, std::vector<size_t> > gene_locus;
+    std::map< std::string, size_t > index = create_loci_index( loci );
+    std::ifstream gene_locus_file( path.c_str( ) );
+    while( gene_locus_file.good( ) )
+    {
+        std::string gene;
+        std::string locus;
+
+        if( ( gene_locus_file >> gene ) && ( gene_locus_file >> locus ) && index.count( locus ) > 0 )
+        {
+            gene_locus[ gene ].push_back( index[ locus ] );
+        }
+    }
+
+    return gene_locus;
+}
+
+/**
+ * Returns the mode of a pair specification, i.e. the part
+ * before the first colon.
+ *
+ * @param spec The pair specification.
+ *
+ * @return The mode of the pair specification.
+ */
+std::string
+get_spec_mode(const std::string &spec)
+{
+    return spec.substr( 0, spec.find( ':' ) );
+}
+
+/**
+ * Parses a number in a pair specification.
+ *
+ * @param str The string to parse.
+ * @param value The parsed value will be stored here.
+ *
+ * @return True if the whole string could be parsed, false otherwise.
+ */
+bool
+parse_spec_number(const std::string &str, double &value)
+{
+    char *end = NULL;
+    value = strtod( str.c_str( ), &end );
+
+    return !str.empty( ) && *end == '\0';
+}
+
+bool
+is_pair_spec(const std::string &spec)
+{
+    std::string mode = get_spec_mode( spec );
+    if( mode != "all" && mode != "within" && mode != "between" && mode != "set" && mode != "set-no-ignore" )
+    {
+        return false;
+    }
+
+    FILE *fp = fopen( spec.c_str( ), "r" );
+    if( fp != NULL )
+    {
+        fclose( fp );
+        return false;
+    }
+
+    return true;
+}
+
+pair_generator *
+create_pair_generator(const std::string &spec, const std::vector<std::string> &snp_names, const std::vector<pio_locus_t> &loci, const std::vector<double> &maf)
+{
+    std::string mode = get_spec_mode( spec );
+
+    /* Parse key=value options */
+    std::map<std::string, std::string> values;
+    if( mode.size( ) < spec.size( ) )
+    {
+        std::istringstream option_stream( spec.substr( mode.size( ) + 1 ) );
+        std::string option;
+        while( std::getline( option_stream, option, ',' ) )
+        {
+            size_t eq = option.find( '=' );
+            if( eq == std::string::npos )
+            {
+                return NULL;
+            }
+
+            values[ option.substr( 0, eq ) ] = option.substr( eq + 1 );
+        }
+    }
+
+    pair_filter filter;
+    std::map<std::string, std::string>::const_iterator it;
+    for(it = values.begin( ); it != values.end( ); ++it)
+    {
+        double value = 0.0;
+        if( it->first == "file" || it->first == "restrict" )
+        {
+            continue;
+        }
+        else if( !parse_spec_number( it->second, value ) )
+        {
+            return NULL;
+        }
+
+        if( it->first == "maf" )
+        {
+            filter.maf_threshold = value;
+        }
+        else if( it->first == "combined" )
+        {
+            filter.combined_threshold = value;
+        }
+        else if( it->first == "dist" )
+        {
+            filter.pos_threshold = (long long) value;
+        }
+        else if( it->first == "tile" && value >= 0 )
+        {
+            filter.tile_size = (size_t) value;
+        }
+        else
+        {
+            return NULL;
+        }
+    }
+
+    bool needs_file = mode != "all";
+    if( needs_file != ( values.count( "file" ) > 0 ) || ( values.count( "restrict" ) > 0 && mode != "between" ) )
+    {
+        return NULL;
+    }
+
+    pair_generator *generator = new pair_generator( snp_names, loci, maf, filter );
+    if( mode == "all" )
+    {
+        generator->set_all( );
+    }
+    else if( mode == "within" )
+    {
+        generator->set_within( parse_gene_locus( values[ "file" ], snp_names ) );
+    }
+    else if( mode == "between" && values.count( "restrict" ) > 0 )
+    {
+        generator->set_between( parse_gene_locus( values[ "file" ], snp_names ), parse_genes( values[ "restrict" ] ) );
+    }
+    else if( mode == "between" )
+    {
+        generator->set_between( parse_gene_locus( values[ "file" ], snp_names ) );
+    }
+    else if( mode == "set" || mode == "set-no-ignore" )
+    {
+        generator->set_set( parse_set( values[ "file" ], snp_names ), mode == "set" );
+    }
+    else
+    {
+        delete generator;
+        return NULL;
+    }
+
+    return generator;
+}
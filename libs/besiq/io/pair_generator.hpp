@@ -0,0 +1,413 @@
+#ifndef __PAIR_GENERATOR_H__
+#define __PAIR_GENERATOR_H__
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <plinkio/plinkio.h>
+
+#include <besiq/io/pairfile.hpp>
+
+/**
+ * A list of pairs of names, such as pairs of genes.
+ */
+typedef std::vector< std::pair<std::string, std::string> > name_pair_vector;
+
+/**
+ * Filters that determine which pairs of snps are generated.
+ */
+struct pair_filter
+{
+    /**
+     * Constructor, by default no pairs are removed.
+     */
+    pair_filter()
+        : maf_threshold( 0.0 ),
+          combined_threshold( 0.0 ),
+          pos_threshold( 0 ),
+          tile_size( 0 )
+    {
+    }
+
+    /**
+     * Snps with a minor allele frequency less than this are removed.
+     */
+    double maf_threshold;
+
+    /**
+     * Pairs where the product of the mafs is less than this are removed.
+     */
+    double combined_threshold;
+
+    /**
+     * Smallest allowable distance between two snps on the same chromosome.
+     */
+    long long pos_threshold;
+
+    /**
+     * If non-zero, pairs are generated in tiles of this many snps
+     * from each group so that the rows stay in the cache.
+     */
+    size_t tile_size;
+};
+
+/**
+ * A range of candidate pairs, either all pairs i < j of a single
+ * group, or all pairs between two groups.
+ */
+struct pair_segment
+{
+    /**
+     * Group of the first snp.
+     */
+    size_t first;
+
+    /**
+     * Group of the second snp.
+     */
+    size_t second;
+
+    /**
+     * If true, only pairs i < j within the first group are generated.
+     */
+    bool triangle;
+};
+
+/**
+ * A pair file that enumerates pairs on the fly instead of reading
+ * them from disk. The pairs are generated in the same order as they
+ * are written by besiq-pairs.
+ *
+ * The candidate pairs are enumerated in segments, and splits are
+ * computed arithmetically on the candidate pairs before the pair
+ * filters are applied, so splits may differ somewhat in the number
+ * of generated pairs.
+ *
+ * When a tile size is given, each segment is traversed in tiles of
+ * tile_size x tile_size snps, so that a small set of rows are reused
+ * for many consecutive pairs.
+ */
+class pair_generator : public pairfile
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param snp_names Names of all snps.
+     * @param loci Information about all snps, used for the distance filter.
+     * @param maf Minor allele frequency of all snps, NaN for snps where
+     *            all samples are missing, which are never paired.
+     * @param filter Filters to apply.
+     */
+    pair_generator(const std::vector<std::string> &snp_names, const std::vector<pio_locus_t> &loci, const std::vector<double> &maf, const pair_filter &filter);
+
+    /**
+     * Generates all pairs of snps.
+     */
+    void set_all();
+
+    /**
+     * Generates all pairs of snps within each gene.
+     *
+     * @param gene_locus Map from gene to the snps in that gene.
+     */
+    void set_within(const std::map< std::string, std::vector<size_t> > &gene_locus);
+
+    /**
+     * Generates all pairs of snps between each pair of genes.
+     *
+     * @param gene_locus Map from gene to the snps in that gene.
+     */
+    void set_between(const std::map< std::string, std::vector<size_t> > &gene_locus);
+
+    /**
+     * Generates all pairs of snps between the given pairs of genes.
+     *
+     * @param gene_locus Map from gene to the snps in that gene.
+     * @param gene_gene The pairs of genes.
+     */
+    void set_between(const std::map< std::string, std::vector<size_t> > &gene_locus, const name_pair_vector &gene_gene);
+
+    /**
+     * Generates all pairs where one of the snps is in the given set.
+     *
+     * @param snp_set Set of snps.
+     * @param ignore_in_set If true, ignore pairs where both snps are in the set.
+     */
+    void set_set(const std::set<size_t> &snp_set, bool ignore_in_set);
+
+    bool open(size_t split = 1, size_t num_splits = 1);
+    void close();
+    bool read(std::pair<std::string, std::string> &pair);
+    bool read(std::pair<size_t, size_t> &pair);
+    const std::vector<std::string> &get_snp_names();
+
+    /**
+     * Pairs can not be written to a generator.
+     *
+     * @return Always false.
+     */
+    bool write(size_t snp1_id1, size_t snp2_id2);
+
+    /**
+     * Returns the number of candidate pairs in the opened split,
+     * this includes pairs that will be removed by the filters.
+     *
+     * @return The number of candidate pairs.
+     */
+    size_t num_pairs();
+
+private:
+    /**
+     * Adds a group of snps, snps that do not pass the
+     * maf threshold are removed.
+     *
+     * @param snps The snps in the group.
+     *
+     * @return The index of the group.
+     */
+    size_t add_group(const std::vector<size_t> &snps);
+
+    /**
+     * Removes all groups and segments.
+     */
+    void clear();
+
+    /**
+     * Moves to the first segment.
+     *
+     * @return False if there are no segments.
+     */
+    bool first_segment();
+
+    /**
+     * Moves to the next segment.
+     *
+     * @return False if there are no more segments.
+     */
+    bool next_segment();
+
+    /**
+     * Returns the end of the tile that starts at the given position.
+     *
+     * @param begin Start of the tile.
+     * @param n Number of snps in the group.
+     *
+     * @return The end of the tile.
+     */
+    size_t tile_end(size_t begin, size_t n) const;
+
+    /**
+     * Moves to the first tile of the first segment.
+     *
+     * @return False if there are no segments.
+     */
+    bool first_tile();
+
+    /**
+     * Moves to the next tile, which may be in the next segment.
+     *
+     * @return False if there are no more tiles.
+     */
+    bool next_tile();
+
+    /**
+     * Determines whether the current tile is on the diagonal of
+     * a triangle segment, in which only pairs i < j are generated.
+     *
+     * @return True if the current tile is on the diagonal.
+     */
+    bool is_diagonal_tile() const;
+
+    /**
+     * Returns the number of candidate pairs in the current tile.
+     *
+     * @return The number of candidate pairs in the current tile.
+     */
+    uint64_t tile_pairs() const;
+
+    /**
+     * Moves to the candidate pair with the given index.
+     *
+     * @param index Index of the candidate pair.
+     */
+    void seek(uint64_t index);
+
+    /**
+     * Moves to the next candidate pair.
+     */
+    void advance();
+
+    /**
+     * Determines whether a pair passes the pair filters.
+     *
+     * @param snp1 The first snp.
+     * @param snp2 The second snp.
+     *
+     * @return True if the pair should be generated.
+     */
+    bool keep(size_t snp1, size_t snp2) const;
+
+    /**
+     * Names of all snps.
+     */
+    std::vector<std::string> m_snp_names;
+
+    /**
+     * Chromosome of each snp.
+     */
+    std::vector<unsigned char> m_chromosome;
+
+    /**
+     * Position of each snp.
+     */
+    std::vector<long long> m_position;
+
+    /**
+     * Minor allele frequency of each snp.
+     */
+    std::vector<double> m_maf;
+
+    /**
+     * The filters to apply.
+     */
+    pair_filter m_filter;
+
+    /**
+     * Groups of snps that pairs are generated from.
+     */
+    std::vector< std::vector<size_t> > m_groups;
+
+    /**
+     * The segments to enumerate, not used when m_all_group_pairs is set.
+     */
+    std::vector<pair_segment> m_segments;
+
+    /**
+     * If true, the segments are all pairs of groups, which are
+     * not stored explicitly.
+     */
+    bool m_all_group_pairs;
+
+    /**
+     * Non-zero for snps in the set, only used for sets.
+     */
+    std::vector<char> m_in_set;
+
+    /**
+     * If true, pairs where both snps are in the set are ignored.
+     */
+    bool m_ignore_in_set;
+
+    /**
+     * Index of the current segment in m_segments.
+     */
+    size_t m_segment_index;
+
+    /**
+     * The current segment.
+     */
+    pair_segment m_segment;
+
+    /**
+     * Start of the current tile in the first group.
+     */
+    size_t m_tile_i;
+
+    /**
+     * Start of the current tile in the second group.
+     */
+    size_t m_tile_j;
+
+    /**
+     * Position of the first snp in the first group.
+     */
+    size_t m_i;
+
+    /**
+     * Position of the second snp in the second group.
+     */
+    size_t m_j;
+
+    /**
+     * Number of candidate pairs in the opened split.
+     */
+    uint64_t m_num_candidates;
+
+    /**
+     * Number of candidate pairs left to enumerate.
+     */
+    uint64_t m_candidates_left;
+};
+
+/**
+ * Parses a file in which each line contains two names.
+ *
+ * @param path Path of the file.
+ *
+ * @return The parsed pairs of names.
+ */
+name_pair_vector parse_genes(const std::string &path);
+
+/**
+ * Parses a file in which each line contains a snp name.
+ *
+ * @param path Path of the file.
+ * @param loci A list of locus names.
+ *
+ * @return The index of the parsed snps.
+ */
+std::set<size_t> parse_set(const std::string &path, const std::vector<std::string> &loci);
+
+/**
+ * Parses a file in which each line contains a gene name and
+ * a locus, effectively grouping each snp in genes. Loci that
+ * are not in the list of locus names are ignored.
+ *
+ * @param path Path to the file.
+ * @param loci A list of locus names.
+ *
+ * @return A map from gene name to a list of loci.
+ */
+std::map< std::string, std::vector<size_t> > parse_gene_locus(const std::string &path, const std::vector<std::string> &loci);
+
+/**
+ * Determines whether the given string is a pair specification
+ * rather than a path to a pair file. A pair specification is one
+ * of all, within, between, set or set-no-ignore, optionally followed
+ * by a colon and a comma separated list of key=value options:
+ *
+ *   maf       Smallest maf of each snp.
+ *   combined  Smallest product of the mafs of the two snps.
+ *   dist      Smallest distance between two snps on the same chromosome.
+ *   file      The gene-locus file (within, between) or snp set (set, set-no-ignore).
+ *   restrict  Only the pairs of genes in this file (between).
+ *   tile      Generate the pairs in tiles of this many snps.
+ *
+ * For example all:maf=0.05,dist=1e6. Existing files are never
+ * treated as specifications.
+ *
+ * @param spec The string to check.
+ *
+ * @return True if the string is a pair specification.
+ */
+bool is_pair_spec(const std::string &spec);
+
+/**
+ * Creates a pair generator from a pair specification.
+ *
+ * @param spec The pair specification, see is_pair_spec.
+ * @param snp_names Names of all snps.
+ * @param loci Information about all snps.
+ * @param maf Minor allele frequency of all snps.
+ *
+ * @return A pair generator, or NULL if the specification
+ *         could not be parsed.
+ */
+pair_generator *create_pair_generator(const std::string &spec, const std::vector<std::string> &snp_names, const std::vector<pio_locus_t> &loci, const std::vector<double> &maf);
+
+#endif /* End of __PAIR_GENERATOR_H__ */
@@ -2,11 +2,14 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <queue>
 
 #include <besiq/io/misc.hpp>
 #include <besiq/io/pairfile.hpp>
 
 #define BLOCK_SIZE 4194304ULL
+#define SORT_CHUNK_SIZE 67108864ULL
+#define MERGE_BUFFER_SIZE 65536ULL
 
 bpairfile::bpairfile(const std::string &path)
     : m_path( path ),
@@ -149,6 +152,28 @@ bpairfile::read(std::pair<std::string, std::string> &pair)
     return true;
 }
 
+bool
+bpairfile::read(std::pair<size_t, size_t> &pair)
+{
+    if( m_mode != "r" || m_fp == NULL || m_pairs_left <= 0 )
+    {
+        return false;
+    }
+
+    uint32_t read_pair[ 2 ];
+    size_t bytes_read = fread( read_pair, sizeof( uint32_t ), 2, m_fp );
+    if( bytes_read != 2 )
+    {
+        return false;
+    }
+
+    pair.first = read_pair[ 0 ] < m_snp_names.size( ) ? read_pair[ 0 ] : PAIR_MISSING_ID;
+    pair.second = read_pair[ 1 ] < m_snp_names.size( ) ? read_pair[ 1 ] : PAIR_MISSING_ID;
+    m_pairs_left--;
+
+    return true;
+}
+
 bool
 bpairfile::write(size_t snp_id1, size_t snp_id2)
 {
@@ -291,6 +316,29 @@ bool tpairfile::read(std::pair<std::string, std::string> &pair)
     return true;
 }
 
+bool tpairfile::read(std::pair<size_t, size_t> &pair)
+{
+    std::pair<std::string, std::string> name_pair;
+    if( !read( name_pair ) )
+    {
+        return false;
+    }
+
+    std::map<std::string, size_t>::const_iterator snp1 = m_snp_to_index.find( name_pair.first );
+    std::map<std::string, size_t>::const_iterator snp2 = m_snp_to_index.find( name_pair.second );
+
+    pair.first = snp1 != m_snp_to_index.end( ) ? snp1->second : PAIR_MISSING_ID;
+    pair.second = snp2 != m_snp_to_index.end( ) ? snp2->second : PAIR_MISSING_ID;
+
+    return true;
+}
+
+const std::vector<std::string> &
+tpairfile::get_snp_names()
+{
+    return m_snp_names;
+}
+
 bool tpairfile::write(size_t snp1_id, size_t snp2_id)
 {
     *m_output << m_snp_names[ snp1_id ] << " " << m_snp_names[ snp2_id ] << "\n";
@@ -343,6 +391,41 @@ open_pair_file(const std::string &path, const std::vector<std::string> &snp_name
     }
 }
 
+std::vector<bool>
+find_split_snps(bpairfile &pairs, size_t split, size_t num_splits)
+{
+    if( !pairs.open( split, num_splits ) )
+    {
+        return std::vector<bool>( );
+    }
+
+    std::vector<bool> used( pairs.get_snp_names( ).size( ), false );
+    size_t num_used = 0;
+    std::pair<size_t, size_t> pair;
+
+    /* Stop early when all snps are used, e.g. for all pairs */
+    while( num_used < used.size( ) && pairs.read( pair ) )
+    {
+        if( pair.first == PAIR_MISSING_ID || pair.second == PAIR_MISSING_ID )
+        {
+            continue;
+        }
+
+        if( !used[ pair.first ] )
+        {
+            used[ pair.first ] = true;
+            num_used++;
+        }
+        if( !used[ pair.second ] )
+        {
+            used[ pair.second ] = true;
+            num_used++;
+        }
+    }
+
+    return used;
+}
+
 bool write_pairs_in_block(uint32_t *snp_buffer, uint64_t num_pairs, FILE *in_fp, FILE *out_fp)
 {
     for(int64_t block_pairs_left = num_pairs; block_pairs_left > 0; block_pairs_left -= BLOCK_SIZE )
@@ -470,4 +553,272 @@ split_error:
     return !error;
 }
 
+/**
+ * A pair of snp ids as it is stored in a binary pair file.
+ */
+struct pair_entry
+{
+    uint32_t snp1;
+    uint32_t snp2;
+};
+
+/**
+ * Orders pairs by the tile they belong to, and then by the
+ * snp ids within the tile.
+ */
+class tile_order
+{
+public:
+    tile_order(size_t tile_size)
+        : m_tile_size( tile_size )
+    {
+    }
+
+    bool operator()(const pair_entry &a, const pair_entry &b) const
+    {
+        size_t tile_a1 = a.snp1 / m_tile_size;
+        size_t tile_b1 = b.snp1 / m_tile_size;
+        if( tile_a1 != tile_b1 )
+        {
+            return tile_a1 < tile_b1;
+        }
+
+        size_t tile_a2 = a.snp2 / m_tile_size;
+        size_t tile_b2 = b.snp2 / m_tile_size;
+        if( tile_a2 != tile_b2 )
+        {
+            return tile_a2 < tile_b2;
+        }
+
+        if( a.snp1 != b.snp1 )
+        {
+            return a.snp1 < b.snp1;
+        }
+
+        return a.snp2 < b.snp2;
+    }
+
+private:
+    size_t m_tile_size;
+};
+
+/**
+ * A sorted run of pairs in a temporary file that is read in blocks
+ * during the merge.
+ */
+struct pair_run
+{
+    FILE *fp;
+    uint64_t pairs_left;
+    std::vector<pair_entry> buffer;
+    size_t pos;
+};
+
+/**
+ * The next pair of a run together with the index of the run.
+ */
+typedef std::pair<pair_entry, size_t> run_entry;
+
+/**
+ * Orders run entries so that the smallest pair is on top
+ * of a priority queue.
+ */
+class run_order
+{
+public:
+    run_order(const tile_order &order)
+        : m_order( order )
+    {
+    }
+
+    bool operator()(const run_entry &a, const run_entry &b) const
+    {
+        return m_order( b.first, a.first );
+    }
+
+private:
+    tile_order m_order;
+};
+
+/**
+ * Reads the next block of a run if the buffer is exhausted.
+ *
+ * @param run The run.
+ *
+ * @return True if there is at least one pair in the buffer.
+ */
+bool fill_run(pair_run &run)
+{
+    if( run.pos < run.buffer.size( ) )
+    {
+        return true;
+    }
+    if( run.pairs_left == 0 )
+    {
+        return false;
+    }
+
+    run.buffer.resize( std::min( run.pairs_left, (uint64_t) MERGE_BUFFER_SIZE ) );
+    run.pos = 0;
+    if( fread( &run.buffer[ 0 ], sizeof( pair_entry ), run.buffer.size( ), run.fp ) != run.buffer.size( ) )
+    {
+        run.buffer.clear( );
+        return false;
+    }
+    run.pairs_left -= run.buffer.size( );
+
+    return true;
+}
+
+/**
+ * Merges sorted runs into the output file.
+ *
+ * @param runs The sorted runs.
+ * @param order The order of the pairs.
+ * @param out_fp The output file.
+ *
+ * @return True if all pairs could be merged, false otherwise.
+ */
+bool merge_runs(std::vector<pair_run> &runs, const tile_order &order, FILE *out_fp)
+{
+    std::priority_queue<run_entry, std::vector<run_entry>, run_order> queue( ( run_order( order ) ) );
+
+    uint64_t num_pairs = 0;
+    for(size_t i = 0; i < runs.size( ); i++)
+    {
+        num_pairs += runs[ i ].pairs_left;
+        if( fill_run( runs[ i ] ) )
+        {
+            queue.push( std::make_pair( runs[ i ].buffer[ runs[ i ].pos++ ], i ) );
+        }
+    }
+
+    std::vector<pair_entry> out_buffer;
+    out_buffer.reserve( MERGE_BUFFER_SIZE );
+    uint64_t num_written = 0;
+    while( !queue.empty( ) )
+    {
+        run_entry top = queue.top( );
+        queue.pop( );
+
+        out_buffer.push_back( top.first );
+        if( out_buffer.size( ) == MERGE_BUFFER_SIZE )
+        {
+            if( fwrite( &out_buffer[ 0 ], sizeof( pair_entry ), out_buffer.size( ), out_fp ) != out_buffer.size( ) )
+            {
+                return false;
+            }
+            num_written += out_buffer.size( );
+            out_buffer.clear( );
+        }
+
+        pair_run &run = runs[ top.second ];
+        if( fill_run( run ) )
+        {
+            queue.push( std::make_pair( run.buffer[ run.pos++ ], top.second ) );
+        }
+    }
+
+    if( !out_buffer.empty( ) )
+    {
+        if( fwrite( &out_buffer[ 0 ], sizeof( pair_entry ), out_buffer.size( ), out_fp ) != out_buffer.size( ) )
+        {
+            return false;
+        }
+        num_written += out_buffer.size( );
+    }
+
+    return num_written == num_pairs;
+}
+
+bool sort_pair_file(const std::string &input_path, size_t tile_size, const std::string &output_path)
+{
+    if( tile_size == 0 )
+    {
+        return false;
+    }
+
+    FILE *fp = fopen( input_path.c_str( ), "r" );
+    if( fp == NULL )
+    {
+        return false;
+    }
+
+    bpair_header header;
+    char *buffer = parse_header( fp, &header );
+    if( buffer == NULL )
+    {
+        return false;
+    }
+
+    /* Sort chunks that fit in memory into temporary runs */
+    tile_order order( tile_size );
+    bool error = false;
+    std::vector<pair_run> runs;
+    std::vector<std::string> run_paths;
+    std::vector<pair_entry> chunk;
+    for(uint64_t pairs_left = header.num_pairs; pairs_left > 0 && !error; )
+    {
+        chunk.resize( std::min( pairs_left, (uint64_t) SORT_CHUNK_SIZE ) );
+        if( fread( &chunk[ 0 ], sizeof( pair_entry ), chunk.size( ), fp ) != chunk.size( ) )
+        {
+            error = true;
+            break;
+        }
+        pairs_left -= chunk.size( );
+        std::sort( chunk.begin( ), chunk.end( ), order );
+
+        std::stringstream ss;
+        ss << output_path << ".run" << runs.size( ) + 1;
+        run_paths.push_back( ss.str( ) );
+
+        pair_run run;
+        run.fp = fopen( run_paths.back( ).c_str( ), "w+" );
+        run.pairs_left = chunk.size( );
+        run.pos = 0;
+        if( run.fp == NULL )
+        {
+            error = true;
+            break;
+        }
+        runs.push_back( run );
+
+        if( fwrite( &chunk[ 0 ], sizeof( pair_entry ), chunk.size( ), run.fp ) != chunk.size( ) )
+        {
+            error = true;
+        }
+        fseek( run.fp, 0L, SEEK_SET );
+    }
+    fclose( fp );
+    std::vector<pair_entry>( ).swap( chunk );
+
+    /* Merge the runs into the output file */
+    if( !error )
+    {
+        FILE *out_fp = fopen( output_path.c_str( ), "w" );
+        if( out_fp == NULL ||
+            fwrite( &header, sizeof( bpair_header ), 1, out_fp ) != 1 ||
+            fwrite( buffer, 1, header.header_length, out_fp ) != header.header_length ||
+            !merge_runs( runs, order, out_fp ) )
+        {
+            error = true;
+        }
 
+        if( out_fp != NULL )
+        {
+            fclose( out_fp );
+        }
+    }
+
+    for(size_t i = 0; i < runs.size( ); i++)
+    {
+        fclose( runs[ i ].fp );
+    }
+    for(size_t i = 0; i < run_paths.size( ); i++)
+    {
+        remove( run_paths[ i ].c_str( ) );
+    }
+    free( buffer );
+
+    return !error;
+}
@@ -10,6 +10,13 @@
 #include <stdio.h>
 
 #define PAIR_CUR_VERSION 0x5cf2d3f2
+
+/**
+ * Index returned by pairfile::read for snps that are not in
+ * the list of snp names.
+ */
+const size_t PAIR_MISSING_ID = (size_t) -1;
+
 /**
  * Defines the header.
  */
@@ -47,6 +54,25 @@ public:
     virtual bool open(size_t split = 1, size_t num_splits = 1) = 0;
     virtual void close() = 0;
     virtual bool read(std::pair<std::string, std::string> &pair) = 0;
+
+    /**
+     * Reads a pair as indices into get_snp_names( ), which avoids
+     * creating and looking up strings for each pair.
+     *
+     * @param pair The indices of the snps will be written here, a snp
+     *             that is not in get_snp_names( ) is given PAIR_MISSING_ID.
+     *
+     * @return True if a pair could be read, false otherwise.
+     */
+    virtual bool read(std::pair<size_t, size_t> &pair) = 0;
+
+    /**
+     * Returns the names of the snps that the indices refer to.
+     *
+     * @return The names of the snps that the indices refer to.
+     */
+    virtual const std::vector<std::string> &get_snp_names() = 0;
+
     virtual bool write(size_t snp1_id1, size_t snp2_id2) = 0;
     virtual size_t num_pairs() = 0;
     virtual ~pairfile(){ };
@@ -61,6 +87,8 @@ public:
     bool open(size_t split = 1, size_t num_splits = 1);
     void close();
     bool read(std::pair<std::string, std::string> &pair);
+    bool read(std::pair<size_t, size_t> &pair);
+    const std::vector<std::string> &get_snp_names();
     bool write(size_t snp1_id1, size_t snp2_id2);
     size_t num_pairs();
 private:
@@ -100,6 +128,7 @@ public:
     const std::vector<std::string> & get_snp_names();
 
     bool read(std::pair<std::string, std::string> &pair);
+    bool read(std::pair<size_t, size_t> &pair);
     bool write(size_t snp_id1, size_t snp_id2);
     size_t num_pairs();
 
@@ -128,4 +157,32 @@ private:
 pairfile * open_pair_file(const std::string &path, const std::vector<std::string> &snp_names);
 bool split_pair_file(const std::string &all_pairs, size_t num_splits, const std::string &output_path);
 
+/**
+ * Finds the snps that are part of at least one pair in the given
+ * split of a binary pair file. The file has to be opened again
+ * before the pairs are read.
+ *
+ * @param pairs The pair file.
+ * @param split The split to read, 1-based.
+ * @param num_splits The number of splits.
+ *
+ * @return True for each snp in get_snp_names( ) that is part of a
+ *         pair, or an empty vector if the file could not be opened.
+ */
+std::vector<bool> find_split_snps(bpairfile &pairs, size_t split, size_t num_splits);
+
+/**
+ * Sorts a binary pair file into tile order, i.e. the pairs are ordered
+ * by (snp1 / tile_size, snp2 / tile_size) so that consecutive pairs
+ * share a small set of snps. Large files are sorted in chunks that
+ * are merged from temporary files next to the output file.
+ *
+ * @param input_path Path to the pair file to sort.
+ * @param tile_size Number of snps in each tile.
+ * @param output_path Path to the sorted pair file.
+ *
+ * @return True if the pairs could be sorted, false otherwise.
+ */
+bool sort_pair_file(const std::string &input_path, size_t tile_size, const std::string &output_path);
+
 #endif /* End of __BINARY_PAIR_H__ */
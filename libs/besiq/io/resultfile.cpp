@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <sys/stat.h>
 
 #include <besiq/io/misc.hpp>
@@ -135,7 +137,18 @@ bresultfile::write(const std::pair<std::string, std::string> &pair, float *value
         return false;
     }
 
-    uint32_t write_pair[] = { (uint32_t) snp1->second, (uint32_t) snp2->second };
+    return write( snp1->second, snp2->second, values );
+}
+
+bool
+bresultfile::write(size_t snp1, size_t snp2, float *values)
+{
+    if( m_mode != "w" || m_fp == NULL || snp1 >= m_snp_names.size( ) || snp2 >= m_snp_names.size( ) )
+    {
+        return false;
+    }
+
+    uint32_t write_pair[] = { (uint32_t) snp1, (uint32_t) snp2 };
     size_t n_snp = fwrite( write_pair, sizeof( uint32_t ), 2, m_fp );
     size_t n_cols = fwrite( values, sizeof( float ), m_header.num_float_cols, m_fp );
     if( n_snp == 2 && n_cols == m_header.num_float_cols )
@@ -245,13 +258,14 @@ bresultfile::is_corrupted()
     return num_pairs != m_header.num_pairs;
 }
 
-tresultfile::tresultfile(const std::string &path, const std::string &mode)
+tresultfile::tresultfile(const std::string &path, const std::string &mode, const std::vector<std::string> &snp_names)
     : m_mode( mode ), 
       m_path( path ),
       m_input( NULL ),
       m_output( NULL ),
       m_num_pairs( 0 ),
-      m_written( false )
+      m_written( false ),
+      m_snp_names( snp_names )
 {
 
 }
@@ -354,6 +368,28 @@ tresultfile::write(const std::pair<std::string, std::string> &pair, float *value
     }
 
     *m_output << pair.first << " " << pair.second;
+    write_values( values );
+
+    return true;
+}
+
+bool
+tresultfile::write(size_t snp1, size_t snp2, float *values)
+{
+    if( m_output == NULL || !m_written || snp1 >= m_snp_names.size( ) || snp2 >= m_snp_names.size( ) )
+    {
+        return false;
+    }
+
+    *m_output << m_snp_names[ snp1 ] << " " << m_snp_names[ snp2 ];
+    write_values( values );
+
+    return true;
+}
+
+void
+tresultfile::write_values(float *values)
+{
     for(int i = 0; i < m_col_names.size( ); i++)
     {
         if( values[ i ] != result_get_missing( ) )
@@ -366,8 +402,6 @@ tresultfile::write(const std::pair<std::string, std::string> &pair, float *value
         }
     }
     *m_output << "\n";
-
-    return true;
 }
 
 uint64_t
@@ -436,6 +470,132 @@ tresultfile::close()
     }
 }
 
+split_resultfile::split_resultfile(const std::vector<resultfile *> &files, const std::vector<std::string> &prefixes)
+    : m_files( files ),
+      m_prefixes( prefixes ),
+      m_columns( files.size( ) )
+{
+}
+
+split_resultfile::~split_resultfile()
+{
+    for(int i = 0; i < m_files.size( ); i++)
+    {
+        delete m_files[ i ];
+    }
+}
+
+bool
+split_resultfile::open()
+{
+    for(int i = 0; i < m_files.size( ); i++)
+    {
+        if( !m_files[ i ]->open( ) )
+        {
+            return false;
+        }
+    }
+
+    return !m_files.empty( );
+}
+
+void
+split_resultfile::close()
+{
+    for(int i = 0; i < m_files.size( ); i++)
+    {
+        m_files[ i ]->close( );
+    }
+}
+
+bool
+split_resultfile::read(std::pair<std::string, std::string> *pair, float *values)
+{
+    return false;
+}
+
+void
+split_resultfile::gather(size_t file, float *values)
+{
+    const std::vector<size_t> &columns = m_columns[ file ];
+    for(int i = 0; i < columns.size( ); i++)
+    {
+        m_buffer[ i ] = values[ columns[ i ] ];
+    }
+}
+
+bool
+split_resultfile::write(const std::pair<std::string, std::string> &pair, float *values)
+{
+    bool success = true;
+    for(int i = 0; i < m_files.size( ); i++)
+    {
+        gather( i, values );
+        success = m_files[ i ]->write( pair, &m_buffer[ 0 ] ) && success;
+    }
+
+    return success;
+}
+
+bool
+split_resultfile::write(size_t snp1, size_t snp2, float *values)
+{
+    bool success = true;
+    for(int i = 0; i < m_files.size( ); i++)
+    {
+        gather( i, values );
+        success = m_files[ i ]->write( snp1, snp2, &m_buffer[ 0 ] ) && success;
+    }
+
+    return success;
+}
+
+uint64_t
+split_resultfile::num_pairs()
+{
+    return m_files[ 0 ]->num_pairs( );
+}
+
+const std::vector<std::string> &
+split_resultfile::get_header()
+{
+    return m_col_names;
+}
+
+const std::vector<std::string> &
+split_resultfile::get_snp_names()
+{
+    return m_files[ 0 ]->get_snp_names( );
+}
+
+bool
+split_resultfile::set_header(const std::vector<std::string> &header)
+{
+    m_col_names = header;
+
+    bool success = true;
+    size_t max_columns = 1;
+    for(int i = 0; i < m_files.size( ); i++)
+    {
+        std::vector<std::string> file_header;
+        m_columns[ i ].clear( );
+        for(int j = 0; j < header.size( ); j++)
+        {
+            if( header[ j ].compare( 0, m_prefixes[ i ].size( ), m_prefixes[ i ] ) == 0 )
+            {
+                m_columns[ i ].push_back( j );
+                file_header.push_back( header[ j ].substr( m_prefixes[ i ].size( ) ) );
+            }
+        }
+
+        max_columns = std::max( max_columns, file_header.size( ) );
+        success = m_files[ i ]->set_header( file_header ) && success;
+    }
+    m_buffer.resize( max_columns );
+
+    return success;
+}
+
 resultfile *
 open_result_file(const std::string &path)
 {
@@ -118,6 +118,18 @@ class resultfile
          */
         virtual bool write(const std::pair<std::string, std::string> &pair, float *values) = 0;
 
+        /**
+         * Writes a pair to the file given the indices of the
+         * variants in get_snp_names( ).
+         *
+         * @param snp1 Index of the first snp.
+         * @param snp2 Index of the second snp.
+         * @param values List of values to write.
+         *
+         * @return True if successful, false otherwise.
+         */
+        virtual bool write(size_t snp1, size_t snp2, float *values) = 0;
+
         /**
          * Closes the file.
          */
@@ -170,6 +182,11 @@ class bresultfile : public resultfile
          */
         virtual bool write(const std::pair<std::string, std::string> &pair, float *values);
 
+        /**
+         * @see resultfile::write.
+         */
+        virtual bool write(size_t snp1, size_t snp2, float *values);
+
         /**
          * @see resultfile::num_pairs.
          */
@@ -245,8 +262,10 @@ class tresultfile : public resultfile
          *
          * @param path Path to the input file.
          * @param mode Reading or writing, "r" or "w".
+         * @param snp_names A list of names for each snp, required
+         *                  when writing pairs by index.
          */
-        tresultfile(const std::string &path, const std::string &mode);
+        tresultfile(const std::string &path, const std::string &mode, const std::vector<std::string> &snp_names = std::vector<std::string>( ));
 
         /**
          * Destructor.
@@ -273,6 +292,11 @@ class tresultfile : public resultfile
          */
         virtual bool write(const std::pair<std::string, std::string> &pair, float *values);
 
+        /**
+         * @see resultfile::write.
+         */
+        virtual bool write(size_t snp1, size_t snp2, float *values);
+
         /**
          * @see resultfile::num_pairs.
          */
@@ -294,6 +318,13 @@ class tresultfile : public resultfile
         bool set_header(const std::vector<std::string> &header);
 
     private:
+        /**
+         * Writes the values of a pair and ends the line.
+         *
+         * @param values List of values to write.
+         */
+        void write_values(float *values);
+
         /**
          * Read or writing mode.
          */
@@ -327,6 +358,112 @@ class tresultfile : public resultfile
         std::vector<std::string> m_snp_names;
 };
 
+/**
+ * Splits the columns of each pair over several result files, each
+ * file gets the columns whose names start with its prefix, with the
+ * prefix removed. Columns that match no prefix are dropped. Only
+ * writing is supported.
+ */
+class split_resultfile : public resultfile
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param files The result files, opened for writing. They
+         *              are deleted by this object.
+         * @param prefixes The column name prefix of each file.
+         */
+        split_resultfile(const std::vector<resultfile *> &files, const std::vector<std::string> &prefixes);
+
+        /**
+         * Destructor.
+         */
+        ~split_resultfile();
+
+        /**
+         * @see resultfile::open.
+         */
+        bool open();
+        
+        /**
+         * @see resultfile::close.
+         */
+        void close();
+
+        /**
+         * Not supported, always returns false.
+         *
+         * @see resultfile::read.
+         */
+        bool read(std::pair<std::string, std::string> *pair, float *values);
+
+        /**
+         * @see resultfile::write.
+         */
+        virtual bool write(const std::pair<std::string, std::string> &pair, float *values);
+
+        /**
+         * @see resultfile::write.
+         */
+        virtual bool write(size_t snp1, size_t snp2, float *values);
+
+        /**
+         * @see resultfile::num_pairs.
+         */
+        uint64_t num_pairs();
+
+        /**
+         * @see resultfile::get_header.
+         */
+        const std::vector<std::string> &get_header();
+        
+        /**
+         * @see resultfile::get_snp_names.
+         */
+        const std::vector<std::string> &get_snp_names();
+
+        /**
+         * @see resultfile::set_header.
+         */
+        bool set_header(const std::vector<std::string> &header);
+
+    private:
+        /**
+         * Copies the columns of the given file from values
+         * to m_buffer.
+         *
+         * @param file Index of the file.
+         * @param values The values of all columns.
+         */
+        void gather(size_t file, float *values);
+
+        /**
+         * The result files.
+         */
+        std::vector<resultfile *> m_files;
+
+        /**
+         * The column name prefix of each file.
+         */
+        std::vector<std::string> m_prefixes;
+
+        /**
+         * The indices of the columns written to each file.
+         */
+        std::vector< std::vector<size_t> > m_columns;
+
+        /**
+         * List of names of all columns.
+         */
+        std::vector<std::string> m_col_names;
+
+        /**
+         * The values written to one file.
+         */
+        std::vector<float> m_buffer;
+};
+
 /**
  * Opens a result file (binary or text) and returns a pointer to it.
  *
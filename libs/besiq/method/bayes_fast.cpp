@@ -1,4 +1,5 @@
 #include <besiq/method/bayes_fast.hpp>
+#include <plink/plink_file.hpp>
 
 bayes_fast_method::bayes_fast_method(method_data_ptr data, arma::vec alpha)
 : method_type::method_type( data )
@@ -44,32 +45,36 @@ bayes_fast_method::set_models(const std::vector<model *> &models)
 std::vector<std::string>
 bayes_fast_method::init()
 {
-    m_weight = arma::ones<arma::vec>( get_data( )->missing.n_elem );
-   
-    const arma::uvec &missing = get_data( )->missing;
-    for(int i = 0; i < missing.size( ); i++)
-    {
-        if( missing[ i ] == 1 )
-        {
-            m_weight[ i ] = 0.0;
-        }
-    }
+    m_counter = count_engine( get_data( )->phenotype, get_data( )->missing );
 
     std::vector<std::string> header;
     header.push_back( "Posterior" );
     return header;
 }
 
+void
+bayes_fast_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
 double bayes_fast_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
+    binary_table counts;
+    m_counter.count( row1, row2, counts );
+
     log_double denominator = 0.0;
-    std::vector<log_double> prior_likelihood( m_models.size( ), 0.0 );
+    log_double numerator = 0.0;
     for(int i = 0; i < m_models.size( ); i++)
     {
-        prior_likelihood[ i ] = m_models[ i ]->prior( ) * m_models[ i ]->prob( row1, row2, get_data( )->phenotype, m_weight );
-        denominator += prior_likelihood[ i ];
+        log_double prior_likelihood = m_models[ i ]->prior( ) * m_models[ i ]->prob( counts );
+        if( i == 0 )
+        {
+            numerator = prior_likelihood;
+        }
+        denominator += prior_likelihood;
     }
-    log_double posterior = prior_likelihood[ 0 ] / denominator;
+    log_double posterior = numerator / denominator;
 
     output[ 0 ] = posterior.value( );
     
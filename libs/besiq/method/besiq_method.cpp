@@ -1,6 +1,7 @@
 #include <besiq/method/besiq_method.hpp>
 #include <glm/models/binomial.hpp>
 #include <glm/irls.hpp>
+#include <plink/plink_file.hpp>
 
 besiq_method::besiq_method(method_data_ptr data, arma::vec alpha)
 : method_type::method_type( data )
@@ -46,9 +47,10 @@ besiq_method::set_models(const std::vector<model *> &models)
 std::vector<std::string>
 besiq_method::init()
 {
+    arma::vec weight;
     if( get_data( )->covariate_matrix.n_elem == 0 )
     {
-        m_weight = arma::ones<arma::vec>( get_data( )->missing.n_elem );
+        weight = arma::ones<arma::vec>( get_data( )->missing.n_elem );
     }
     else
     {
@@ -63,33 +65,39 @@ besiq_method::init()
         glm_info null_info;
         irls( null, get_data( )->phenotype, get_data( )->missing, model, null_info );
 
-        m_weight = abs( get_data( )->phenotype - full_info.mu ) / abs( get_data( )->phenotype - null_info.mu );
+        weight = abs( get_data( )->phenotype - full_info.mu ) / abs( get_data( )->phenotype - null_info.mu );
     }
 
-    const arma::uvec &missing = get_data( )->missing;
-    for(int i = 0; i < missing.size( ); i++)
-    {
-        if( missing[ i ] == 1 )
-        {
-            m_weight[ i ] = 0.0;
-        }
-    }
+    m_counter = count_engine( get_data( )->phenotype, get_data( )->missing, weight );
 
     std::vector<std::string> header;
     header.push_back( "Posterior" );
     return header;
 }
 
+void
+besiq_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
 double besiq_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
+    binary_table counts;
+    m_counter.count( row1, row2, counts );
+
     log_double denominator = 0.0;
-    std::vector<log_double> prior_likelihood( m_models.size( ), 0.0 );
+    log_double numerator = 0.0;
     for(int i = 0; i < m_models.size( ); i++)
     {
-        prior_likelihood[ i ] = m_models[ i ]->prior( ) * m_models[ i ]->prob( row1, row2, get_data( )->phenotype, m_weight );
-        denominator += prior_likelihood[ i ];
+        log_double prior_likelihood = m_models[ i ]->prior( ) * m_models[ i ]->prob( counts );
+        if( i == 0 )
+        {
+            numerator = prior_likelihood;
+        }
+        denominator += prior_likelihood;
     }
-    log_double posterior = prior_likelihood[ 0 ] / denominator;
+    log_double posterior = numerator / denominator;
 
     output[ 0 ] = posterior.value( );
 
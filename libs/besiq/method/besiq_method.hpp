@@ -40,6 +40,11 @@ public:
      * @see method_type::init.
      */
     virtual std::vector<std::string> init();
+
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
     
     /**
      * @see method_type::run.
@@ -54,10 +59,10 @@ private:
     std::vector<model *> m_models;
     
     /**
-     * A weight > 0 associated with each sample, that allows for
-     * covariate adjustment.
+     * Computes the contingency tables, weighted by a weight > 0
+     * for each sample that allows for covariate adjustment.
      */
-    arma::vec m_weight;
+    count_engine m_counter;
 };
 
 #endif /* End of __BAYESIC_METHOD_H__ */
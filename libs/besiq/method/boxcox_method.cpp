@@ -1,4 +1,5 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <glm/models/binomial.hpp>
 #include <glm/models/normal.hpp>
 #include <glm/models/links/power.hpp>
@@ -76,7 +77,7 @@ double boxcox_method::run(const snp_row &row1, const snp_row &row2, float *outpu
     for(int i = 0; i < m_model.size( ); i++)
     {
         glm_info null_info;
-        glm_fit( m_model_matrix.get_null( ), m_fixed_pheno, missing, *m_model[ i ], null_info );
+        glm_fit( m_model_matrix.get_null( ), m_fixed_pheno, missing, *m_model[ i ], null_info, m_workspace );
 
         if( !null_info.success )
         {
@@ -97,14 +98,15 @@ double boxcox_method::run(const snp_row &row1, const snp_row &row2, float *outpu
 
     /* Fit alternative model and test against best null */
     glm_info alt_info;
-    glm_fit( m_model_matrix.get_alt( ), m_fixed_pheno, missing, *m_model[ best_index ], alt_info );
+    glm_fit( m_model_matrix.get_alt( ), m_fixed_pheno, missing, *m_model[ best_index ], alt_info, m_workspace );
 
     if( alt_info.success )
     {
         try
         {
             double LR = -2 * ( max_logl - alt_info.logl );
-            double p = 1.0 - chi_square_cdf( LR, m_model_matrix.num_df( ) );
+            double p = chi_square_upper( LR, m_model_matrix.num_df( ) );
+            set_log10_p( chi_square_upper_log10( LR, m_model_matrix.num_df( ) ) );
 
             output[ 0 ] = m_lambda[ best_index ];
             if( std::abs( m_lambda[ best_index ] ) < 1e-5 )
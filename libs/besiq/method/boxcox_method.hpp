@@ -68,6 +68,11 @@ private:
      * A possibly transformed phenotype.
      */
     arma::vec m_fixed_pheno;
+
+    /**
+     * Buffers of the model fits, reused between pairs.
+     */
+    glm_workspace m_workspace;
 };
 
 #endif /* End of __BOXCOX_METHOD_H__ */
@@ -1,13 +1,38 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <besiq/method/caseonly_method.hpp>
 #include <besiq/stats/snp_count.hpp>
+#include <plink/plink_file.hpp>
+
+/**
+ * Returns the smallest cell of the columns that have samples, so
+ * that the pooled tests can be run when one column is empty.
+ *
+ * @param counts The counts of the pair.
+ *
+ * @return The smallest cell, or -1 if there are no samples.
+ */
+static double
+smallest_populated_cell(const binary_table &counts)
+{
+    double smallest = -1;
+    for(size_t c = 0; c < binary_table::num_columns; c++)
+    {
+        if( counts.sum( c ) > 0 && ( smallest < 0 || counts.min( c ) < smallest ) )
+        {
+            smallest = counts.min( c );
+        }
+    }
+
+    return smallest;
+}
 
 caseonly_method::caseonly_method(method_data_ptr data, const std::string &method)
 : method_type::method_type( data ),
   m_method( method ),
   m_wald( data )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.size( ) );
+    m_counter = count_engine( data->phenotype, data->missing );
 }
 
 std::vector<std::string>
@@ -38,69 +63,93 @@ caseonly_method::init()
     return header;
 }
 
+void
+caseonly_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
 double
 caseonly_method::run(const snp_row &row1, const snp_row &row2, float *output)
+{
+    binary_table counts;
+    m_counter.count( row1, row2, counts );
+
+    return run_from_counts( counts, output );
+}
+
+count_type
+caseonly_method::get_count_type()
+{
+    return COUNT_TYPE_BINARY;
+}
+
+double
+caseonly_method::run_from_counts(const binary_table &counts, float *output)
 {
     double p = -1.0;
     if( m_method == "r2" )
     {
-        p = compute_r2( row1, row2, output );
-        m_wald.run( row1, row2, &output[ 2 ] );
+        p = compute_r2( counts, output );
+        m_wald.run_from_counts( counts, &output[ 2 ] );
     }
     else if( m_method == "css" )
     {
-        p = compute_css( row1, row2, output );
-        m_wald.run( row1, row2, &output[ 2 ] );
+        p = compute_css( counts, output );
+        m_wald.run_from_counts( counts, &output[ 2 ] );
     }
     else if( m_method == "contrast" )
     {
-        p = compute_contrast( row1, row2, output );
+        p = compute_contrast( counts, output );
     }
 
     return p;
 }
 
 double
-caseonly_method::compute_r2(const snp_row &row1, const snp_row &row2, float *output)
+caseonly_method::compute_r2(const binary_table &counts, float *output)
 {
-    arma::mat counts = joint_count( row1, row2, get_data( )->phenotype, m_weight );
-    arma::vec snp_snp = sum( counts, 1 );
-    arma::vec snp1 = arma::zeros<arma::vec>( 3 );
-    arma::vec snp2 = arma::zeros<arma::vec>( 3 );
-    arma::vec u = arma::zeros<arma::vec>( 3 );
-    arma::vec v = arma::zeros<arma::vec>( 3 );
-    double N = arma::accu( counts );
+    double snp_snp[ 9 ];
+    double snp1[ 3 ] = { 0.0, 0.0, 0.0 };
+    double snp2[ 3 ] = { 0.0, 0.0, 0.0 };
+    double N = counts.sum( 0 ) + counts.sum( 1 );
     set_num_ok_samples( (size_t) N );
-    if( arma::min( arma::min( counts ) ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    if( smallest_populated_cell( counts ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
     {
         return -9;
     }
 
     for(int i = 0; i < 3; i++)
     {
-        u[ i ] = i;
-        v[ i ] = i;
         for(int j = 0; j < 3; j++)
         {
+            snp_snp[ 3 * i + j ] = counts( 3 * i + j, 0 ) + counts( 3 * i + j, 1 );
             snp1[ i ] += snp_snp[ 3 * i + j ];
             snp2[ j ] += snp_snp[ 3 * i + j ];
         }
     }
     
+    /* The genotypes are coded as u = v = ( 0, 1, 2 ) */
+    double u_snp1 = snp1[ 1 ] + 2 * snp1[ 2 ];
+    double uu_snp1 = snp1[ 1 ] + 4 * snp1[ 2 ];
+    double v_snp2 = snp2[ 1 ] + 2 * snp2[ 2 ];
+    double vv_snp2 = snp2[ 1 ] + 4 * snp2[ 2 ];
+
     double T = 0.0;
     double m = 0.0;
-    double var = (dot( u % u, snp1 ) - pow( dot( u, snp1 ), 2 ) / N) * (dot( v % v, snp2 ) - pow( dot( v, snp2 ), 2 ) / N );
+    double var = (uu_snp1 - pow( u_snp1, 2 ) / N) * (vv_snp2 - pow( v_snp2, 2 ) / N );
     for(int i = 0; i < 3; i++)
     {
         for(int j = 0; j < 3; j++)
         {
-            T += u[ i ] * v[ j ] * snp_snp[ 3 * i + j ];
-            m += u[ i ] * v[ j ] * snp1[ i ] * snp2[ j ] / N;
+            T += i * j * snp_snp[ 3 * i + j ];
+            m += i * j * snp1[ i ] * snp2[ j ] / N;
         }
     }
 
     double R2 = pow( T - m, 2 ) / ( var / N );
-    double p = 1.0 - chi_square_cdf( R2, 1 );
+    double p = chi_square_upper( R2, 1 );
+    set_log10_p( chi_square_upper_log10( R2, 1 ) );
  
     output[ 0 ] = R2;
     output[ 1 ] = p;
@@ -109,46 +158,55 @@ caseonly_method::compute_r2(const snp_row &row1, const snp_row &row2, float *out
 }
 
 double
-caseonly_method::compute_css(const snp_row &row1, const snp_row &row2, float *output)
+caseonly_method::compute_css(const binary_table &counts, float *output)
 {
-    arma::mat counts = joint_count( row1, row2, get_data( )->phenotype, m_weight );
-    arma::vec snp_snp = sum( counts, 1 );
-    arma::vec snp1 = arma::zeros<arma::vec>( 3 );
-    arma::vec snp2 = arma::zeros<arma::vec>( 3 );
-    if( arma::min( arma::min( counts ) ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    double snp_snp[ 9 ];
+    double snp1[ 3 ] = { 0.0, 0.0, 0.0 };
+    double snp2[ 3 ] = { 0.0, 0.0, 0.0 };
+    double N = counts.sum( 0 ) + counts.sum( 1 );
+    set_num_ok_samples( (size_t) N );
+    if( smallest_populated_cell( counts ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
     {
         return -9;
     }
 
-    double N = arma::accu( counts );
-    set_num_ok_samples( (size_t) N );
-
     for(int i = 0; i < 3; i++)
     {
         for(int j = 0; j < 3; j++)
         {
+            snp_snp[ 3 * i + j ] = counts( 3 * i + j, 0 ) + counts( 3 * i + j, 1 );
             snp1[ i ] += snp_snp[ 3 * i + j ];
             snp2[ j ] += snp_snp[ 3 * i + j ];
         }
     }
     
-    arma::vec f1 = snp1 / N;
-    arma::vec f2 = snp2 / N;
+    double f1[ 3 ];
+    double f2[ 3 ];
+    for(int i = 0; i < 3; i++)
+    {
+        f1[ i ] = snp1[ i ] / N;
+        f2[ i ] = snp2[ i ] / N;
+    }
 
-    arma::vec o = arma::zeros<arma::vec>( 4 );
+    double o[ 4 ];
     o[ 0 ] = snp_snp[ 3 * 0 + 0 ] + snp_snp[ 3 * 1 + 0 ] + snp_snp[ 3 * 2 + 0 ] + snp_snp[ 3 * 0 + 1 ] + snp_snp[ 3 * 0 + 2 ];
     o[ 1 ] = snp_snp[ 3 * 1 + 1 ];
     o[ 2 ] = snp_snp[ 3 * 2 + 1 ] + snp_snp[ 3 * 1 + 2 ];
     o[ 3 ] = snp_snp[ 3 * 2 + 2 ];
 
-    arma::vec e = arma::zeros<arma::vec>( 4 );
+    double e[ 4 ];
     e[ 0 ] = f1[ 0 ] * f2[ 0 ] + f1[ 1 ] * f2[ 0 ] + f1[ 2 ] * f2[ 0 ] + f1[ 0 ] * f2[ 1 ] + f1[ 0 ] * f2[ 2 ];
     e[ 1 ] = f1[ 1 ] * f2[ 1 ];
     e[ 2 ] = f1[ 1 ] * f2[ 2 ] + f1[ 2 ] * f2[ 1 ];
     e[ 3 ] = f1[ 2 ] * f2[ 2 ];
 
-    double chi2 = sum( pow( o - N * e, 2 ) / ( N * e ) );
-    double p = 1.0 - chi_square_cdf( chi2, 3 );
+    double chi2 = 0.0;
+    for(int i = 0; i < 4; i++)
+    {
+        chi2 += pow( o[ i ] - N * e[ i ], 2 ) / ( N * e[ i ] );
+    }
+    double p = chi_square_upper( chi2, 3 );
+    set_log10_p( chi_square_upper_log10( chi2, 3 ) );
 
     output[ 0 ] = chi2;
     output[ 1 ] = p;
@@ -157,19 +215,16 @@ caseonly_method::compute_css(const snp_row &row1, const snp_row &row2, float *ou
 }
 
 double
-caseonly_method::compute_contrast(const snp_row &row1, const snp_row &row2, float *output)
+caseonly_method::compute_contrast(const binary_table &counts, float *output)
 {
-    arma::mat counts = joint_count( row1, row2, get_data( )->phenotype, m_weight );
-
-    if( arma::min( arma::min( counts ) ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    double N_controls = counts.sum( 0 );
+    double N_cases = counts.sum( 1 );
+    double N = N_controls + N_cases;
+    set_num_ok_samples( (size_t) N );
+    if( counts.min( ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
     {
         return -9;
     }
-    
-    double N = arma::accu( counts );
-    double N_controls = sum( counts.col( 0 ) );
-    double N_cases = sum( counts.col( 1 ) );
-    set_num_ok_samples( (size_t) N );
 
     double p_a_case = ( 2 * (counts( 6 , 1 ) + counts( 7 , 1 ) + counts( 8 , 1 ) ) + counts( 3 , 1 ) + counts( 4 , 1 ) + counts( 5 , 1 ) ) / ( 2 * N_cases );
     double p_a_control = ( 2 * (counts( 6 , 0 ) + counts( 7 , 0 ) + counts( 8 , 0 ) ) + counts( 3 , 0 ) + counts( 4 , 0 ) + counts( 5 , 0 ) ) / ( 2 * N_controls );
@@ -204,10 +259,17 @@ caseonly_method::compute_contrast(const snp_row &row1, const snp_row &row2, floa
 
     double chi2 = pow( delta_case - delta_control, 2 ) / ( sigma2_diff );
     
-    double p = 1 - chi_square_cdf( chi2, 1 );
+    double p = chi_square_upper( chi2, 1 );
+    set_log10_p( chi_square_upper_log10( chi2, 1 ) );
 
     output[ 0 ] = delta_case - delta_control;
     output[ 1 ] = p;
 
     return p;
 }
+
+method_type *
+caseonly_method::clone()
+{
+    return new caseonly_method( *this );
+}
@@ -9,10 +9,16 @@
 #include <besiq/method/method.hpp>
 #include <besiq/method/wald_method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
 
 /**
  * This class is responsible for intializing and repeatedly
  * executing the case-only test by Lewinger et al.
+ *
+ * The 'r2' and 'css' tests pool the samples of both columns, so they
+ * can also be run on data with only cases, which count_engine then
+ * counts with the cases mask alone. The Wald columns of these tests
+ * and the 'contrast' test need both cases and controls.
  */
 class caseonly_method
 : public method_type
@@ -32,20 +38,39 @@ public:
      */
     virtual std::vector<std::string> init();
 
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
+
     /**
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * @see method_type::get_count_type.
+     */
+    virtual count_type get_count_type();
+
+    /**
+     * @see method_type::run_from_counts.
+     */
+    virtual double run_from_counts(const binary_table &counts, float *output);
+
+    /**
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
+
 private: 
-    virtual double compute_r2(const snp_row &row1, const snp_row &row2, float *output);
-    virtual double compute_css(const snp_row &row1, const snp_row &row2, float *output);
-    virtual double compute_contrast(const snp_row &row1, const snp_row &row2, float *output);
+    virtual double compute_r2(const binary_table &counts, float *output);
+    virtual double compute_css(const binary_table &counts, float *output);
+    virtual double compute_contrast(const binary_table &counts, float *output);
     /**
-     * A weight > 0 associated with each sample, that allows for
-     * covariate adjustment.
+     * Computes the contingency tables of the non-missing samples.
      */
-    arma::vec m_weight;
+    count_engine m_counter;
 
     /**
      * What type of method to use 'r2' or 'css'.
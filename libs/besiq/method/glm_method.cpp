@@ -1,18 +1,68 @@
+#include <algorithm>
+
 #include <besiq/method/glm_method.hpp>
 
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 
 glm_method::glm_method(method_data_ptr data, const glm_model &model, model_matrix &model_matrix)
 : method_type::method_type( data ),
   m_model( model ),
-  m_model_matrix( model_matrix )
+  m_model_matrix( model_matrix ),
+  m_grouped( model_matrix ),
+  m_lr_threshold( 0.0 )
+{
+    if( m_grouped.is_valid( ) )
+    {
+        m_counter = count_engine( data->phenotype, data->missing );
+    }
+    else if( !glm_is_linear( model ) )
+    {
+        /* The intercept and covariates are the same for all pairs */
+        const arma::mat &null = m_model_matrix.get_null( );
+        arma::mat shared = null.cols( m_model_matrix.num_null( ) - 1, null.n_cols - 1 );
+        m_alt_batch = shared_ptr<irls_batch>( new irls_batch( model, shared, m_model_matrix.num_alt( ) - 1 ) );
+        m_null_batch = shared_ptr<irls_batch>( new irls_batch( model, shared, m_model_matrix.num_null( ) - 1, m_alt_batch->capacity( ) ) );
+    }
+}
+
+glm_method::glm_method(const glm_method &other)
+: method_type::method_type( other ),
+  m_model( other.m_model ),
+  m_own_model_matrix( other.m_model_matrix.clone( ) ),
+  m_model_matrix( *m_own_model_matrix ),
+  m_grouped( other.m_grouped ),
+  m_counter( other.m_counter ),
+  m_score( other.m_score ),
+  m_lr_threshold( other.m_lr_threshold )
 {
+    if( other.m_null_batch )
+    {
+        m_null_batch = shared_ptr<irls_batch>( new irls_batch( *other.m_null_batch ) );
+        m_alt_batch = shared_ptr<irls_batch>( new irls_batch( *other.m_alt_batch ) );
+    }
+}
+
+bool
+glm_method::use_score_test(double lr_threshold)
+{
+    const arma::mat &null = m_model_matrix.get_null( );
+    arma::mat Z = null.cols( m_model_matrix.num_null( ) - 1, null.n_cols - 1 );
+    m_score = shared_ptr<score_test>( new score_test( Z, get_data( )->phenotype, get_data( )->missing, m_model ) );
+    m_lr_threshold = lr_threshold;
+
+    return m_score->is_valid( );
 }
 
 std::vector<std::string>
 glm_method::init()
 {
     std::vector<std::string> header;
+    if( m_score )
+    {
+        header.push_back( "SCORE" );
+        header.push_back( "P_SCORE" );
+    }
     header.push_back( "LR" );
     header.push_back( "P" );
 
@@ -21,27 +71,98 @@ glm_method::init()
 
 double glm_method::run(const snp_row &row1, const snp_row &row2, float *output)
 { 
+    if( !m_score )
+    {
+        return run_lr( row1, row2, output );
+    }
+
+    arma::uvec missing = get_data( )->missing;
+    m_model_matrix.update_matrix( row1, row2, missing );
+    set_num_ok_samples( missing.n_elem - sum( missing ) );
+
+    /* The main effects are the first columns of the null matrix */
+    double statistic = 0.0;
+    unsigned int df = m_score->compute( m_model_matrix.get_alt( ), m_model_matrix.num_null( ) - 1, m_model_matrix.num_df( ), missing, statistic );
+    if( df == 0 )
+    {
+        return -9;
+    }
+
+    double p;
+    double log10_p;
+    try
+    {
+        p = chi_square_upper( statistic, df );
+        log10_p = chi_square_upper_log10( statistic, df );
+    }
+    catch(bad_domain_value &e)
+    {
+        return -9;
+    }
+    output[ 0 ] = statistic;
+    output[ 1 ] = p;
+
+    /* The score test is returned for all pairs, so that the top pairs
+     * and the threshold compare the same test */
+    if( p < m_lr_threshold )
+    {
+        run_lr( row1, row2, output + 2 );
+    }
+    set_log10_p( log10_p );
+
+    return p;
+}
+
+double
+glm_method::run_lr(const snp_row &row1, const snp_row &row2, float *output)
+{
+    if( m_grouped.is_valid( ) )
+    {
+        cont_table counts;
+        m_counter.count( row1, row2, counts );
+
+        return run_from_counts( counts, output );
+    }
+
     arma::uvec missing = get_data( )->missing;
 
     m_model_matrix.update_matrix( row1, row2, missing );
 
     glm_info null_info;
-    arma::vec b1 = glm_fit( m_model_matrix.get_null( ), get_data( )->phenotype, missing, m_model, null_info, get_data( )->fast_inversion );
+    const arma::vec &null_start = m_start.get_null( m_model_matrix, row1, row2 );
+    arma::vec b1 = glm_fit( m_model_matrix.get_null( ), get_data( )->phenotype, missing, m_model, null_info, m_workspace, null_start, get_data( )->fast_inversion );
+    add_fit( null_info.num_iters );
+
+    arma::vec alt_start;
+    if( null_info.success )
+    {
+        m_start.add_null( m_model_matrix, row1, row2, b1 );
+        alt_start = m_model_matrix.null_to_alt( b1 );
+    }
 
     glm_info alt_info;
-    arma::vec b = glm_fit( m_model_matrix.get_alt( ), get_data( )->phenotype, missing, m_model, alt_info, get_data( )->fast_inversion );
+    arma::vec b = glm_fit( m_model_matrix.get_alt( ), get_data( )->phenotype, missing, m_model, alt_info, m_workspace, alt_start, get_data( )->fast_inversion );
+    add_fit( alt_info.num_iters );
 
     set_num_ok_samples( missing.n_elem - sum( missing ) );
 
+    return lr_test( null_info, alt_info, output );
+}
+
+double
+glm_method::lr_test(const glm_info &null_info, const glm_info &alt_info, float *output)
+{
     if( null_info.success && alt_info.success )
     {
         double LR = -2 * ( null_info.logl - alt_info.logl );
 
         try
         {
+            double p = chi_square_upper( LR, m_model_matrix.num_df( ) );
+            set_log10_p( chi_square_upper_log10( LR, m_model_matrix.num_df( ) ) );
             output[ 0 ] = LR;
-            output[ 1 ] = 1.0 - chi_square_cdf( LR, m_model_matrix.num_df( ) );
-            return output[ 1 ];
+            output[ 1 ] = p;
+            return p;
         }
         catch(bad_domain_value &e)
         {
@@ -51,3 +172,105 @@ double glm_method::run(const snp_row &row1, const snp_row &row2, float *output)
 
     return -9;
 }
+
+void
+glm_method::run_lr_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                         size_t stride, double *statistics, size_t *num_ok, double *log10_p)
+{
+    m_null_batch->clear( );
+    m_alt_batch->clear( );
+    for(size_t i = 0; i < n; i++)
+    {
+        arma::uvec missing = get_data( )->missing;
+        m_model_matrix.update_matrix( row1, *rows2[ i ], missing );
+        num_ok[ i ] = missing.n_elem - sum( missing );
+
+        m_null_batch->add( m_model_matrix.get_null( ), missing );
+        m_null_batch->set_start( i, m_start.get_null( m_model_matrix, row1, *rows2[ i ] ) );
+        m_alt_batch->add( m_model_matrix.get_alt( ), missing );
+    }
+
+    m_null_batch->fit( get_data( )->phenotype );
+    for(size_t i = 0; i < n; i++)
+    {
+        const glm_info &null_info = m_null_batch->get_info( i );
+        add_fit( null_info.num_iters );
+        if( null_info.success )
+        {
+            m_start.add_null( m_model_matrix, row1, *rows2[ i ], m_null_batch->get_beta( i ) );
+            m_alt_batch->set_start( i, m_model_matrix.null_to_alt( m_null_batch->get_beta( i ) ) );
+        }
+    }
+
+    m_alt_batch->fit( get_data( )->phenotype );
+    for(size_t i = 0; i < n; i++)
+    {
+        const glm_info &alt_info = m_alt_batch->get_info( i );
+        add_fit( alt_info.num_iters );
+        set_log10_p( -9 );
+        statistics[ i ] = lr_test( m_null_batch->get_info( i ), alt_info, outputs + i * stride );
+        log10_p[ i ] = get_log10_p( );
+    }
+}
+
+count_type
+glm_method::get_count_type()
+{
+    return !m_score && m_grouped.is_valid( ) ? COUNT_TYPE_CONT : COUNT_TYPE_NONE;
+}
+
+double
+glm_method::run_from_counts(const cont_table &counts, float *output)
+{
+    set_num_ok_samples( m_grouped.update( counts ) );
+
+    glm_info null_info;
+    arma::vec b1 = glm_fit( m_grouped.get_null( ), m_grouped.get_groups( ), m_model, null_info, m_workspace, m_start.get_null( ), get_data( )->fast_inversion );
+    add_fit( null_info.num_iters );
+
+    arma::vec alt_start;
+    if( null_info.success )
+    {
+        m_start.add_null( b1 );
+        alt_start = m_model_matrix.null_to_alt( b1 );
+    }
+
+    glm_info alt_info;
+    glm_fit( m_grouped.get_alt( ), m_grouped.get_groups( ), m_model, alt_info, m_workspace, alt_start, get_data( )->fast_inversion );
+    add_fit( alt_info.num_iters );
+
+    return lr_test( null_info, alt_info, output );
+}
+
+void
+glm_method::run_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                      size_t stride, double *statistics, size_t *num_ok, double *log10_p)
+{
+    if( !m_score && m_grouped.is_valid( ) )
+    {
+        method_type::run_batch( row1, rows2, n, outputs, stride, statistics, num_ok, log10_p );
+        return;
+    }
+
+    m_model_matrix.set_first( row1 );
+    if( !m_score && m_null_batch )
+    {
+        size_t batch_size = m_null_batch->capacity( );
+        for(size_t start = 0; start < n; start += batch_size)
+        {
+            run_lr_batch( row1, rows2 + start, std::min( batch_size, n - start ), outputs + start * stride,
+                          stride, statistics + start, num_ok + start, log10_p + start );
+        }
+    }
+    else
+    {
+        method_type::run_batch( row1, rows2, n, outputs, stride, statistics, num_ok, log10_p );
+    }
+    m_model_matrix.clear_first( );
+}
+
+method_type *
+glm_method::clone()
+{
+    return new glm_method( *this );
+}
@@ -7,8 +7,12 @@
 #include <armadillo>
 
 #include <glm/glm.hpp>
+#include <glm/irls_batch.hpp>
+#include <glm/score_test.hpp>
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
+#include <besiq/glm_start.hpp>
 #include <besiq/model_matrix.hpp>
 
 /**
@@ -26,26 +30,169 @@ public:
      */
     glm_method(method_data_ptr data, const glm_model &model, model_matrix &model_matrix);
     
+    /**
+     * Tests the interaction with a score test instead of fitting the
+     * null and alternative model for each pair. The model of the
+     * covariates is fitted once, and the likelihood ratio test is only
+     * run for pairs that are significant in the score test. Must be
+     * called before init.
+     *
+     * @param lr_threshold The likelihood ratio test is run for pairs
+     *                     with a score test p-value below this.
+     *
+     * @return False if the model of the covariates could not be fitted.
+     */
+    bool use_score_test(double lr_threshold);
+
     /**
      * @see method_type::init.
      */
     virtual std::vector<std::string> init();
 
     /**
+     * Runs the score test if use_score_test has been called, the
+     * result of the likelihood ratio test is then only set for pairs
+     * below its threshold. The score test p-value is returned for all
+     * pairs.
+     *
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * Decodes the genotypes of row1 once for all pairs, unless
+     * the pairs are fitted on grouped samples. Models that are
+     * fitted by IRLS on the samples are fitted in batches of
+     * pairs, see irls_batch.
+     *
+     * @see method_type::run_batch.
+     */
+    virtual void run_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                           size_t stride, double *statistics, size_t *num_ok, double *log10_p);
+
+    /**
+     * Returns COUNT_TYPE_CONT when the model matrix has no covariates,
+     * since the models can then be fitted on the samples grouped by
+     * genotype.
+     *
+     * @see method_type::get_count_type.
+     */
+    virtual count_type get_count_type();
+
+    /**
+     * @see method_type::run_from_counts.
+     */
+    virtual double run_from_counts(const cont_table &counts, float *output);
+
+    /**
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
+
 private:
+    /**
+     * Copy constructor used by clone, the copy gets its own model matrix.
+     *
+     * @param other The method to copy.
+     */
+    glm_method(const glm_method &other);
+
+    /**
+     * Fits the null and alternative model and computes the
+     * likelihood ratio test.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param output The LR statistic and p-value will be stored here.
+     *
+     * @return The p-value or -9 if the models could not be fitted.
+     */
+    double run_lr(const snp_row &row1, const snp_row &row2, float *output);
+
+    /**
+     * Fits the null and alternative models of several pairs together
+     * and computes their likelihood ratio tests, see run_batch.
+     *
+     * @param row1 The first snp of all pairs.
+     * @param rows2 The second snp of each pair.
+     * @param n The number of pairs, at most the capacity of the batches.
+     * @param outputs The results of pair i are stored at outputs + i * stride.
+     * @param stride The distance between the results of two pairs.
+     * @param statistics The p-value of each pair will be stored here.
+     * @param num_ok The number of usable samples of each pair will be stored here.
+     * @param log10_p The value -log10 of the p-value of each pair will be stored here.
+     */
+    void run_lr_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                      size_t stride, double *statistics, size_t *num_ok, double *log10_p);
+
+    /**
+     * Computes the likelihood ratio test of two fitted models.
+     *
+     * @param null_info The fit of the null model.
+     * @param alt_info The fit of the alternative model.
+     * @param output The LR statistic and p-value will be stored here.
+     *
+     * @return The p-value or -9 if the models could not be fitted.
+     */
+    double lr_test(const glm_info &null_info, const glm_info &alt_info, float *output);
+
     /**
      * The glm model used, in this case a binomial model with logit link.
      */
     const glm_model &m_model;
 
+    /**
+     * Model matrix owned by this method, only set for clones.
+     */
+    shared_ptr<model_matrix> m_own_model_matrix;
+
     /**
      * The model matrix that is used.
      */
     model_matrix &m_model_matrix;
+
+    /**
+     * Buffers of the model fits, reused between pairs.
+     */
+    glm_workspace m_workspace;
+
+    /**
+     * Starting points of the model fits, from the previous pairs.
+     */
+    glm_start m_start;
+
+    /**
+     * Fits the null models of a batch of pairs, NULL if the models
+     * are not fitted by IRLS on the samples.
+     */
+    shared_ptr<irls_batch> m_null_batch;
+
+    /**
+     * Fits the alternative models of a batch of pairs.
+     */
+    shared_ptr<irls_batch> m_alt_batch;
+
+    /**
+     * The model matrix grouped by genotype, if it has no covariates.
+     */
+    grouped_matrix m_grouped;
+
+    /**
+     * Computes the groups of a pair.
+     */
+    count_engine m_counter;
+
+    /**
+     * The score test of the interaction, shared by the clones, or
+     * NULL if the likelihood ratio test is used.
+     */
+    shared_ptr<score_test> m_score;
+
+    /**
+     * The likelihood ratio test is also run for pairs with a score
+     * test p-value below this.
+     */
+    double m_lr_threshold;
 };
 
 #endif /* End of __GLM_METHOD_H__ */
@@ -1,6 +1,8 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <besiq/method/loglinear_method.hpp>
 #include <besiq/stats/snp_count.hpp>
+#include <plink/plink_file.hpp>
 
 loglinear_method::loglinear_method(method_data_ptr data)
 : method_type::method_type( data )
@@ -10,7 +12,7 @@ loglinear_method::loglinear_method(method_data_ptr data)
     m_models.push_back( new binomial_single( false ) );
     m_models.push_back( new binomial_null( ) );
 
-    m_weight = arma::ones<arma::vec>( data->phenotype.size( ) );
+    m_counter = count_engine( data->phenotype, data->missing );
 }
 
 std::vector<std::string>
@@ -23,31 +25,69 @@ loglinear_method::init()
     return header;
 }
 
+void
+loglinear_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
 double
 loglinear_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat count = joint_count( row1, row2, get_data( )->phenotype, m_weight );
-    size_t num_samples = arma::accu( count );
+    binary_table bound;
+    double num_bounded = 0.0;
+    if( m_counter.bound( row1, row2, bound, num_bounded ) && bound.min( ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    {
+        set_num_ok_samples( (size_t) num_bounded );
+        add_skipped( );
+        return -9;
+    }
+
+    binary_table count;
+    m_counter.count( row1, row2, count );
+
+    return run_from_counts( count, output );
+}
+
+count_type
+loglinear_method::get_count_type()
+{
+    return COUNT_TYPE_BINARY;
+}
+
+double
+loglinear_method::run_from_counts(const binary_table &count, float *output)
+{
+    size_t num_samples = count.sum( 0 ) + count.sum( 1 );
     set_num_ok_samples( num_samples );
-    if( arma::min( arma::min( count ) ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    if( count.min( ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
     {
         return -9;
     }
 
-    std::vector<log_double> likelihood( m_models.size( ), 0.0 );
-    std::vector<double> bic( m_models.size( ), 0.0 );
-    for(int i = 0; i < m_models.size( ); i++)
+    /* Find the reduced model with the smallest BIC */
+    log_double full_likelihood = m_models[ 0 ]->prob( count );
+    log_double best_likelihood = 0.0;
+    unsigned int best_model = 0;
+    double best_bic = 0.0;
+    for(int i = 1; i < m_models.size( ); i++)
     {
-        likelihood[ i ] = m_models[ i ]->prob( count );
-        bic[ i ] = -2.0 * likelihood[ i ].log_value( ) + m_models[ i ]->df( ) * log( num_samples );
+        log_double likelihood = m_models[ i ]->prob( count );
+        double bic = -2.0 * likelihood.log_value( ) + m_models[ i ]->df( ) * log( num_samples );
+        if( best_model == 0 || bic < best_bic )
+        {
+            best_likelihood = likelihood;
+            best_model = i;
+            best_bic = bic;
+        }
     }
 
-    unsigned int best_model = std::distance( bic.begin( ), std::min_element( bic.begin( ) + 1, bic.end( ) ) );
-    double LR = -2.0*(likelihood[ best_model ].log_value( ) - likelihood[ 0 ].log_value( ));
+    double LR = -2.0*(best_likelihood.log_value( ) - full_likelihood.log_value( ));
 
     try
     {
-        double p_value = 1.0 - chi_square_cdf( LR, m_models[ 0 ]->df( ) - m_models[ best_model ]->df( ) );
+        double p_value = chi_square_upper( LR, m_models[ 0 ]->df( ) - m_models[ best_model ]->df( ) );
+        set_log10_p( chi_square_upper_log10( LR, m_models[ 0 ]->df( ) - m_models[ best_model ]->df( ) ) );
         output[ 0 ] = p_value;
         return p_value;
     }
@@ -57,3 +97,9 @@ loglinear_method::run(const snp_row &row1, const snp_row &row2, float *output)
 
     return -9;
 }
+
+method_type *
+loglinear_method::clone()
+{
+    return new loglinear_method( *this );
+}
@@ -8,6 +8,7 @@
 
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
 #include <besiq/stats/binomial_models.hpp>
 
 /**
@@ -31,22 +32,41 @@ public:
      */
     virtual std::vector<std::string> init();
 
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
+
     /**
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * @see method_type::get_count_type.
+     */
+    virtual count_type get_count_type();
+
+    /**
+     * @see method_type::run_from_counts.
+     */
+    virtual double run_from_counts(const binary_table &counts, float *output);
+
+    /**
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
+
 private: 
     /**
-     * A weight > 0 associated with each sample, that allows for
-     * covariate adjustment.
+     * Computes the contingency tables of the non-missing samples.
      */
-    arma::vec m_weight;
+    count_engine m_counter;
 
     /**
      * The models used.
      */
-    std::vector<closed_form_model *> m_models;
+    std::vector<binomial_model *> m_models;
 };
 
 #endif /* End of __LOGLINEAR_METHOD_H__ */
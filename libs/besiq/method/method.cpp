@@ -1,42 +1,719 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <plink/plink_file.hpp>
 #include <besiq/method/method.hpp>
 #include <besiq/io/pairfile.hpp>
 #include <besiq/io/resultfile.hpp>
+#include <besiq/stats/permutation.hpp>
+#include <besiq/stats/pvalue_summary.hpp>
+
+/**
+ * Number of pairs that a thread reads from the pair file at a time.
+ */
+const size_t METHOD_BLOCK_SIZE = 4096;
+
+/**
+ * A block of consecutive pairs from the pair file, and the
+ * results computed for them.
+ */
+struct pair_block
+{
+    /**
+     * Rows in the genotype matrix for each pair.
+     */
+    std::vector< std::pair<size_t, size_t> > rows;
+
+    /**
+     * Snp ids in the result file for each pair.
+     */
+    std::vector< std::pair<size_t, size_t> > ids;
+
+    /**
+     * The statistic returned by the method for each pair.
+     */
+    std::vector<double> statistic;
+
+    /**
+     * Non-zero if the pair passed the threshold and should be written.
+     */
+    std::vector<char> keep;
+
+    /**
+     * The number of usable samples of each pair.
+     */
+    std::vector<size_t> num_ok;
+
+    /**
+     * The value -log10 of the p-value of each pair, or -9 if the
+     * method did not record it, see method_type::get_log10_p.
+     */
+    std::vector<double> log10_p;
+
+    /**
+     * The output of the method for each pair stored one after another.
+     */
+    std::vector<float> output;
+
+    /**
+     * The smallest statistic of each permutation over the pairs in
+     * the block, only used when permutations are run.
+     */
+    std::vector<double> null_min;
+};
+
+/**
+ * A pair in the list of top pairs.
+ */
+struct top_pair
+{
+    /**
+     * The statistic returned by the method.
+     */
+    double statistic;
+
+    /**
+     * Snp ids in the result file.
+     */
+    std::pair<size_t, size_t> ids;
+
+    /**
+     * The output of the method.
+     */
+    std::vector<float> output;
+
+    /**
+     * Orders by statistic, and ties by ids so that the top pairs
+     * do not depend on the order in which the pairs were run.
+     */
+    bool operator<(const top_pair &other) const
+    {
+        if( statistic != other.statistic )
+        {
+            return statistic < other.statistic;
+        }
+
+        return ids < other.ids;
+    }
+};
+
+/**
+ * The pairs with the smallest statistics, kept as a max heap so that
+ * the worst pair is replaced first, and a summary of all statistics.
+ */
+struct top_list
+{
+    top_list(size_t max_size)
+        : max_size( max_size )
+    {
+    }
+
+    /**
+     * Maximum number of pairs to keep.
+     */
+    size_t max_size;
+
+    /**
+     * The kept pairs as a heap.
+     */
+    std::vector<top_pair> heap;
+
+    /**
+     * Summary of the statistics of all pairs.
+     */
+    pvalue_summary summary;
+};
+
+/**
+ * Maps each name to its index in another list of names.
+ *
+ * @param names The names to map.
+ * @param target The list of names that the indices refer to.
+ *
+ * @return The index of each name in target, or PAIR_MISSING_ID
+ *         if it is not present.
+ */
+std::vector<size_t>
+map_snp_names(const std::vector<std::string> &names, const std::vector<std::string> &target)
+{
+    std::vector<size_t> indices( names.size( ), PAIR_MISSING_ID );
+    if( names == target )
+    {
+        for(size_t i = 0; i < names.size( ); i++)
+        {
+            indices[ i ] = i;
+        }
+
+        return indices;
+    }
+
+    std::map<std::string, size_t> target_index;
+    for(size_t i = 0; i < target.size( ); i++)
+    {
+        target_index[ target[ i ] ] = i;
+    }
+
+    for(size_t i = 0; i < names.size( ); i++)
+    {
+        std::map<std::string, size_t>::const_iterator it = target_index.find( names[ i ] );
+        if( it != target_index.end( ) )
+        {
+            indices[ i ] = it->second;
+        }
+    }
+
+    return indices;
+}
+
+/**
+ * Reads the next block of pairs, pairs that refer to snps that
+ * are not in the genotype or result file are skipped.
+ *
+ * @param pairs The pair file.
+ * @param pair_to_row Row in the genotype matrix of each pair file id.
+ * @param pair_to_result Id in the result file of each pair file id.
+ * @param block The block to fill.
+ *
+ * @return False if there were no more pairs to read, true otherwise.
+ */
+bool
+read_block(pairfile &pairs, const std::vector<size_t> &pair_to_row, const std::vector<size_t> &pair_to_result, pair_block &block)
+{
+    block.rows.clear( );
+    block.ids.clear( );
+
+    std::pair<size_t, size_t> pair;
+    size_t num_read = 0;
+    while( num_read < METHOD_BLOCK_SIZE && pairs.read( pair ) )
+    {
+        num_read++;
+        if( pair.first == PAIR_MISSING_ID || pair.second == PAIR_MISSING_ID )
+        {
+            continue;
+        }
+
+        size_t row1_index = pair_to_row[ pair.first ];
+        size_t row2_index = pair_to_row[ pair.second ];
+        if( row1_index == GENOTYPE_MISSING_INDEX || row2_index == GENOTYPE_MISSING_INDEX )
+        {
+            continue;
+        }
+
+        block.rows.push_back( std::make_pair( row1_index, row2_index ) );
+        block.ids.push_back( std::make_pair( pair_to_result[ pair.first ], pair_to_result[ pair.second ] ) );
+    }
+
+    return num_read > 0;
+}
+
+/**
+ * Runs the method on each permutation of the pairs in a block, and
+ * stores the empirical p-value of each pair that has a statistic and
+ * the smallest statistic of each permutation.
+ *
+ * Pairs without an observed statistic, because they were ruled out
+ * before counting or failed the cell size, are still permuted, since
+ * a permutation can give them enough samples in each cell. Leaving
+ * them out would make the smallest statistics of the permutations too
+ * large.
+ *
+ * @param method The method to run, must run from binary tables.
+ * @param permutations The permutations.
+ * @param genotypes Genotypes for all SNPs.
+ * @param num_columns The number of output columns including the sample count.
+ * @param column The column of the empirical p-value.
+ * @param block The block of pairs, the statistics must have been computed.
+ */
+void
+run_permutations(method_type &method, const permutation_engine &permutations, const genotype_matrix_ptr &genotypes,
+                 size_t num_columns, size_t column, pair_block &block)
+{
+    size_t num_permutations = permutations.size( );
+    block.null_min.assign( num_permutations, 1.0 );
+
+    std::vector<binary_table> tables( num_permutations );
+    std::vector<float> scratch( num_columns );
+    for(size_t i = 0; i < block.rows.size( ); i++)
+    {
+        double statistic = block.statistic[ i ];
+        bool has_statistic = statistic != -9 && statistic == statistic;
+
+        permutations.count( genotypes->get_row( block.rows[ i ].first ), genotypes->get_row( block.rows[ i ].second ), &tables[ 0 ] );
+
+        /* Statistics are p-values, so smaller is more extreme */
+        size_t num_extreme = 0;
+        for(size_t p = 0; p < num_permutations; p++)
+        {
+            std::fill( scratch.begin( ), scratch.end( ), result_get_missing( ) );
+            double permuted = method.run_from_counts( tables[ p ], &scratch[ 0 ] );
+            if( permuted == -9 || permuted != permuted )
+            {
+                continue;
+            }
+
+            if( has_statistic && permuted <= statistic )
+            {
+                num_extreme++;
+            }
+            block.null_min[ p ] = std::min( block.null_min[ p ], permuted );
+        }
+
+        if( has_statistic )
+        {
+            block.output[ i * num_columns + column ] = ( 1.0 + num_extreme ) / ( 1.0 + num_permutations );
+        }
+    }
+}
+
+/**
+ * Keeps the smallest statistic of each permutation.
+ *
+ * @param null_min The smallest statistic of each permutation so far.
+ * @param block A block that the permutations were run on.
+ */
+void
+merge_null(std::vector<double> &null_min, const pair_block &block)
+{
+    for(size_t p = 0; p < block.null_min.size( ); p++)
+    {
+        null_min[ p ] = std::min( null_min[ p ], block.null_min[ p ] );
+    }
+}
+
+/**
+ * Writes the smallest statistic of each permutation, one per line.
+ *
+ * @param null_min The smallest statistic of each permutation.
+ * @param null_path The path to write to.
+ */
+void
+write_null(const std::vector<double> &null_min, const std::string &null_path)
+{
+    std::ofstream null_file( null_path.c_str( ) );
+    if( !null_file )
+    {
+        std::cerr << "besiq: warning: Could not write null distribution to " << null_path << "." << std::endl;
+        return;
+    }
+
+    null_file << std::setprecision( 17 );
+    for(size_t p = 0; p < null_min.size( ); p++)
+    {
+        null_file << null_min[ p ] << "\n";
+    }
+}
+
+/**
+ * Runs the method on all pairs in a block, consecutive pairs that
+ * share the first snp are run as one batch.
+ *
+ * @param method The method to run.
+ * @param genotypes Genotypes for all SNPs.
+ * @param permutations The permutations to run, or NULL.
+ * @param num_columns The number of output columns including the sample count.
+ * @param block The block of pairs, the output will be stored here.
+ */
+void
+run_block(method_type &method, const genotype_matrix_ptr &genotypes, const permutation_engine *permutations,
+          size_t num_columns, pair_block &block)
+{
+    double threshold = method.get_data( )->threshold;
+    bool log_p = method.get_data( )->log_p;
+    size_t num_pairs = block.rows.size( );
+
+    block.statistic.assign( num_pairs, -9 );
+    block.keep.assign( num_pairs, 0 );
+    block.num_ok.assign( num_pairs, 0 );
+    block.log10_p.assign( num_pairs, -9 );
+    block.output.assign( num_pairs * num_columns, result_get_missing( ) );
+
+    std::vector<const snp_row *> rows2;
+    size_t start = 0;
+    while( start < num_pairs )
+    {
+        size_t end = start + 1;
+        while( end < num_pairs && block.rows[ end ].first == block.rows[ start ].first )
+        {
+            end++;
+        }
+
+        rows2.clear( );
+        for(size_t i = start; i < end; i++)
+        {
+            rows2.push_back( &genotypes->get_row( block.rows[ i ].second ) );
+        }
+
+        const snp_row &row1 = genotypes->get_row( block.rows[ start ].first );
+        method.run_batch( row1, &rows2[ 0 ], end - start, &block.output[ start * num_columns ], num_columns,
+                          &block.statistic[ start ], &block.num_ok[ start ], &block.log10_p[ start ] );
+        start = end;
+    }
+
+    if( permutations != NULL )
+    {
+        size_t column = num_columns - ( log_p ? 3 : 2 );
+        run_permutations( method, *permutations, genotypes, num_columns, column, block );
+    }
+
+    for(size_t i = 0; i < num_pairs; i++)
+    {
+        double statistic = block.statistic[ i ];
+        if( threshold != -9 && (statistic == -9 || statistic > threshold) )
+        {
+            continue;
+        }
+
+        if( log_p && statistic >= 0.0 && statistic <= 1.0 )
+        {
+            double log10_p = block.log10_p[ i ];
+            if( log10_p < 0.0 )
+            {
+                log10_p = statistic < 1.0 ? -log10( statistic ) : 0.0;
+            }
+            block.output[ i * num_columns + num_columns - 2 ] = log10_p;
+        }
+        block.output[ i * num_columns + num_columns - 1 ] = block.num_ok[ i ];
+        block.keep[ i ] = 1;
+    }
+}
+
+/**
+ * Writes the pairs in a block that passed the threshold.
+ *
+ * @param result The result file.
+ * @param num_columns The number of output columns including the sample count.
+ * @param block The block to write.
+ */
+void
+write_block(resultfile &result, size_t num_columns, pair_block &block)
+{
+    for(size_t i = 0; i < block.rows.size( ); i++)
+    {
+        if( block.keep[ i ] )
+        {
+            result.write( block.ids[ i ].first, block.ids[ i ].second, &block.output[ i * num_columns ] );
+        }
+    }
+}
+
+/**
+ * Adds a pair to a top list if it is better than the worst kept pair.
+ *
+ * @param top The top list.
+ * @param pair The pair, its output is swapped into the list if kept.
+ */
+void
+add_top_pair(top_list &top, top_pair &pair)
+{
+    if( !top.heap.empty( ) && top.heap.size( ) >= top.max_size && !( pair < top.heap.front( ) ) )
+    {
+        return;
+    }
+
+    top.heap.push_back( top_pair( ) );
+    top.heap.back( ).statistic = pair.statistic;
+    top.heap.back( ).ids = pair.ids;
+    top.heap.back( ).output.swap( pair.output );
+    std::push_heap( top.heap.begin( ), top.heap.end( ) );
+    if( top.heap.size( ) > top.max_size )
+    {
+        std::pop_heap( top.heap.begin( ), top.heap.end( ) );
+        top.heap.pop_back( );
+    }
+}
+
+/**
+ * Adds the pairs in a block to the summary, and keeps the pairs
+ * that passed the threshold and are among the top pairs.
+ *
+ * @param top The top list.
+ * @param num_columns The number of output columns including the sample count.
+ * @param block The block of pairs.
+ */
+void
+add_top_block(top_list &top, size_t num_columns, const pair_block &block)
+{
+    top_pair pair;
+    for(size_t i = 0; i < block.rows.size( ); i++)
+    {
+        double statistic = block.statistic[ i ];
+        top.summary.add( statistic );
+
+        /* Missing and NaN statistics can not be ranked */
+        if( !block.keep[ i ] || statistic == -9 || statistic != statistic )
+        {
+            continue;
+        }
+
+        pair.statistic = statistic;
+        pair.ids = block.ids[ i ];
+        pair.output.assign( block.output.begin( ) + i * num_columns, block.output.begin( ) + ( i + 1 ) * num_columns );
+        add_top_pair( top, pair );
+    }
+}
+
+/**
+ * Adds the pairs and the summary of another top list to a top list.
+ *
+ * @param top The top list.
+ * @param other The other top list, its pairs are moved.
+ */
+void
+merge_top(top_list &top, top_list &other)
+{
+    for(size_t i = 0; i < other.heap.size( ); i++)
+    {
+        add_top_pair( top, other.heap[ i ] );
+    }
+    top.summary.merge( other.summary );
+}
+
+/**
+ * Writes the top pairs sorted by their statistic, and the summary
+ * of all statistics.
+ *
+ * @param result The result file.
+ * @param top The top list, the heap is sorted.
+ * @param summary_path Path to the summary, standard error if empty.
+ */
+void
+write_top(resultfile &result, top_list &top, const std::string &summary_path)
+{
+    std::sort_heap( top.heap.begin( ), top.heap.end( ) );
+    for(size_t i = 0; i < top.heap.size( ); i++)
+    {
+        result.write( top.heap[ i ].ids.first, top.heap[ i ].ids.second, &top.heap[ i ].output[ 0 ] );
+    }
+
+    if( summary_path.empty( ) )
+    {
+        top.summary.write( std::cerr );
+        return;
+    }
+
+    std::ofstream summary_file( summary_path.c_str( ) );
+    if( !summary_file )
+    {
+        std::cerr << "besiq: warning: Could not write summary to " << summary_path << "." << std::endl;
+        return;
+    }
+    top.summary.write( summary_file );
+}
+
+#ifdef _OPENMP
+/**
+ * Runs the method in parallel. Each thread reads a block from the pair
+ * file when it becomes idle, and finished blocks are kept in a reorder
+ * buffer until all preceding blocks have been written, so the output is
+ * identical to a serial run. If only the top pairs are kept, each thread
+ * keeps its own top list that is merged when all pairs have been run.
+ *
+ * @param methods One method for each thread.
+ * @param genotypes Genotypes for all SNPs.
+ * @param permutations The permutations to run, or NULL.
+ * @param null_min The smallest statistic of each permutation is kept here.
+ * @param pairs The pairs to test.
+ * @param pair_to_row Row in the genotype matrix of each pair file id.
+ * @param pair_to_result Id in the result file of each pair file id.
+ * @param num_columns The number of output columns including the sample count.
+ * @param result The result file.
+ * @param top The top list, or NULL if all pairs should be written.
+ */
+void
+run_parallel(std::vector<method_type *> &methods, const genotype_matrix_ptr &genotypes,
+             const permutation_engine *permutations, std::vector<double> &null_min, pairfile &pairs,
+             const std::vector<size_t> &pair_to_row, const std::vector<size_t> &pair_to_result,
+             size_t num_columns, resultfile &result, top_list *top)
+{
+    size_t next_read = 0;
+    size_t next_write = 0;
+    bool pairs_left = true;
+    std::map<size_t, pair_block *> finished;
+
+    #pragma omp parallel num_threads( methods.size( ) )
+    {
+        method_type &method = *methods[ omp_get_thread_num( ) ];
+        top_list thread_top( top != NULL ? top->max_size : 0 );
+        while( true )
+        {
+            pair_block *block = new pair_block( );
+            size_t block_id = 0;
+            bool has_block = false;
+
+            #pragma omp critical( run_method_read )
+            {
+                if( pairs_left )
+                {
+                    pairs_left = read_block( pairs, pair_to_row, pair_to_result, *block );
+                    has_block = pairs_left;
+                    if( has_block )
+                    {
+                        block_id = next_read++;
+                    }
+                }
+            }
+
+            if( !has_block )
+            {
+                delete block;
+                break;
+            }
+
+            run_block( method, genotypes, permutations, num_columns, *block );
+            if( permutations != NULL )
+            {
+                #pragma omp critical( run_method_null )
+                merge_null( null_min, *block );
+            }
+
+            if( top != NULL )
+            {
+                add_top_block( thread_top, num_columns, *block );
+                delete block;
+                continue;
+            }
+
+            #pragma omp critical( run_method_write )
+            {
+                finished[ block_id ] = block;
+                while( !finished.empty( ) && finished.begin( )->first == next_write )
+                {
+                    write_block( result, num_columns, *finished.begin( )->second );
+                    delete finished.begin( )->second;
+                    finished.erase( finished.begin( ) );
+                    next_write++;
+                }
+            }
+        }
+
+        if( top != NULL )
+        {
+            #pragma omp critical( run_method_write )
+            {
+                merge_top( *top, thread_top );
+            }
+        }
+    }
+}
+#endif
 
 void run_method(method_type &method, genotype_matrix_ptr genotypes, pairfile &pairs, resultfile &result)
 {
+    const method_data_ptr &data = method.get_data( );
     std::vector<std::string> method_header = method.init( );
+    shared_ptr<permutation_engine> permutations;
+    if( data->num_permutations > 0 )
+    {
+        if( method.get_count_type( ) != COUNT_TYPE_BINARY )
+        {
+            throw std::invalid_argument( "run_method: Permutations need a method that runs from case/control counts." );
+        }
+
+        permutations = shared_ptr<permutation_engine>( new permutation_engine( data->phenotype, data->missing, data->num_permutations, data->permutation_seed ) );
+        method_header.push_back( "PERM_P" );
+    }
+    std::vector<double> null_min( data->num_permutations, 1.0 );
+    if( data->log_p )
+    {
+        method_header.push_back( "LOG10P" );
+    }
     method_header.push_back( "N" );
+    method.set_genotypes( genotypes );
     result.set_header( method_header );
+    size_t num_columns = method_header.size( );
 
-    float *output = new float[ method_header.size( ) ];
-    double threshold = method.get_data( )->threshold;
-    
-    std::pair<std::string, std::string> pair;
-    while( pairs.read( pair ) )
+    /* Translate pair file ids once, so no names are looked up per pair */
+    std::vector<size_t> pair_to_row = genotypes->get_indices( pairs.get_snp_names( ) );
+    std::vector<size_t> pair_to_result = map_snp_names( pairs.get_snp_names( ), result.get_snp_names( ) );
+
+    top_list top( data->top );
+    top_list *top_ptr = data->top > 0 ? &top : NULL;
+    bool done = false;
+    size_t num_skipped = 0;
+    size_t num_fits = 0;
+    size_t num_iterations = 0;
+
+#ifdef _OPENMP
+    unsigned int num_threads = data->num_threads;
+    if( num_threads > 1 )
     {
-        snp_row const *row1 = genotypes->get_row( pair.first );
-        snp_row const *row2 = genotypes->get_row( pair.second );
+        std::vector<method_type *> methods( 1, &method );
+        for(unsigned int i = 1; i < num_threads; i++)
+        {
+            method_type *copy = method.clone( );
+            if( copy == NULL )
+            {
+                std::cerr << "besiq: warning: Method can not be run in parallel, using a single thread." << std::endl;
+                break;
+            }
+            methods.push_back( copy );
+        }
 
-        if( row1 == NULL || row2 == NULL )
+        if( methods.size( ) == num_threads )
         {
-            continue;
+            run_parallel( methods, genotypes, permutations.get( ), null_min, pairs, pair_to_row, pair_to_result, num_columns, result, top_ptr );
+            done = true;
         }
 
-        std::fill( output, output + method_header.size( ), result_get_missing( ) );
+        for(size_t i = 1; i < methods.size( ); i++)
+        {
+            num_skipped += methods[ i ]->num_skipped( );
+            num_fits += methods[ i ]->num_fits( );
+            num_iterations += methods[ i ]->num_iterations( );
+            delete methods[ i ];
+        }
+    }
+#endif
 
-        double statistic = method.run( *row1, *row2, output );
-        if( threshold != -9 && (statistic == -9 || statistic > threshold) )
+    pair_block block;
+    while( !done && read_block( pairs, pair_to_row, pair_to_result, block ) )
+    {
+        run_block( method, genotypes, permutations.get( ), num_columns, block );
+        if( permutations.get( ) != NULL )
         {
-            continue;
+            merge_null( null_min, block );
         }
 
-        output[ method_header.size( ) - 1 ] = method.num_ok_samples( *row1, *row2 );
+        if( top_ptr != NULL )
+        {
+            add_top_block( top, num_columns, block );
+        }
+        else
+        {
+            write_block( result, num_columns, block );
+        }
+    }
+
+    if( permutations.get( ) != NULL )
+    {
+        write_null( null_min, data->null_path );
+    }
 
-        result.write( pair, output );
+    num_skipped += method.num_skipped( );
+    num_fits += method.num_fits( );
+    num_iterations += method.num_iterations( );
+    if( top_ptr != NULL )
+    {
+        top.summary.add_skipped( num_skipped );
+        write_top( result, top, data->summary_path );
+    }
+    else if( num_skipped > 0 )
+    {
+        std::cerr << "besiq: " << num_skipped << " pairs were skipped before counting, because they can not meet the smallest cell size." << std::endl;
     }
 
-    delete[] output;
+    if( num_fits > 0 )
+    {
+        std::cerr << "besiq: " << num_fits << " models were fitted with an average of " << (double) num_iterations / num_fits << " IRLS iterations." << std::endl;
+    }
 }
@@ -8,6 +8,7 @@
 
 #include <plink/snp_row.hpp>
 #include <shared_ptr/shared_ptr.hpp>
+#include <besiq/stats/snp_count.hpp>
 
 class pairfile;
 class resultfile;
@@ -26,6 +27,28 @@ const unsigned int METHOD_SMALLEST_CELL_SIZE_BINOMIAL = 5;
  */
 const unsigned int METHOD_SMALLEST_CELL_SIZE_NORMAL = 10;
 
+/**
+ * The contingency table that a method can compute its statistic
+ * from, see method_type::run_from_counts.
+ */
+enum count_type
+{
+    /**
+     * The method needs the genotypes and can not be run from counts.
+     */
+    COUNT_TYPE_NONE,
+
+    /**
+     * The method is run from a binary_table of controls and cases.
+     */
+    COUNT_TYPE_BINARY,
+
+    /**
+     * The method is run from a cont_table of a continuous phenotype.
+     */
+    COUNT_TYPE_CONT
+};
+
 /**
  * Represents additional data that is required by the method.
  */
@@ -75,6 +98,52 @@ struct method_data
      * Use fast less robust matrix inversion.
      */
     bool fast_inversion;
+
+    /**
+     * Number of threads to use when running a method.
+     */
+    unsigned int num_threads;
+
+    /**
+     * If non-zero, only this many pairs with the smallest statistics
+     * are written, and a summary of all statistics is written to
+     * summary_path.
+     */
+    unsigned int top;
+
+    /**
+     * Path to the summary of all statistics when only the top pairs
+     * are written, standard error if empty.
+     */
+    std::string summary_path;
+
+    /**
+     * If true, -log10 of the p-value is written in the column LOG10P
+     * before the number of usable samples. Methods that record it with
+     * set_log10_p compute it from the test statistic, so it is finite
+     * also when the p-value underflows. For other methods it is
+     * computed from the statistic returned by run.
+     */
+    bool log_p;
+
+    /**
+     * If non-zero, the phenotype is permuted this many times. The
+     * empirical p-value of each pair is written in the column PERM_P,
+     * and the smallest statistic of each permutation over all pairs
+     * is written to null_path, for family-wise correction.
+     */
+    unsigned int num_permutations;
+
+    /**
+     * The seed of the permutations, runs on different splits of the
+     * pair file must use the same seed.
+     */
+    unsigned long permutation_seed;
+
+    /**
+     * Path to the smallest statistic of each permutation.
+     */
+    std::string null_path;
 };
 
 /**
@@ -90,7 +159,11 @@ public:
      */
     method_type(method_data_ptr data)
         : m_data( data ),
-          m_num_ok_samples( 0 )
+          m_num_ok_samples( 0 ),
+          m_log10_p( -9 ),
+          m_num_skipped( 0 ),
+          m_num_fits( 0 ),
+          m_num_iterations( 0 )
     {
     }
 
@@ -99,13 +172,27 @@ public:
     }
 
     /**
-     * Returns the additional data.
+     * Returns the additional data. A reference is returned so that
+     * concurrent calls do not touch the reference count.
      */
-    method_data_ptr get_data()
+    const method_data_ptr &get_data()
     {
         return m_data;
     }
 
+    /**
+     * Creates a copy of this method that has its own scratch
+     * buffers, so that it can be run concurrently with this
+     * method on the same data.
+     *
+     * @return A new method that must be deleted by the caller, or
+     *         NULL if the method can not be run concurrently.
+     */
+    virtual method_type *clone()
+    {
+        return NULL;
+    }
+
     virtual void set_num_ok_samples(size_t ok_samples)
     {
         m_num_ok_samples = ok_samples;
@@ -125,11 +212,47 @@ public:
         return m_num_ok_samples;
     }
 
+    /**
+     * Records -log10 of the p-value returned by the last call to run.
+     * Methods compute it from their test statistic with the
+     * *_upper_log10 functions, so that it is finite also when the
+     * p-value underflows.
+     *
+     * @param log10_p The value -log10 of the p-value.
+     */
+    void set_log10_p(double log10_p)
+    {
+        m_log10_p = log10_p;
+    }
+
+    /**
+     * Returns -log10 of the p-value of the last call to run, see
+     * set_log10_p.
+     *
+     * @return The value -log10 of the p-value, or -9 if the method
+     *         did not record it.
+     */
+    double get_log10_p() const
+    {
+        return m_log10_p;
+    }
+
     /**
      * Return the column names that will be written by this method.
      */
     virtual std::vector<std::string> init() = 0;
 
+    /**
+     * Called after init and before any pair is run, so that the
+     * method can precompute quantities of each variant. The rows
+     * given to run will be rows of this matrix.
+     *
+     * @param genotypes The genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes)
+    {
+    }
+
     /**
      * 
      * @param row1 The first genotype.
@@ -142,6 +265,134 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output) = 0;
 
+    /**
+     * Runs the method on several pairs that share the first snp, so
+     * that work that only depends on the first snp is done once. By
+     * default each pair is run separately.
+     *
+     * @param row1 The first snp of all pairs.
+     * @param rows2 The second snp of each pair.
+     * @param n The number of pairs.
+     * @param outputs The results of pair i are stored at outputs + i * stride,
+     *                see run.
+     * @param stride The distance between the results of two pairs.
+     * @param statistics The test statistic of each pair will be stored here.
+     * @param num_ok The number of usable samples of each pair will be
+     *               stored here, see num_ok_samples.
+     * @param log10_p The value -log10 of the p-value of each pair will
+     *                be stored here, or -9, see get_log10_p.
+     */
+    virtual void run_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                           size_t stride, double *statistics, size_t *num_ok, double *log10_p)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            set_log10_p( -9 );
+            statistics[ i ] = run( row1, *rows2[ i ], outputs + i * stride );
+            num_ok[ i ] = num_ok_samples( row1, *rows2[ i ] );
+            log10_p[ i ] = get_log10_p( );
+        }
+    }
+
+    /**
+     * Returns the contingency table that the method can be run from
+     * with run_from_counts.
+     *
+     * @return The type of table, COUNT_TYPE_NONE if the method
+     *         can only be run on the genotypes.
+     */
+    virtual count_type get_count_type()
+    {
+        return COUNT_TYPE_NONE;
+    }
+
+    /**
+     * Computes the statistic from an already counted table of the
+     * non-missing samples, so that several methods can share one
+     * count of a pair. Only called when get_count_type returns
+     * COUNT_TYPE_BINARY.
+     *
+     * @param counts The counts of the pair.
+     * @param output The results for this method, see run.
+     *
+     * @return The value of the test statistic, see run.
+     */
+    virtual double run_from_counts(const binary_table &counts, float *output)
+    {
+        return -9;
+    }
+
+    /**
+     * Computes the statistic from an already counted table of the
+     * non-missing samples. Only called when get_count_type returns
+     * COUNT_TYPE_CONT.
+     *
+     * @param counts The counts of the pair.
+     * @param output The results for this method, see run.
+     *
+     * @return The value of the test statistic, see run.
+     */
+    virtual double run_from_counts(const cont_table &counts, float *output)
+    {
+        return -9;
+    }
+
+    /**
+     * Returns the number of pairs that were ruled out before counting,
+     * because they could not meet the smallest cell size.
+     *
+     * @return The number of skipped pairs.
+     */
+    size_t num_skipped() const
+    {
+        return m_num_skipped;
+    }
+
+    /**
+     * Returns the number of iteratively fitted models, see add_fit.
+     *
+     * @return The number of fitted models.
+     */
+    size_t num_fits() const
+    {
+        return m_num_fits;
+    }
+
+    /**
+     * Returns the total number of iterations of the fitted models.
+     *
+     * @return The number of iterations.
+     */
+    size_t num_iterations() const
+    {
+        return m_num_iterations;
+    }
+
+protected:
+    /**
+     * Records that a pair was ruled out before counting.
+     */
+    void add_skipped()
+    {
+        m_num_skipped++;
+    }
+
+    /**
+     * Records the iterations of a model fit, so that the average
+     * number of IRLS iterations can be reported. Fits without
+     * iterations, such as linear regression, are not counted.
+     *
+     * @param num_iters The number of iterations of the fit.
+     */
+    void add_fit(unsigned int num_iters)
+    {
+        if( num_iters > 0 )
+        {
+            m_num_fits++;
+            m_num_iterations += num_iters;
+        }
+    }
+
 private:
     /**
      * Additional data required by the method.
@@ -152,16 +403,46 @@ private:
      * The number of samples
      */
     size_t m_num_ok_samples;
+
+    /**
+     * The value -log10 of the p-value of the last call to run.
+     */
+    double m_log10_p;
+
+    /**
+     * The number of pairs that were ruled out before counting.
+     */
+    size_t m_num_skipped;
+
+    /**
+     * The number of iteratively fitted models.
+     */
+    size_t m_num_fits;
+
+    /**
+     * The total number of iterations of the fitted models.
+     */
+    size_t m_num_iterations;
 };
 
 /**
  * Runs the given method on the genotype file, traversing
- * the given list of SNPs.
+ * the given list of SNPs. If more than one thread is requested
+ * in the method data and the method can be cloned, the pairs
+ * are processed in parallel, but the results are written in
+ * the same order as the pairs are read.
+ *
+ * If a top is set in the method data, only the pairs with the smallest
+ * statistics are kept while running, and they are written sorted by
+ * the statistic together with a summary of all statistics.
  *
  * @param method A method to run.
  * @param genotype_matix Genotypes for all SNPs.
  * @param pairs The pairs to test.
  * @param result The result file.
+ *
+ * @throws std::invalid_argument if permutations are requested for a
+ *         method that does not run from binary tables.
  */
 void run_method(method_type &method, genotype_matrix_ptr genotype_matrix, pairfile &pairs, resultfile &result);
 
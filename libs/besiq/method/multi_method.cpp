@@ -0,0 +1,136 @@
+#include <besiq/method/multi_method.hpp>
+#include <plink/plink_file.hpp>
+
+multi_method::multi_method(method_data_ptr data, const std::vector<method_type *> &methods, const std::vector<std::string> &names)
+: method_type::method_type( data ),
+  m_methods( methods ),
+  m_names( names )
+{
+    m_counter = count_engine( data->phenotype, data->missing );
+}
+
+multi_method::~multi_method()
+{
+    for(int i = 0; i < m_methods.size( ); i++)
+    {
+        delete m_methods[ i ];
+    }
+}
+
+std::vector<std::string>
+multi_method::init()
+{
+    std::vector<std::string> header;
+
+    m_offset.clear( );
+    m_num_columns.clear( );
+    for(int i = 0; i < m_methods.size( ); i++)
+    {
+        std::vector<std::string> method_header = m_methods[ i ]->init( );
+        m_offset.push_back( header.size( ) );
+        m_num_columns.push_back( method_header.size( ) );
+        for(int j = 0; j < method_header.size( ); j++)
+        {
+            header.push_back( m_names[ i ] + "_" + method_header[ j ] );
+        }
+        header.push_back( m_names[ i ] + "_N" );
+    }
+
+    return header;
+}
+
+void
+multi_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+    for(int i = 0; i < m_methods.size( ); i++)
+    {
+        if( m_methods[ i ]->get_count_type( ) == COUNT_TYPE_NONE )
+        {
+            m_methods[ i ]->set_genotypes( genotypes );
+        }
+    }
+}
+
+double
+multi_method::run(const snp_row &row1, const snp_row &row2, float *output)
+{
+    bool has_binary = false;
+    bool has_cont = false;
+    for(int i = 0; i < m_methods.size( ); i++)
+    {
+        has_binary = has_binary || m_methods[ i ]->get_count_type( ) == COUNT_TYPE_BINARY;
+        has_cont = has_cont || m_methods[ i ]->get_count_type( ) == COUNT_TYPE_CONT;
+    }
+
+    binary_table binary_counts;
+    if( has_binary )
+    {
+        m_counter.count( row1, row2, binary_counts );
+    }
+    cont_table cont_counts;
+    if( has_cont )
+    {
+        m_counter.count( row1, row2, cont_counts );
+    }
+
+    double statistic = -9;
+    for(int i = 0; i < m_methods.size( ); i++)
+    {
+        method_type *method = m_methods[ i ];
+        float *method_output = &output[ m_offset[ i ] ];
+
+        double method_statistic = -9;
+        method->set_log10_p( -9 );
+        switch( method->get_count_type( ) )
+        {
+            case COUNT_TYPE_BINARY:
+                method_statistic = method->run_from_counts( binary_counts, method_output );
+                break;
+            case COUNT_TYPE_CONT:
+                method_statistic = method->run_from_counts( cont_counts, method_output );
+                break;
+            default:
+                method_statistic = method->run( row1, row2, method_output );
+                break;
+        }
+
+        size_t num_ok_samples = method->num_ok_samples( row1, row2 );
+        method_output[ m_num_columns[ i ] ] = num_ok_samples;
+        if( i == 0 )
+        {
+            statistic = method_statistic;
+            set_num_ok_samples( num_ok_samples );
+            set_log10_p( method->get_log10_p( ) );
+        }
+    }
+
+    return statistic;
+}
+
+method_type *
+multi_method::clone()
+{
+    std::vector<method_type *> methods;
+    for(int i = 0; i < m_methods.size( ); i++)
+    {
+        method_type *method = m_methods[ i ]->clone( );
+        if( method == NULL )
+        {
+            for(int j = 0; j < methods.size( ); j++)
+            {
+                delete methods[ j ];
+            }
+
+            return NULL;
+        }
+        methods.push_back( method );
+    }
+
+    multi_method *copy = new multi_method( get_data( ), methods, m_names );
+    copy->m_offset = m_offset;
+    copy->m_num_columns = m_num_columns;
+    copy->m_counter = m_counter;
+
+    return copy;
+}
@@ -0,0 +1,88 @@
+#ifndef __MULTI_METHOD_H__
+#define __MULTI_METHOD_H__
+
+#include <string>
+#include <vector>
+
+#include <besiq/method/method.hpp>
+#include <besiq/stats/snp_count.hpp>
+
+/**
+ * This class runs several methods on each pair, and counts the
+ * contingency table of a pair only once for all methods that can
+ * be run from counts.
+ *
+ * The columns of each method are prefixed by its name and followed
+ * by its own number of usable samples, '<name>_N'. The statistic
+ * and the usable samples of the first method are used for the
+ * threshold and top pairs.
+ */
+class multi_method
+: public method_type
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param data Additional data required by all methods, such as
+     *             covariates.
+     * @param methods The methods to run, they are deleted by this
+     *                object.
+     * @param names The name of each method, used as column prefix.
+     */
+    multi_method(method_data_ptr data, const std::vector<method_type *> &methods, const std::vector<std::string> &names);
+
+    /**
+     * Destructor.
+     */
+    ~multi_method();
+
+    /**
+     * @see method_type::init.
+     */
+    virtual std::vector<std::string> init();
+
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
+
+    /**
+     * @see method_type::run.
+     */
+    virtual double run(const snp_row &row1, const snp_row &row2, float *output);
+
+    /**
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
+
+private:
+    /**
+     * The methods to run.
+     */
+    std::vector<method_type *> m_methods;
+
+    /**
+     * The name of each method.
+     */
+    std::vector<std::string> m_names;
+
+    /**
+     * The first output column of each method.
+     */
+    std::vector<size_t> m_offset;
+
+    /**
+     * The number of output columns of each method, excluding
+     * the number of usable samples.
+     */
+    std::vector<size_t> m_num_columns;
+
+    /**
+     * Computes the contingency tables of the non-missing samples.
+     */
+    count_engine m_counter;
+};
+
+#endif /* End of __MULTI_METHOD_H__ */
@@ -1,11 +1,13 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <besiq/method/peer_method.hpp>
 #include <besiq/stats/snp_count.hpp>
+#include <plink/plink_file.hpp>
 
 peer_method::peer_method(method_data_ptr data)
 : method_type::method_type( data )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.size( ) );
+    m_counter = count_engine( data->phenotype, data->missing );
 }
 
 std::vector<std::string>
@@ -24,6 +26,12 @@ peer_method::init()
     return header;
 }
 
+void
+peer_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
 /**
  * rr | rd
  * dr | dd
@@ -37,40 +45,39 @@ peer_method::init()
  *                      at locus 1.
  * @param snp2_onestart The minimum number of minor alleles that should be considered a 1.
  *                      at locus 2.
+ * @param encoded_counts The counts of the 2x2 table ordered as rr, rd, dr and dd
+ *                       will be stored here.
  */
-arma::mat
-peer_method::encode_counts(const arma::mat &counts, size_t snp1_onestart, size_t snp2_onestart)
+void
+peer_method::encode_counts(const binary_table &counts, size_t snp1_onestart, size_t snp2_onestart, double encoded_counts[ 4 ][ 2 ])
 {
     int dd = ( snp1_onestart == 1 ) && ( snp2_onestart == 1 );
     int rd = ( snp1_onestart == 1 ) && ( snp2_onestart == 2 );
     int dr = ( snp1_onestart == 2 ) && ( snp2_onestart == 1 );
     int rr = ( snp1_onestart == 2 ) && ( snp2_onestart == 2 );
 
-    arma::mat encoded_counts( 4, 2 );
     for(int i = 0; i <= 1; i++)
     {
-        encoded_counts( 0, i ) = counts( 0, i ) + (rd + rr) * counts( 1, i ) + (dr + rr) * counts( 3, i ) + rr * counts( 4, i );
-        encoded_counts( 1, i ) = (dr + dd) * counts( 1, i ) + counts( 2, i ) + dr * counts( 4, i ) + (dr + rr) * counts( 5, i );
-        encoded_counts( 2, i ) = (rd + dd) * counts( 3, i ) + rd * counts( 4, i ) + counts( 6, i ) + (rd + rr) * counts( 7, i );
-        encoded_counts( 3, i ) = dd * counts( 4, i ) + (rd + dd) * counts( 5, i ) + (dr + dd) * counts( 7, i ) + counts( 8, i );
+        encoded_counts[ 0 ][ i ] = counts( 0, i ) + (rd + rr) * counts( 1, i ) + (dr + rr) * counts( 3, i ) + rr * counts( 4, i );
+        encoded_counts[ 1 ][ i ] = (dr + dd) * counts( 1, i ) + counts( 2, i ) + dr * counts( 4, i ) + (dr + rr) * counts( 5, i );
+        encoded_counts[ 2 ][ i ] = (rd + dd) * counts( 3, i ) + rd * counts( 4, i ) + counts( 6, i ) + (rd + rr) * counts( 7, i );
+        encoded_counts[ 3 ][ i ] = dd * counts( 4, i ) + (rd + dd) * counts( 5, i ) + (dr + dd) * counts( 7, i ) + counts( 8, i );
     }
-
-    return encoded_counts;
 }
 
 void
-peer_method::compute_ld_p(const arma::mat &counts, float *ld_case_z, float *ld_contrast_z)
+peer_method::compute_ld_p(const double counts[ 4 ][ 2 ], float *ld_case_z, float *ld_contrast_z)
 {
-    double N_controls = sum( counts.col( 0 ) );
-    double N_cases = sum( counts.col( 1 ) );
+    double N_controls = counts[ 0 ][ 0 ] + counts[ 1 ][ 0 ] + counts[ 2 ][ 0 ] + counts[ 3 ][ 0 ];
+    double N_cases = counts[ 0 ][ 1 ] + counts[ 1 ][ 1 ] + counts[ 2 ][ 1 ] + counts[ 3 ][ 1 ];
 
-    double p_a_case = ( counts( 1, 1 ) + counts( 3, 1 ) ) / N_cases;
-    double p_a_control = ( counts( 1, 0 ) + counts( 3, 0 ) ) / N_controls;
-    double p_b_case = ( counts( 2, 1 ) + counts( 3, 1 ) ) / N_cases;
-    double p_b_control = ( counts( 2, 0 ) + counts( 3, 0 ) ) / N_controls;
+    double p_a_case = ( counts[ 1 ][ 1 ] + counts[ 3 ][ 1 ] ) / N_cases;
+    double p_a_control = ( counts[ 1 ][ 0 ] + counts[ 3 ][ 0 ] ) / N_controls;
+    double p_b_case = ( counts[ 2 ][ 1 ] + counts[ 3 ][ 1 ] ) / N_cases;
+    double p_b_control = ( counts[ 2 ][ 0 ] + counts[ 3 ][ 0 ] ) / N_controls;
     
-    double p_ab_case = counts( 3, 1 ) / N_cases;
-    double p_ab_control = counts( 3, 0 ) / N_controls;
+    double p_ab_case = counts[ 3 ][ 1 ] / N_cases;
+    double p_ab_control = counts[ 3 ][ 0 ] / N_controls;
 
     double delta_case = ( p_ab_case - p_a_case * p_b_case );
     double delta_control = ( p_ab_control - p_a_control * p_b_control );
@@ -86,29 +93,57 @@ peer_method::compute_ld_p(const arma::mat &counts, float *ld_case_z, float *ld_c
 double
 peer_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat counts = joint_count( row1, row2, get_data( )->phenotype, m_weight );
-    
-    if( arma::min( arma::min( counts ) ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    binary_table counts;
+    m_counter.count( row1, row2, counts );
+
+    return run_from_counts( counts, output );
+}
+
+count_type
+peer_method::get_count_type()
+{
+    return COUNT_TYPE_BINARY;
+}
+
+double
+peer_method::run_from_counts(const binary_table &counts, float *output)
+{
+    set_num_ok_samples( (size_t) ( counts.sum( 0 ) + counts.sum( 1 ) ) );
+    if( counts.min( ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
     {
         return -9;
     }
-    set_num_ok_samples( (size_t) arma::accu( counts ) );
 
     size_t output_index = 0;
+    double log10_p = -9;
     for(int i = 1; i <= 2; i++)
     {
         for(int j = 1; j <= 2; j++)
         {
-            arma::mat encoded_counts = encode_counts( counts, i, j );
+            double encoded_counts[ 4 ][ 2 ];
+            encode_counts( counts, i, j, encoded_counts );
 
             float ld_case_z;
             float ld_contrast_z;
             compute_ld_p( encoded_counts, &ld_case_z, &ld_contrast_z );
 
             output[ output_index++ ] = ld_case_z;
-            output[ output_index++ ] = 1 - norm_cdf( ld_contrast_z, 0.0, 1.0 );
+            output[ output_index++ ] = norm_upper( ld_contrast_z, 0.0, 1.0 );
+
+            double log10_contrast_p = norm_upper_log10( ld_contrast_z, 0.0, 1.0 );
+            if( log10_contrast_p > log10_p )
+            {
+                log10_p = log10_contrast_p;
+            }
         }
     }
+    set_log10_p( log10_p );
 
     return min_na( min_na( output[ 1 ], output[ 3 ] ), min_na( output[ 5 ], output[ 7 ] ) );
 }
+
+method_type *
+peer_method::clone()
+{
+    return new peer_method( *this );
+}
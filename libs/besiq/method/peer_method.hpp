@@ -9,6 +9,7 @@
 #include <besiq/method/method.hpp>
 #include <besiq/method/wald_method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
 
 /**
  * This class is responsible for intializing and repeatedly
@@ -31,19 +32,38 @@ public:
      */
     virtual std::vector<std::string> init();
 
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
+
     /**
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * @see method_type::get_count_type.
+     */
+    virtual count_type get_count_type();
+
+    /**
+     * @see method_type::run_from_counts.
+     */
+    virtual double run_from_counts(const binary_table &counts, float *output);
+
+    /**
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
+
 private: 
-    void compute_ld_p(const arma::mat &counts, float *ld_case_z, float *ld_contrast_z);
-    arma::mat encode_counts(const arma::mat &counts, size_t snp1_onestart, size_t snp2_onestart);
+    void compute_ld_p(const double counts[ 4 ][ 2 ], float *ld_case_z, float *ld_contrast_z);
+    void encode_counts(const binary_table &counts, size_t snp1_onestart, size_t snp2_onestart, double encoded_counts[ 4 ][ 2 ]);
     /**
-     * A weight > 0 associated with each sample, that allows for
-     * covariate adjustment.
+     * Computes the contingency tables of the non-missing samples.
      */
-    arma::vec m_weight;
+    count_engine m_counter;
 };
 
 #endif /* End of __PEER_METHOD_H__ */
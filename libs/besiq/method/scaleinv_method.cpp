@@ -1,4 +1,5 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <glm/models/binomial.hpp>
 #include <glm/models/normal.hpp>
 
@@ -6,8 +7,14 @@
 
 scaleinv_method::scaleinv_method(method_data_ptr data, model_matrix &model_matrix, bool is_lm)
 : method_type::method_type( data ),
-  m_model_matrix( model_matrix )
+  m_model_matrix( model_matrix ),
+  m_grouped( model_matrix )
 {
+    if( m_grouped.is_valid( ) )
+    {
+        m_counter = count_engine( data->phenotype, data->missing );
+    }
+
     if( !is_lm )
     {
         m_model.push_back( new binomial( "identity" ) );
@@ -20,6 +27,8 @@ scaleinv_method::scaleinv_method(method_data_ptr data, model_matrix &model_matri
     {
         m_model.push_back( new normal( "identity" ) );
     }
+
+    m_start.resize( m_model.size( ) );
 }
 
 scaleinv_method::~scaleinv_method()
@@ -43,17 +52,85 @@ scaleinv_method::init()
 
 double scaleinv_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
+    if( m_grouped.is_valid( ) )
+    {
+        cont_table counts;
+        m_counter.count( row1, row2, counts );
+
+        return run_from_counts( counts, output );
+    }
+
     arma::uvec missing = get_data( )->missing;
     m_model_matrix.update_matrix( row1, row2, missing );
     set_num_ok_samples( missing.n_elem - sum( missing ) );
     
     for(int i = 0; i < m_model.size( ); i++)
     {
+        glm_info null_info;
+        const arma::vec &null_start = m_start[ i ].get_null( m_model_matrix, row1, row2 );
+        arma::vec b = glm_fit( m_model_matrix.get_null( ), get_data( )->phenotype, missing, *m_model[ i ], null_info, m_workspace, null_start );
+        add_fit( null_info.num_iters );
+
+        arma::vec alt_start;
+        if( null_info.success )
+        {
+            m_start[ i ].add_null( m_model_matrix, row1, row2, b );
+            alt_start = m_model_matrix.null_to_alt( b );
+        }
+
         glm_info alt_info;
-        glm_fit( m_model_matrix.get_alt( ), get_data( )->phenotype, missing, *m_model[ i ], alt_info );
+        glm_fit( m_model_matrix.get_alt( ), get_data( )->phenotype, missing, *m_model[ i ], alt_info, m_workspace, alt_start );
+        add_fit( alt_info.num_iters );
+
+        if( !null_info.success || !alt_info.success )
+        {
+            continue;
+        }
+
+        try
+        {
+            double LR = -2 * ( null_info.logl - alt_info.logl );
+            double p = chi_square_upper( LR, m_model_matrix.num_df( ) );
+            set_log10_p( chi_square_upper_log10( LR, m_model_matrix.num_df( ) ) );
+            output[ i ] = p;
 
+            return p;
+        }
+        catch(bad_domain_value &e)
+        {
+        }
+    }
+
+    return -9;
+}
+
+count_type
+scaleinv_method::get_count_type()
+{
+    return m_grouped.is_valid( ) ? COUNT_TYPE_CONT : COUNT_TYPE_NONE;
+}
+
+double
+scaleinv_method::run_from_counts(const cont_table &counts, float *output)
+{
+    set_num_ok_samples( m_grouped.update( counts ) );
+
+    for(int i = 0; i < m_model.size( ); i++)
+    {
         glm_info null_info;
-        glm_fit( m_model_matrix.get_null( ), get_data( )->phenotype, missing, *m_model[ i ], null_info );
+        arma::vec b = glm_fit( m_grouped.get_null( ), m_grouped.get_groups( ), *m_model[ i ], null_info, m_workspace, m_start[ i ].get_null( ) );
+        add_fit( null_info.num_iters );
+
+        arma::vec alt_start;
+        if( null_info.success )
+        {
+            m_start[ i ].add_null( b );
+            alt_start = m_model_matrix.null_to_alt( b );
+        }
+
+        glm_info alt_info;
+        glm_fit( m_grouped.get_alt( ), m_grouped.get_groups( ), *m_model[ i ], alt_info, m_workspace, alt_start );
+        add_fit( alt_info.num_iters );
 
         if( !null_info.success || !alt_info.success )
         {
@@ -63,7 +140,8 @@ double scaleinv_method::run(const snp_row &row1, const snp_row &row2, float *out
         try
         {
             double LR = -2 * ( null_info.logl - alt_info.logl );
-            double p = 1.0 - chi_square_cdf( LR, m_model_matrix.num_df( ) );
+            double p = chi_square_upper( LR, m_model_matrix.num_df( ) );
+            set_log10_p( chi_square_upper_log10( LR, m_model_matrix.num_df( ) ) );
             output[ i ] = p;
 
             return p;
@@ -9,6 +9,8 @@
 #include <glm/glm.hpp>
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
+#include <besiq/glm_start.hpp>
 #include <besiq/model_matrix.hpp>
 
 /**
@@ -41,6 +43,20 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * Returns COUNT_TYPE_CONT when the model matrix has no covariates,
+     * since the models can then be fitted on the samples grouped by
+     * genotype.
+     *
+     * @see method_type::get_count_type.
+     */
+    virtual count_type get_count_type();
+
+    /**
+     * @see method_type::run_from_counts.
+     */
+    virtual double run_from_counts(const cont_table &counts, float *output);
+
 private:
     /**
      * The included models.
@@ -51,6 +67,26 @@ private:
      * The model matrix.
      */
     model_matrix &m_model_matrix;
+
+    /**
+     * Buffers of the model fits, reused between pairs.
+     */
+    glm_workspace m_workspace;
+
+    /**
+     * Starting points of the fits of each model, from the previous pairs.
+     */
+    std::vector<glm_start> m_start;
+
+    /**
+     * The model matrix grouped by genotype, if it has no covariates.
+     */
+    grouped_matrix m_grouped;
+
+    /**
+     * Computes the groups of a pair.
+     */
+    count_engine m_counter;
 };
 
 #endif /* End of __SCALEINV_METHOD_H__ */
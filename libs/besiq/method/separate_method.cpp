@@ -1,4 +1,5 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <glm/models/binomial.hpp>
 #include <glm/models/normal.hpp>
 
@@ -14,6 +15,7 @@ separate_method::separate_method(method_data_ptr data, glm_model *model)
     m_model_matrix.push_back( new separate_matrix( data->covariate_matrix, data->phenotype.n_elem, REC_DOM ) );
     m_model_matrix.push_back( new separate_matrix( data->covariate_matrix, data->phenotype.n_elem, DOM_REC ) );
     m_model_matrix.push_back( new separate_matrix( data->covariate_matrix, data->phenotype.n_elem, REC_REC ) );
+    m_start.resize( m_model_matrix.size( ) );
 }
 
 separate_method::~separate_method()
@@ -43,16 +45,27 @@ separate_method::init()
 double separate_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
     size_t num_samples = get_data( )->missing.n_elem - sum( get_data( )->missing );
+    double log10_p = -9;
     
     for(int i = 0; i < m_model_matrix.size( ); i++)
     {
         arma::uvec missing = get_data( )->missing;
         m_model_matrix[ i ]->update_matrix( row1, row2, missing );
-        glm_info alt_info;
-        arma::vec b = glm_fit( m_model_matrix[ i ]->get_alt( ), get_data( )->phenotype, missing, *m_model, alt_info );
-
         glm_info null_info;
-        glm_fit( m_model_matrix[ i ]->get_null( ), get_data( )->phenotype, missing, *m_model, null_info );
+        const arma::vec &null_start = m_start[ i ].get_null( *m_model_matrix[ i ], row1, row2 );
+        arma::vec b1 = glm_fit( m_model_matrix[ i ]->get_null( ), get_data( )->phenotype, missing, *m_model, null_info, m_workspace, null_start );
+        add_fit( null_info.num_iters );
+
+        arma::vec alt_start;
+        if( null_info.success )
+        {
+            m_start[ i ].add_null( *m_model_matrix[ i ], row1, row2, b1 );
+            alt_start = m_model_matrix[ i ]->null_to_alt( b1 );
+        }
+
+        glm_info alt_info;
+        arma::vec b = glm_fit( m_model_matrix[ i ]->get_alt( ), get_data( )->phenotype, missing, *m_model, alt_info, m_workspace, alt_start );
+        add_fit( alt_info.num_iters );
         num_samples = std::min( (size_t) (missing.n_elem - sum( missing )), num_samples );
 
         if( !null_info.success || !alt_info.success )
@@ -63,9 +76,10 @@ double separate_method::run(const snp_row &row1, const snp_row &row2, float *out
         try
         {
             double LR = -2 * ( null_info.logl - alt_info.logl );
-            double p = 1.0 - chi_square_cdf( LR, m_model_matrix[ i ]->num_df( ) );
+            double p = chi_square_upper( LR, m_model_matrix[ i ]->num_df( ) );
             output[ 2*i ] = b[ 2 ];
             output[ 2*i + 1 ] = p;
+            log10_p = std::max( log10_p, chi_square_upper_log10( LR, m_model_matrix[ i ]->num_df( ) ) );
         }
         catch(bad_domain_value &e)
         {
@@ -73,6 +87,7 @@ double separate_method::run(const snp_row &row1, const snp_row &row2, float *out
     }
 
     set_num_ok_samples( num_samples );
+    set_log10_p( log10_p );
 
     return min_na( min_na( output[ 1 ], output[ 3 ] ), min_na( output[ 5 ], output[ 7 ] ) );
 }
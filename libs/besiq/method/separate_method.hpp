@@ -9,6 +9,7 @@
 #include <glm/glm.hpp>
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/glm_start.hpp>
 #include <besiq/model_matrix.hpp>
 
 /**
@@ -51,6 +52,15 @@ private:
      */
     glm_model *m_model;
 
+    /**
+     * Buffers of the model fits, reused between pairs.
+     */
+    glm_workspace m_workspace;
+
+    /**
+     * Starting points of the fits of each model matrix, from the previous pairs.
+     */
+    std::vector<glm_start> m_start;
 };
 
 #endif /* End of __SEPARATE_METHOD_H__ */
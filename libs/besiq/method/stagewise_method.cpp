@@ -1,8 +1,10 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <besiq/method/stagewise_method.hpp>
 #include <besiq/stats/snp_count.hpp>
 #include <besiq/stats/binomial_models.hpp>
 #include <besiq/stats/normal_models.hpp>
+#include <plink/plink_file.hpp>
 
 stagewise_method::stagewise_method(method_data_ptr data, const std::string &model)
 : method_type::method_type( data ),
@@ -10,20 +12,59 @@ stagewise_method::stagewise_method(method_data_ptr data, const std::string &mode
 {
     if( model == "normal" )
     {
-        m_models.push_back( new normal_full( ) );
-        m_models.push_back( new normal_null( ) );
-        m_models.push_back( new normal_single( true ) );
-        m_models.push_back( new normal_single( false ) );
+        m_normal_models.push_back( new normal_full( ) );
+        m_normal_models.push_back( new normal_null( ) );
+        m_normal_models.push_back( new normal_single( true ) );
+        m_normal_models.push_back( new normal_single( false ) );
     }
     else if( model == "binomial" )
     {
-        m_models.push_back( new binomial_full( ) );
-        m_models.push_back( new binomial_null( ) );
-        m_models.push_back( new binomial_single( true ) );
-        m_models.push_back( new binomial_single( false ) );
+        m_binomial_models.push_back( new binomial_full( ) );
+        m_binomial_models.push_back( new binomial_null( ) );
+        m_binomial_models.push_back( new binomial_single( true ) );
+        m_binomial_models.push_back( new binomial_single( false ) );
     }
 
-    m_weight = 1.0 - arma::conv_to<arma::vec>::from( data->missing );
+    m_counter = count_engine( data->phenotype, data->missing );
+}
+
+/**
+ * Tests each reduced model against the full model with a
+ * likelihood ratio test.
+ *
+ * @param models The models, the full model first.
+ * @param count The contingency table of the snps.
+ * @param output The p-value of each reduced model will be stored here.
+ * @param log10_p The value -log10 of the returned p-value will be stored here.
+ *
+ * @return The p-value of the first reduced model.
+ */
+template<class Table>
+static double
+compute_stagewise(const std::vector<closed_form_model<Table> *> &models, const Table &count, float *output, double &log10_p)
+{
+    double statistic = -9;
+    log_double full_likelihood = models[ 0 ]->prob( count );
+    for(int i = 1; i < models.size( ); i++)
+    {
+        double LR = -2.0*(models[ i ]->prob( count ).log_value( ) - full_likelihood.log_value( ));
+
+        try
+        {
+            double p = chi_square_upper( LR, models[ 0 ]->df( ) - models[ i ]->df( ) );
+            output[ i - 1 ] = p;
+            if( i == 1 )
+            {
+                statistic = p;
+                log10_p = chi_square_upper_log10( LR, models[ 0 ]->df( ) - models[ i ]->df( ) );
+            }
+        }
+        catch(bad_domain_value &e)
+        {
+        }
+    }
+
+    return statistic;
 }
 
 std::vector<std::string>
@@ -38,50 +79,155 @@ stagewise_method::init()
     return header;
 }
 
+void
+stagewise_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
+bool
+stagewise_method::can_skip(const snp_row &row1, const snp_row &row2)
+{
+    binary_table bound;
+    double num_bounded = 0.0;
+    if( m_counter.bound( row1, row2, bound, num_bounded ) && bound.min( ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    {
+        set_num_ok_samples( (size_t) num_bounded );
+        return true;
+    }
+
+    return false;
+}
+
 double
 stagewise_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    std::vector<log_double> likelihood( m_models.size( ), 0.0 );
-
-    arma::mat count;
-    float min_samples = 0.0;
-    unsigned int sample_threshold = METHOD_SMALLEST_CELL_SIZE_BINOMIAL;
     if( m_model == "binomial" )
     {
-        count = joint_count( row1, row2, get_data( )->phenotype, m_weight );
-        set_num_ok_samples( (size_t) arma::accu( count ) );
-        min_samples = arma::min( arma::min( count ) );
+        if( can_skip( row1, row2 ) )
+        {
+            add_skipped( );
+            return -9;
+        }
+
+        binary_table count;
+        m_counter.count( row1, row2, count );
+
+        return run_from_counts( count, output );
     }
     else if( m_model == "normal" )
     {
-        count = joint_count_cont( row1, row2, get_data( )->phenotype, m_weight );
-        set_num_ok_samples( (size_t) arma::accu( count.col( 1 ) ) );
-        min_samples = arma::min( count.col( 1 ) );
-        sample_threshold = METHOD_SMALLEST_CELL_SIZE_NORMAL;
+        size_table bound;
+        double num_bounded = 0.0;
+        if( m_counter.bound( row1, row2, bound, num_bounded ) && bound.min( 0 ) < METHOD_SMALLEST_CELL_SIZE_NORMAL )
+        {
+            set_num_ok_samples( (size_t) num_bounded );
+            add_skipped( );
+            return -9;
+        }
+
+        cont_table count;
+        m_counter.count( row1, row2, count );
+
+        return run_from_counts( count, output );
     }
-    
-    if( min_samples < sample_threshold )
+
+    return -9;
+}
+
+void
+stagewise_method::run_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                            size_t stride, double *statistics, size_t *num_ok, double *log10_p)
+{
+    if( m_model != "binomial" )
     {
-        return -9;
+        method_type::run_batch( row1, rows2, n, outputs, stride, statistics, num_ok, log10_p );
+        return;
+    }
+
+    std::vector<size_t> counted;
+    std::vector<const snp_row *> counted_rows;
+    for(size_t i = 0; i < n; i++)
+    {
+        if( can_skip( row1, *rows2[ i ] ) )
+        {
+            add_skipped( );
+            statistics[ i ] = -9;
+            num_ok[ i ] = method_type::num_ok_samples( row1, *rows2[ i ] );
+            log10_p[ i ] = -9;
+            continue;
+        }
+
+        counted.push_back( i );
+        counted_rows.push_back( rows2[ i ] );
     }
-    
-    for(int i = 0; i < m_models.size( ); i++)
+
+    if( counted.empty( ) )
     {
-        likelihood[ i ] = m_models[ i ]->prob( count );
+        return;
     }
 
-    for(int i = 1; i < m_models.size( ); i++)
+    std::vector<binary_table> counts( counted.size( ) );
+    m_counter.count( row1, &counted_rows[ 0 ], counted.size( ), &counts[ 0 ] );
+    for(size_t k = 0; k < counted.size( ); k++)
     {
-        double LR = -2.0*(likelihood[ i ].log_value( ) - likelihood[ 0 ].log_value( ));
+        size_t i = counted[ k ];
+        set_log10_p( -9 );
+        statistics[ i ] = run_from_counts( counts[ k ], outputs + i * stride );
+        num_ok[ i ] = method_type::num_ok_samples( row1, *rows2[ i ] );
+        log10_p[ i ] = get_log10_p( );
+    }
+}
 
-        try
-        {
-            output[ i - 1 ] = 1.0 - chi_square_cdf( LR, m_models[ 0 ]->df( ) - m_models[ i ]->df( ) );
-        }
-        catch(bad_domain_value &e)
-        {
-        }
+count_type
+stagewise_method::get_count_type()
+{
+    if( m_model == "binomial" )
+    {
+        return COUNT_TYPE_BINARY;
     }
+    else if( m_model == "normal" )
+    {
+        return COUNT_TYPE_CONT;
+    }
+
+    return COUNT_TYPE_NONE;
+}
 
-    return output[ 0 ];
+double
+stagewise_method::run_from_counts(const binary_table &count, float *output)
+{
+    set_num_ok_samples( (size_t) ( count.sum( 0 ) + count.sum( 1 ) ) );
+    if( count.min( ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    {
+        return -9;
+    }
+
+    double log10_p = -9;
+    double statistic = compute_stagewise( m_binomial_models, count, output, log10_p );
+    set_log10_p( log10_p );
+
+    return statistic;
+}
+
+double
+stagewise_method::run_from_counts(const cont_table &count, float *output)
+{
+    set_num_ok_samples( (size_t) count.sum( 1 ) );
+    if( count.min( 1 ) < METHOD_SMALLEST_CELL_SIZE_NORMAL )
+    {
+        return -9;
+    }
+
+    double log10_p = -9;
+    double statistic = compute_stagewise( m_normal_models, count, output, log10_p );
+    set_log10_p( log10_p );
+
+    return statistic;
+}
+
+method_type *
+stagewise_method::clone()
+{
+    return new stagewise_method( *this );
 }
@@ -32,6 +32,11 @@ public:
      */
     virtual std::vector<std::string> init();
 
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
+
     /**
      * Returns the number of usable samples.
      *
@@ -60,21 +65,66 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * Prescreens each pair, and counts the remaining pairs together
+     * so that the planes of row1 are read once for two partners.
+     *
+     * @see method_type::run_batch.
+     */
+    virtual void run_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                           size_t stride, double *statistics, size_t *num_ok, double *log10_p);
+
+    /**
+     * @see method_type::get_count_type.
+     */
+    virtual count_type get_count_type();
+
+    /**
+     * @see method_type::run_from_counts.
+     */
+    virtual double run_from_counts(const binary_table &count, float *output);
+
+    /**
+     * @see method_type::run_from_counts.
+     */
+    virtual double run_from_counts(const cont_table &count, float *output);
+
+    /**
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
+
 private:
+    /**
+     * Determines from the marginals of the snps whether the binomial
+     * table can not have large enough cells, so that the pair can be
+     * skipped without counting.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     *
+     * @return True if the pair can be skipped.
+     */
+    bool can_skip(const snp_row &row1, const snp_row &row2);
+
     /**
      * Type of model.
      */
     std::string m_model;
     /**
-     * A weight > 0 associated with each sample, that allows for
-     * covariate adjustment.
+     * Computes the contingency tables of the non-missing samples.
+     */
+    count_engine m_counter;
+
+    /**
+     * The models used for a binomial phenotype, the full model first.
      */
-    arma::vec m_weight;
+    std::vector<binomial_model *> m_binomial_models;
 
     /**
-     * The models used.
+     * The models used for a normal phenotype, the full model first.
      */
-    std::vector<closed_form_model *> m_models;
+    std::vector<normal_model *> m_normal_models;
 
     /**
      * Number of usable samples in the last call to run.
@@ -1,14 +1,19 @@
+#include <algorithm>
+
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <besiq/method/wald_lm_method.hpp>
 #include <besiq/stats/snp_count.hpp>
+#include <besiq/stats/wald_kernels.hpp>
 
 wald_lm_method::wald_lm_method(method_data_ptr data, bool unequal_var)
 : method_type::method_type( data ),
   m_unequal_var( unequal_var )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.n_elem );
-    m_missing = get_data( )->missing;
-    m_pheno = get_data()->phenotype;
+    m_counter = count_engine( data->phenotype, data->missing );
+    std::fill( m_C, m_C + WALD_MAX_TERMS * WALD_MAX_TERMS, 0.0 );
+    std::fill( m_beta, m_beta + WALD_MAX_TERMS, 0.0 );
+    m_num_valid = 0;
 }
 
 std::vector<std::string>
@@ -26,108 +31,126 @@ wald_lm_method::init()
 arma::mat
 wald_lm_method::get_last_C()
 {
-    return m_C;
+    arma::mat C( m_num_valid, m_num_valid );
+    for(int i = 0; i < m_num_valid; i++)
+    {
+        for(int j = 0; j < m_num_valid; j++)
+        {
+            C( i, j ) = m_C[ i * WALD_MAX_TERMS + j ];
+        }
+    }
+
+    return C;
 }
 
 arma::vec
 wald_lm_method::get_last_beta()
 {
-    return m_beta;
+    arma::vec beta( m_num_valid );
+    for(int i = 0; i < m_num_valid; i++)
+    {
+        beta[ i ] = m_beta[ i ];
+    }
+
+    return beta;
+}
+
+size_t
+wald_lm_method::get_last_estimate(double *beta, double *C)
+{
+    std::copy( m_beta, m_beta + WALD_MAX_TERMS, beta );
+    std::copy( m_C, m_C + WALD_MAX_TERMS * WALD_MAX_TERMS, C );
+
+    return m_num_valid;
 }
 
 
 double
 wald_lm_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat suf = arma::zeros<arma::mat>( 3, 3 );
-    arma::mat suf2 = arma::zeros<arma::mat>( 3, 3 );
-    arma::mat n = arma::zeros<arma::mat>( 3, 3 );
+    cont_table counts;
+    m_counter.count( row1, row2, counts );
 
-    for(int i = 0; i < row1.size( ); i++)
-    {
-        unsigned char snp1 = row1[ i ];
-        unsigned char snp2 = row2[ i ];
-        
-        if( snp1 == 3 || snp2 == 3 || m_missing[ i ] == 1 )
-        {
-            continue;
-        }
+    return run_from_counts( counts, output );
+}
 
-        double pheno = m_pheno[ i ];
-        n( snp1, snp2 ) += 1;
-        suf( snp1, snp2 ) += pheno;
-        suf2( snp1, snp2 ) += pheno * pheno;
-    }
+count_type
+wald_lm_method::get_count_type()
+{
+    return COUNT_TYPE_CONT;
+}
 
+double
+wald_lm_method::run_from_counts(const cont_table &counts, float *output)
+{
     /* Calculate residual and estimate sigma^2 */
-    arma::mat resid = arma::zeros<arma::mat>( 3, 3 );
-    arma::mat mu = arma::zeros<arma::mat>( 3, 3 );
+    double n[ 3 ][ 3 ];
+    double resid[ 3 ][ 3 ] = { { 0.0 } };
+    double mu[ 3 ][ 3 ] = { { 0.0 } };
+    double resid_sum = 0.0;
     double num_samples = 0.0;
     for(int i = 0; i < 3; i++)
     {
         for(int j = 0; j < 3; j++)
         {
-            if( n( i, j ) < METHOD_SMALLEST_CELL_SIZE_NORMAL )
+            double suf = counts( 3 * i + j, 0 );
+            double suf2 = counts( 3 * i + j, 2 );
+            n[ i ][ j ] = counts( 3 * i + j, 1 );
+            if( n[ i ][ j ] < METHOD_SMALLEST_CELL_SIZE_NORMAL )
             {
                 continue;
             }
 
-            resid( i, j ) = ( suf2( i, j ) - suf( i, j ) * suf( i, j ) / n( i, j ) );
-            mu( i, j ) = suf( i, j ) / n( i, j );
-            num_samples += n( i, j );
+            resid[ i ][ j ] = ( suf2 - suf * suf / n[ i ][ j ] );
+            mu[ i ][ j ] = suf / n[ i ][ j ];
+            resid_sum += resid[ i ][ j ];
+            num_samples += n[ i ][ j ];
         }
     }
     set_num_ok_samples( (size_t)num_samples );
 
-    arma::mat sigma2 = arma::zeros<arma::mat>( 3, 3 );
-    if( !m_unequal_var )
-    {
-        sigma2 = sigma2 + arma::accu( resid ) / ( num_samples - 9 );
-    }
-    else
+    double sigma2[ 3 ][ 3 ] = { { 0.0 } };
+    for(int i = 0; i < 3; i++)
     {
-        for(int i = 0; i < 3; i++)
+        for(int j = 0; j < 3; j++)
         {
-            for(int j = 0; j < 3; j++)
+            if( !m_unequal_var )
             {
-                if( n( i, j ) > 9 )
-                {
-                    sigma2( i, j ) = resid( i, j ) / ( n( i, j ) - 9 );
-                }
+                sigma2[ i ][ j ] = resid_sum / ( num_samples - 9 );
+            }
+            else if( n[ i ][ j ] > 9 )
+            {
+                sigma2[ i ][ j ] = resid[ i ][ j ] / ( n[ i ][ j ] - 9 );
             }
         }
     }
 
     /* Find valid parameters and estimate beta */
     int num_valid = 0;
-    arma::uvec valid( 4 );
-    m_beta = arma::zeros<arma::vec>( 4 );
+    int valid[ WALD_MAX_TERMS ];
     int i_map[] = { 1, 1, 2, 2 };
     int j_map[] = { 1, 2, 1, 2 };
     for(int i = 0; i < 4; i++)
     {
         int c_i = i_map[ i ];
         int c_j = j_map[ i ];
-        if( n( 0, 0 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n( 0, c_j ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n( c_i, 0 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n( c_i, c_j) >= METHOD_SMALLEST_CELL_SIZE_NORMAL )
+        if( n[ 0 ][ 0 ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n[ 0 ][ c_j ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n[ c_i ][ 0 ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n[ c_i ][ c_j ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL )
         {
             valid[ num_valid ] = i;
-            m_beta[ num_valid ] = mu( 0, 0 ) - mu( 0, c_j ) - mu( c_i, 0 ) + mu( c_i, c_j );
+            m_beta[ num_valid ] = mu[ 0 ][ 0 ] - mu[ 0 ][ c_j ] - mu[ c_i ][ 0 ] + mu[ c_i ][ c_j ];
             num_valid++;
         }
     }
+    m_num_valid = num_valid;
     if( num_valid <= 0 )
     {
         return -9;
     }
 
-    valid.resize( num_valid );
-    m_beta.resize( num_valid );
-
     /* Construct covariance matrix */ 
-    m_C = arma::zeros<arma::mat>( num_valid, num_valid );
     for(int iv = 0; iv < num_valid; iv++)
     {
         int i = valid[ iv ];
@@ -144,21 +167,28 @@ wald_lm_method::run(const snp_row &row1, const snp_row &row2, float *output)
             int same_col = c_j == o_j;
             int in_cell = i == j;
 
-            m_C( iv, jv ) = ( sigma2( 0, 0 ) / n( 0, 0 ) + same_col * sigma2( 0, c_j ) / n( 0, c_j ) + same_row * sigma2( c_i, 0 ) / n( c_i, 0 ) + in_cell * sigma2( c_i, c_j ) / n( c_i, c_j ) );
+            m_C[ iv * WALD_MAX_TERMS + jv ] = ( sigma2[ 0 ][ 0 ] / n[ 0 ][ 0 ] + same_col * sigma2[ 0 ][ c_j ] / n[ 0 ][ c_j ] + same_row * sigma2[ c_i ][ 0 ] / n[ c_i ][ 0 ] + in_cell * sigma2[ c_i ][ c_j ] / n[ c_i ][ c_j ] );
         }
     }
 
-    arma::mat Cinv( num_valid, num_valid );
-    if( !inv( Cinv, m_C ) )
+    /* Test if b != 0 with Wald test */
+    double chi = 0.0;
+    if( !wald_statistic( m_C, m_beta, num_valid, &chi ) )
     {
         return -9;
     }
-    
-    /* Test if b != 0 with Wald test */
-    double chi = dot( m_beta, Cinv * m_beta );
+
     output[ 0 ] = chi;
-    output[ 1 ] = 1.0 - chi_square_cdf( chi, num_valid );
-    output[ 2 ] = valid.n_elem;
+    double p = chi_square_upper( chi, num_valid );
+    set_log10_p( chi_square_upper_log10( chi, num_valid ) );
+    output[ 1 ] = p;
+    output[ 2 ] = num_valid;
+
+    return p;
+}
 
-    return output[ 1 ];
+method_type *
+wald_lm_method::clone()
+{
+    return new wald_lm_method( *this );
 }
@@ -8,6 +8,8 @@
 
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
+#include <besiq/stats/wald_kernels.hpp>
 
 /**
  * This class is responsible for executing the closed form
@@ -44,26 +46,44 @@ public:
      * @return the last computed beta.
      */
     arma::vec get_last_beta();
+
+    /**
+     * Copies the last computed betas and covariance matrix without
+     * allocating.
+     *
+     * @param beta The betas are stored here, WALD_MAX_TERMS values.
+     * @param C The covariance matrix is stored here, WALD_MAX_TERMS
+     *          by WALD_MAX_TERMS values in row major order.
+     *
+     * @return The number of valid terms, only the first this many
+     *         betas and rows and columns of C are set.
+     */
+    size_t get_last_estimate(double *beta, double *C);
     
     /**
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
-private:
+
     /**
-     * Weight for each sample.
+     * @see method_type::get_count_type.
      */
-    arma::vec m_weight;
-    
+    virtual count_type get_count_type();
+
     /**
-     * Phenotype.
+     * @see method_type::run_from_counts.
      */
-    arma::vec m_pheno;
+    virtual double run_from_counts(const cont_table &counts, float *output);
 
     /**
-     * Missing samples.
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
+private:
+    /**
+     * Computes the contingency tables of the non-missing samples.
      */
-    arma::uvec m_missing;
+    count_engine m_counter;
     
     /**
      * Determines whether variances should be estimated separately.
@@ -71,14 +91,20 @@ private:
     bool m_unequal_var;
     
     /**
-     * Current covariance matrix for the betas.
+     * Current covariance matrix for the betas, row major with
+     * stride WALD_MAX_TERMS.
      */
-    arma::mat m_C;
+    double m_C[ WALD_MAX_TERMS * WALD_MAX_TERMS ];
 
     /**
      * Current betas.
      */
-    arma::vec m_beta;
+    double m_beta[ WALD_MAX_TERMS ];
+
+    /**
+     * Number of valid terms in m_C and m_beta.
+     */
+    int m_num_valid;
 };
 
 #endif /* End of __WALD_LM_METHOD_H__ */
@@ -1,13 +1,19 @@
+#include <algorithm>
+
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <besiq/method/wald_method.hpp>
 #include <besiq/stats/snp_count.hpp>
+#include <besiq/stats/wald_kernels.hpp>
+#include <plink/plink_file.hpp>
 
 wald_method::wald_method(method_data_ptr data)
 : method_type::method_type( data )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.n_elem );
-    m_pheno = get_data( )->phenotype;
-    m_missing = get_data( )->missing;
+    m_counter = count_engine( data->phenotype, data->missing );
+    std::fill( m_C, m_C + WALD_MAX_TERMS * WALD_MAX_TERMS, 0.0 );
+    std::fill( m_beta, m_beta + WALD_MAX_TERMS, 0.0 );
+    m_num_valid = 0;
 }
 
 std::vector<std::string>
@@ -22,94 +28,210 @@ wald_method::init()
     return header;
 }
 
+void
+wald_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
 arma::mat
 wald_method::get_last_C()
 {
-    return m_C;
+    arma::mat C( m_num_valid, m_num_valid );
+    for(int i = 0; i < m_num_valid; i++)
+    {
+        for(int j = 0; j < m_num_valid; j++)
+        {
+            C( i, j ) = m_C[ i * WALD_MAX_TERMS + j ];
+        }
+    }
+
+    return C;
 }
 
 arma::vec
 wald_method::get_last_beta()
 {
-    return m_beta;
+    arma::vec beta( m_num_valid );
+    for(int i = 0; i < m_num_valid; i++)
+    {
+        beta[ i ] = m_beta[ i ];
+    }
+
+    return beta;
+}
+
+size_t
+wald_method::get_last_estimate(double *beta, double *C)
+{
+    std::copy( m_beta, m_beta + WALD_MAX_TERMS, beta );
+    std::copy( m_C, m_C + WALD_MAX_TERMS * WALD_MAX_TERMS, C );
+
+    return m_num_valid;
+}
+
+bool
+wald_method::can_skip(const snp_row &row1, const snp_row &row2)
+{
+    /* Skipped pairs report all samples instead of the samples in the
+     * usable cells, so only skip when untested pairs are not written */
+    const method_data_ptr &data = get_data( );
+    if( data->threshold == -9 && data->top == 0 )
+    {
+        return false;
+    }
+
+    binary_table bound;
+    double num_bounded = 0.0;
+    if( !m_counter.bound( row1, row2, bound, num_bounded ) )
+    {
+        return false;
+    }
+
+    /* An interaction needs the cells 00, 0j, i0 and ij in both classes */
+    for(int c_i = 1; c_i <= 2; c_i++)
+    {
+        for(int c_j = 1; c_j <= 2; c_j++)
+        {
+            int cells[] = { 0, c_j, 3 * c_i, 3 * c_i + c_j };
+            bool possible = true;
+            for(int k = 0; k < 4; k++)
+            {
+                possible = possible && bound( cells[ k ], 0 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+                                       bound( cells[ k ], 1 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL;
+            }
+
+            if( possible )
+            {
+                return false;
+            }
+        }
+    }
+
+    set_num_ok_samples( (size_t) num_bounded );
+    return true;
 }
 
 double
 wald_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat n0 = arma::zeros<arma::mat>( 3, 3 );
-    arma::mat n1 = arma::zeros<arma::mat>( 3, 3 );
-    for(int i = 0; i < row1.size( ); i++)
+    if( can_skip( row1, row2 ) )
+    {
+        add_skipped( );
+        return -9;
+    }
+
+    binary_table counts;
+    m_counter.count( row1, row2, counts );
+
+    return run_from_counts( counts, output );
+}
+
+void
+wald_method::run_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                       size_t stride, double *statistics, size_t *num_ok, double *log10_p)
+{
+    std::vector<size_t> counted;
+    std::vector<const snp_row *> counted_rows;
+    for(size_t i = 0; i < n; i++)
     {
-        unsigned char snp1 = row1[ i ];
-        unsigned char snp2 = row2[ i ];
-        if( snp1 == 3 || snp2 == 3 || m_missing[ i ] == 1 )
+        if( can_skip( row1, *rows2[ i ] ) )
         {
+            add_skipped( );
+            statistics[ i ] = -9;
+            num_ok[ i ] = num_ok_samples( row1, *rows2[ i ] );
+            log10_p[ i ] = -9;
             continue;
         }
 
-        unsigned int pheno = m_pheno[ i ];
-        if( pheno == 0 )
-        {
-            n0( snp1, snp2 ) += 1;
-        }
-        else if( pheno == 1 )
+        counted.push_back( i );
+        counted_rows.push_back( rows2[ i ] );
+    }
+
+    if( counted.empty( ) )
+    {
+        return;
+    }
+
+    std::vector<binary_table> counts( counted.size( ) );
+    m_counter.count( row1, &counted_rows[ 0 ], counted.size( ), &counts[ 0 ] );
+    for(size_t k = 0; k < counted.size( ); k++)
+    {
+        size_t i = counted[ k ];
+        set_log10_p( -9 );
+        statistics[ i ] = run_from_counts( counts[ k ], outputs + i * stride );
+        num_ok[ i ] = num_ok_samples( row1, *rows2[ i ] );
+        log10_p[ i ] = get_log10_p( );
+    }
+}
+
+count_type
+wald_method::get_count_type()
+{
+    return COUNT_TYPE_BINARY;
+}
+
+double
+wald_method::run_from_counts(const binary_table &counts, float *output)
+{
+    double n0[ 3 ][ 3 ];
+    double n1[ 3 ][ 3 ];
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
         {
-            n1( snp1, snp2 ) += 1;
+            n0[ i ][ j ] = counts( 3 * i + j, 0 );
+            n1[ i ][ j ] = counts( 3 * i + j, 1 );
         }
     }
 
-    arma::mat eta( 3, 3 );
+    double eta[ 3 ][ 3 ];
     double num_samples = 0.0;
     for(int i = 0; i < 3; i++)
     {
         for(int j = 0; j < 3; j++)
         {
-            if( n0( i, j ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL || n1( i, j ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+            if( n0[ i ][ j ] < METHOD_SMALLEST_CELL_SIZE_BINOMIAL || n1[ i ][ j ] < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
             {
                 continue;
             }
 
-            eta( i, j ) = log( n1( i, j ) / n0( i, j ) );
-            num_samples += n1( i, j ) + n0( i, j );
+            eta[ i ][ j ] = log( n1[ i ][ j ] / n0[ i ][ j ] );
+            num_samples += n1[ i ][ j ] + n0[ i ][ j ];
         }
     }
 
     /* Find valid parameters and estimate beta */
     int num_valid = 0;
-    arma::uvec valid( 4 );
-    m_beta = arma::zeros<arma::vec>( 4 );
+    int valid[ WALD_MAX_TERMS ];
     int i_map[] = { 1, 1, 2, 2 };
     int j_map[] = { 1, 2, 1, 2 };
     for(int i = 0; i < 4; i++)
     {
         int c_i = i_map[ i ];
         int c_j = j_map[ i ];
-        if( n0( 0, 0 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n0( 0, c_j ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n0( c_i, 0 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n0( c_i, c_j) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n1( 0, 0 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n1( 0, c_j ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n1( c_i, 0 ) >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-            n1( c_i, c_j) >= METHOD_SMALLEST_CELL_SIZE_NORMAL )
+        if( n0[ 0 ][ 0 ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n0[ 0 ][ c_j ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n0[ c_i ][ 0 ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n0[ c_i ][ c_j ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n1[ 0 ][ 0 ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n1[ 0 ][ c_j ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n1[ c_i ][ 0 ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n1[ c_i ][ c_j ] >= METHOD_SMALLEST_CELL_SIZE_NORMAL )
         {
             valid[ num_valid ] = i;
-            m_beta[ num_valid ] = eta( 0, 0 ) - eta( 0, c_j ) - eta( c_i, 0 ) + eta( c_i, c_j );
+            m_beta[ num_valid ] = eta[ 0 ][ 0 ] - eta[ 0 ][ c_j ] - eta[ c_i ][ 0 ] + eta[ c_i ][ c_j ];
             num_valid++;
         }
     }
     set_num_ok_samples( (size_t)num_samples );
+    m_num_valid = num_valid;
     if( num_valid <= 0 )
     {
         return -9;
     }
-    
-    valid.resize( num_valid );
-    m_beta.resize( num_valid );
 
     /* Construct covariance matrix */
-    m_C = arma::zeros<arma::mat>( num_valid, num_valid );
     for(int iv = 0; iv < num_valid; iv++)
     {
         int i = valid[ iv ];
@@ -126,22 +248,29 @@ wald_method::run(const snp_row &row1, const snp_row &row2, float *output)
             int same_col = c_j == o_j;
             int in_cell = i == j;
 
-            m_C( iv, jv ) = 1.0 / n0( 0, 0 ) + same_col / n0( 0, c_j ) + same_row / n0( c_i, 0 ) + in_cell / n0( c_i, c_j );
-            m_C( iv, jv ) += 1.0 / n1( 0, 0 ) + same_col / n1( 0, c_j ) + same_row / n1( c_i, 0 ) + in_cell / n1( c_i, c_j );
+            m_C[ iv * WALD_MAX_TERMS + jv ] = 1.0 / n0[ 0 ][ 0 ] + same_col / n0[ 0 ][ c_j ] + same_row / n0[ c_i ][ 0 ] + in_cell / n0[ c_i ][ c_j ];
+            m_C[ iv * WALD_MAX_TERMS + jv ] += 1.0 / n1[ 0 ][ 0 ] + same_col / n1[ 0 ][ c_j ] + same_row / n1[ c_i ][ 0 ] + in_cell / n1[ c_i ][ c_j ];
         }
     }
 
-    arma::mat Cinv( num_valid, num_valid );
-    if( !inv( Cinv, m_C ) )
+    /* Test if b != 0 with Wald test */
+    double chi = 0.0;
+    if( !wald_statistic( m_C, m_beta, num_valid, &chi ) )
     {
         return -9;
     }
-    
-    /* Test if b != 0 with Wald test */
-    double chi = dot( m_beta, Cinv * m_beta );
+
     output[ 0 ] = chi;
-    output[ 1 ] = 1.0 - chi_square_cdf( chi, num_valid );
-    output[ 2 ] = valid.n_elem;
+    double p = chi_square_upper( chi, num_valid );
+    set_log10_p( chi_square_upper_log10( chi, num_valid ) );
+    output[ 1 ] = p;
+    output[ 2 ] = num_valid;
+
+    return p;
+}
 
-    return output[ 1 ];
+method_type *
+wald_method::clone()
+{
+    return new wald_method( *this );
 }
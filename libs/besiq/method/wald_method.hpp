@@ -8,6 +8,8 @@
 
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
+#include <besiq/stats/wald_kernels.hpp>
 
 /**
  * This class is responsible for executing the closed form
@@ -30,6 +32,11 @@ public:
      */
     virtual std::vector<std::string> init();
 
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
+
     /**
      * Returns the last computed covariance matrix.
      *
@@ -43,36 +50,81 @@ public:
      * @return the last computed beta.
      */
     arma::vec get_last_beta();
+
+    /**
+     * Copies the last computed betas and covariance matrix without
+     * allocating.
+     *
+     * @param beta The betas are stored here, WALD_MAX_TERMS values.
+     * @param C The covariance matrix is stored here, WALD_MAX_TERMS
+     *          by WALD_MAX_TERMS values in row major order.
+     *
+     * @return The number of valid terms, only the first this many
+     *         betas and rows and columns of C are set.
+     */
+    size_t get_last_estimate(double *beta, double *C);
     
     /**
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
-private:
+
     /**
-     * Weight for each sample.
+     * Prescreens each pair, and counts the remaining pairs together
+     * so that the planes of row1 are read once for two partners.
+     *
+     * @see method_type::run_batch.
      */
-    arma::vec m_weight;
-    
+    virtual void run_batch(const snp_row &row1, const snp_row *const *rows2, size_t n, float *outputs,
+                           size_t stride, double *statistics, size_t *num_ok, double *log10_p);
+
     /**
-     * Phenotypes.
+     * @see method_type::get_count_type.
      */
-    arma::vec m_pheno;
-    
+    virtual count_type get_count_type();
+
     /**
-     * Missing.
+     * @see method_type::run_from_counts.
      */
-    arma::uvec m_missing;
+    virtual double run_from_counts(const binary_table &counts, float *output);
 
     /**
-     * Current covariance matrix for the betas.
+     * @see method_type::clone.
      */
-    arma::mat m_C;
+    virtual method_type *clone();
+private:
+    /**
+     * Determines from the marginals of the snps whether no interaction
+     * can have large enough cells, so that the pair can be skipped
+     * without counting.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     *
+     * @return True if the pair can be skipped.
+     */
+    bool can_skip(const snp_row &row1, const snp_row &row2);
+
+    /**
+     * Computes the contingency tables of the non-missing samples.
+     */
+    count_engine m_counter;
+
+    /**
+     * Current covariance matrix for the betas, row major with
+     * stride WALD_MAX_TERMS.
+     */
+    double m_C[ WALD_MAX_TERMS * WALD_MAX_TERMS ];
 
     /**
      * Current betas.
      */
-    arma::vec m_beta;
+    double m_beta[ WALD_MAX_TERMS ];
+
+    /**
+     * Number of valid terms in m_C and m_beta.
+     */
+    int m_num_valid;
 };
 
 #endif /* End of __WALD_METHOD_H__ */
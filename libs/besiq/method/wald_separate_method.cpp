@@ -1,11 +1,13 @@
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 #include <besiq/method/wald_separate_method.hpp>
 #include <besiq/stats/snp_count.hpp>
+#include <plink/plink_file.hpp>
 
 wald_separate_method::wald_separate_method(method_data_ptr data, bool is_lm)
 : method_type::method_type( data )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.n_elem );
+    m_counter = count_engine( data->phenotype, data->missing );
     m_is_lm = is_lm;
 }
 
@@ -26,17 +28,24 @@ wald_separate_method::init()
     return header;
 }
 
+void
+wald_separate_method::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_counter.set_genotypes( genotypes );
+}
+
 void
 wald_separate_method::compute_lm(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat n = joint_count_cont( row1, row2, get_data( )->phenotype, m_weight );
+    cont_table n;
+    m_counter.count( row1, row2, n );
 
-    size_t num_samples = arma::accu( n.col( 1 ) );
+    size_t num_samples = n.sum( 1 );
     set_num_ok_samples( num_samples );
+    double log10_p = -9;
     
     /* Calculate residual and estimate sigma^2 */
     double residual_sum = 0.0;
-    arma::mat mu = arma::zeros<arma::mat>( 3, 3 );
     for(int i = 0; i < 9; i++)
     {
         double deviance = ( n( i, 2 ) - n( i, 0 ) * n( i, 0 ) / n( i, 1 ) );
@@ -53,7 +62,8 @@ wald_separate_method::compute_lm(const snp_row &row1, const snp_row &row2, float
         double var_dd = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 4, 1 ) );
         double w_dd = b_dd * b_dd / var_dd;
         output[ 0 ] = b_dd;
-        output[ 1 ] = 1.0 - chi_square_cdf( w_dd, 1 );
+        output[ 1 ] = chi_square_upper( w_dd, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_dd, 1 ) );
     }
     if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
         n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
@@ -64,7 +74,8 @@ wald_separate_method::compute_lm(const snp_row &row1, const snp_row &row2, float
         double var_rd = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 5, 1 ) );
         double w_rd = b_rd * b_rd / var_rd;
         output[ 2 ] = b_rd;
-        output[ 3 ] = 1.0 - chi_square_cdf( w_rd, 1 );
+        output[ 3 ] = chi_square_upper( w_rd, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_rd, 1 ) );
     }
     if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
         n( 1, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
@@ -75,7 +86,8 @@ wald_separate_method::compute_lm(const snp_row &row1, const snp_row &row2, float
         double var_dr = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 7, 1 ) );
         double w_dr = b_dr * b_dr / var_dr;
         output[ 4 ] = b_dr;
-        output[ 5 ] = 1.0 - chi_square_cdf( w_dr, 1 );
+        output[ 5 ] = chi_square_upper( w_dr, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_dr, 1 ) );
     }
     if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
         n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
@@ -86,15 +98,19 @@ wald_separate_method::compute_lm(const snp_row &row1, const snp_row &row2, float
         double var_rr = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 8, 1 ) );
         double w_rr = b_rr * b_rr / var_rr;
         output[ 6 ] = b_rr;
-        output[ 7 ] = 1.0 - chi_square_cdf( w_rr, 1 );
+        output[ 7 ] = chi_square_upper( w_rr, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_rr, 1 ) );
     }
+    set_log10_p( log10_p );
 }
 
 void
 wald_separate_method::compute_binomial(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat n = joint_count( row1, row2, get_data( )->phenotype, m_weight );
-    set_num_ok_samples( (size_t) arma::accu( n ) );
+    binary_table n;
+    m_counter.count( row1, row2, n );
+    set_num_ok_samples( (size_t) ( n.sum( 0 ) + n.sum( 1 ) ) );
+    double log10_p = -9;
 
     if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
         n( 1, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
@@ -109,7 +125,8 @@ wald_separate_method::compute_binomial(const snp_row &row1, const snp_row &row2,
         double var_dd = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 1, 0 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 3, 0 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 4, 0 ) + 1.0 / n( 4, 1 );
         double w_dd = b_dd * b_dd / var_dd;
         output[ 0 ] = b_dd;
-        output[ 1 ] = 1.0 - chi_square_cdf( w_dd, 1 );
+        output[ 1 ] = chi_square_upper( w_dd, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_dd, 1 ) );
     }
     if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
         n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
@@ -124,7 +141,8 @@ wald_separate_method::compute_binomial(const snp_row &row1, const snp_row &row2,
         double var_rd = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 2, 0 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 3, 0 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 5, 0 ) + 1.0 / n( 5, 1 );
         double w_rd = b_rd * b_rd / var_rd;
         output[ 2 ] = b_rd;
-        output[ 3 ] = 1.0 - chi_square_cdf( w_rd, 1 );
+        output[ 3 ] = chi_square_upper( w_rd, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_rd, 1 ) );
     }
     if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
         n( 1, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
@@ -139,7 +157,8 @@ wald_separate_method::compute_binomial(const snp_row &row1, const snp_row &row2,
         double var_dr = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 1, 0 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 6, 0 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 7, 0 ) + 1.0 / n( 7, 1 );
         double w_dr = b_dr * b_dr / var_dr;
         output[ 4 ] = b_dr;
-        output[ 5 ] = 1.0 - chi_square_cdf( w_dr, 1 );
+        output[ 5 ] = chi_square_upper( w_dr, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_dr, 1 ) );
     }
     if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
         n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
@@ -154,8 +173,10 @@ wald_separate_method::compute_binomial(const snp_row &row1, const snp_row &row2,
         double var_rr = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 2, 0 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 6, 0 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 8, 0 ) + 1.0 / n( 8, 1 );
         double w_rr = b_rr * b_rr / var_rr;
         output[ 6 ] = b_rr;
-        output[ 7 ] = 1.0 - chi_square_cdf( w_rr, 1 );
+        output[ 7 ] = chi_square_upper( w_rr, 1 );
+        log10_p = std::max( log10_p, chi_square_upper_log10( w_rr, 1 ) );
     }
+    set_log10_p( log10_p );
 }
 
 double
@@ -173,3 +194,9 @@ wald_separate_method::run(const snp_row &row1, const snp_row &row2, float *outpu
     return min_na( min_na( output[ 1 ], output[ 3 ] ),
                    min_na( output[ 5 ], output[ 7 ] ) );
 }
+
+method_type *
+wald_separate_method::clone()
+{
+    return new wald_separate_method( *this );
+}
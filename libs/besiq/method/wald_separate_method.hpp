@@ -8,6 +8,7 @@
 
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
 
 /**
  * This class is responsible for executing the closed form
@@ -29,18 +30,28 @@ public:
      * @see method_type::init.
      */
     virtual std::vector<std::string> init();
+
+    /**
+     * @see method_type::set_genotypes.
+     */
+    virtual void set_genotypes(const genotype_matrix_ptr &genotypes);
     
     /**
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
+
+    /**
+     * @see method_type::clone.
+     */
+    virtual method_type *clone();
 private:
     void compute_lm(const snp_row &row1, const snp_row &row2, float *output);
     void compute_binomial(const snp_row &row1, const snp_row &row2, float *output);
     /**
-     * Weight for each sample.
+     * Computes the contingency tables of the non-missing samples.
      */
-    arma::vec m_weight;
+    count_engine m_counter;
 
     /**
      * Indicates whether this is a linear model or not.
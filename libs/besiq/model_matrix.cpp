@@ -1,8 +1,32 @@
 #include <besiq/model_matrix.hpp>
 
+arma::vec
+model_matrix::null_to_alt(const arma::vec &null_beta)
+{
+    size_t num_main = num_null( ) - 1;
+    size_t num_cov = get_null( ).n_cols - num_null( );
+    if( null_beta.n_elem != num_null( ) + num_cov )
+    {
+        return arma::vec( );
+    }
+
+    arma::vec alt_beta = arma::zeros<arma::vec>( num_alt( ) + num_cov );
+    for(size_t i = 0; i < num_main; i++)
+    {
+        alt_beta[ i ] = null_beta[ i ];
+    }
+    for(size_t i = num_main; i < null_beta.n_elem; i++)
+    {
+        alt_beta[ i + num_df( ) ] = null_beta[ i ];
+    }
+
+    return alt_beta;
+}
+
 general_matrix::general_matrix(const arma::mat &cov, size_t n, size_t num_null, size_t num_alt)
     : m_alt( n, cov.n_cols + num_alt ),
-     m_null( n, cov.n_cols + num_null )
+     m_null( n, cov.n_cols + num_null ),
+     m_first_row( NULL )
 {
     /*
      * Null matrix.
@@ -33,6 +57,93 @@ general_matrix::~general_matrix()
 {
 }
 
+/**
+ * Decodes the genotypes of a snp by visiting the set bits of
+ * each plane.
+ *
+ * @param row The snp.
+ * @param genotypes The genotype of each sample will be stored here.
+ */
+static void
+decode_row(const snp_row &row, std::vector<unsigned char> &genotypes)
+{
+    genotypes.assign( row.size( ), 0 );
+    for(unsigned char g = 1; g < SNP_ROW_NUM_PLANES; g++)
+    {
+        const uint64_t *plane = row.get_plane( g );
+        for(size_t w = 0; w < row.num_words( ); w++)
+        {
+            uint64_t bits = plane[ w ];
+            while( bits != 0 )
+            {
+                size_t sample = w * SNP_ROW_BITS_PER_WORD + __builtin_ctzll( bits );
+                if( sample < genotypes.size( ) )
+                {
+                    genotypes[ sample ] = g;
+                }
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+void
+general_matrix::set_first(const snp_row &row1)
+{
+    decode_row( row1, m_first );
+    m_first_row = &row1;
+}
+
+void
+general_matrix::clear_first()
+{
+    m_first_row = NULL;
+}
+
+void
+general_matrix::decode_rows(const snp_row &row1, const snp_row &row2, const unsigned char *&genotypes1, const unsigned char *&genotypes2)
+{
+    if( m_first_row != &row1 )
+    {
+        decode_row( row1, m_first );
+    }
+    decode_row( row2, m_second );
+
+    genotypes1 = m_first.empty( ) ? NULL : &m_first[ 0 ];
+    genotypes2 = m_second.empty( ) ? NULL : &m_second[ 0 ];
+}
+
+bool
+general_matrix::get_cells(arma::mat &alt, arma::mat &null) const
+{
+    if( m_alt.n_cols > m_num_alt || m_alt.n_rows < COUNT_TABLE_NUM_CELLS )
+    {
+        return false;
+    }
+
+    snp_row row1;
+    snp_row row2;
+    row1.resize( COUNT_TABLE_NUM_CELLS );
+    row2.resize( COUNT_TABLE_NUM_CELLS );
+    for(unsigned char g1 = 0; g1 < 3; g1++)
+    {
+        for(unsigned char g2 = 0; g2 < 3; g2++)
+        {
+            row1.assign( 3 * g1 + g2, g1 );
+            row2.assign( 3 * g1 + g2, g2 );
+        }
+    }
+
+    arma::uvec missing = arma::zeros<arma::uvec>( m_alt.n_rows );
+    model_matrix *cells = clone( );
+    cells->update_matrix( row1, row2, missing );
+    alt = cells->get_alt( ).rows( 0, COUNT_TABLE_NUM_CELLS - 1 );
+    null = cells->get_null( ).rows( 0, COUNT_TABLE_NUM_CELLS - 1 );
+    delete cells;
+
+    return true;
+}
+
 const arma::mat &
 general_matrix::get_alt()
 {
@@ -63,24 +174,40 @@ general_matrix::num_null()
     return m_num_null;
 }
 
+unsigned int
+general_matrix::main_effect_snp(size_t column) const
+{
+    return column < ( m_num_null - 1 ) / 2 ? 0 : 1;
+}
+
 additive_matrix::additive_matrix(const arma::mat &cov, size_t n)
     : general_matrix( cov, n, 3, 4 )
 {
 }
 
+model_matrix *
+additive_matrix::clone() const
+{
+    return new additive_matrix( *this );
+}
+
 void
 additive_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing)
 {
+    const unsigned char *geno1;
+    const unsigned char *geno2;
+    decode_rows( row1, row2, geno1, geno2 );
+
     for(int i = 0; i < row1.size( ); i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 && missing[ i ] == 0 )
+        if( geno1[ i ] != 3 && geno2[ i ] != 3 && missing[ i ] == 0 )
         {
-            m_alt( i, 0 ) = row1[ i ];
-            m_alt( i, 1 ) = row2[ i ];
-            m_alt( i, 2 ) = row1[ i ] * row2[ i ];
+            m_alt( i, 0 ) = geno1[ i ];
+            m_alt( i, 1 ) = geno2[ i ];
+            m_alt( i, 2 ) = geno1[ i ] * geno2[ i ];
             
-            m_null( i, 0 ) = row1[ i ];
-            m_null( i, 1 ) = row2[ i ];
+            m_null( i, 0 ) = geno1[ i ];
+            m_null( i, 1 ) = geno2[ i ];
         }
         else
         {
@@ -101,17 +228,27 @@ tukey_matrix::tukey_matrix(const arma::mat &cov, size_t n)
 {
 }
 
+model_matrix *
+tukey_matrix::clone() const
+{
+    return new tukey_matrix( *this );
+}
+
 void
 tukey_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing)
 {
+    const unsigned char *geno1;
+    const unsigned char *geno2;
+    decode_rows( row1, row2, geno1, geno2 );
+
     for(int i = 0; i < row1.size( ); i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 && missing[ i ] == 0 )
+        if( geno1[ i ] != 3 && geno2[ i ] != 3 && missing[ i ] == 0 )
         {
-            double s11 = row1[ i ] == 1 ? 1.0 : 0.0;
-            double s12 = row1[ i ] == 2 ? 1.0 : 0.0;
-            double s21 = row2[ i ] == 1 ? 1.0 : 0.0;
-            double s22 = row2[ i ] == 2 ? 1.0 : 0.0;
+            double s11 = geno1[ i ] == 1 ? 1.0 : 0.0;
+            double s12 = geno1[ i ] == 2 ? 1.0 : 0.0;
+            double s21 = geno2[ i ] == 1 ? 1.0 : 0.0;
+            double s22 = geno2[ i ] == 2 ? 1.0 : 0.0;
 
             m_alt( i, 0 ) = s11;
             m_alt( i, 1 ) = s12;
@@ -148,17 +285,27 @@ factor_matrix::factor_matrix(const arma::mat &cov, size_t n)
 {
 }
 
+model_matrix *
+factor_matrix::clone() const
+{
+    return new factor_matrix( *this );
+}
+
 void
 factor_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing)
 {
+    const unsigned char *geno1;
+    const unsigned char *geno2;
+    decode_rows( row1, row2, geno1, geno2 );
+
     for(int i = 0; i < row1.size( ); i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 && missing[ i ] == 0 )
+        if( geno1[ i ] != 3 && geno2[ i ] != 3 && missing[ i ] == 0 )
         {
-            double s11 = row1[ i ] == 1 ? 1.0 : 0.0;
-            double s12 = row1[ i ] == 2 ? 1.0 : 0.0;
-            double s21 = row2[ i ] == 1 ? 1.0 : 0.0;
-            double s22 = row2[ i ] == 2 ? 1.0 : 0.0;
+            double s11 = geno1[ i ] == 1 ? 1.0 : 0.0;
+            double s12 = geno1[ i ] == 2 ? 1.0 : 0.0;
+            double s21 = geno2[ i ] == 1 ? 1.0 : 0.0;
+            double s22 = geno2[ i ] == 2 ? 1.0 : 0.0;
 
             m_alt( i, 0 ) = s11;
             m_alt( i, 1 ) = s12;
@@ -200,17 +347,34 @@ noia_matrix::noia_matrix(const arma::mat &cov, size_t n)
 {
 }
 
+model_matrix *
+noia_matrix::clone() const
+{
+    return new noia_matrix( *this );
+}
+
+unsigned int
+noia_matrix::main_effect_snp(size_t column) const
+{
+    /* a1, a2, d1, d2 */
+    return column % 2;
+}
+
 void
 noia_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing)
 {
+    const unsigned char *geno1;
+    const unsigned char *geno2;
+    decode_rows( row1, row2, geno1, geno2 );
+
     for(int i = 0; i < row1.size( ); i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 && missing[ i ] == 0 )
+        if( geno1[ i ] != 3 && geno2[ i ] != 3 && missing[ i ] == 0 )
         {
-            double a1 = row1[ i ] - 1;
-            double a2 = row2[ i ] - 1;
-            double d1 = row1[ i ] == 1 ? 1.0 : 0.0;
-            double d2 = row2[ i ] == 1 ? 1.0 : 0.0;
+            double a1 = geno1[ i ] - 1;
+            double a2 = geno2[ i ] - 1;
+            double d1 = geno1[ i ] == 1 ? 1.0 : 0.0;
+            double d2 = geno2[ i ] == 1 ? 1.0 : 0.0;
 
             m_alt( i, 0 ) = a1;
             m_alt( i, 1 ) = a2;
@@ -270,15 +434,25 @@ separate_matrix::separate_matrix(const arma::mat &cov, size_t n, separate_mode_t
     }
 }
 
+model_matrix *
+separate_matrix::clone() const
+{
+    return new separate_matrix( *this );
+}
+
 void
 separate_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing)
 {
+    const unsigned char *geno1;
+    const unsigned char *geno2;
+    decode_rows( row1, row2, geno1, geno2 );
+
     for(int i = 0; i < row1.size( ); i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 && missing[ i ] == 0 )
+        if( geno1[ i ] != 3 && geno2[ i ] != 3 && missing[ i ] == 0 )
         {
-            double snp1 = ( row1[ i ] >= m_snp1_threshold ) ? 1.0 : 0.0;
-            double snp2 = ( row2[ i ] >= m_snp2_threshold ) ? 1.0 : 0.0;
+            double snp1 = ( geno1[ i ] >= m_snp1_threshold ) ? 1.0 : 0.0;
+            double snp2 = ( geno2[ i ] >= m_snp2_threshold ) ? 1.0 : 0.0;
 
             m_alt( i, 0 ) = snp1;
             m_alt( i, 1 ) = snp2;
@@ -325,6 +499,66 @@ make_model_matrix(const std::string &type, const arma::mat &cov, size_t n)
     }
 }
 
+grouped_matrix::grouped_matrix(const model_matrix &matrix)
+{
+    m_valid = matrix.get_cells( m_cell_alt, m_cell_null );
+}
+
+bool
+grouped_matrix::is_valid() const
+{
+    return m_valid;
+}
+
+size_t
+grouped_matrix::update(const cont_table &counts)
+{
+    arma::uvec cells( COUNT_TABLE_NUM_CELLS );
+    size_t num_groups = 0;
+    double num_samples = 0.0;
+    for(size_t c = 0; c < COUNT_TABLE_NUM_CELLS; c++)
+    {
+        if( counts( c, 1 ) > 0.0 )
+        {
+            cells[ num_groups++ ] = c;
+            num_samples += counts( c, 1 );
+        }
+    }
+    cells.resize( num_groups );
+
+    m_alt = m_cell_alt.rows( cells );
+    m_null = m_cell_null.rows( cells );
+    m_groups.n.set_size( num_groups );
+    m_groups.sum.set_size( num_groups );
+    m_groups.sum_sq.set_size( num_groups );
+    for(size_t i = 0; i < num_groups; i++)
+    {
+        m_groups.sum[ i ] = counts( cells[ i ], 0 );
+        m_groups.n[ i ] = counts( cells[ i ], 1 );
+        m_groups.sum_sq[ i ] = counts( cells[ i ], 2 );
+    }
+
+    return (size_t) num_samples;
+}
+
+const arma::mat &
+grouped_matrix::get_alt() const
+{
+    return m_alt;
+}
+
+const arma::mat &
+grouped_matrix::get_null() const
+{
+    return m_null;
+}
+
+const glm_groups &
+grouped_matrix::get_groups() const
+{
+    return m_groups;
+}
+
 env_matrix::env_matrix(const arma::mat &cov, size_t n)
     : m_alt( n, cov.n_cols + 4 )
 {
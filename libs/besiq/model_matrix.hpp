@@ -1,9 +1,13 @@
 #ifndef __MODEL_MATRIX_H__
 #define __MODEL_MATRIX_H__
 
+#include <vector>
+
 #include <armadillo>
 
 #include <plink/snp_row.hpp>
+#include <glm/glm_groups.hpp>
+#include <besiq/stats/snp_count.hpp>
 
 class model_matrix
 {
@@ -14,6 +18,23 @@ class model_matrix
          */
         virtual void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing) = 0;
 
+        /**
+         * Decodes the first snp once for the following updates that
+         * use the same row, until clear_first is called.
+         *
+         * @param row1 The first snp, must not change until clear_first.
+         */
+        virtual void set_first(const snp_row &row1)
+        {
+        }
+
+        /**
+         * Forgets the row given to set_first.
+         */
+        virtual void clear_first()
+        {
+        }
+
         /**
          * Returns the model matrix.
          */
@@ -22,6 +43,55 @@ class model_matrix
         virtual size_t num_df() = 0;
         virtual size_t num_alt() = 0;
         virtual size_t num_null() = 0;
+
+        /**
+         * Returns a copy of this model matrix that can be
+         * updated independently of this one.
+         */
+        virtual model_matrix *clone() const = 0;
+
+        /**
+         * Computes the row of the alternative and null matrix for
+         * each genotype combination, row 3 * g1 + g2 is the row of
+         * samples with genotype g1 for the first snp and g2 for the
+         * second. Only possible when the rows do not depend on
+         * anything other than the genotypes.
+         *
+         * @param alt The rows of the alternative matrix will be stored here.
+         * @param null The rows of the null matrix will be stored here.
+         *
+         * @return False if the rows of samples with the same genotypes
+         *         can differ, in which case nothing is stored.
+         */
+        virtual bool get_cells(arma::mat &alt, arma::mat &null) const
+        {
+            return false;
+        }
+
+        /**
+         * Returns the snp that a main effect column of the null
+         * matrix codes, the main effects are the first num_null - 1
+         * columns.
+         *
+         * @param column The main effect column.
+         *
+         * @return 0 for the first snp and 1 for the second snp.
+         */
+        virtual unsigned int main_effect_snp(size_t column) const = 0;
+
+        /**
+         * Expands coefficients of the null matrix to coefficients of
+         * the alternative matrix that give the same fit, that is with
+         * the interaction coefficients set to zero. The alternative
+         * matrix must be the null matrix with the interaction columns
+         * inserted after the main effects.
+         *
+         * @param null_beta The coefficients of the null matrix.
+         *
+         * @return The coefficients of the alternative matrix, or an
+         *         empty vector if null_beta has the wrong size.
+         */
+        arma::vec null_to_alt(const arma::vec &null_beta);
 };
 
 class general_matrix : public model_matrix
@@ -35,12 +105,58 @@ public:
     virtual size_t num_alt();
     virtual size_t num_null();
     virtual void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing) = 0;
+    virtual void set_first(const snp_row &row1);
+    virtual void clear_first();
+
+    /**
+     * The rows are found by updating a copy of this matrix with
+     * one sample of each genotype combination, so they are only
+     * available without covariates.
+     *
+     * @see model_matrix::get_cells.
+     */
+    virtual bool get_cells(arma::mat &alt, arma::mat &null) const;
+
+    /**
+     * The main effects of the first snp are followed by those of
+     * the second snp.
+     *
+     * @see model_matrix::main_effect_snp.
+     */
+    virtual unsigned int main_effect_snp(size_t column) const;
 
 protected:
+    /**
+     * Decodes the genotypes of both snps, the first snp is only
+     * decoded if it is not the row given to set_first.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param genotypes1 The genotypes of the first snp will be stored here.
+     * @param genotypes2 The genotypes of the second snp will be stored here.
+     */
+    void decode_rows(const snp_row &row1, const snp_row &row2, const unsigned char *&genotypes1, const unsigned char *&genotypes2);
+
     arma::mat m_alt;
     arma::mat m_null;
     size_t m_num_alt;
     size_t m_num_null;
+
+private:
+    /**
+     * The row given to set_first, or NULL.
+     */
+    const snp_row *m_first_row;
+
+    /**
+     * The decoded genotypes of the first snp.
+     */
+    std::vector<unsigned char> m_first;
+
+    /**
+     * The decoded genotypes of the second snp.
+     */
+    std::vector<unsigned char> m_second;
 };
 
 class additive_matrix : public general_matrix
@@ -48,6 +164,7 @@ class additive_matrix : public general_matrix
 public:
     additive_matrix(const arma::mat &cov, size_t n);
     void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing);
+    model_matrix *clone() const;
 };
 
 class tukey_matrix : public general_matrix
@@ -55,6 +172,7 @@ class tukey_matrix : public general_matrix
 public:
     tukey_matrix(const arma::mat &cov, size_t n);
     void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing);
+    model_matrix *clone() const;
 };
 
 class factor_matrix : public general_matrix
@@ -62,6 +180,7 @@ class factor_matrix : public general_matrix
 public:
     factor_matrix(const arma::mat &cov, size_t n);
     void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing);
+    model_matrix *clone() const;
 };
 
 class noia_matrix : public general_matrix
@@ -69,6 +188,8 @@ class noia_matrix : public general_matrix
 public:
     noia_matrix(const arma::mat &cov, size_t n);
     void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing);
+    model_matrix *clone() const;
+    unsigned int main_effect_snp(size_t column) const;
 };
 
 typedef enum 
@@ -84,6 +205,7 @@ class separate_matrix : public general_matrix
 public:
     separate_matrix(const arma::mat &cov, size_t n, separate_mode_t mode);
     void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing);
+    model_matrix *clone() const;
 private:
     int m_snp1_threshold;
     int m_snp2_threshold;
@@ -91,6 +213,88 @@ private:
 
 model_matrix *make_model_matrix(const std::string &type, const arma::mat &cov, size_t n);
 
+/**
+ * The rows of a model matrix for the genotype combinations of a pair
+ * that have samples, together with the phenotype summarized over the
+ * samples of each combination. When the model matrix has no covariates,
+ * a glm fitted on these at most nine groups has the same estimates and
+ * likelihood as one fitted on the samples.
+ */
+class grouped_matrix
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param matrix The model matrix whose rows are used.
+     */
+    grouped_matrix(const model_matrix &matrix);
+
+    /**
+     * Returns true if the model matrix could be grouped, otherwise
+     * the model has to be fitted on the samples.
+     *
+     * @return True if the model matrix could be grouped.
+     */
+    bool is_valid() const;
+
+    /**
+     * Updates the groups and rows for a pair.
+     *
+     * @param counts The sum of phenotypes, number of samples and
+     *               sum of squared phenotypes of each genotype combination.
+     *
+     * @return The number of samples in the groups.
+     */
+    size_t update(const cont_table &counts);
+
+    /**
+     * Returns the alternative matrix with one row per group.
+     */
+    const arma::mat &get_alt() const;
+
+    /**
+     * Returns the null matrix with one row per group.
+     */
+    const arma::mat &get_null() const;
+
+    /**
+     * Returns the phenotype summarized for each group.
+     */
+    const glm_groups &get_groups() const;
+
+private:
+    /**
+     * True if the model matrix could be grouped.
+     */
+    bool m_valid;
+
+    /**
+     * The row of the alternative matrix for each genotype combination.
+     */
+    arma::mat m_cell_alt;
+
+    /**
+     * The row of the null matrix for each genotype combination.
+     */
+    arma::mat m_cell_null;
+
+    /**
+     * The rows of the alternative matrix of the current groups.
+     */
+    arma::mat m_alt;
+
+    /**
+     * The rows of the null matrix of the current groups.
+     */
+    arma::mat m_null;
+
+    /**
+     * The phenotype of the current groups.
+     */
+    glm_groups m_groups;
+};
+
 class env_matrix
 {
 public:
@@ -2,6 +2,15 @@
 
 using namespace arma;
 
+log_double
+model::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+{
+    binary_table counts;
+    count_engine( phenotype, arma::uvec( ), weight ).count( row1, row2, counts );
+
+    return prob( counts );
+}
+
 saturated::saturated(log_double prior, const arma::vec &alpha)
 : model::model( prior, alpha )
 {
@@ -9,17 +18,14 @@ saturated::saturated(log_double prior, const arma::vec &alpha)
 }
 
 log_double
-saturated::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+saturated::prob(const binary_table &counts)
 {
-    mat counts = joint_count( row1, row2, phenotype, weight );
-
-    vec alpha = get_alpha( );
+    const arma::vec &alpha = get_alpha( );
     
     log_double likelihood = 1.0;
-    for(int i = 0; i < counts.n_rows; i++)
+    for(int i = 0; i < 9; i++)
     {
-        vec row_count = counts.row( i ).t( );
-        likelihood *= log_double::from_log( ldirmult( row_count, alpha ) );
+        likelihood *= log_double::from_log( ldirmult( counts.n[ i ], alpha ) );
     }
 
     return likelihood;
@@ -32,12 +38,11 @@ null::null(log_double prior, const arma::vec &alpha)
 }
 
 log_double
-null::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+null::prob(const binary_table &counts)
 {
-    vec counts = pheno_count( row1, row2, phenotype, weight );
-    vec alpha = get_alpha( );
+    double pheno[ 2 ] = { counts.sum( 0 ), counts.sum( 1 ) };
 
-    return log_double::from_log( ldirmult( counts, alpha ) );
+    return log_double::from_log( ldirmult( pheno, get_alpha( ) ) );
 }
 
 ld_assoc::ld_assoc(log_double prior, const arma::vec &alpha, bool is_first)
@@ -48,20 +53,27 @@ ld_assoc::ld_assoc(log_double prior, const arma::vec &alpha, bool is_first)
 }
 
 log_double
-ld_assoc::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+ld_assoc::prob(const binary_table &counts)
 {
-    const snp_row &snp1 = m_is_first ? row1 : row2;
-    const snp_row &snp2 = m_is_first ? row2 : row1;
-
-    mat counts = single_count( snp1, snp2, phenotype, weight );
-    
-    vec alpha = get_alpha( );
+    const arma::vec &alpha = get_alpha( );
 
     log_double likelihood = 1.0;
-    for(int i = 0; i < counts.n_rows; i++)
+    for(int i = 0; i < 3; i++)
     {
-        vec row_count = counts.row( i ).t( );
-        likelihood *= log_double::from_log( ldirmult( row_count, alpha ) );
+        double snp_pheno[ 2 ];
+        for(int k = 0; k < 2; k++)
+        {
+            if( m_is_first )
+            {
+                snp_pheno[ k ] = counts( 3*i, k ) + counts( 3*i + 1, k ) + counts( 3*i + 2, k );
+            }
+            else
+            {
+                snp_pheno[ k ] = counts( 3*0 + i, k ) + counts( 3*1 + i, k ) + counts( 3*2 + i, k );
+            }
+        }
+
+        likelihood *= log_double::from_log( ldirmult( snp_pheno, alpha ) );
     }
 
     return likelihood;
@@ -75,11 +87,9 @@ sindependent::sindependent(log_double prior, const arma::vec &alpha, int num_mc_
 }
 
 log_double
-sindependent::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+sindependent::prob(const binary_table &counts)
 {
-    mat counts = joint_count( row1, row2, phenotype, weight );
-
-    vec alpha = model::get_alpha( );
+    const arma::vec &alpha = model::get_alpha( );
     log_double likelihood = 0.0;
     for(int k = 0; k < m_num_mc_iterations; k++)
     {
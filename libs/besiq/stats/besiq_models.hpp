@@ -47,7 +47,7 @@ public:
      *
      * @return the prior parameters.
      */
-    arma::vec get_alpha()
+    const arma::vec &get_alpha() const
     {
         return m_alpha;
     }
@@ -63,7 +63,18 @@ public:
      *
      * @return The likelihood of the snps.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight) = 0;
+    log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+
+    /**
+     * Computes the likelihood of the phenotype under this
+     * model given the contingency table of the snps, so that
+     * the table can be shared by several models.
+     *
+     * @param counts The number of cases and controls for each genotype.
+     *
+     * @return The likelihood of the snps.
+     */
+    virtual log_double prob(const binary_table &counts) = 0;
     
 private:
     /**
@@ -93,10 +104,12 @@ public:
      */
     saturated(log_double prior, const arma::vec &alpha);
     
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const binary_table &counts);
 };
 
 /**
@@ -152,10 +165,12 @@ public:
      */
     static log_double pheno_prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
 
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const binary_table &counts);
 };
 
 /**
@@ -174,10 +189,12 @@ public:
      */
     ld_assoc(log_double prior, const arma::vec &alpha, bool is_first);
 
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const binary_table &counts);
 
 private:
     /**
@@ -207,10 +224,12 @@ public:
      */
     sindependent(log_double prior, const arma::vec &alpha, int num_mc_iterations);
 
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const binary_table &counts);
 
 private:
     dir_generator m_rdir;
@@ -1,63 +1,81 @@
 #include <besiq/stats/closed_form_models.hpp>
 #include <besiq/stats/binomial_models.hpp>
 
-using namespace arma;
+/**
+ * Computes the log likelihood of a binomial cell where the probability
+ * of a case is estimated from the cell itself.
+ *
+ * @param controls The number of controls in the cell.
+ * @param cases The number of cases in the cell.
+ *
+ * @return The log likelihood of the cell.
+ */
+static double
+binomial_cell_loglikelihood(double controls, double cases)
+{
+    double p = cases / ( controls + cases );
+
+    return cases * log( p ) + controls * log( 1 - p );
+}
 
 binomial_full::binomial_full()
-: closed_form_model::closed_form_model( 9 )
+: binomial_model( 9 )
 {
 
 }
 
 log_double
-binomial_full::prob(const arma::mat &count)
+binomial_full::prob(const binary_table &count)
 {
-    arma::vec p_full = count.col( 1 ) / ( count.col( 0 ) + count.col( 1 ) );
+    double loglikelihood = 0.0;
+    for(int i = 0; i < 9; i++)
+    {
+        loglikelihood += binomial_cell_loglikelihood( count( i, 0 ), count( i, 1 ) );
+    }
 
-    return log_double::from_log( accu( count.col( 1 ) % arma::log( p_full ) + count.col( 0 ) % arma::log( 1 - p_full ) ) );
+    return log_double::from_log( loglikelihood );
 }
 
 binomial_null::binomial_null()
-: closed_form_model::closed_form_model( 1 )
+: binomial_model( 1 )
 {
 
 }
 
 log_double
-binomial_null::prob(const arma::mat &count)
+binomial_null::prob(const binary_table &count)
 {
-    arma::rowvec pheno = sum( count, 0 );
-    double p_case = pheno( 1 ) / ( pheno( 0 ) + pheno( 1 ) );
-
-    return log_double::from_log( pheno( 1 ) * log( p_case ) + pheno( 0 ) * log( 1 - p_case ) );
+    return log_double::from_log( binomial_cell_loglikelihood( count.sum( 0 ), count.sum( 1 ) ) );
 }
 
 binomial_single::binomial_single(bool is_first)
-: closed_form_model::closed_form_model( 3 ),
+: binomial_model( 3 ),
   m_is_first( is_first )
 {
 
 }
 
 log_double
-binomial_single::prob(const arma::mat &count)
+binomial_single::prob(const binary_table &count)
 {
-    arma::mat snp_pheno = zeros<mat>( 3, 2 );
+    double loglikelihood = 0.0;
     for(int i = 0; i < 3; i++)
     {
-        if( m_is_first )
-        {
-            snp_pheno( i, 0 ) = count( 3*i, 0 ) + count( 3*i + 1, 0 ) + count( 3*i + 2, 0 );
-            snp_pheno( i, 1 ) = count( 3*i, 1 ) + count( 3*i + 1, 1 ) + count( 3*i + 2, 1 );
-        }
-        else
+        double snp_pheno[ 2 ];
+        for(int k = 0; k < 2; k++)
         {
-            snp_pheno( i, 0 ) = count( 3*0 + i, 0 ) + count( 3*1 + i, 0 ) + count( 3*2 + i, 0 );
-            snp_pheno( i, 1 ) = count( 3*0 + i, 1 ) + count( 3*1 + i, 1 ) + count( 3*2 + i, 1 );
+            if( m_is_first )
+            {
+                snp_pheno[ k ] = count( 3*i, k ) + count( 3*i + 1, k ) + count( 3*i + 2, k );
+            }
+            else
+            {
+                snp_pheno[ k ] = count( 3*0 + i, k ) + count( 3*1 + i, k ) + count( 3*2 + i, k );
+            }
         }
+
+        loglikelihood += binomial_cell_loglikelihood( snp_pheno[ 0 ], snp_pheno[ 1 ] );
     }
     
-    arma::vec p_snp = snp_pheno.col( 1 ) / ( snp_pheno.col( 0 ) + snp_pheno.col( 1 ) );
-    
-    return log_double::from_log( accu( snp_pheno.col( 1 ) % arma::log( p_snp ) + snp_pheno.col( 0 ) % arma::log( 1 - p_snp ) ) );
+    return log_double::from_log( loglikelihood );
 }
@@ -11,7 +11,7 @@
  * that each cell in the table has it is own parameter.
  */
 class binomial_full
-: public closed_form_model
+: public binomial_model
 {
 public:
     /**
@@ -22,7 +22,7 @@ public:
     /**
      * @see binomial_model::prob.
      */
-    virtual log_double prob(const arma::mat &count);
+    virtual log_double prob(const binary_table &count);
 };
 
 /**
@@ -30,7 +30,7 @@ public:
  * the phenotype. The snps may however be in ld.
  */
 class binomial_null
-: public closed_form_model
+: public binomial_model
 {
 public:
     /**
@@ -41,7 +41,7 @@ public:
     /**
      * @see binomial_model::prob.
      */
-    virtual log_double prob(const arma::mat &count);
+    virtual log_double prob(const binary_table &count);
 };
 
 /**
@@ -49,7 +49,7 @@ public:
  * the phenotype, and the other possibly in ld with the first.
  */
 class binomial_single
-: public closed_form_model
+: public binomial_model
 {
 public:
     /**
@@ -62,7 +62,7 @@ public:
     /**
      * @see binomial_model::prob.
      */
-    virtual log_double prob(const arma::mat &count);
+    virtual log_double prob(const binary_table &count);
 
 private:
     /**
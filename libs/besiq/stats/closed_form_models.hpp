@@ -8,8 +8,9 @@
 
 /**
  * This class represents a general model that can compute a
- * model likelihood for two snps.
+ * model likelihood for two snps from their contingency table.
  */
+template<class Table>
 class closed_form_model
 {
 public:
@@ -23,6 +24,13 @@ public:
     {
     }
 
+    /**
+     * Destructor.
+     */
+    virtual ~closed_form_model()
+    {
+    }
+
     /**
      * Returns the degrees of freedom of this model.
      *
@@ -37,11 +45,11 @@ public:
      * Computes the likelihood of the snps and phenotypes under this
      * model. 
      *
-     * @param count The number of counts for each genotype.
+     * @param count The contingency table of the snps.
      *
      * @return The likelihood of the snps.
      */
-    virtual log_double prob(const arma::mat &count) = 0;
+    virtual log_double prob(const Table &count) = 0;
     
 private:
     
@@ -51,4 +59,14 @@ private:
     unsigned int m_df;
 };
 
+/**
+ * Models of a binary phenotype.
+ */
+typedef closed_form_model<binary_table> binomial_model;
+
+/**
+ * Models of a continuous phenotype.
+ */
+typedef closed_form_model<cont_table> normal_model;
+
 #endif /* End of __CLOSED_FORM_MODELS_H__ */
@@ -0,0 +1,617 @@
+#include <plink/snp_row.hpp>
+#include <besiq/stats/count_kernels.hpp>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define COUNT_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Returns the most capable instruction set of the running cpu.
+ *
+ * @return The instruction set.
+ */
+static count_isa
+detect_count_isa()
+{
+#ifdef COUNT_KERNELS_X86
+    __builtin_cpu_init( );
+    if( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512vpopcntdq" ) )
+    {
+        return COUNT_ISA_AVX512;
+    }
+    else if( __builtin_cpu_supports( "avx2" ) )
+    {
+        return COUNT_ISA_AVX2;
+    }
+#endif
+
+    return COUNT_ISA_SCALAR;
+}
+
+/**
+ * The instruction set of the running cpu.
+ */
+static const count_isa CPU_COUNT_ISA = detect_count_isa( );
+
+count_isa
+get_count_isa()
+{
+    return CPU_COUNT_ISA;
+}
+
+bool
+is_count_isa_supported(count_isa isa)
+{
+    return isa <= CPU_COUNT_ISA;
+}
+
+const char *
+get_count_isa_name(count_isa isa)
+{
+    switch( isa )
+    {
+        case COUNT_ISA_AVX2:
+            return "avx2";
+        case COUNT_ISA_AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+/**
+ * Counts the set bits of a word.
+ *
+ * @param x A word.
+ *
+ * @return The number of set bits.
+ */
+static inline unsigned int
+popcount64(uint64_t x)
+{
+    return __builtin_popcountll( x );
+}
+
+/**
+ * Reference implementation of count_planes.
+ */
+static void
+count_planes_scalar(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                    const uint64_t *controls, const uint64_t *cases, size_t num_words,
+                    unsigned int n[][ 2 ])
+{
+    for(size_t w = 0; w < num_words; w++)
+    {
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            uint64_t ab = a[ k ][ w ] & b[ k ][ w ];
+            n[ k ][ 0 ] += popcount64( ab & controls[ w ] );
+            n[ k ][ 1 ] += popcount64( ab & cases[ w ] );
+        }
+    }
+}
+
+/**
+ * Reference implementation of count_planes_single.
+ */
+static void
+count_planes_single_scalar(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                           const uint64_t *mask, size_t num_words, unsigned int n[])
+{
+    for(size_t w = 0; w < num_words; w++)
+    {
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            n[ k ] += popcount64( a[ k ][ w ] & b[ k ][ w ] & mask[ w ] );
+        }
+    }
+}
+
+/**
+ * Reference implementation of count_planes_masks.
+ */
+static void
+count_planes_masks_scalar(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                          const uint64_t *masks, size_t num_masks, size_t num_words, uint64_t *n)
+{
+    for(size_t w = 0; w < num_words; w++)
+    {
+        const uint64_t *masks_w = masks + w * num_masks;
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            uint64_t ab = a[ k ][ w ] & b[ k ][ w ];
+            if( ab == 0 )
+            {
+                continue;
+            }
+
+            uint64_t *n_k = n + k * num_masks;
+            for(size_t m = 0; m < num_masks; m++)
+            {
+                n_k[ m ] += popcount64( ab & masks_w[ m ] );
+            }
+        }
+    }
+}
+
+/**
+ * Reference implementation of sum_planes, visits the samples
+ * of each cell by their set bits. Always inlined so that it can be
+ * compiled for other instruction sets.
+ */
+template<size_t NUM_COLUMNS>
+static inline __attribute__(( always_inline )) void
+sum_planes_scalar(const uint64_t *const p1[ 3 ], const uint64_t *const p2[ 3 ],
+                  const double *const *columns, size_t num_words, double *sums)
+{
+    for(size_t w = 0; w < num_words; w++)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            uint64_t a = p1[ i ][ w ];
+            if( a == 0 )
+            {
+                continue;
+            }
+
+            for(int j = 0; j < 3; j++)
+            {
+                uint64_t bits = a & p2[ j ][ w ];
+                double *cell = sums + ( 3 * i + j ) * NUM_COLUMNS;
+                while( bits != 0 )
+                {
+                    size_t sample = w * SNP_ROW_BITS_PER_WORD + __builtin_ctzll( bits );
+                    for(size_t k = 0; k < NUM_COLUMNS; k++)
+                    {
+                        cell[ k ] += columns[ k ][ sample ];
+                    }
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+}
+
+#ifdef COUNT_KERNELS_X86
+
+/**
+ * Counts the set bits of each 64-bit lane by looking up the
+ * count of each nibble.
+ *
+ * @param v The words.
+ *
+ * @return The number of set bits in each lane.
+ */
+__attribute__(( target( "avx2" ) ))
+static inline __m256i
+popcount256(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8( 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 );
+    const __m256i low_mask = _mm256_set1_epi8( 0x0f );
+    __m256i low = _mm256_and_si256( v, low_mask );
+    __m256i high = _mm256_and_si256( _mm256_srli_epi16( v, 4 ), low_mask );
+    __m256i counts = _mm256_add_epi8( _mm256_shuffle_epi8( lookup, low ), _mm256_shuffle_epi8( lookup, high ) );
+
+    return _mm256_sad_epu8( counts, _mm256_setzero_si256( ) );
+}
+
+/**
+ * Returns the sum of the 64-bit lanes.
+ *
+ * @param v The lanes.
+ *
+ * @return The sum of the lanes.
+ */
+__attribute__(( target( "avx2" ) ))
+static inline uint64_t
+sum_lanes256(__m256i v)
+{
+    uint64_t lanes[ 4 ];
+    _mm256_storeu_si256( (__m256i *) lanes, v );
+
+    return lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+}
+
+/**
+ * AVX2 implementation of count_planes, 4 words at a time.
+ */
+__attribute__(( target( "avx2,popcnt" ) ))
+static void
+count_planes_avx2(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                  const uint64_t *controls, const uint64_t *cases, size_t num_words,
+                  unsigned int n[][ 2 ])
+{
+    __m256i acc[ COUNT_MAX_PAIRS ][ 2 ];
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        acc[ k ][ 0 ] = _mm256_setzero_si256( );
+        acc[ k ][ 1 ] = _mm256_setzero_si256( );
+    }
+
+    size_t w = 0;
+    for(; w + 4 <= num_words; w += 4)
+    {
+        __m256i controls_w = _mm256_loadu_si256( (const __m256i *) ( controls + w ) );
+        __m256i cases_w = _mm256_loadu_si256( (const __m256i *) ( cases + w ) );
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            __m256i ab = _mm256_and_si256( _mm256_loadu_si256( (const __m256i *) ( a[ k ] + w ) ),
+                                           _mm256_loadu_si256( (const __m256i *) ( b[ k ] + w ) ) );
+            acc[ k ][ 0 ] = _mm256_add_epi64( acc[ k ][ 0 ], popcount256( _mm256_and_si256( ab, controls_w ) ) );
+            acc[ k ][ 1 ] = _mm256_add_epi64( acc[ k ][ 1 ], popcount256( _mm256_and_si256( ab, cases_w ) ) );
+        }
+    }
+
+    /* Remaining words */
+    const uint64_t *a_tail[ COUNT_MAX_PAIRS ];
+    const uint64_t *b_tail[ COUNT_MAX_PAIRS ];
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        n[ k ][ 0 ] += sum_lanes256( acc[ k ][ 0 ] );
+        n[ k ][ 1 ] += sum_lanes256( acc[ k ][ 1 ] );
+        a_tail[ k ] = a[ k ] + w;
+        b_tail[ k ] = b[ k ] + w;
+    }
+    count_planes_scalar( a_tail, b_tail, num_pairs, controls + w, cases + w, num_words - w, n );
+}
+
+/**
+ * AVX2 implementation of count_planes_single, 4 words at a time.
+ */
+__attribute__(( target( "avx2,popcnt" ) ))
+static void
+count_planes_single_avx2(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                         const uint64_t *mask, size_t num_words, unsigned int n[])
+{
+    __m256i acc[ COUNT_MAX_PAIRS ];
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        acc[ k ] = _mm256_setzero_si256( );
+    }
+
+    size_t w = 0;
+    for(; w + 4 <= num_words; w += 4)
+    {
+        __m256i mask_w = _mm256_loadu_si256( (const __m256i *) ( mask + w ) );
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            __m256i ab = _mm256_and_si256( _mm256_loadu_si256( (const __m256i *) ( a[ k ] + w ) ),
+                                           _mm256_loadu_si256( (const __m256i *) ( b[ k ] + w ) ) );
+            acc[ k ] = _mm256_add_epi64( acc[ k ], popcount256( _mm256_and_si256( ab, mask_w ) ) );
+        }
+    }
+
+    /* Remaining words */
+    const uint64_t *a_tail[ COUNT_MAX_PAIRS ];
+    const uint64_t *b_tail[ COUNT_MAX_PAIRS ];
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        n[ k ] += sum_lanes256( acc[ k ] );
+        a_tail[ k ] = a[ k ] + w;
+        b_tail[ k ] = b[ k ] + w;
+    }
+    count_planes_single_scalar( a_tail, b_tail, num_pairs, mask + w, num_words - w, n );
+}
+
+/**
+ * AVX2 implementation of count_planes_masks, 4 masks at a time.
+ */
+__attribute__(( target( "avx2,popcnt" ) ))
+static void
+count_planes_masks_avx2(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                        const uint64_t *masks, size_t num_masks, size_t num_words, uint64_t *n)
+{
+    for(size_t w = 0; w < num_words; w++)
+    {
+        const uint64_t *masks_w = masks + w * num_masks;
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            uint64_t ab = a[ k ][ w ] & b[ k ][ w ];
+            if( ab == 0 )
+            {
+                continue;
+            }
+
+            uint64_t *n_k = n + k * num_masks;
+            __m256i ab_w = _mm256_set1_epi64x( (long long) ab );
+            size_t m = 0;
+            for(; m + 4 <= num_masks; m += 4)
+            {
+                __m256i count = popcount256( _mm256_and_si256( ab_w, _mm256_loadu_si256( (const __m256i *) ( masks_w + m ) ) ) );
+                _mm256_storeu_si256( (__m256i *) ( n_k + m ), _mm256_add_epi64( _mm256_loadu_si256( (const __m256i *) ( n_k + m ) ), count ) );
+            }
+            for(; m < num_masks; m++)
+            {
+                n_k[ m ] += popcount64( ab & masks_w[ m ] );
+            }
+        }
+    }
+}
+
+/**
+ * AVX2 implementation of sum_planes. Masked adds of 4 samples at a
+ * time for each of the 9 cells are slower than visiting the set bits,
+ * so this is the reference loop compiled with tzcnt and blsr.
+ */
+template<size_t NUM_COLUMNS>
+__attribute__(( target( "avx2,bmi,popcnt" ) ))
+static void
+sum_planes_avx2(const uint64_t *const p1[ 3 ], const uint64_t *const p2[ 3 ],
+                const double *const *columns, size_t num_words, double *sums)
+{
+    sum_planes_scalar<NUM_COLUMNS>( p1, p2, columns, num_words, sums );
+}
+
+/**
+ * AVX-512 implementation of count_planes, 8 words at a time,
+ * the last words are read with a masked load.
+ */
+__attribute__(( target( "avx512f,avx512vpopcntdq" ) ))
+static void
+count_planes_avx512(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                    const uint64_t *controls, const uint64_t *cases, size_t num_words,
+                    unsigned int n[][ 2 ])
+{
+    __m512i acc[ COUNT_MAX_PAIRS ][ 2 ];
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        acc[ k ][ 0 ] = _mm512_setzero_si512( );
+        acc[ k ][ 1 ] = _mm512_setzero_si512( );
+    }
+
+    for(size_t w = 0; w < num_words; w += 8)
+    {
+        __mmask8 load_mask = num_words - w >= 8 ? 0xff : ( 1U << ( num_words - w ) ) - 1;
+        __m512i controls_w = _mm512_maskz_loadu_epi64( load_mask, controls + w );
+        __m512i cases_w = _mm512_maskz_loadu_epi64( load_mask, cases + w );
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            __m512i ab = _mm512_and_si512( _mm512_maskz_loadu_epi64( load_mask, a[ k ] + w ),
+                                           _mm512_maskz_loadu_epi64( load_mask, b[ k ] + w ) );
+            acc[ k ][ 0 ] = _mm512_add_epi64( acc[ k ][ 0 ], _mm512_popcnt_epi64( _mm512_and_si512( ab, controls_w ) ) );
+            acc[ k ][ 1 ] = _mm512_add_epi64( acc[ k ][ 1 ], _mm512_popcnt_epi64( _mm512_and_si512( ab, cases_w ) ) );
+        }
+    }
+
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        n[ k ][ 0 ] += _mm512_reduce_add_epi64( acc[ k ][ 0 ] );
+        n[ k ][ 1 ] += _mm512_reduce_add_epi64( acc[ k ][ 1 ] );
+    }
+}
+
+/**
+ * AVX-512 implementation of count_planes_single, 8 words at a time,
+ * the last words are read with a masked load.
+ */
+__attribute__(( target( "avx512f,avx512vpopcntdq" ) ))
+static void
+count_planes_single_avx512(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                           const uint64_t *mask, size_t num_words, unsigned int n[])
+{
+    __m512i acc[ COUNT_MAX_PAIRS ];
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        acc[ k ] = _mm512_setzero_si512( );
+    }
+
+    for(size_t w = 0; w < num_words; w += 8)
+    {
+        __mmask8 load_mask = num_words - w >= 8 ? 0xff : ( 1U << ( num_words - w ) ) - 1;
+        __m512i mask_w = _mm512_maskz_loadu_epi64( load_mask, mask + w );
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            __m512i ab = _mm512_and_si512( _mm512_maskz_loadu_epi64( load_mask, a[ k ] + w ),
+                                           _mm512_maskz_loadu_epi64( load_mask, b[ k ] + w ) );
+            acc[ k ] = _mm512_add_epi64( acc[ k ], _mm512_popcnt_epi64( _mm512_and_si512( ab, mask_w ) ) );
+        }
+    }
+
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        n[ k ] += _mm512_reduce_add_epi64( acc[ k ] );
+    }
+}
+
+/**
+ * AVX-512 implementation of count_planes_masks, 8 masks at a time,
+ * the last masks are read with a masked load.
+ */
+__attribute__(( target( "avx512f,avx512vpopcntdq" ) ))
+static void
+count_planes_masks_avx512(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                          const uint64_t *masks, size_t num_masks, size_t num_words, uint64_t *n)
+{
+    for(size_t w = 0; w < num_words; w++)
+    {
+        const uint64_t *masks_w = masks + w * num_masks;
+        for(size_t k = 0; k < num_pairs; k++)
+        {
+            uint64_t ab = a[ k ][ w ] & b[ k ][ w ];
+            if( ab == 0 )
+            {
+                continue;
+            }
+
+            uint64_t *n_k = n + k * num_masks;
+            __m512i ab_w = _mm512_set1_epi64( (long long) ab );
+            for(size_t m = 0; m < num_masks; m += 8)
+            {
+                __mmask8 load_mask = num_masks - m >= 8 ? 0xff : ( 1U << ( num_masks - m ) ) - 1;
+                __m512i count = _mm512_popcnt_epi64( _mm512_and_si512( ab_w, _mm512_maskz_loadu_epi64( load_mask, masks_w + m ) ) );
+                _mm512_mask_storeu_epi64( n_k + m, load_mask, _mm512_add_epi64( _mm512_maskz_loadu_epi64( load_mask, n_k + m ), count ) );
+            }
+        }
+    }
+}
+
+/**
+ * AVX-512 implementation of sum_planes, each group of 8 samples
+ * is added to each cell with its genotype bits as the write mask.
+ */
+template<size_t NUM_COLUMNS>
+__attribute__(( target( "avx512f" ) ))
+static void
+sum_planes_avx512(const uint64_t *const p1[ 3 ], const uint64_t *const p2[ 3 ],
+                  const double *const *columns, size_t num_words, double *sums)
+{
+    __m512d acc[ 9 ][ NUM_COLUMNS ];
+    for(int c = 0; c < 9; c++)
+    {
+        for(size_t k = 0; k < NUM_COLUMNS; k++)
+        {
+            acc[ c ][ k ] = _mm512_setzero_pd( );
+        }
+    }
+
+    for(size_t w = 0; w < num_words; w++)
+    {
+        uint64_t cells[ 9 ];
+        uint64_t any = 0;
+        for(int i = 0; i < 3; i++)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                cells[ 3 * i + j ] = p1[ i ][ w ] & p2[ j ][ w ];
+                any |= cells[ 3 * i + j ];
+            }
+        }
+
+        for(unsigned int shift = 0; shift < SNP_ROW_BITS_PER_WORD; shift += 8)
+        {
+            if( ( ( any >> shift ) & 0xff ) == 0 )
+            {
+                continue;
+            }
+
+            size_t sample = w * SNP_ROW_BITS_PER_WORD + shift;
+            __m512d x[ NUM_COLUMNS ];
+            for(size_t k = 0; k < NUM_COLUMNS; k++)
+            {
+                x[ k ] = _mm512_loadu_pd( columns[ k ] + sample );
+            }
+
+            for(int c = 0; c < 9; c++)
+            {
+                __mmask8 mask = ( cells[ c ] >> shift ) & 0xff;
+                for(size_t k = 0; k < NUM_COLUMNS; k++)
+                {
+                    acc[ c ][ k ] = _mm512_mask_add_pd( acc[ c ][ k ], mask, acc[ c ][ k ], x[ k ] );
+                }
+            }
+        }
+    }
+
+    for(int c = 0; c < 9; c++)
+    {
+        for(size_t k = 0; k < NUM_COLUMNS; k++)
+        {
+            sums[ c * NUM_COLUMNS + k ] += _mm512_reduce_add_pd( acc[ c ][ k ] );
+        }
+    }
+}
+
+#endif /* End of COUNT_KERNELS_X86 */
+
+void
+count_planes(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+             const uint64_t *controls, const uint64_t *cases, size_t num_words,
+             count_isa isa, unsigned int n[][ 2 ])
+{
+#ifdef COUNT_KERNELS_X86
+    if( isa == COUNT_ISA_AVX512 )
+    {
+        count_planes_avx512( a, b, num_pairs, controls, cases, num_words, n );
+        return;
+    }
+    else if( isa == COUNT_ISA_AVX2 )
+    {
+        count_planes_avx2( a, b, num_pairs, controls, cases, num_words, n );
+        return;
+    }
+#endif
+
+    count_planes_scalar( a, b, num_pairs, controls, cases, num_words, n );
+}
+
+void
+count_planes_single(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                    const uint64_t *mask, size_t num_words, count_isa isa, unsigned int n[])
+{
+#ifdef COUNT_KERNELS_X86
+    if( isa == COUNT_ISA_AVX512 )
+    {
+        count_planes_single_avx512( a, b, num_pairs, mask, num_words, n );
+        return;
+    }
+    else if( isa == COUNT_ISA_AVX2 )
+    {
+        count_planes_single_avx2( a, b, num_pairs, mask, num_words, n );
+        return;
+    }
+#endif
+
+    count_planes_single_scalar( a, b, num_pairs, mask, num_words, n );
+}
+
+void
+count_planes_masks(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                   const uint64_t *masks, size_t num_masks, size_t num_words,
+                   count_isa isa, uint64_t *n)
+{
+#ifdef COUNT_KERNELS_X86
+    if( isa == COUNT_ISA_AVX512 )
+    {
+        count_planes_masks_avx512( a, b, num_pairs, masks, num_masks, num_words, n );
+        return;
+    }
+    else if( isa == COUNT_ISA_AVX2 )
+    {
+        count_planes_masks_avx2( a, b, num_pairs, masks, num_masks, num_words, n );
+        return;
+    }
+#endif
+
+    count_planes_masks_scalar( a, b, num_pairs, masks, num_masks, num_words, n );
+}
+
+/**
+ * Selects the implementation of sum_planes for a fixed number of columns.
+ */
+template<size_t NUM_COLUMNS>
+static void
+sum_planes_isa(const uint64_t *const p1[ 3 ], const uint64_t *const p2[ 3 ],
+               const double *const *columns, size_t num_words, count_isa isa, double *sums)
+{
+#ifdef COUNT_KERNELS_X86
+    if( isa == COUNT_ISA_AVX512 )
+    {
+        sum_planes_avx512<NUM_COLUMNS>( p1, p2, columns, num_words, sums );
+        return;
+    }
+    else if( isa == COUNT_ISA_AVX2 )
+    {
+        sum_planes_avx2<NUM_COLUMNS>( p1, p2, columns, num_words, sums );
+        return;
+    }
+#endif
+
+    sum_planes_scalar<NUM_COLUMNS>( p1, p2, columns, num_words, sums );
+}
+
+void
+sum_planes(const uint64_t *const p1[ 3 ], const uint64_t *const p2[ 3 ],
+           const double *const *columns, size_t num_columns, size_t num_words,
+           count_isa isa, double *sums)
+{
+    if( num_columns == 2 )
+    {
+        sum_planes_isa<2>( p1, p2, columns, num_words, isa, sums );
+    }
+    else
+    {
+        sum_planes_isa<3>( p1, p2, columns, num_words, isa, sums );
+    }
+}
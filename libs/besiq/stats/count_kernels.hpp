@@ -0,0 +1,149 @@
+#ifndef __COUNT_KERNELS_H__
+#define __COUNT_KERNELS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Instruction sets that the contingency table kernels are
+ * implemented for, ordered from least to most capable.
+ */
+enum count_isa
+{
+    /**
+     * Portable scalar code, used as the reference.
+     */
+    COUNT_ISA_SCALAR = 0,
+
+    /**
+     * AVX2, 4 words at a time.
+     */
+    COUNT_ISA_AVX2 = 1,
+
+    /**
+     * AVX-512F with VPOPCNTDQ, 8 words or 8 samples at a time.
+     */
+    COUNT_ISA_AVX512 = 2
+};
+
+/**
+ * Number of instruction sets in count_isa.
+ */
+const size_t COUNT_ISA_NUM = 3;
+
+/**
+ * Returns the most capable instruction set that the running cpu
+ * supports, detected once by CPUID at startup.
+ *
+ * @return The detected instruction set.
+ */
+count_isa get_count_isa();
+
+/**
+ * Returns true if the running cpu supports the given instruction
+ * set and this build contains kernels for it.
+ *
+ * @param isa The instruction set.
+ *
+ * @return True if the kernels for isa can be used.
+ */
+bool is_count_isa_supported(count_isa isa);
+
+/**
+ * Returns a short name of an instruction set.
+ *
+ * @param isa The instruction set.
+ *
+ * @return The name of the instruction set.
+ */
+const char *get_count_isa_name(count_isa isa);
+
+/**
+ * Largest number of plane pairs that can be counted at once.
+ */
+const size_t COUNT_MAX_PAIRS = 9;
+
+/**
+ * Counts the samples in each mask that are set in both planes of
+ * each pair by AND and popcount.
+ *
+ * @param a The first plane of each pair.
+ * @param b The second plane of each pair.
+ * @param num_pairs The number of pairs, at most COUNT_MAX_PAIRS.
+ * @param controls Bit i is set if sample i is counted in column 0.
+ * @param cases Bit i is set if sample i is counted in column 1.
+ * @param num_words The number of words in each plane and mask.
+ * @param isa The instruction set to use, must be supported.
+ * @param n The counts of each pair are added here.
+ */
+void count_planes(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                  const uint64_t *controls, const uint64_t *cases, size_t num_words,
+                  count_isa isa, unsigned int n[][ 2 ]);
+
+/**
+ * Counts the samples in a single mask that are set in both planes of
+ * each pair. This does half the work of count_planes, and is used when
+ * one of the columns has no samples, e.g. for case-only data.
+ *
+ * @param a The first plane of each pair.
+ * @param b The second plane of each pair.
+ * @param num_pairs The number of pairs, at most COUNT_MAX_PAIRS.
+ * @param mask Bit i is set if sample i is counted.
+ * @param num_words The number of words in each plane and the mask.
+ * @param isa The instruction set to use, must be supported.
+ * @param n The counts of each pair are added here.
+ */
+void count_planes_single(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                         const uint64_t *mask, size_t num_words, count_isa isa, unsigned int n[]);
+
+/**
+ * Largest number of masks that can be counted at once by
+ * count_planes_masks.
+ */
+const size_t COUNT_MAX_MASKS = 64;
+
+/**
+ * Counts the samples in each of a group of masks that are set in both
+ * planes of each pair. The masks are interleaved, word w of mask m is
+ * masks[ w * num_masks + m ], so that each word of a pair is combined
+ * with all masks while it is in a register. This is used to count a
+ * pair for many permutations of the phenotype in one pass.
+ *
+ * @param a The first plane of each pair.
+ * @param b The second plane of each pair.
+ * @param num_pairs The number of pairs, at most COUNT_MAX_PAIRS.
+ * @param masks The interleaved masks.
+ * @param num_masks The number of masks, at most COUNT_MAX_MASKS.
+ * @param num_words The number of words in each plane and mask.
+ * @param isa The instruction set to use, must be supported.
+ * @param n The count of pair k and mask m is added to n[ k * num_masks + m ].
+ */
+void count_planes_masks(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                        const uint64_t *masks, size_t num_masks, size_t num_words,
+                        count_isa isa, uint64_t *n);
+
+/**
+ * Sums per-sample values over the samples with each combination of
+ * genotypes. Column k of cell 3 * i + j is the sum of columns[ k ][ s ]
+ * over all samples s that have genotype i in the first snp and
+ * genotype j in the second.
+ *
+ * The vectorized kernels sum in a different order than the scalar
+ * kernel, so results agree up to rounding, and exactly when all
+ * partial sums are representable, e.g. for integer valued columns.
+ *
+ * @param p1 The planes of genotype 0, 1 and 2 of the first snp.
+ * @param p2 The planes of genotype 0, 1 and 2 of the second snp.
+ * @param columns The values of each sample for each column, each
+ *                padded with zeros to num_words * SNP_ROW_BITS_PER_WORD.
+ * @param num_columns The number of columns, 2 or 3.
+ * @param num_words The number of words in each plane.
+ * @param isa The instruction set to use, must be supported.
+ * @param sums The sums of each cell, stored as 9 rows of num_columns
+ *             values, are added here.
+ */
+void sum_planes(const uint64_t *const p1[ 3 ], const uint64_t *const p2[ 3 ],
+                const double *const *columns, size_t num_columns, size_t num_words,
+                count_isa isa, double *sums);
+
+#endif /* End of __COUNT_KERNELS_H__ */
@@ -14,13 +14,24 @@ ldirmult(const arma::vec &x, const arma::vec &alpha)
 {
     assert( x.n_elem == alpha.n_elem );
     
-    double alpha_sum = arma::sum( alpha );
-    double x_sum = arma::sum( x );
+    return ldirmult( x.memptr( ), alpha );
+}
+
+double
+ldirmult(const double *x, const arma::vec &alpha)
+{
+    double alpha_sum = 0.0;
+    double x_sum = 0.0;
+    for(int i = 0; i < alpha.n_elem; i++)
+    {
+        alpha_sum += alpha[ i ];
+        x_sum += x[ i ];
+    }
 
     double K = lgamma( alpha_sum ) - lgamma( x_sum + alpha_sum );
     double x_alpha = 0.0;
 
-    for(int i = 0; i < x.n_elem; i++)
+    for(int i = 0; i < alpha.n_elem; i++)
     {
         x_alpha += lgamma( x[ i ] + alpha[ i ] ) - lgamma( alpha[ i ] );
     }
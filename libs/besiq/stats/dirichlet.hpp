@@ -38,6 +38,18 @@ double dirmult(const arma::vec &x, const arma::vec &alpha);
  */
 double ldirmult(const arma::vec &x, const arma::vec &alpha);
 
+/**
+ * Computes the dirichlet multinomial log probability of
+ * observations stored in an array, so that cells of a count_table
+ * can be used without copying.
+ * 
+ * @param x The observations, one for each element of alpha.
+ * @param alpha The prior parameters of the dirichlet density.
+ *
+ * @return The log posterior probability of x.
+ */
+double ldirmult(const double *x, const arma::vec &alpha);
+
 /**
  * Computes the log of the binomial coefficient (n choose k).
  *
@@ -1,75 +1,100 @@
 #include <besiq/stats/normal_models.hpp>
 
-using namespace arma;
+/**
+ * Computes the residual sum of squares of a cell around its mean.
+ *
+ * @param sum The sum of the phenotypes in the cell.
+ * @param n The number of samples in the cell.
+ * @param sum_squares The sum of the squared phenotypes in the cell.
+ *
+ * @return The residual sum of squares.
+ */
+static double
+normal_cell_residual(double sum, double n, double sum_squares)
+{
+    double mu = sum / n;
+
+    return n * mu * mu - 2 * mu * sum + sum_squares;
+}
+
+/**
+ * Computes the log likelihood of a normal model given its residual
+ * sum of squares.
+ *
+ * @param residual The residual sum of squares.
+ * @param n The number of samples.
+ * @param k The number of mean parameters.
+ *
+ * @return The log likelihood.
+ */
+static double
+normal_loglikelihood(double residual, double n, double k)
+{
+    double sigma_square = residual / ( n - k );
+
+    return -(n/2)*log(2*arma::datum::pi) - (n/2)*log( sigma_square ) - 1/(2*sigma_square) * residual;
+}
 
 normal_full::normal_full()
-: closed_form_model::closed_form_model( 9 )
+: normal_model( 9 )
 {
 
 }
 
 log_double
-normal_full::prob(const arma::mat &count)
+normal_full::prob(const cont_table &count)
 {
-    arma::vec mu_full = count.col( 0 ) / count.col( 1 );
-    arma::vec residual = count.col( 1 ) % mu_full % mu_full - 2 * mu_full % count.col( 0 ) + count.col( 2 );
-    double k = 9;
-    double n = sum( count.col( 1 ) );
-    double sigma_square = sum( residual ) / ( n - k );
+    double residual = 0.0;
+    for(int i = 0; i < 9; i++)
+    {
+        residual += normal_cell_residual( count( i, 0 ), count( i, 1 ), count( i, 2 ) );
+    }
 
-    return log_double::from_log( -(n/2)*log(2*datum::pi) - (n/2)*log( sigma_square ) - 1/(2*sigma_square) * sum( residual ) );
+    return log_double::from_log( normal_loglikelihood( residual, count.sum( 1 ), 9 ) );
 }
 
 normal_null::normal_null()
-: closed_form_model::closed_form_model( 1 )
+: normal_model( 1 )
 {
 
 }
 
 log_double
-normal_null::prob(const arma::mat &count)
+normal_null::prob(const cont_table &count)
 {
-    double mu = sum( count.col( 0 ) ) / sum( count.col( 1 ) );
-    double residual = sum( count.col( 1 ) ) * mu * mu - 2 * mu * sum( count.col( 0 ) ) + sum( count.col( 2 ) );
-    double k = 1;
-    double n = sum( count.col( 1 ) );
-    double sigma_square = residual / ( n - k );
+    double residual = normal_cell_residual( count.sum( 0 ), count.sum( 1 ), count.sum( 2 ) );
 
-    return log_double::from_log( -(n/2)*log(2*datum::pi) - (n/2)*log( sigma_square ) - 1/(2*sigma_square) * residual );
+    return log_double::from_log( normal_loglikelihood( residual, count.sum( 1 ), 1 ) );
 }
 
 normal_single::normal_single(bool is_first)
-: closed_form_model::closed_form_model( 3 ),
+: normal_model( 3 ),
   m_is_first( is_first )
 {
 
 }
 
 log_double
-normal_single::prob(const arma::mat &count)
+normal_single::prob(const cont_table &count)
 {
-    arma::mat snp_pheno = zeros<mat>( 3, 3 );
+    double residual = 0.0;
     for(int i = 0; i < 3; i++)
     {
-        if( m_is_first )
+        double snp_pheno[ 3 ];
+        for(int k = 0; k < 3; k++)
         {
-            snp_pheno( i, 0 ) = count( 3*i, 0 ) + count( 3*i + 1, 0 ) + count( 3*i + 2, 0 );
-            snp_pheno( i, 1 ) = count( 3*i, 1 ) + count( 3*i + 1, 1 ) + count( 3*i + 2, 1 );
-            snp_pheno( i, 2 ) = count( 3*i, 2 ) + count( 3*i + 1, 2 ) + count( 3*i + 2, 2 );
-        }
-        else
-        {
-            snp_pheno( i, 0 ) = count( 3*0 + i, 0 ) + count( 3*1 + i, 0 ) + count( 3*2 + i, 0 );
-            snp_pheno( i, 1 ) = count( 3*0 + i, 1 ) + count( 3*1 + i, 1 ) + count( 3*2 + i, 1 );
-            snp_pheno( i, 2 ) = count( 3*0 + i, 2 ) + count( 3*1 + i, 2 ) + count( 3*2 + i, 2 );
+            if( m_is_first )
+            {
+                snp_pheno[ k ] = count( 3*i, k ) + count( 3*i + 1, k ) + count( 3*i + 2, k );
+            }
+            else
+            {
+                snp_pheno[ k ] = count( 3*0 + i, k ) + count( 3*1 + i, k ) + count( 3*2 + i, k );
+            }
         }
+
+        residual += normal_cell_residual( snp_pheno[ 0 ], snp_pheno[ 1 ], snp_pheno[ 2 ] );
     }
-    
-    arma::vec mu_single = snp_pheno.col( 0 ) / snp_pheno.col( 1 );
-    arma::vec residual = snp_pheno.col( 1 ) % mu_single % mu_single - 2 * mu_single % snp_pheno.col( 0 ) + snp_pheno.col( 2 );
-    double k = 3;
-    double n = sum( snp_pheno.col( 1 ) );
-    double sigma_square = sum( residual ) / ( n - k );
-
-    return log_double::from_log( -(n/2)*log(2*datum::pi) - (n/2)*log( sigma_square ) - 1/(2*sigma_square) * sum( residual ) );
+
+    return log_double::from_log( normal_loglikelihood( residual, count.sum( 1 ), 3 ) );
 }
@@ -11,7 +11,7 @@
  * that each cell in the table has it is own parameter.
  */
 class normal_full
-: public closed_form_model
+: public normal_model
 {
 public:
     /**
@@ -20,9 +20,9 @@ public:
     normal_full();
 
     /**
-     * @see closed_form_model::prob.
+     * @see normal_model::prob.
      */
-    virtual log_double prob(const arma::mat &count);
+    virtual log_double prob(const cont_table &count);
 };
 
 /**
@@ -30,7 +30,7 @@ public:
  * the phenotype. The snps may however be in ld.
  */
 class normal_null
-: public closed_form_model
+: public normal_model
 {
 public:
     /**
@@ -39,9 +39,9 @@ public:
     normal_null();
 
     /**
-     * @see closed_form_model::prob.
+     * @see normal_model::prob.
      */
-    virtual log_double prob(const arma::mat &count);
+    virtual log_double prob(const cont_table &count);
 };
 
 /**
@@ -49,7 +49,7 @@ public:
  * the phenotype, and the other possibly in ld with the first.
  */
 class normal_single
-: public closed_form_model
+: public normal_model
 {
 public:
     /**
@@ -60,9 +60,9 @@ public:
     normal_single(bool is_first);
 
     /**
-     * @see closed_form_model::prob.
+     * @see normal_model::prob.
      */
-    virtual log_double prob(const arma::mat &count);
+    virtual log_double prob(const cont_table &count);
 
 private:
     /**
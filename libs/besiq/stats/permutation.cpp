@@ -0,0 +1,133 @@
+#include <algorithm>
+
+#include <besiq/stats/dirichlet.hpp>
+#include <besiq/stats/permutation.hpp>
+
+/**
+ * Returns a uniformly distributed index below n. Taking the remainder
+ * of a draw would favour the small indices, so the draws at or above
+ * the largest multiple of n are rejected.
+ *
+ * @param rng The random generator, draws 32 bits.
+ * @param n The number of indices, at least 1.
+ *
+ * @return An index in [0, n).
+ */
+static size_t
+uniform_index(prg_type &rng, size_t n)
+{
+    const uint64_t range = 1ULL << 32;
+    const uint64_t limit = range - range % n;
+    uint64_t x;
+    do
+    {
+        x = rng( );
+    }
+    while( x >= limit );
+
+    return x % n;
+}
+
+permutation_engine::permutation_engine(const arma::vec &phenotype, const arma::uvec &missing, size_t num_permutations, unsigned long seed)
+    : m_isa( get_count_isa( ) ),
+      m_num_permutations( num_permutations )
+{
+    arma::vec present = arma::ones<arma::vec>( phenotype.n_elem );
+    for(size_t i = 0; i < missing.n_elem; i++)
+    {
+        if( missing[ i ] != 0 )
+        {
+            present[ i ] = 0.0;
+        }
+    }
+
+    pheno_mask mask;
+    make_pheno_mask( phenotype, present, mask );
+    m_num_words = mask.cases.size( );
+    m_samples.resize( m_num_words );
+    std::vector<size_t> samples;
+    std::vector<char> is_case;
+    for(size_t w = 0; w < m_num_words; w++)
+    {
+        m_samples[ w ] = mask.controls[ w ] | mask.cases[ w ];
+        for(size_t bit = 0; bit < SNP_ROW_BITS_PER_WORD; bit++)
+        {
+            if( ( m_samples[ w ] >> bit ) & 1 )
+            {
+                samples.push_back( w * SNP_ROW_BITS_PER_WORD + bit );
+                is_case.push_back( ( mask.cases[ w ] >> bit ) & 1 );
+            }
+        }
+    }
+
+    /* Each permutation shuffles the labels of the previous one, which
+     * is as random as shuffling the observed labels */
+    prg_type rng( seed );
+    for(size_t start = 0; start < m_num_permutations; start += PERMUTATION_BLOCK_SIZE)
+    {
+        size_t block_size = std::min( PERMUTATION_BLOCK_SIZE, m_num_permutations - start );
+        m_cases.push_back( std::vector<uint64_t>( m_num_words * block_size, 0 ) );
+        std::vector<uint64_t> &block = m_cases.back( );
+        for(size_t m = 0; m < block_size; m++)
+        {
+            for(size_t i = samples.size( ); i > 1; i--)
+            {
+                std::swap( is_case[ i - 1 ], is_case[ uniform_index( rng, i ) ] );
+            }
+
+            for(size_t i = 0; i < samples.size( ); i++)
+            {
+                if( is_case[ i ] )
+                {
+                    size_t w = samples[ i ] / SNP_ROW_BITS_PER_WORD;
+                    block[ w * block_size + m ] |= 1ULL << ( samples[ i ] % SNP_ROW_BITS_PER_WORD );
+                }
+            }
+        }
+    }
+}
+
+size_t
+permutation_engine::size() const
+{
+    return m_num_permutations;
+}
+
+void
+permutation_engine::count(const snp_row &row1, const snp_row &row2, binary_table *tables) const
+{
+    const uint64_t *a[ COUNT_TABLE_NUM_CELLS ];
+    const uint64_t *b[ COUNT_TABLE_NUM_CELLS ];
+    for(unsigned char i = 0; i < 3; i++)
+    {
+        for(unsigned char j = 0; j < 3; j++)
+        {
+            a[ 3 * i + j ] = row1.get_plane( i );
+            b[ 3 * i + j ] = row2.get_plane( j );
+        }
+    }
+
+    /* The samples in each cell do not depend on the permutation */
+    unsigned int total[ COUNT_TABLE_NUM_CELLS ] = { 0 };
+    count_planes_single( a, b, COUNT_TABLE_NUM_CELLS, &m_samples[ 0 ], m_num_words, m_isa, total );
+
+    uint64_t cases[ COUNT_TABLE_NUM_CELLS * PERMUTATION_BLOCK_SIZE ];
+    for(size_t k = 0; k < m_cases.size( ); k++)
+    {
+        size_t start = k * PERMUTATION_BLOCK_SIZE;
+        size_t block_size = std::min( PERMUTATION_BLOCK_SIZE, m_num_permutations - start );
+        std::fill( cases, cases + COUNT_TABLE_NUM_CELLS * block_size, 0 );
+        count_planes_masks( a, b, COUNT_TABLE_NUM_CELLS, &m_cases[ k ][ 0 ], block_size, m_num_words, m_isa, cases );
+
+        for(size_t m = 0; m < block_size; m++)
+        {
+            binary_table &table = tables[ start + m ];
+            for(size_t c = 0; c < COUNT_TABLE_NUM_CELLS; c++)
+            {
+                double num_cases = cases[ c * block_size + m ];
+                table( c, 0 ) = total[ c ] - num_cases;
+                table( c, 1 ) = num_cases;
+            }
+        }
+    }
+}
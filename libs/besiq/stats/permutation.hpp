@@ -0,0 +1,90 @@
+#ifndef __PERMUTATION_H__
+#define __PERMUTATION_H__
+
+#include <vector>
+
+#include <armadillo>
+
+#include <plink/snp_row.hpp>
+#include <besiq/stats/count_kernels.hpp>
+#include <besiq/stats/snp_count.hpp>
+
+/**
+ * Number of permutations whose case masks are stored together and
+ * counted in one pass over a pair.
+ */
+const size_t PERMUTATION_BLOCK_SIZE = COUNT_MAX_MASKS;
+
+/**
+ * Computes the binary tables of a pair for many permutations of
+ * a binary phenotype, for empirical and family-wise p-values.
+ *
+ * The case labels are permuted among the samples that are controls
+ * or cases, so the samples in each cell are the same as in the observed
+ * table and only the split into controls and cases changes. The case
+ * mask of each permutation is generated once and stored as a bit plane,
+ * interleaved with the other permutations of its block, so that each
+ * word of a cell is counted for a whole block of permutations while it
+ * is in a register.
+ */
+class permutation_engine
+{
+public:
+    /**
+     * Constructor, generates the permutations.
+     *
+     * @param phenotype The phenotype, 0.0 for controls and 1.0 for cases,
+     *                  other samples are not counted.
+     * @param missing Missing samples are indicated by non-zero values.
+     * @param num_permutations The number of permutations.
+     * @param seed The seed of the random generator, the permutations only
+     *             depend on the seed and the phenotype.
+     */
+    permutation_engine(const arma::vec &phenotype, const arma::uvec &missing, size_t num_permutations, unsigned long seed);
+
+    /**
+     * Returns the number of permutations.
+     *
+     * @return The number of permutations.
+     */
+    size_t size() const;
+
+    /**
+     * Counts the controls and cases of a pair for each permutation.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param tables The table of permutation i is stored in tables[ i ],
+     *               must have room for size( ) tables.
+     */
+    void count(const snp_row &row1, const snp_row &row2, binary_table *tables) const;
+
+private:
+    /**
+     * The instruction set that the tables are computed with.
+     */
+    count_isa m_isa;
+
+    /**
+     * The number of permutations.
+     */
+    size_t m_num_permutations;
+
+    /**
+     * The number of words in each mask.
+     */
+    size_t m_num_words;
+
+    /**
+     * Bit i is set if sample i is a control or a case.
+     */
+    std::vector<uint64_t> m_samples;
+
+    /**
+     * The case masks of each block of PERMUTATION_BLOCK_SIZE permutations,
+     * word w of permutation m is at w * block_size + m, see count_planes_masks.
+     */
+    std::vector< std::vector<uint64_t> > m_cases;
+};
+
+#endif /* End of __PERMUTATION_H__ */
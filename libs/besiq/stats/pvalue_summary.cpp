@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include <dcdflib/libdcdf.hpp>
+#include <besiq/stats/pvalue_summary.hpp>
+
+pvalue_summary::pvalue_summary()
+    : m_num_pairs( 0 ),
+      m_num_missing( 0 ),
+      m_num_invalid( 0 ),
+      m_num_skipped( 0 ),
+      m_bins( PVALUE_SUMMARY_NUM_FINE_BINS, 0 )
+{
+}
+
+void
+pvalue_summary::add(double statistic)
+{
+    m_num_pairs++;
+    if( statistic == -9 )
+    {
+        m_num_missing++;
+        return;
+    }
+
+    /* Also true for NaN */
+    if( !( statistic >= 0.0 && statistic <= 1.0 ) )
+    {
+        m_num_invalid++;
+        return;
+    }
+
+    size_t bin = std::min( (size_t) ( statistic * PVALUE_SUMMARY_NUM_FINE_BINS ), PVALUE_SUMMARY_NUM_FINE_BINS - 1 );
+    m_bins[ bin ]++;
+}
+
+void
+pvalue_summary::merge(const pvalue_summary &other)
+{
+    m_num_pairs += other.m_num_pairs;
+    m_num_missing += other.m_num_missing;
+    m_num_invalid += other.m_num_invalid;
+    m_num_skipped += other.m_num_skipped;
+    for(size_t i = 0; i < m_bins.size( ); i++)
+    {
+        m_bins[ i ] += other.m_bins[ i ];
+    }
+}
+
+void
+pvalue_summary::add_skipped(uint64_t num_skipped)
+{
+    m_num_skipped += num_skipped;
+}
+
+uint64_t
+pvalue_summary::num_skipped() const
+{
+    return m_num_skipped;
+}
+
+uint64_t
+pvalue_summary::num_pairs() const
+{
+    return m_num_pairs;
+}
+
+uint64_t
+pvalue_summary::num_tested() const
+{
+    return m_num_pairs - m_num_missing;
+}
+
+std::vector<uint64_t>
+pvalue_summary::get_histogram(size_t num_bins) const
+{
+    std::vector<uint64_t> histogram( num_bins, 0 );
+    size_t bins_per_bin = PVALUE_SUMMARY_NUM_FINE_BINS / num_bins;
+    for(size_t i = 0; i < m_bins.size( ); i++)
+    {
+        histogram[ i / bins_per_bin ] += m_bins[ i ];
+    }
+
+    return histogram;
+}
+
+double
+pvalue_summary::median() const
+{
+    uint64_t num_pvalues = num_tested( ) - m_num_invalid;
+    if( num_pvalues == 0 )
+    {
+        return -9;
+    }
+
+    double half = num_pvalues / 2.0;
+    uint64_t num_below = 0;
+    for(size_t i = 0; i < m_bins.size( ); i++)
+    {
+        if( num_below + m_bins[ i ] >= half && m_bins[ i ] > 0 )
+        {
+            double fraction = ( half - num_below ) / m_bins[ i ];
+            return ( i + fraction ) / PVALUE_SUMMARY_NUM_FINE_BINS;
+        }
+
+        num_below += m_bins[ i ];
+    }
+
+    return 1.0;
+}
+
+double
+pvalue_summary::lambda() const
+{
+    double median_p = median( );
+    if( median_p == -9 )
+    {
+        return -9;
+    }
+    if( median_p >= 1.0 )
+    {
+        return 0.0;
+    }
+
+    /* A chi-square distribution with 1 df is a gamma distribution with shape 1/2 and rate 1/2 */
+    double median_chi2 = gamma_cdf_inv( 1.0 - median_p, 0.5, 0.5 );
+    double expected_chi2 = gamma_cdf_inv( 0.5, 0.5, 0.5 );
+
+    return median_chi2 / expected_chi2;
+}
+
+void
+pvalue_summary::write(std::ostream &stream) const
+{
+    stream << "pairs\t" << num_pairs( ) << "\n";
+    stream << "tested\t" << num_tested( ) << "\n";
+    stream << "skipped\t" << num_skipped( ) << "\n";
+    stream << "median_p\t" << median( ) << "\n";
+    stream << "lambda\t" << lambda( ) << "\n";
+    stream << "\n";
+
+    stream << "p_lower\tp_upper\tcount\n";
+    std::vector<uint64_t> histogram = get_histogram( PVALUE_SUMMARY_NUM_BINS );
+    for(size_t i = 0; i < histogram.size( ); i++)
+    {
+        stream << i / (double) PVALUE_SUMMARY_NUM_BINS << "\t" << ( i + 1 ) / (double) PVALUE_SUMMARY_NUM_BINS << "\t" << histogram[ i ] << "\n";
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef __PVALUE_SUMMARY_H__
+#define __PVALUE_SUMMARY_H__
+
+#include <iostream>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * Number of bins in the p-value histogram that is written.
+ */
+const size_t PVALUE_SUMMARY_NUM_BINS = 20;
+
+/**
+ * Number of bins that p-values are counted in, the median is
+ * interpolated within one of these bins.
+ */
+const size_t PVALUE_SUMMARY_NUM_FINE_BINS = 10000;
+
+/**
+ * Summarizes the p-values of all tested pairs in constant memory,
+ * so that the distribution can be inspected without writing one
+ * record per pair. Summaries of different threads can be merged.
+ */
+class pvalue_summary
+{
+public:
+    /**
+     * Constructor.
+     */
+    pvalue_summary();
+
+    /**
+     * Adds the statistic of a pair.
+     *
+     * @param statistic A p-value, -9 if the pair could not be tested.
+     *                  Values outside [0, 1] are counted as tested but
+     *                  are not part of the histogram.
+     */
+    void add(double statistic);
+
+    /**
+     * Adds all pairs in another summary to this one.
+     *
+     * @param other The other summary.
+     */
+    void merge(const pvalue_summary &other);
+
+    /**
+     * Records pairs that were ruled out before they were tested,
+     * they must also have been added as untested pairs.
+     *
+     * @param num_skipped The number of skipped pairs.
+     */
+    void add_skipped(uint64_t num_skipped);
+
+    /**
+     * Returns the number of pairs that were ruled out before they
+     * were tested.
+     *
+     * @return The number of skipped pairs.
+     */
+    uint64_t num_skipped() const;
+
+    /**
+     * Returns the number of pairs that have been added.
+     *
+     * @return The number of pairs.
+     */
+    uint64_t num_pairs() const;
+
+    /**
+     * Returns the number of pairs that had a p-value.
+     *
+     * @return The number of tested pairs.
+     */
+    uint64_t num_tested() const;
+
+    /**
+     * Returns the number of p-values in each bin of the histogram,
+     * bin i contains p-values in [i / num_bins, (i + 1) / num_bins).
+     *
+     * @param num_bins The number of bins, must divide
+     *                 PVALUE_SUMMARY_NUM_FINE_BINS.
+     *
+     * @return The number of p-values in each bin.
+     */
+    std::vector<uint64_t> get_histogram(size_t num_bins = PVALUE_SUMMARY_NUM_BINS) const;
+
+    /**
+     * Returns the median p-value, interpolated within the bin
+     * that contains it.
+     *
+     * @return The median p-value, or -9 if there are no p-values.
+     */
+    double median() const;
+
+    /**
+     * Returns the genomic inflation factor, i.e. the median of the
+     * chi-square statistics that correspond to the p-values divided
+     * by the median of a chi-square distribution with 1 degree of freedom.
+     *
+     * @return The genomic inflation factor, or -9 if there are no p-values.
+     */
+    double lambda() const;
+
+    /**
+     * Writes the number of pairs, the inflation factor and the histogram.
+     *
+     * @param stream The output stream.
+     */
+    void write(std::ostream &stream) const;
+
+private:
+    /**
+     * Number of pairs that have been added.
+     */
+    uint64_t m_num_pairs;
+
+    /**
+     * Number of pairs without a p-value.
+     */
+    uint64_t m_num_missing;
+
+    /**
+     * Number of pairs with a statistic outside [0, 1].
+     */
+    uint64_t m_num_invalid;
+
+    /**
+     * Number of pairs that were ruled out before they were tested.
+     */
+    uint64_t m_num_skipped;
+
+    /**
+     * Number of p-values in each fine bin.
+     */
+    std::vector<uint64_t> m_bins;
+};
+
+#endif /* End of __PVALUE_SUMMARY_H__ */
@@ -2,6 +2,599 @@
 
 using namespace arma;
 
+/**
+ * Counts the number of set bits in a word.
+ *
+ * @param x A word.
+ *
+ * @return The number of set bits.
+ */
+static inline unsigned int
+popcount64(uint64_t x)
+{
+    return __builtin_popcountll( x );
+}
+
+bool
+make_pheno_mask(const arma::vec &phenotype, const arma::vec &weight, pheno_mask &mask)
+{
+    size_t num_words = ( phenotype.n_elem + SNP_ROW_BITS_PER_WORD - 1 ) / SNP_ROW_BITS_PER_WORD;
+    mask.controls.assign( num_words, 0 );
+    mask.cases.assign( num_words, 0 );
+
+    for(int i = 0; i < phenotype.n_elem; i++)
+    {
+        if( weight[ i ] == 0.0 )
+        {
+            continue;
+        }
+        else if( weight[ i ] != 1.0 )
+        {
+            return false;
+        }
+
+        uint64_t bit = 1ULL << ( i % SNP_ROW_BITS_PER_WORD );
+        if( phenotype[ i ] == 0.0 )
+        {
+            mask.controls[ i / SNP_ROW_BITS_PER_WORD ] |= bit;
+        }
+        else if( phenotype[ i ] == 1.0 )
+        {
+            mask.cases[ i / SNP_ROW_BITS_PER_WORD ] |= bit;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Returns true if any bit of a mask is set.
+ *
+ * @param mask The mask.
+ *
+ * @return True if the mask contains a sample, false otherwise.
+ */
+static bool
+has_samples(const std::vector<uint64_t> &mask)
+{
+    for(size_t w = 0; w < mask.size( ); w++)
+    {
+        if( mask[ w ] != 0 )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Returns the planes of genotype 0, 1 and 2 of a snp.
+ *
+ * @param row The snp.
+ * @param planes The planes will be stored here.
+ */
+static void
+get_planes(const snp_row &row, const uint64_t *planes[ 3 ])
+{
+    for(unsigned char g = 0; g < 3; g++)
+    {
+        planes[ g ] = row.get_plane( g );
+    }
+}
+
+/**
+ * Returns the pairs of planes of the cells 3 * i + j, i.e. plane i
+ * of the first snp and plane j of the second.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param a The plane of the first snp of each cell will be stored here.
+ * @param b The plane of the second snp of each cell will be stored here.
+ */
+static void
+get_cell_planes(const snp_row &row1, const snp_row &row2, const uint64_t *a[ 9 ], const uint64_t *b[ 9 ])
+{
+    for(unsigned char i = 0; i < 3; i++)
+    {
+        for(unsigned char j = 0; j < 3; j++)
+        {
+            a[ 3 * i + j ] = row1.get_plane( i );
+            b[ 3 * i + j ] = row2.get_plane( j );
+        }
+    }
+}
+
+arma::mat
+joint_count(const snp_row &row1, const snp_row &row2, const pheno_mask &mask)
+{
+    const uint64_t *a[ 9 ];
+    const uint64_t *b[ 9 ];
+    get_cell_planes( row1, row2, a, b );
+
+    unsigned int n[ 9 ][ 2 ] = { { 0 } };
+    count_planes( a, b, 9, &mask.controls[ 0 ], &mask.cases[ 0 ], row1.num_words( ), get_count_isa( ), n );
+
+    arma::mat counts( 9, 2 );
+    for(int i = 0; i < 9; i++)
+    {
+        counts( i, 0 ) = n[ i ][ 0 ];
+        counts( i, 1 ) = n[ i ][ 1 ];
+    }
+
+    return counts;
+}
+
+count_engine::count_engine()
+    : m_isa( get_count_isa( ) ),
+      m_unit_weights( true ),
+      m_single_column( -1 )
+{
+}
+
+count_engine::count_engine(const arma::vec &phenotype, const arma::uvec &missing)
+    : m_isa( get_count_isa( ) )
+{
+    init( phenotype, missing, arma::ones<arma::vec>( phenotype.n_elem ) );
+}
+
+count_engine::count_engine(const arma::vec &phenotype, const arma::uvec &missing, const arma::vec &weight)
+    : m_isa( get_count_isa( ) )
+{
+    init( phenotype, missing, weight );
+}
+
+void
+count_engine::init(const arma::vec &phenotype, const arma::uvec &missing, const arma::vec &weight)
+{
+    arma::vec present_weight = weight;
+    for(size_t i = 0; i < missing.n_elem; i++)
+    {
+        if( missing[ i ] != 0 )
+        {
+            present_weight[ i ] = 0.0;
+        }
+    }
+
+    m_unit_weights = make_pheno_mask( phenotype, present_weight, m_mask );
+
+    bool has_controls = has_samples( m_mask.controls );
+    bool has_cases = has_samples( m_mask.cases );
+    m_single_column = -1;
+    if( has_controls != has_cases )
+    {
+        m_single_column = has_cases ? 1 : 0;
+    }
+
+    /* Padded to whole words so that the kernels can read full vectors */
+    size_t num_padded = m_mask.cases.size( ) * SNP_ROW_BITS_PER_WORD;
+    m_control_weight.assign( num_padded, 0.0 );
+    m_case_weight.assign( num_padded, 0.0 );
+    m_weight.assign( num_padded, 0.0 );
+    m_weighted_pheno.assign( num_padded, 0.0 );
+    m_weighted_sq.assign( num_padded, 0.0 );
+    m_samples.assign( m_mask.cases.size( ), 0 );
+    for(size_t i = 0; i < phenotype.n_elem; i++)
+    {
+        double w = present_weight[ i ];
+        if( w == 0.0 )
+        {
+            continue;
+        }
+
+        m_samples[ i / SNP_ROW_BITS_PER_WORD ] |= 1ULL << ( i % SNP_ROW_BITS_PER_WORD );
+        m_control_weight[ i ] = phenotype[ i ] == 0.0 ? w : 0.0;
+        m_case_weight[ i ] = phenotype[ i ] == 1.0 ? w : 0.0;
+        m_weight[ i ] = w;
+        m_weighted_pheno[ i ] = w * phenotype[ i ];
+        m_weighted_sq[ i ] = w * phenotype[ i ] * phenotype[ i ];
+    }
+}
+
+void
+count_engine::count_pairs(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                          size_t num_words, unsigned int n[][ 2 ]) const
+{
+    if( m_single_column < 0 )
+    {
+        count_planes( a, b, num_pairs, &m_mask.controls[ 0 ], &m_mask.cases[ 0 ], num_words, m_isa, n );
+        return;
+    }
+
+    /* The other column is zero, so only half of the popcounts are needed */
+    const uint64_t *mask = m_single_column == 0 ? &m_mask.controls[ 0 ] : &m_mask.cases[ 0 ];
+    unsigned int single[ COUNT_MAX_PAIRS ] = { 0 };
+    count_planes_single( a, b, num_pairs, mask, num_words, m_isa, single );
+    for(size_t k = 0; k < num_pairs; k++)
+    {
+        n[ k ][ m_single_column ] += single[ k ];
+    }
+}
+
+bool
+count_engine::has_unit_weights() const
+{
+    return m_unit_weights;
+}
+
+count_isa
+count_engine::get_isa() const
+{
+    return m_isa;
+}
+
+bool
+count_engine::set_isa(count_isa isa)
+{
+    if( !is_count_isa_supported( isa ) )
+    {
+        return false;
+    }
+
+    m_isa = isa;
+    return true;
+}
+
+void
+count_engine::set_genotypes(const genotype_matrix_ptr &genotypes)
+{
+    m_genotypes = genotype_matrix_ptr( );
+    m_marginals = class_counts_ptr( );
+    if( !m_unit_weights || genotypes.get( ) == NULL || genotypes->size( ) == 0 )
+    {
+        return;
+    }
+
+    std::vector< std::vector<uint64_t> > masks;
+    masks.push_back( m_mask.controls );
+    masks.push_back( m_mask.cases );
+    masks.push_back( m_samples );
+
+    m_genotypes = genotypes;
+    m_marginals = genotypes->get_class_counts( masks );
+}
+
+const snp_marginal *
+count_engine::find_marginal(const snp_row &row) const
+{
+    if( m_marginals.get( ) == NULL )
+    {
+        return NULL;
+    }
+
+    size_t index = m_genotypes->get_index( row );
+    if( index == GENOTYPE_MISSING_INDEX )
+    {
+        return NULL;
+    }
+
+    return &( *m_marginals )[ index ];
+}
+
+double
+count_engine::count_present(const snp_row &row1, const snp_row &row2, const snp_marginal &marginal1,
+                            const snp_marginal &marginal2, size_t column) const
+{
+    double total = 0.0;
+    for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
+    {
+        total += marginal1.n[ g ][ column ];
+    }
+
+    double missing_both = 0.0;
+    if( marginal1.n[ 3 ][ column ] > 0 && marginal2.n[ 3 ][ column ] > 0 )
+    {
+        const uint64_t *masks[ 3 ] = { &m_mask.controls[ 0 ], &m_mask.cases[ 0 ], &m_samples[ 0 ] };
+        const uint64_t *missing1 = row1.get_plane( 3 );
+        const uint64_t *missing2 = row2.get_plane( 3 );
+        for(size_t w = 0; w < row1.num_words( ); w++)
+        {
+            missing_both += popcount64( missing1[ w ] & missing2[ w ] & masks[ column ][ w ] );
+        }
+    }
+
+    return total - marginal1.n[ 3 ][ column ] - marginal2.n[ 3 ][ column ] + missing_both;
+}
+
+bool
+count_engine::bound(const snp_row &row1, const snp_row &row2, binary_table &upper, double &num_samples) const
+{
+    const snp_marginal *marginal1 = find_marginal( row1 );
+    const snp_marginal *marginal2 = find_marginal( row2 );
+    if( marginal1 == NULL || marginal2 == NULL )
+    {
+        return false;
+    }
+
+    for(int c = 0; c < 2; c++)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                upper( 3 * i + j, c ) = std::min( marginal1->n[ i ][ c ], marginal2->n[ j ][ c ] );
+            }
+        }
+    }
+    num_samples = count_present( row1, row2, *marginal1, *marginal2, 0 ) +
+                  count_present( row1, row2, *marginal1, *marginal2, 1 );
+
+    return true;
+}
+
+bool
+count_engine::bound(const snp_row &row1, const snp_row &row2, size_table &upper, double &num_samples) const
+{
+    const snp_marginal *marginal1 = find_marginal( row1 );
+    const snp_marginal *marginal2 = find_marginal( row2 );
+    if( marginal1 == NULL || marginal2 == NULL )
+    {
+        return false;
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            upper( 3 * i + j, 0 ) = std::min( marginal1->n[ i ][ 2 ], marginal2->n[ j ][ 2 ] );
+        }
+    }
+    num_samples = count_present( row1, row2, *marginal1, *marginal2, 2 );
+
+    return true;
+}
+
+/**
+ * Returns true if a row has controls or cases with a missing genotype.
+ *
+ * @param marginal The marginals of the row.
+ *
+ * @return True if the row has missing genotypes.
+ */
+static bool
+has_missing(const snp_marginal &marginal)
+{
+    return marginal.n[ 3 ][ 0 ] + marginal.n[ 3 ][ 1 ] > 0;
+}
+
+/**
+ * Returns the number of plane pairs that are counted to derive a
+ * binary table from the marginals, see get_interior_pairs.
+ *
+ * @param marginal1 The marginals of the first snp.
+ * @param marginal2 The marginals of the second snp.
+ *
+ * @return The number of plane pairs.
+ */
+static size_t
+num_interior_pairs(const snp_marginal &marginal1, const snp_marginal &marginal2)
+{
+    bool missing1 = has_missing( marginal1 );
+    bool missing2 = has_missing( marginal2 );
+
+    return 4 + 2 * missing2 + 2 * missing1 + ( missing1 && missing2 );
+}
+
+/**
+ * Returns the plane pairs that are counted to derive a binary table
+ * from the marginals. The interior cells 11, 12, 21, 22 come first,
+ * followed by the genotypes that are paired with a missing genotype.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param marginal1 The marginals of the first snp.
+ * @param marginal2 The marginals of the second snp.
+ * @param a The plane of the first snp of each pair will be stored here.
+ * @param b The plane of the second snp of each pair will be stored here.
+ *
+ * @return The number of plane pairs.
+ */
+static size_t
+get_interior_pairs(const snp_row &row1, const snp_row &row2, const snp_marginal &marginal1,
+                   const snp_marginal &marginal2, const uint64_t **a, const uint64_t **b)
+{
+    bool missing1 = has_missing( marginal1 );
+    bool missing2 = has_missing( marginal2 );
+
+    size_t num_pairs = 0;
+    for(unsigned char i = 1; i <= 2; i++)
+    {
+        for(unsigned char j = 1; j <= 2; j++)
+        {
+            a[ num_pairs ] = row1.get_plane( i );
+            b[ num_pairs ] = row2.get_plane( j );
+            num_pairs++;
+        }
+    }
+
+    if( missing2 )
+    {
+        for(unsigned char i = 1; i <= 2; i++)
+        {
+            a[ num_pairs ] = row1.get_plane( i );
+            b[ num_pairs ] = row2.get_plane( 3 );
+            num_pairs++;
+        }
+    }
+
+    if( missing1 )
+    {
+        for(unsigned char j = 1; j <= 2; j++)
+        {
+            a[ num_pairs ] = row1.get_plane( 3 );
+            b[ num_pairs ] = row2.get_plane( j );
+            num_pairs++;
+        }
+    }
+
+    if( missing1 && missing2 )
+    {
+        a[ num_pairs ] = row1.get_plane( 3 );
+        b[ num_pairs ] = row2.get_plane( 3 );
+        num_pairs++;
+    }
+
+    return num_pairs;
+}
+
+/**
+ * Derives a binary table from the counts of the plane pairs given by
+ * get_interior_pairs and the marginals of both snps.
+ *
+ * @param n The counts of each plane pair.
+ * @param marginal1 The marginals of the first snp.
+ * @param marginal2 The marginals of the second snp.
+ * @param table The counts will be stored here.
+ */
+static void
+derive_interior(const unsigned int n[][ 2 ], const snp_marginal &marginal1, const snp_marginal &marginal2,
+                binary_table &table)
+{
+    bool missing1 = has_missing( marginal1 );
+    bool missing2 = has_missing( marginal2 );
+    size_t missing2_index = 4;
+    size_t missing1_index = missing2_index + 2 * missing2;
+    size_t both_index = missing1_index + 2 * missing1;
+
+    for(int c = 0; c < 2; c++)
+    {
+        double n11 = n[ 0 ][ c ];
+        double n12 = n[ 1 ][ c ];
+        double n21 = n[ 2 ][ c ];
+        double n22 = n[ 3 ][ c ];
+        double n1_missing = missing2 ? n[ missing2_index ][ c ] : 0.0;
+        double n2_missing = missing2 ? n[ missing2_index + 1 ][ c ] : 0.0;
+        double missing_n1 = missing1 ? n[ missing1_index ][ c ] : 0.0;
+        double missing_n2 = missing1 ? n[ missing1_index + 1 ][ c ] : 0.0;
+        double missing_both = missing1 && missing2 ? n[ both_index ][ c ] : 0.0;
+
+        table( 4, c ) = n11;
+        table( 5, c ) = n12;
+        table( 7, c ) = n21;
+        table( 8, c ) = n22;
+        table( 3, c ) = marginal1.n[ 1 ][ c ] - n11 - n12 - n1_missing;
+        table( 6, c ) = marginal1.n[ 2 ][ c ] - n21 - n22 - n2_missing;
+        table( 1, c ) = marginal2.n[ 1 ][ c ] - n11 - n21 - missing_n1;
+        table( 2, c ) = marginal2.n[ 2 ][ c ] - n12 - n22 - missing_n2;
+
+        /* Samples with genotype 0 in the first snp that are missing in the second */
+        double n0_missing = marginal2.n[ 3 ][ c ] - n1_missing - n2_missing - missing_both;
+        table( 0, c ) = marginal1.n[ 0 ][ c ] - table( 1, c ) - table( 2, c ) - n0_missing;
+    }
+}
+
+void
+count_engine::count_interior(const snp_row &row1, const snp_row &row2, const snp_marginal &marginal1,
+                             const snp_marginal &marginal2, binary_table &table) const
+{
+    const uint64_t *a[ COUNT_MAX_PAIRS ];
+    const uint64_t *b[ COUNT_MAX_PAIRS ];
+    size_t num_pairs = get_interior_pairs( row1, row2, marginal1, marginal2, a, b );
+
+    unsigned int n[ COUNT_MAX_PAIRS ][ 2 ] = { { 0 } };
+    count_pairs( a, b, num_pairs, row1.num_words( ), n );
+
+    derive_interior( n, marginal1, marginal2, table );
+}
+
+void
+count_engine::count(const snp_row &row1, const snp_row &row2, binary_table &table) const
+{
+    table.clear( );
+    if( m_unit_weights )
+    {
+        const snp_marginal *marginal1 = find_marginal( row1 );
+        const snp_marginal *marginal2 = find_marginal( row2 );
+        if( marginal1 != NULL && marginal2 != NULL )
+        {
+            count_interior( row1, row2, *marginal1, *marginal2, table );
+            return;
+        }
+
+        const uint64_t *a[ 9 ];
+        const uint64_t *b[ 9 ];
+        get_cell_planes( row1, row2, a, b );
+
+        unsigned int n[ 9 ][ 2 ] = { { 0 } };
+        count_pairs( a, b, 9, row1.num_words( ), n );
+
+        for(int i = 0; i < 9; i++)
+        {
+            table( i, 0 ) = n[ i ][ 0 ];
+            table( i, 1 ) = n[ i ][ 1 ];
+        }
+    }
+    else
+    {
+        const uint64_t *p1[ 3 ];
+        const uint64_t *p2[ 3 ];
+        get_planes( row1, p1 );
+        get_planes( row2, p2 );
+
+        const double *columns[ 2 ] = { &m_control_weight[ 0 ], &m_case_weight[ 0 ] };
+        sum_planes( p1, p2, columns, 2, row1.num_words( ), m_isa, &table.n[ 0 ][ 0 ] );
+    }
+}
+
+void
+count_engine::count(const snp_row &row1, const snp_row *const *rows2, size_t n, binary_table *tables) const
+{
+    const snp_marginal *marginal1 = m_unit_weights ? find_marginal( row1 ) : NULL;
+    size_t k = 0;
+    while( k < n )
+    {
+        const snp_marginal *marginal2 = marginal1 != NULL ? find_marginal( *rows2[ k ] ) : NULL;
+        if( marginal2 == NULL )
+        {
+            count( row1, *rows2[ k ], tables[ k ] );
+            k++;
+            continue;
+        }
+
+        /* The next table is counted in the same call if its plane pairs
+         * fit, so that the planes of row1 and the masks are read once */
+        const uint64_t *a[ COUNT_MAX_PAIRS ];
+        const uint64_t *b[ COUNT_MAX_PAIRS ];
+        size_t num_first = get_interior_pairs( row1, *rows2[ k ], *marginal1, *marginal2, a, b );
+        size_t num_pairs = num_first;
+        const snp_marginal *next_marginal = k + 1 < n ? find_marginal( *rows2[ k + 1 ] ) : NULL;
+        if( next_marginal != NULL && num_first + num_interior_pairs( *marginal1, *next_marginal ) <= COUNT_MAX_PAIRS )
+        {
+            num_pairs += get_interior_pairs( row1, *rows2[ k + 1 ], *marginal1, *next_marginal, a + num_first, b + num_first );
+        }
+        else
+        {
+            next_marginal = NULL;
+        }
+
+        unsigned int counts[ COUNT_MAX_PAIRS ][ 2 ] = { { 0 } };
+        count_pairs( a, b, num_pairs, row1.num_words( ), counts );
+
+        tables[ k ].clear( );
+        derive_interior( counts, *marginal1, *marginal2, tables[ k ] );
+        k++;
+        if( next_marginal != NULL )
+        {
+            tables[ k ].clear( );
+            derive_interior( counts + num_first, *marginal1, *next_marginal, tables[ k ] );
+            k++;
+        }
+    }
+}
+
+void
+count_engine::count(const snp_row &row1, const snp_row &row2, cont_table &table) const
+{
+    const uint64_t *p1[ 3 ];
+    const uint64_t *p2[ 3 ];
+    get_planes( row1, p1 );
+    get_planes( row2, p2 );
+
+    table.clear( );
+    const double *columns[ 3 ] = { &m_weighted_pheno[ 0 ], &m_weight[ 0 ], &m_weighted_sq[ 0 ] };
+    sum_planes( p1, p2, columns, 3, row1.num_words( ), m_isa, &table.n[ 0 ][ 0 ] );
+}
+
 arma::mat
 joint_count(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
 {
@@ -39,13 +632,20 @@ joint_count_cont(const snp_row &row1, const snp_row &row2, const arma::vec &phen
 arma::vec
 joint_count(const snp_row &row1, const snp_row &row2)
 {
+    /* XXX: Should we have a weight here? */
     arma::vec counts = zeros<vec>( 9 );
-    for(int i = 0; i < row1.size( ); i++)
+    for(int i = 0; i < 3; i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 )
+        const uint64_t *a = row1.get_plane( i );
+        for(int j = 0; j < 3; j++)
         {
-            /* XXX: Should we have a weight here? */
-            counts[ 3 * row1[ i ] + row2[ i ] ] += 1.0;
+            const uint64_t *b = row2.get_plane( j );
+            unsigned int n = 0;
+            for(size_t w = 0; w < row1.num_words( ); w++)
+            {
+                n += popcount64( a[ w ] & b[ w ] );
+            }
+            counts[ 3 * i + j ] = n;
         }
     }
 
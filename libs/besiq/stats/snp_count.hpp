@@ -1,9 +1,430 @@
 #ifndef __SNP_COUNT_H__
 #define __SNP_COUNT_H__
 
+#include <algorithm>
+#include <vector>
+
 #include <armadillo>
 
+#include <plink/plink_file.hpp>
 #include <plink/snp_row.hpp>
+#include <shared_ptr/shared_ptr.hpp>
+#include <besiq/stats/count_kernels.hpp>
+
+/**
+ * Bitmasks over the samples that indicate which samples are
+ * controls and cases, laid out like the bit planes in snp_row.
+ * Samples that are missing or have zero weight are in neither.
+ */
+struct pheno_mask
+{
+    /**
+     * Bit i is set if sample i is a control.
+     */
+    std::vector<uint64_t> controls;
+
+    /**
+     * Bit i is set if sample i is a case.
+     */
+    std::vector<uint64_t> cases;
+};
+
+/**
+ * Number of controls (column 0), cases (column 1) and all counted
+ * samples (column 2) with each genotype 0, 1, 2 and 3 (missing) of
+ * a single snp, see genotype_matrix::get_class_counts.
+ */
+typedef genotype_class_counts snp_marginal;
+
+/**
+ * Number of cells in a contingency table of two snps.
+ */
+const size_t COUNT_TABLE_NUM_CELLS = 9;
+
+/**
+ * A contingency table of two snps with a fixed number of columns,
+ * so that it can be stored on the stack. Each row is a cell
+ * 3 * snp1 + snp2, i.e. ordered from left to right and top to bottom.
+ */
+template<size_t NUM_COLUMNS>
+struct count_table
+{
+    /**
+     * The number of columns of each cell.
+     */
+    static const size_t num_columns = NUM_COLUMNS;
+
+    /**
+     * The values of each cell.
+     */
+    double n[ COUNT_TABLE_NUM_CELLS ][ NUM_COLUMNS ];
+
+    /**
+     * Returns the value of a column in a cell.
+     *
+     * @param cell The cell 3 * snp1 + snp2.
+     * @param column The column.
+     *
+     * @return The value.
+     */
+    double &operator()(size_t cell, size_t column)
+    {
+        return n[ cell ][ column ];
+    }
+
+    const double &operator()(size_t cell, size_t column) const
+    {
+        return n[ cell ][ column ];
+    }
+
+    /**
+     * Sets all values to zero.
+     */
+    void clear()
+    {
+        for(size_t i = 0; i < COUNT_TABLE_NUM_CELLS; i++)
+        {
+            for(size_t j = 0; j < NUM_COLUMNS; j++)
+            {
+                n[ i ][ j ] = 0.0;
+            }
+        }
+    }
+
+    /**
+     * Returns the sum of a column over all cells.
+     *
+     * @param column The column.
+     *
+     * @return The sum of the column.
+     */
+    double sum(size_t column) const
+    {
+        double total = 0.0;
+        for(size_t i = 0; i < COUNT_TABLE_NUM_CELLS; i++)
+        {
+            total += n[ i ][ column ];
+        }
+
+        return total;
+    }
+
+    /**
+     * Returns the smallest value of a column.
+     *
+     * @param column The column.
+     *
+     * @return The smallest value of the column.
+     */
+    double min(size_t column) const
+    {
+        double smallest = n[ 0 ][ column ];
+        for(size_t i = 1; i < COUNT_TABLE_NUM_CELLS; i++)
+        {
+            smallest = std::min( smallest, n[ i ][ column ] );
+        }
+
+        return smallest;
+    }
+
+    /**
+     * Returns the smallest value in the table.
+     *
+     * @return The smallest value in the table.
+     */
+    double min() const
+    {
+        double smallest = min( 0 );
+        for(size_t j = 1; j < NUM_COLUMNS; j++)
+        {
+            smallest = std::min( smallest, min( j ) );
+        }
+
+        return smallest;
+    }
+};
+
+/**
+ * Counts of controls (column 0) and cases (column 1) for each cell.
+ */
+typedef count_table<2> binary_table;
+
+/**
+ * Sum of phenotypes (column 0), number of samples (column 1) and sum
+ * of squared phenotypes (column 2) for each cell.
+ */
+typedef count_table<3> cont_table;
+
+/**
+ * Number of samples (column 0) for each cell.
+ */
+typedef count_table<1> size_table;
+
+/**
+ * Fills the contingency tables of snp pairs for a fixed phenotype,
+ * so that all count-based methods treat missing samples, weights and
+ * phenotypes in the same way. The tables are computed from the bit
+ * planes of the snps with the kernels of the instruction set that
+ * was detected at startup. When all weights are 0 or 1 binary tables
+ * are computed by popcount, otherwise the weights of the samples in
+ * each cell are summed.
+ */
+class count_engine
+{
+public:
+    /**
+     * Constructor for an engine without samples.
+     */
+    count_engine();
+
+    /**
+     * Constructor.
+     *
+     * @param phenotype The phenotype, 0.0 or 1.0 for binary tables.
+     * @param missing Missing samples are indicated by non-zero values.
+     */
+    count_engine(const arma::vec &phenotype, const arma::uvec &missing);
+
+    /**
+     * Constructor.
+     *
+     * @param phenotype The phenotype, 0.0 or 1.0 for binary tables.
+     * @param missing Missing samples are indicated by non-zero values.
+     * @param weight The weight of each sample, so that a sample with
+     *               weight 0.5 is counted as 0.5 instead of 1.0.
+     */
+    count_engine(const arma::vec &phenotype, const arma::uvec &missing, const arma::vec &weight);
+
+    /**
+     * Returns true if all non-missing samples have weight 1, so that
+     * tables are computed by popcount.
+     *
+     * @return True if all non-missing samples have weight 1.
+     */
+    bool has_unit_weights() const;
+
+    /**
+     * Returns the instruction set that the tables are computed with.
+     *
+     * @return The instruction set.
+     */
+    count_isa get_isa() const;
+
+    /**
+     * Selects the instruction set that the tables are computed with,
+     * all instruction sets give the same tables up to rounding.
+     *
+     * @param isa The instruction set.
+     *
+     * @return False if the cpu does not support isa, in which case
+     *         the current instruction set is kept.
+     */
+    bool set_isa(count_isa isa);
+
+    /**
+     * Uses the number of cases and controls with each genotype of the
+     * rows of a genotype matrix, which are computed once by the matrix
+     * and shared by all engines with the same phenotype. Binary tables
+     * of two rows of the matrix are then derived from the 4 cells where
+     * both genotypes are 1 or 2, the marginals, and the samples that
+     * are missing in only one of the rows, which are only counted for
+     * rows that have missing genotypes. Only used when all weights are
+     * 0 or 1, other rows are counted as before.
+     *
+     * @param genotypes The genotype matrix.
+     */
+    void set_genotypes(const genotype_matrix_ptr &genotypes);
+
+    /**
+     * Bounds each cell of the binary table of two rows of the matrix
+     * given to set_genotypes by the smaller of the two marginals,
+     * without counting.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param upper The upper bound of each cell will be stored here.
+     * @param num_samples The exact number of samples in the table will
+     *                    be stored here.
+     *
+     * @return False if either row has no marginals, in which case
+     *         nothing is stored.
+     */
+    bool bound(const snp_row &row1, const snp_row &row2, binary_table &upper, double &num_samples) const;
+
+    /**
+     * Bounds the number of samples in each cell of the continuous
+     * table of two rows of the matrix given to set_genotypes, without
+     * counting.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param upper The upper bound of each cell will be stored here.
+     * @param num_samples The exact number of samples in the table will
+     *                    be stored here.
+     *
+     * @return False if either row has no marginals, in which case
+     *         nothing is stored.
+     */
+    bool bound(const snp_row &row1, const snp_row &row2, size_table &upper, double &num_samples) const;
+
+    /**
+     * Counts the number of cases and controls with each genotype,
+     * samples with a phenotype other than 0.0 or 1.0 are ignored.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param table The counts will be stored here.
+     */
+    void count(const snp_row &row1, const snp_row &row2, binary_table &table) const;
+
+    /**
+     * Counts the binary tables of one snp against several others.
+     * When the tables are derived from the marginals, two tables are
+     * counted in one call of the kernel if their plane pairs fit, so
+     * that the planes of the first snp and the masks are read once.
+     *
+     * @param row1 The first snp.
+     * @param rows2 The second snp of each table.
+     * @param n The number of tables.
+     * @param tables The counts of each table will be stored here.
+     */
+    void count(const snp_row &row1, const snp_row *const *rows2, size_t n, binary_table *tables) const;
+
+    /**
+     * Aggregates the phenotype for each genotype.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param table The sums will be stored here.
+     */
+    void count(const snp_row &row1, const snp_row &row2, cont_table &table) const;
+
+private:
+    /**
+     * Initializes the weights and masks.
+     *
+     * @param phenotype The phenotype.
+     * @param missing Missing samples are indicated by non-zero values.
+     * @param weight The weight of each sample.
+     */
+    void init(const arma::vec &phenotype, const arma::uvec &missing, const arma::vec &weight);
+
+    /**
+     * Counts the controls and cases set in both planes of each pair,
+     * only counts the populated column if the other has no samples.
+     *
+     * @param a The first plane of each pair.
+     * @param b The second plane of each pair.
+     * @param num_pairs The number of pairs, at most COUNT_MAX_PAIRS.
+     * @param num_words The number of words in each plane.
+     * @param n The counts of each pair are added here.
+     */
+    void count_pairs(const uint64_t *const *a, const uint64_t *const *b, size_t num_pairs,
+                     size_t num_words, unsigned int n[][ 2 ]) const;
+
+    /**
+     * Returns the marginals of a row of the matrix given to
+     * set_genotypes.
+     *
+     * @param row The row.
+     *
+     * @return The marginals of the row, or NULL if the row is
+     *         not stored in the matrix.
+     */
+    const snp_marginal *find_marginal(const snp_row &row) const;
+
+    /**
+     * Derives a binary table from the marginals of both rows,
+     * see set_genotypes.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param marginal1 The marginals of the first snp.
+     * @param marginal2 The marginals of the second snp.
+     * @param table The counts will be stored here.
+     */
+    void count_interior(const snp_row &row1, const snp_row &row2, const snp_marginal &marginal1,
+                        const snp_marginal &marginal2, binary_table &table) const;
+
+    /**
+     * Returns the number of samples in a column of the marginals that
+     * are not missing in either row, only counts the samples that are
+     * missing in both rows if both rows have missing genotypes.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param marginal1 The marginals of the first snp.
+     * @param marginal2 The marginals of the second snp.
+     * @param column The column of the marginals.
+     *
+     * @return The number of samples.
+     */
+    double count_present(const snp_row &row1, const snp_row &row2, const snp_marginal &marginal1,
+                         const snp_marginal &marginal2, size_t column) const;
+
+    /**
+     * The instruction set that the tables are computed with.
+     */
+    count_isa m_isa;
+
+    /**
+     * True if all weights are 0 or 1.
+     */
+    bool m_unit_weights;
+
+    /**
+     * Case and control masks, only valid if m_unit_weights.
+     */
+    pheno_mask m_mask;
+
+    /**
+     * The only column of the binary tables that has samples, or -1 if
+     * both controls and cases are present, only valid if m_unit_weights.
+     */
+    int m_single_column;
+
+    /**
+     * Bit i is set if sample i is a control or a case or has another
+     * phenotype, only valid if m_unit_weights.
+     */
+    std::vector<uint64_t> m_samples;
+
+    /**
+     * The weight of each control, 0 for other samples.
+     */
+    std::vector<double> m_control_weight;
+
+    /**
+     * The weight of each case, 0 for other samples.
+     */
+    std::vector<double> m_case_weight;
+
+    /**
+     * The weight of each sample, 0 for missing samples.
+     */
+    std::vector<double> m_weight;
+
+    /**
+     * The weight times the phenotype of each sample.
+     */
+    std::vector<double> m_weighted_pheno;
+
+    /**
+     * The weight times the squared phenotype of each sample.
+     */
+    std::vector<double> m_weighted_sq;
+
+    /**
+     * The matrix given to set_genotypes.
+     */
+    genotype_matrix_ptr m_genotypes;
+
+    /**
+     * The marginals of each row of m_genotypes by index, shared
+     * between copies of the engine.
+     */
+    class_counts_ptr m_marginals;
+};
 
 /**
  * Counts the number of cases and controls with each genotype. The
@@ -21,6 +442,34 @@
  */
 arma::mat joint_count(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
 
+/**
+ * Creates case and control bitmasks from a phenotype and weight
+ * vector, so that counts can be computed by popcount. Samples
+ * with weight 0 or a phenotype other than 0.0 or 1.0 are excluded.
+ *
+ * @param phenotype The phenotype 0.0 or 1.0.
+ * @param weight The weight of each individual.
+ * @param mask The created masks will be stored here.
+ *
+ * @return True if the masks could be created, false if some
+ *         weight is not 0.0 or 1.0.
+ */
+bool make_pheno_mask(const arma::vec &phenotype, const arma::vec &weight, pheno_mask &mask);
+
+/**
+ * Counts the number of cases and controls with each genotype
+ * using the bit planes of the snps, i.e. by AND and popcount
+ * instead of decoding each sample.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The case and control masks.
+ *
+ * @return Counts for each genotype in the same 9x2 layout as the
+ *         weighted joint_count.
+ */
+arma::mat joint_count(const snp_row &row1, const snp_row &row2, const pheno_mask &mask);
+
 /**
  * Aggregates the phenotype for each genotype. The
  * counts are based on the weight, so an individual with weight 0.5 will
@@ -0,0 +1,153 @@
+#include <cmath>
+
+#include <besiq/stats/wald_kernels.hpp>
+
+/**
+ * Computes the lower triangular L such that C = L L^T.
+ *
+ * @param C The symmetric matrix with row stride WALD_MAX_TERMS.
+ * @param L The factor is stored here.
+ *
+ * @return True if C is positive definite, false otherwise.
+ */
+template<size_t N>
+static bool
+cholesky(const double *C, double L[ N ][ N ])
+{
+    for(size_t j = 0; j < N; j++)
+    {
+        double d = C[ j * WALD_MAX_TERMS + j ];
+        for(size_t k = 0; k < j; k++)
+        {
+            d -= L[ j ][ k ] * L[ j ][ k ];
+        }
+        if( !( d > 0.0 ) )
+        {
+            return false;
+        }
+        L[ j ][ j ] = sqrt( d );
+
+        for(size_t i = j + 1; i < N; i++)
+        {
+            double s = C[ i * WALD_MAX_TERMS + j ];
+            for(size_t k = 0; k < j; k++)
+            {
+                s -= L[ i ][ k ] * L[ j ][ k ];
+            }
+            L[ i ][ j ] = s / L[ j ][ j ];
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Solves L y = b for a lower triangular L.
+ */
+template<size_t N>
+static void
+forward_solve(const double L[ N ][ N ], const double *b, double *y)
+{
+    for(size_t i = 0; i < N; i++)
+    {
+        double s = b[ i ];
+        for(size_t k = 0; k < i; k++)
+        {
+            s -= L[ i ][ k ] * y[ k ];
+        }
+        y[ i ] = s / L[ i ][ i ];
+    }
+}
+
+/**
+ * Solves L^T x = y for a lower triangular L.
+ */
+template<size_t N>
+static void
+backward_solve(const double L[ N ][ N ], const double *y, double *x)
+{
+    for(size_t i = N; i-- > 0; )
+    {
+        double s = y[ i ];
+        for(size_t k = i + 1; k < N; k++)
+        {
+            s -= L[ k ][ i ] * x[ k ];
+        }
+        x[ i ] = s / L[ i ][ i ];
+    }
+}
+
+template<size_t N>
+static bool
+statistic_fixed(const double *C, const double *beta, double *chi)
+{
+    double L[ N ][ N ];
+    if( !cholesky<N>( C, L ) )
+    {
+        return false;
+    }
+
+    /* beta^T C^-1 beta = |L^-1 beta|^2 */
+    double y[ N ];
+    forward_solve<N>( L, beta, y );
+    *chi = 0.0;
+    for(size_t i = 0; i < N; i++)
+    {
+        *chi += y[ i ] * y[ i ];
+    }
+
+    return true;
+}
+
+template<size_t N>
+static bool
+invert_fixed(const double *C, double *Cinv)
+{
+    double L[ N ][ N ];
+    if( !cholesky<N>( C, L ) )
+    {
+        return false;
+    }
+
+    for(size_t j = 0; j < N; j++)
+    {
+        double e[ N ] = { 0.0 };
+        double y[ N ];
+        double x[ N ];
+        e[ j ] = 1.0;
+        forward_solve<N>( L, e, y );
+        backward_solve<N>( L, y, x );
+        for(size_t i = 0; i < N; i++)
+        {
+            Cinv[ i * WALD_MAX_TERMS + j ] = x[ i ];
+        }
+    }
+
+    return true;
+}
+
+bool
+wald_statistic(const double *C, const double *beta, size_t num_terms, double *chi)
+{
+    switch( num_terms )
+    {
+        case 1: return statistic_fixed<1>( C, beta, chi );
+        case 2: return statistic_fixed<2>( C, beta, chi );
+        case 3: return statistic_fixed<3>( C, beta, chi );
+        case 4: return statistic_fixed<4>( C, beta, chi );
+        default: return false;
+    }
+}
+
+bool
+wald_invert(const double *C, size_t num_terms, double *Cinv)
+{
+    switch( num_terms )
+    {
+        case 1: return invert_fixed<1>( C, Cinv );
+        case 2: return invert_fixed<2>( C, Cinv );
+        case 3: return invert_fixed<3>( C, Cinv );
+        case 4: return invert_fixed<4>( C, Cinv );
+        default: return false;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef __WALD_KERNELS_H__
+#define __WALD_KERNELS_H__
+
+#include <stddef.h>
+
+/**
+ * Largest number of interaction terms in a wald test, and the row
+ * stride of all covariance matrices passed to the functions below.
+ */
+const size_t WALD_MAX_TERMS = 4;
+
+/**
+ * Computes the wald statistic beta^T C^-1 beta by a Cholesky
+ * decomposition of C, without allocating.
+ *
+ * @param C The symmetric covariance matrix, element (i, j) is
+ *          stored at C[ i * WALD_MAX_TERMS + j ].
+ * @param beta The estimates.
+ * @param num_terms The number of terms, 1 to WALD_MAX_TERMS.
+ * @param chi The statistic is stored here.
+ *
+ * @return True if C is positive definite, false otherwise.
+ */
+bool wald_statistic(const double *C, const double *beta, size_t num_terms, double *chi);
+
+/**
+ * Inverts C by a Cholesky decomposition, without allocating.
+ *
+ * @param C The symmetric covariance matrix, element (i, j) is
+ *          stored at C[ i * WALD_MAX_TERMS + j ].
+ * @param num_terms The number of terms, 1 to WALD_MAX_TERMS.
+ * @param Cinv The inverse is stored here with the same layout as C.
+ *
+ * @return True if C is positive definite, false otherwise.
+ */
+bool wald_invert(const double *C, size_t num_terms, double *Cinv);
+
+#endif /* End of __WALD_KERNELS_H__ */
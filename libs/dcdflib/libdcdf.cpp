@@ -6,6 +6,9 @@ extern "C"
     #include <dcdflib/cdflib.h>
 }
 
+/* The dcdflib routines keep state in static variables, so calls
+ * into the library are serialized when running with OpenMP. */
+
 double
 chi_square_cdf(double x, unsigned int df)
 {
@@ -17,6 +20,7 @@ chi_square_cdf(double x, unsigned int df)
     int status;
     double bound;
 
+    #pragma omp critical( dcdflib )
     cdfchi( &which, &p, &q, &x_chi, &df_chi, &status, &bound );
 
     if( status == 0 )
@@ -42,6 +46,7 @@ norm_cdf(double x, double mu, double sd)
     int status;
     double bound;
 
+    #pragma omp critical( dcdflib )
     cdfnor( &which, &p, &q, &x_norm, &mu_norm, &sd_norm, &status, &bound );
 
     if( status == 0 )
@@ -67,6 +72,7 @@ f_cdf(double x, double d1, double d2)
     int status;
     double bound;
 
+    #pragma omp critical( dcdflib )
     cdff( &which, &p, &q, &x_f, &d1_f, &d2_f, &status, &bound );
 
     if( status == 0 )
@@ -91,6 +97,7 @@ gamma_cdf_inv(double p, double a, double b)
     double bound;
     int status;
 
+    #pragma omp critical( dcdflib )
     cdfgam( &which, &p_gam, &q, &x, &shape, &scale, &status, &bound );
 
     if( status == 0 )
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
+
+extern "C"
+{
+    #include <dcdflib/cdflib.h>
+}
+
+/**
+ * The natural logarithm of 10.
+ */
+static const double TAIL_LN10 = 2.30258509299404568402;
+
+/**
+ * The square root of pi.
+ */
+static const double TAIL_SQRT_PI = 1.77245385090551602730;
+
+/**
+ * Above this value exp( z^2 ) would overflow, so erfcx uses its
+ * asymptotic expansion instead.
+ */
+static const double TAIL_ERFCX_ASYMPTOTIC = 26.0;
+
+/**
+ * Computes the scaled complementary error function exp( z^2 ) erfc( z )
+ * for z >= 0.
+ *
+ * @param z The argument.
+ *
+ * @return The value exp( z^2 ) erfc( z ).
+ */
+static double
+erfcx(double z)
+{
+    if( z < TAIL_ERFCX_ASYMPTOTIC )
+    {
+        return exp( z * z ) * erfc( z );
+    }
+
+    /* 1 - 1/(2z^2) + 3/(4z^4) - 15/(8z^6) + 105/(16z^8) */
+    double u = 1.0 / ( z * z );
+    return ( 1.0 - u * ( 0.5 - u * ( 0.75 - u * ( 1.875 - u * 6.5625 ) ) ) ) / ( z * TAIL_SQRT_PI );
+}
+
+/**
+ * Converts the natural logarithm of a probability to -log10 of it.
+ *
+ * @param ln_p The natural logarithm of the probability.
+ *
+ * @return The value -log10 p, never negative zero.
+ */
+static double
+to_log10(double ln_p)
+{
+    if( ln_p < 0.0 )
+    {
+        return -ln_p / TAIL_LN10;
+    }
+
+    return 0.0;
+}
+
+/**
+ * Computes ln Pr[ X > x ] with dcdflib, for degrees of freedom that
+ * have no closed form series here.
+ */
+static double
+chi_square_upper_ln_dcdflib(double x, unsigned int df)
+{
+    int which = 1;
+    double p;
+    double q;
+    double x_chi = x;
+    double df_chi = df;
+    int status;
+    double bound;
+
+    #pragma omp critical( dcdflib )
+    cdfchi( &which, &p, &q, &x_chi, &df_chi, &status, &bound );
+
+    if( status != 0 )
+    {
+        throw bad_domain_value( x );
+    }
+
+    return log( q );
+}
+
+/**
+ * Computes ln Pr[ X > x ] where X has a chi^2 distribution.
+ *
+ * For even df = 2k the tail is exp( -x/2 ) sum_{i<k} (x/2)^i / i!, and
+ * for odd df = 2k + 1 it is erfc( sqrt( x/2 ) ) plus
+ * exp( -x/2 ) sum_{i=1..k} (x/2)^(i-1/2) / Gamma( i+1/2 ). All terms are
+ * positive, so there is no cancellation, and exp( -x/2 ) is factored
+ * out so that the logarithm is finite for any finite x.
+ */
+static double
+chi_square_upper_ln(double x, unsigned int df)
+{
+    if( !( x >= 0.0 ) )
+    {
+        throw bad_domain_value( x );
+    }
+    if( x == std::numeric_limits<double>::infinity( ) )
+    {
+        return -std::numeric_limits<double>::infinity( );
+    }
+    if( df == 0 || df > TAIL_MAX_CHI_SQUARE_DF )
+    {
+        return chi_square_upper_ln_dcdflib( x, df );
+    }
+
+    double h = 0.5 * x;
+    double sum;
+    if( df % 2 == 0 )
+    {
+        double term = 1.0;
+        sum = 1.0;
+        for(unsigned int i = 1; i < df / 2; i++)
+        {
+            term *= h / i;
+            sum += term;
+        }
+    }
+    else
+    {
+        double s = sqrt( h );
+        double term = 2.0 * s / TAIL_SQRT_PI;
+        sum = erfcx( s );
+        for(unsigned int i = 1; i <= df / 2; i++)
+        {
+            sum += term;
+            term *= h / ( i + 0.5 );
+        }
+    }
+
+    return log( sum ) - h;
+}
+
+double
+chi_square_upper(double x, unsigned int df)
+{
+    return exp( chi_square_upper_ln( x, df ) );
+}
+
+double
+chi_square_upper_log10(double x, unsigned int df)
+{
+    return to_log10( chi_square_upper_ln( x, df ) );
+}
+
+void
+chi_square_upper(const double *x, size_t n, unsigned int df, double *p, double *log10_p)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        double ln_p = chi_square_upper_ln( x[ i ], df );
+        p[ i ] = exp( ln_p );
+        if( log10_p != NULL )
+        {
+            log10_p[ i ] = to_log10( ln_p );
+        }
+    }
+}
+
+/**
+ * Computes ln Pr[ Z > z ] where Z has a standard normal distribution.
+ */
+static double
+norm_upper_ln(double z)
+{
+    double s = z / sqrt( 2.0 );
+    if( s < 1.0 )
+    {
+        return log( 0.5 * erfc( s ) );
+    }
+
+    return log( 0.5 * erfcx( s ) ) - s * s;
+}
+
+double
+norm_upper(double x, double mu, double sd)
+{
+    return 0.5 * erfc( ( x - mu ) / ( sd * sqrt( 2.0 ) ) );
+}
+
+double
+norm_upper_log10(double x, double mu, double sd)
+{
+    return to_log10( norm_upper_ln( ( x - mu ) / sd ) );
+}
+
+/**
+ * Evaluates the continued fraction of the regularized incomplete beta
+ * function by the modified Lentz method, it converges quickly for
+ * x < ( a + 1 ) / ( a + b + 2 ).
+ */
+static double
+beta_continued_fraction(double a, double b, double x)
+{
+    const int max_iterations = 300;
+    const double epsilon = 1e-15;
+    const double tiny = 1e-300;
+
+    double c = 1.0;
+    double d = 1.0 - ( a + b ) * x / ( a + 1.0 );
+    if( fabs( d ) < tiny )
+    {
+        d = tiny;
+    }
+    d = 1.0 / d;
+    double h = d;
+    for(int m = 1; m <= max_iterations; m++)
+    {
+        double m2 = 2.0 * m;
+        double aa = m * ( b - m ) * x / ( ( a - 1.0 + m2 ) * ( a + m2 ) );
+        d = 1.0 + aa * d;
+        if( fabs( d ) < tiny )
+        {
+            d = tiny;
+        }
+        c = 1.0 + aa / c;
+        if( fabs( c ) < tiny )
+        {
+            c = tiny;
+        }
+        d = 1.0 / d;
+        h *= d * c;
+
+        aa = -( a + m ) * ( a + b + m ) * x / ( ( a + m2 ) * ( a + 1.0 + m2 ) );
+        d = 1.0 + aa * d;
+        if( fabs( d ) < tiny )
+        {
+            d = tiny;
+        }
+        c = 1.0 + aa / c;
+        if( fabs( c ) < tiny )
+        {
+            c = tiny;
+        }
+        d = 1.0 / d;
+        double delta = d * c;
+        h *= delta;
+        if( fabs( delta - 1.0 ) < epsilon )
+        {
+            break;
+        }
+    }
+
+    return h;
+}
+
+/**
+ * Computes the Stirling series correction lgamma( x ) - ( ( x - 1/2 ) ln x - x + ln( 2 pi ) / 2 )
+ * for x >= 10.
+ */
+static double
+stirling_correction(double x)
+{
+    double u = 1.0 / ( x * x );
+    return ( 1.0 / 12.0 - u * ( 1.0 / 360.0 - u * ( 1.0 / 1260.0 - u * ( 1.0 / 1680.0 - u / 1188.0 ) ) ) ) / x;
+}
+
+/**
+ * Computes ln B( a, b ) = lgamma( a ) + lgamma( b ) - lgamma( a + b ). When
+ * a parameter is large the lgamma terms nearly cancel, so the Stirling
+ * series is used with the large terms combined analytically.
+ */
+static double
+log_beta(double a, double b)
+{
+    double p = std::min( a, b );
+    double q = std::max( a, b );
+    if( q < 10.0 )
+    {
+        return lgamma( p ) + lgamma( q ) - lgamma( p + q );
+    }
+    else if( p < 10.0 )
+    {
+        /* lgamma( q ) - lgamma( p + q ) with the Stirling series of both */
+        double difference = -p * log( q ) - ( p + q - 0.5 ) * log1p( p / q ) + p +
+                            stirling_correction( q ) - stirling_correction( p + q );
+        return lgamma( p ) + difference;
+    }
+
+    double sum = p + q;
+    return 0.5 * log( 2.0 * M_PI ) + ( p - 0.5 ) * log( p / sum ) + ( q - 0.5 ) * log( q / sum ) - 0.5 * log( sum ) +
+           stirling_correction( p ) + stirling_correction( q ) - stirling_correction( sum );
+}
+
+/**
+ * Computes ln I_y( a, b ) of the regularized incomplete beta function.
+ *
+ * @param a The first shape parameter.
+ * @param b The second shape parameter.
+ * @param y The argument.
+ * @param one_minus_y The value 1 - y, given separately to avoid cancellation.
+ *
+ * @return The value ln I_y( a, b ).
+ */
+static double
+beta_ln(double a, double b, double y, double one_minus_y)
+{
+    if( y <= 0.0 )
+    {
+        return -std::numeric_limits<double>::infinity( );
+    }
+    if( one_minus_y <= 0.0 )
+    {
+        return 0.0;
+    }
+
+    double ln_y = y < 0.5 ? log( y ) : log1p( -one_minus_y );
+    double ln_one_minus_y = one_minus_y < 0.5 ? log( one_minus_y ) : log1p( -y );
+    double ln_front = a * ln_y + b * ln_one_minus_y - log_beta( a, b );
+    if( y < ( a + 1.0 ) / ( a + b + 2.0 ) )
+    {
+        return ln_front + log( beta_continued_fraction( a, b, y ) / a );
+    }
+
+    /* I_y( a, b ) = 1 - I_{1-y}( b, a ) */
+    return log1p( -exp( ln_front + log( beta_continued_fraction( b, a, one_minus_y ) / b ) ) );
+}
+
+/**
+ * Computes ln Pr[ X > x ] where X has a F-distribution, which is
+ * I_y( d2/2, d1/2 ) with y = d2 / ( d2 + d1 x ).
+ */
+static double
+f_upper_ln(double x, double d1, double d2)
+{
+    if( !( x >= 0.0 ) )
+    {
+        throw bad_domain_value( x );
+    }
+    if( !( d1 > 0.0 ) || !( d2 > 0.0 ) )
+    {
+        throw bad_domain_value( !( d1 > 0.0 ) ? d1 : d2 );
+    }
+
+    double denominator = d2 + d1 * x;
+    return beta_ln( 0.5 * d2, 0.5 * d1, d2 / denominator, d1 * x / denominator );
+}
+
+double
+f_upper(double x, double d1, double d2)
+{
+    return exp( f_upper_ln( x, d1, d2 ) );
+}
+
+double
+f_upper_log10(double x, double d1, double d2)
+{
+    return to_log10( f_upper_ln( x, d1, d2 ) );
+}
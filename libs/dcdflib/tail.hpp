@@ -0,0 +1,106 @@
+#ifndef __TAIL_H__
+#define __TAIL_H__
+
+#include <stddef.h>
+
+/**
+ * Largest number of degrees of freedom for which chi_square_upper
+ * uses the closed form series, larger values fall back to dcdflib.
+ */
+const unsigned int TAIL_MAX_CHI_SQUARE_DF = 32;
+
+/**
+ * Computes the upper tail probability Pr[ X > x ] where X has a
+ * chi^2 distribution. Unlike 1 - chi_square_cdf the tail is computed
+ * directly, so it is accurate also far below machine epsilon, and no
+ * lock is taken for the small degrees of freedom used by the tests.
+ *
+ * @param x Observed chi square value.
+ * @param df The degrees of freedom.
+ *
+ * @throws bad_domain_value if x is negative or not a number.
+ *
+ * @return The probability Pr[ X > x ].
+ */
+double chi_square_upper(double x, unsigned int df);
+
+/**
+ * Computes -log10 Pr[ X > x ] where X has a chi^2 distribution.
+ * The logarithm is computed without forming the probability, so
+ * it is finite also when the probability underflows.
+ *
+ * @param x Observed chi square value.
+ * @param df The degrees of freedom.
+ *
+ * @throws bad_domain_value if x is negative or not a number.
+ *
+ * @return The value -log10 Pr[ X > x ].
+ */
+double chi_square_upper_log10(double x, unsigned int df);
+
+/**
+ * Computes the upper tail probability of a batch of chi^2 values
+ * with the same degrees of freedom. The loop keeps no state between
+ * values, so batches can be evaluated concurrently.
+ *
+ * @param x Observed chi square values.
+ * @param n The number of values.
+ * @param df The degrees of freedom.
+ * @param p The probability Pr[ X > x[ i ] ] is stored here.
+ * @param log10_p The value -log10 p[ i ] is stored here, may be NULL.
+ *
+ * @throws bad_domain_value if a value is negative or not a number.
+ */
+void chi_square_upper(const double *x, size_t n, unsigned int df, double *p, double *log10_p);
+
+/**
+ * Computes the upper tail probability Pr[ X > x ] where X has a
+ * normal distribution.
+ *
+ * @param x Observed normal value.
+ * @param mu The mean value.
+ * @param sd The standard deviation.
+ *
+ * @return The probability Pr[ X > x ].
+ */
+double norm_upper(double x, double mu, double sd);
+
+/**
+ * Computes -log10 Pr[ X > x ] where X has a normal distribution.
+ *
+ * @param x Observed normal value.
+ * @param mu The mean value.
+ * @param sd The standard deviation.
+ *
+ * @return The value -log10 Pr[ X > x ].
+ */
+double norm_upper_log10(double x, double mu, double sd);
+
+/**
+ * Computes the upper tail probability Pr[ X > x ] where X has a
+ * F-distribution.
+ *
+ * @param x Observed F value.
+ * @param d1 The degrees of freedom of the numerator.
+ * @param d2 The degrees of freedom of the denominator.
+ *
+ * @throws bad_domain_value if x is negative or not a number.
+ *
+ * @return The probability Pr[ X > x ].
+ */
+double f_upper(double x, double d1, double d2);
+
+/**
+ * Computes -log10 Pr[ X > x ] where X has a F-distribution.
+ *
+ * @param x Observed F value.
+ * @param d1 The degrees of freedom of the numerator.
+ * @param d2 The degrees of freedom of the denominator.
+ *
+ * @throws bad_domain_value if x is negative or not a number.
+ *
+ * @return The value -log10 Pr[ X > x ].
+ */
+double f_upper_log10(double x, double d1, double d2);
+
+#endif /* End of __TAIL_H__ */
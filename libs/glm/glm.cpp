@@ -3,15 +3,53 @@
 #include <glm/lm.hpp>
 #include <glm/irls.hpp>
 
+bool
+glm_is_linear(const glm_model &model)
+{
+    return model.get_name( ) == "normal" && model.get_link( ).get_name( ) == "identity";
+}
+
 arma::vec
 glm_fit(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, bool fast_inversion)
 {
-    if( model.get_name( ) == "normal" && model.get_link( ).get_name( ) == "identity" )
+    glm_workspace workspace;
+    return glm_fit( X, y, missing, model, output, workspace, fast_inversion );
+}
+
+arma::vec
+glm_fit(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion)
+{
+    return glm_fit( X, y, missing, model, output, workspace, arma::vec( ), fast_inversion );
+}
+
+arma::vec
+glm_fit(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, const arma::vec &start, bool fast_inversion)
+{
+    if( glm_is_linear( model ) )
+    {
+        return lm( X, y, missing, model, output, workspace );
+    }
+    else
+    {
+        return irls( X, y, missing, model, output, workspace, start, fast_inversion );
+    }
+}
+
+arma::vec
+glm_fit(const arma::mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion)
+{
+    return glm_fit( X, groups, model, output, workspace, arma::vec( ), fast_inversion );
+}
+
+arma::vec
+glm_fit(const arma::mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, const arma::vec &start, bool fast_inversion)
+{
+    if( glm_is_linear( model ) )
     {
-        return lm( X, y, missing, model, output );
+        return lm( X, groups, model, output, workspace );
     }
     else
     {
-        return irls( X, y, missing, model, output, fast_inversion );
+        return irls( X, groups, model, output, workspace, start, fast_inversion );
     }
 }
@@ -1,9 +1,21 @@
 #ifndef __GLM_H__
 #define __GLM_H__
 
+#include <glm/glm_groups.hpp>
 #include <glm/glm_info.hpp>
+#include <glm/glm_workspace.hpp>
 #include <glm/models/glm_model.hpp>
 
+/**
+ * Returns true if glm_fit fits the model by linear regression,
+ * otherwise it is fitted by iteratively reweighted least squares.
+ *
+ * @param model The GLM model.
+ *
+ * @return True if the model is fitted by linear regression.
+ */
+bool glm_is_linear(const glm_model &model);
+
 /**
  * This function fits a generalized linear model. The specific algorithm
  * depends on the model, but in general either matrix inversion for linear
@@ -21,4 +33,78 @@
  */
 arma::vec glm_fit(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, bool fast_inversion = false);
 
+/**
+ * This function fits a generalized linear model, with buffers that
+ * are reused between calls, so that fitting many models of the same
+ * size does not allocate the temporaries of the least squares problems.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param y The observations.
+ * @param missing Identifies missing sampels by 1 and non-missing by 0.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the least squares problems.
+ * @param fast_inversion Use faster but less robust matrix inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec glm_fit(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion = false);
+
+/**
+ * This function fits a generalized linear model from the given
+ * starting point, which shortens the iterative algorithms when
+ * it is close to the estimate. Linear regression ignores it.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param y The observations.
+ * @param missing Identifies missing sampels by 1 and non-missing by 0.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the least squares problems.
+ * @param start The starting betas, the default starting point is
+ *              used if it is empty or can not be used.
+ * @param fast_inversion Use faster but less robust matrix inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec glm_fit(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, const arma::vec &start, bool fast_inversion = false);
+
+/**
+ * This function fits a generalized linear model on grouped
+ * observations, with one row of the design matrix per group.
+ * The estimates and the log likelihood are the same as when
+ * each observation has its own row.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param groups The grouped observations.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the least squares problems.
+ * @param fast_inversion Use faster but less robust matrix inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec glm_fit(const arma::mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion = false);
+
+/**
+ * This function fits a generalized linear model on grouped
+ * observations from the given starting point.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param groups The grouped observations.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the least squares problems.
+ * @param start The starting betas, the default starting point is
+ *              used if it is empty or can not be used.
+ * @param fast_inversion Use faster but less robust matrix inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec glm_fit(const arma::mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, const arma::vec &start, bool fast_inversion = false);
+
 #endif /* End of __GLM_H__ */
@@ -0,0 +1,32 @@
+#ifndef __GLM_GROUPS_H__
+#define __GLM_GROUPS_H__
+
+#include <armadillo>
+
+/**
+ * Observations that share the same row of the design matrix,
+ * summarized by their number, sum and sum of squares. The
+ * likelihood of a glm only depends on the observations through
+ * these, so a model can be fitted on one row per group instead
+ * of one row per observation.
+ */
+struct glm_groups
+{
+    /**
+     * Number of observations in each group, groups without
+     * observations are treated as missing.
+     */
+    arma::vec n;
+
+    /**
+     * Sum of the observations in each group.
+     */
+    arma::vec sum;
+
+    /**
+     * Sum of the squared observations in each group.
+     */
+    arma::vec sum_sq;
+};
+
+#endif /* End of __GLM_GROUPS_H__ */
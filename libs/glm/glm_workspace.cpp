@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm_workspace.hpp>
+#include <glm/irls.hpp>
+
+using namespace arma;
+
+glm_workspace::glm_workspace()
+    : m_has_factor( false ),
+      m_weighted( GLM_WORKSPACE_BLOCK_ROWS )
+{
+}
+
+void
+glm_workspace::accumulate(const mat &X, const vec &y, const vec &w)
+{
+    size_t n = X.n_rows;
+    size_t p = X.n_cols;
+    m_normal.zeros( p, p );
+    m_rhs.zeros( p );
+
+    double *weighted = m_weighted.memptr( );
+    for(size_t start = 0; start < n; start += GLM_WORKSPACE_BLOCK_ROWS)
+    {
+        size_t num_rows = std::min( GLM_WORKSPACE_BLOCK_ROWS, n - start );
+        const double *w_block = w.memptr( ) + start;
+        const double *y_block = y.memptr( ) + start;
+        for(size_t j = 0; j < p; j++)
+        {
+            const double *xj = X.colptr( j ) + start;
+            double rhs = 0.0;
+            for(size_t i = 0; i < num_rows; i++)
+            {
+                weighted[ i ] = w_block[ i ] * xj[ i ];
+                rhs += weighted[ i ] * y_block[ i ];
+            }
+            m_rhs[ j ] += rhs;
+
+            for(size_t k = j; k < p; k++)
+            {
+                const double *xk = X.colptr( k ) + start;
+                double sum = 0.0;
+                for(size_t i = 0; i < num_rows; i++)
+                {
+                    sum += weighted[ i ] * xk[ i ];
+                }
+                m_normal( k, j ) += sum;
+            }
+        }
+    }
+
+    for(size_t j = 0; j < p; j++)
+    {
+        for(size_t k = j + 1; k < p; k++)
+        {
+            m_normal( j, k ) = m_normal( k, j );
+        }
+    }
+}
+
+bool
+glm_workspace::factor()
+{
+    size_t p = m_normal.n_rows;
+    m_factor.zeros( p, p );
+    for(size_t j = 0; j < p; j++)
+    {
+        double d = m_normal( j, j );
+        for(size_t k = 0; k < j; k++)
+        {
+            d -= m_factor( j, k ) * m_factor( j, k );
+        }
+
+        /* d is what remains of column j after the preceding columns,
+         * relative to its weighted norm m_normal( j, j ) */
+        if( !( d > GLM_WORKSPACE_MIN_PIVOT * m_normal( j, j ) ) )
+        {
+            return false;
+        }
+        m_factor( j, j ) = sqrt( d );
+
+        for(size_t i = j + 1; i < p; i++)
+        {
+            double s = m_normal( i, j );
+            for(size_t k = 0; k < j; k++)
+            {
+                s -= m_factor( i, k ) * m_factor( j, k );
+            }
+            m_factor( i, j ) = s / m_factor( j, j );
+        }
+    }
+
+    return true;
+}
+
+bool
+glm_workspace::solve(const mat &X, const vec &y, const vec &w, bool fast_inversion, vec &beta)
+{
+    accumulate( X, y, w );
+    m_has_factor = factor( );
+    if( !m_has_factor )
+    {
+        beta = weighted_least_squares( X, y, w, fast_inversion );
+        return beta.n_elem > 0;
+    }
+
+    /* L L^T beta = X^T W y */
+    size_t p = X.n_cols;
+    beta.set_size( p );
+    for(size_t i = 0; i < p; i++)
+    {
+        double s = m_rhs[ i ];
+        for(size_t k = 0; k < i; k++)
+        {
+            s -= m_factor( i, k ) * beta[ k ];
+        }
+        beta[ i ] = s / m_factor( i, i );
+    }
+    for(size_t i = p; i-- > 0; )
+    {
+        double s = beta[ i ];
+        for(size_t k = i + 1; k < p; k++)
+        {
+            s -= m_factor( k, i ) * beta[ k ];
+        }
+        beta[ i ] = s / m_factor( i, i );
+    }
+
+    return true;
+}
+
+bool
+glm_workspace::invert(mat &C) const
+{
+    if( !m_has_factor )
+    {
+        return m_normal.is_finite( ) && inv( C, m_normal );
+    }
+
+    /* C = L^-T L^-1, column j of L^-1 is found by forward substitution */
+    size_t p = m_factor.n_rows;
+    mat L_inv = zeros<mat>( p, p );
+    for(size_t j = 0; j < p; j++)
+    {
+        L_inv( j, j ) = 1.0 / m_factor( j, j );
+        for(size_t i = j + 1; i < p; i++)
+        {
+            double s = 0.0;
+            for(size_t k = j; k < i; k++)
+            {
+                s -= m_factor( i, k ) * L_inv( k, j );
+            }
+            L_inv( i, j ) = s / m_factor( i, i );
+        }
+    }
+
+    C.set_size( p, p );
+    for(size_t i = 0; i < p; i++)
+    {
+        for(size_t j = 0; j <= i; j++)
+        {
+            double s = 0.0;
+            for(size_t k = i; k < p; k++)
+            {
+                s += L_inv( k, i ) * L_inv( k, j );
+            }
+            C( i, j ) = s;
+            C( j, i ) = s;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef __GLM_WORKSPACE_H__
+#define __GLM_WORKSPACE_H__
+
+#include <armadillo>
+
+/**
+ * Number of rows of the design matrix that are accumulated at a time,
+ * so that the weighted columns of a block stay in the cache.
+ */
+const size_t GLM_WORKSPACE_BLOCK_ROWS = 256;
+
+/**
+ * Smallest fraction of the weighted norm of a column that must remain
+ * after projecting out the preceding columns for the Cholesky solution
+ * to be used. Below it the columns are nearly collinear, and the squared
+ * condition number of the normal equations would lose too much precision.
+ */
+const double GLM_WORKSPACE_MIN_PIVOT = 1e-8;
+
+/**
+ * Solves the weighted least squares problems of the iteratively
+ * reweighted least squares algorithm through the normal equations,
+ * and keeps all buffers between calls so that fitting many models
+ * of the same size does not allocate.
+ *
+ * X^T W X and X^T W y are accumulated in a single pass over the rows
+ * of the design matrix and solved by a Cholesky factorization. When
+ * X^T W X is not positive definite or is badly conditioned, the
+ * problem is solved by weighted_least_squares as before.
+ */
+class glm_workspace
+{
+public:
+    /**
+     * Constructor.
+     */
+    glm_workspace();
+
+    /**
+     * Solves the weighted least squares problem X^T W X b = X^T W y.
+     *
+     * @param X The design matrix.
+     * @param y The right hand side.
+     * @param w The weight for each observation.
+     * @param fast_inversion If true use less robust but faster inversion
+     *                       when falling back to weighted_least_squares.
+     * @param beta The solution will be stored here.
+     *
+     * @return True if a solution was found, false otherwise.
+     */
+    bool solve(const arma::mat &X, const arma::vec &y, const arma::vec &w, bool fast_inversion, arma::vec &beta);
+
+    /**
+     * Computes the inverse of X^T W X of the last call to solve, which
+     * is the unscaled covariance matrix of the estimate.
+     *
+     * @param C The inverse will be stored here.
+     *
+     * @return True if X^T W X could be inverted, false otherwise.
+     */
+    bool invert(arma::mat &C) const;
+
+private:
+    /**
+     * Accumulates X^T W X and X^T W y, only the lower triangle of
+     * X^T W X is computed.
+     *
+     * @param X The design matrix.
+     * @param y The right hand side.
+     * @param w The weight for each observation.
+     */
+    void accumulate(const arma::mat &X, const arma::vec &y, const arma::vec &w);
+
+    /**
+     * Computes the lower triangular Cholesky factor of X^T W X.
+     *
+     * @return True if X^T W X is positive definite and well
+     *         conditioned, false otherwise.
+     */
+    bool factor();
+
+    /**
+     * X^T W X of the last call to solve.
+     */
+    arma::mat m_normal;
+
+    /**
+     * X^T W y of the last call to solve.
+     */
+    arma::vec m_rhs;
+
+    /**
+     * The Cholesky factor L of X^T W X = L L^T.
+     */
+    arma::mat m_factor;
+
+    /**
+     * True if m_factor is the factor of the last call to solve.
+     */
+    bool m_has_factor;
+
+    /**
+     * The weighted column of the current block of rows.
+     */
+    arma::vec m_weighted;
+};
+
+#endif /* End of __GLM_WORKSPACE_H__ */
@@ -7,6 +7,7 @@
 #include <glm/models/links/glm_link.hpp>
 #include <glm/irls.hpp>
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 
 using namespace arma;
 
@@ -23,13 +24,10 @@ set_missing_to_zero(const uvec &missing, vec &w)
 }
 
 vec
-chi_square_cdf(const vec &x, unsigned int df)
+chi_square_upper(const vec &x, unsigned int df)
 {
     vec p = ones<vec>( x.n_elem );
-    for(int i = 0; i < x.n_elem; i++)
-    {
-        p[ i ] = chi_square_cdf( x[ i ], df );
-    }
+    chi_square_upper( x.memptr( ), x.n_elem, df, p.memptr( ), NULL );
 
     return p;
 }
@@ -80,40 +78,119 @@ compute_w(const vec &var, const vec& mu_eta)
     return 1.0 / ( var % ( mu_eta % mu_eta ) );
 }
 
-vec
-init_beta(const mat &X, const vec&y, const uvec &missing, const glm_model &model, bool fast_inversion = false)
+/**
+ * Computes the starting point of the algorithm by regressing a
+ * transformation of the observations.
+ *
+ * @param X The design matrix.
+ * @param y The observations, or the mean of each group.
+ * @param prior The weight of each observation, 0 if missing.
+ * @param model The GLM model to estimate.
+ * @param workspace Solves the least squares problem.
+ *
+ * @return The starting betas.
+ */
+static vec
+init_beta(const mat &X, const vec&y, const vec &prior, const glm_model &model, glm_workspace &workspace)
 {
     vec eta = model.get_link( ).eta( (y + 0.5) / 3.0 );
 
-    return weighted_least_squares( X, eta, ones<vec>( missing.n_elem ) - missing, fast_inversion );
+    vec b;
+    workspace.solve( X, eta, prior, false, b );
+
+    return b;
 }
 
-vec
-irls(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_info &output, bool fast_inversion)
+/**
+ * Computes the log likelihood of either the observations or the groups.
+ */
+static double
+irls_likelihood(const glm_model &model, const vec &mu, const vec &y, const uvec &missing, const glm_groups *groups, float dispersion = 1.0)
+{
+    if( groups != NULL )
+    {
+        return model.grouped_likelihood( mu, *groups, dispersion );
+    }
+
+    return model.likelihood( mu, y, missing, dispersion );
+}
+
+/**
+ * Estimates the dispersion from either the observations or the groups.
+ */
+static double
+irls_dispersion(const glm_model &model, const vec &mu, const vec &y, const uvec &missing, const glm_groups *groups, float k)
+{
+    if( groups != NULL )
+    {
+        return model.grouped_dispersion( mu, *groups, k );
+    }
+
+    return model.dispersion( mu, y, missing, k );
+}
+
+/**
+ * Performs the iteratively reweighted least squares algorithm.
+ *
+ * @param X The design matrix.
+ * @param y The observations, or the mean of each group.
+ * @param missing Identifies missing observations or empty groups by 1.
+ * @param prior The weight of each row, 1 for observations and the number
+ *              of observations for groups, 0 if missing.
+ * @param groups The grouped observations, or NULL if each row is an observation.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the weighted least squares problems.
+ * @param start The starting betas, or NULL to start from init_beta.
+ * @param fast_inversion If true use less robust but faster inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+static vec
+irls(const mat &X, const vec &y, const uvec &missing, const vec &prior, const glm_groups *groups, const glm_model &model, glm_info &output, glm_workspace &workspace, const vec *start, bool fast_inversion)
 {
     const glm_link &link = model.get_link( );
-    vec b = init_beta( X, y, missing, model );
+    vec b;
+    vec eta;
+    vec mu;
+    if( start != NULL && start->n_elem == X.n_cols && start->is_finite( ) )
+    {
+        b = *start;
+        eta = X * b;
+        mu = link.mu( eta );
+    }
+    if( b.n_elem == 0 || !model.valid_mu( mu ) )
+    {
+        start = NULL;
+        b = init_beta( X, y, prior, model, workspace );
+        if( b.n_elem != X.n_cols )
+        {
+            output.num_iters = 0;
+            output.converged = false;
+            output.success = false;
+            return b;
+        }
+        eta = X * b;
+        mu = link.mu( eta );
+    }
     vec w( X.n_rows );
     vec z( X.n_rows );
-    vec eta = X * b;
-    vec mu = link.mu( eta );
 
     vec mu_eta = link.mu_eta( mu );
 
     int num_iter = 0;
     double old_logl = -DBL_MAX;
-    double logl = model.likelihood( mu, y, missing );
+    double logl = irls_likelihood( model, mu, y, missing, groups );
     bool invalid_mu = false;
     bool inverse_fail = false;
     vec b_old = b;
     bool first_attempt = true;
     while( num_iter < IRLS_MAX_ITERS && ! ( fabs( logl - old_logl ) / ( 0.1 + fabs( logl ) ) < IRLS_TOLERANCE ) )
     {
-        w = compute_w( model.var( mu ), mu_eta );
+        w = prior % compute_w( model.var( mu ), mu_eta );
         z = compute_z( eta, mu, mu_eta, y );
         set_missing_to_zero( missing, w );
-        b = weighted_least_squares( X, z, w, fast_inversion );
-        if( b.n_elem <= 0 )
+        if( !workspace.solve( X, z, w, fast_inversion, b ) )
         {
             inverse_fail = true;
             break;
@@ -142,24 +219,33 @@ compute_eta:
 
         old_logl = logl;
         b_old = b;
-        logl = model.likelihood( mu, y, missing );
+        logl = irls_likelihood( model, mu, y, missing, groups );
 
         num_iter++;
     }
 
+    if( start != NULL && ( num_iter >= IRLS_MAX_ITERS || invalid_mu || inverse_fail ) )
+    {
+        /* The fit may still succeed from the default starting point */
+        b = irls( X, y, missing, prior, groups, model, output, workspace, NULL, fast_inversion );
+        output.num_iters += num_iter;
+
+        return b;
+    }
+
+    output.num_iters = num_iter;
     if( num_iter < IRLS_MAX_ITERS && !invalid_mu && !inverse_fail )
     {
-        mat I = X.t( ) * diagmat( w ) * X;
+        /* X^T W X of the last solve is the information matrix */
         mat C;
-        if( I.is_finite( ) && inv( C, I ) )
+        if( workspace.invert( C ) )
         {
-            float dispersion = model.dispersion( mu, y, missing, b.n_elem );
-            output.se_beta = sqrt( model.dispersion( mu, y, missing, dispersion ) * diagvec( C ) );
-            output.num_iters = num_iter;
+            float dispersion = irls_dispersion( model, mu, y, missing, groups, b.n_elem );
+            output.se_beta = sqrt( irls_dispersion( model, mu, y, missing, groups, dispersion ) * diagvec( C ) );
             output.converged = true;
             output.success = true;
             output.mu = mu;
-            output.logl = model.likelihood( mu, y, missing, dispersion );
+            output.logl = irls_likelihood( model, mu, y, missing, groups, dispersion );
             
             vec wald_z = b / output.se_beta;
             vec chi2_value = wald_z % wald_z;
@@ -168,7 +254,7 @@ compute_eta:
             {
                 try
                 {
-                    output.p_value[ i ] = 1.0 - chi_square_cdf( chi2_value[ i ], 1 );
+                    output.p_value[ i ] = chi_square_upper( chi2_value[ i ], 1 );
                 }
                 catch(bad_domain_value &e)
                 {
@@ -183,7 +269,6 @@ compute_eta:
     }
     else
     {   
-        output.num_iters = num_iter;
         output.converged = false;
         output.success = false;
     }
@@ -191,6 +276,57 @@ compute_eta:
     return b;
 }
 
+vec
+irls(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_info &output, bool fast_inversion)
+{
+    glm_workspace workspace;
+    return irls( X, y, missing, model, output, workspace, fast_inversion );
+}
+
+vec
+irls(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion)
+{
+    vec prior = ones<vec>( missing.n_elem );
+    set_missing_to_zero( missing, prior );
+
+    return irls( X, y, missing, prior, NULL, model, output, workspace, NULL, fast_inversion );
+}
+
+vec
+irls(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, const vec &start, bool fast_inversion)
+{
+    vec prior = ones<vec>( missing.n_elem );
+    set_missing_to_zero( missing, prior );
+
+    return irls( X, y, missing, prior, NULL, model, output, workspace, &start, fast_inversion );
+}
+
+vec
+irls(const mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion)
+{
+    return irls( X, groups, model, output, workspace, vec( ), fast_inversion );
+}
+
+vec
+irls(const mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, const vec &start, bool fast_inversion)
+{
+    uvec missing = zeros<uvec>( groups.n.n_elem );
+    vec mean = zeros<vec>( groups.n.n_elem );
+    for(int i = 0; i < groups.n.n_elem; i++)
+    {
+        if( groups.n[ i ] > 0.0 )
+        {
+            mean[ i ] = groups.sum[ i ] / groups.n[ i ];
+        }
+        else
+        {
+            missing[ i ] = 1;
+        }
+    }
+
+    return irls( X, mean, missing, groups.n, &groups, model, output, workspace, &start, fast_inversion );
+}
+
 vec
 irls(const mat &X, const vec &y, const glm_model &model, glm_info &output, bool fast_inversion)
 {
@@ -3,7 +3,9 @@
 
 #include <armadillo>
 
+#include <glm/glm_groups.hpp>
 #include <glm/glm_info.hpp>
+#include <glm/glm_workspace.hpp>
 #include <glm/models/glm_model.hpp>
 
 /**
@@ -26,14 +28,14 @@ static double IRLS_TOLERANCE = 10e-8;
 void set_missing_to_zero(const arma::uvec &missing, arma::vec &w);
 
 /**
- * Compute the chisquare cdf for a vector of chi square variables.
+ * Compute the upper tail probability for a vector of chi square variables.
  *
  * @param x Vector of chi square values.
  * @param df Degrees of freedom.
  *
  * @return Vector of corresponding p-values.
  */
-arma::vec chi_square_cdf(const arma::vec &x, unsigned int df);
+arma::vec chi_square_upper(const arma::vec &x, unsigned int df);
 
 /**
  * Solves the weighted least square problem:
@@ -113,4 +115,82 @@ arma::vec irls(const arma::mat &X, const arma::vec &y, const glm_model &model, g
  */
 arma::vec irls(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, bool fast_inversion = false);
 
+/**
+ * This function performs the iteratively reweighted
+ * least squares algorithm to estimate beta coefficients
+ * of a genearlized linear model, with buffers that are
+ * reused between calls.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param y The observations.
+ * @param missing Identifies missing sampels by 1 and non-missing by 0.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the weighted least squares problems.
+ * @param fast_inversion If true use less robust but faster inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec irls(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion = false);
+
+/**
+ * This function performs the iteratively reweighted
+ * least squares algorithm from the given starting point,
+ * typically the estimate of a similar model. If the starting
+ * point does not fit the design matrix, gives an invalid mean
+ * or the algorithm fails from it, the default starting point
+ * is used instead.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param y The observations.
+ * @param missing Identifies missing sampels by 1 and non-missing by 0.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas, num_iters
+ *               includes the iterations from a failed starting point.
+ * @param workspace Solves the weighted least squares problems.
+ * @param start The starting betas, may be empty.
+ * @param fast_inversion If true use less robust but faster inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec irls(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace, const arma::vec &start, bool fast_inversion = false);
+
+/**
+ * This function performs the iteratively reweighted
+ * least squares algorithm on grouped observations, with
+ * one row of the design matrix per group. The log likelihood
+ * is that of the observations of the groups.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param groups The grouped observations.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the weighted least squares problems.
+ * @param fast_inversion If true use less robust but faster inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec irls(const arma::mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, bool fast_inversion = false);
+
+/**
+ * This function performs the iteratively reweighted
+ * least squares algorithm on grouped observations from
+ * the given starting point.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param groups The grouped observations.
+ * @param model The GLM model to estimate.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the weighted least squares problems.
+ * @param start The starting betas, may be empty.
+ * @param fast_inversion If true use less robust but faster inversion.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec irls(const arma::mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace, const arma::vec &start, bool fast_inversion = false);
+
 #endif /* End of __IRLS_H__ */
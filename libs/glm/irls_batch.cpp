@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <glm/irls.hpp>
+#include <glm/irls_batch.hpp>
+#include <glm/models/links/glm_link.hpp>
+
+using namespace arma;
+
+irls_batch::irls_batch(const glm_model &model, const mat &shared, size_t num_varying, size_t max_models)
+    : m_model( model ),
+      m_shared( shared ),
+      m_num_varying( num_varying ),
+      m_num_cols( num_varying + shared.n_cols ),
+      m_num_samples( shared.n_rows ),
+      m_capacity( std::max( max_models, (size_t) 1 ) ),
+      m_size( 0 )
+{
+    size_t values_per_model = m_num_varying * m_num_samples;
+    if( values_per_model > 0 )
+    {
+        m_capacity = std::max( std::min( m_capacity, IRLS_BATCH_MAX_VALUES / values_per_model ), (size_t) 1 );
+    }
+
+    m_varying.resize( values_per_model * m_capacity );
+    m_missing.resize( m_capacity );
+    m_start.resize( m_capacity );
+    m_beta.resize( m_capacity );
+    m_info.resize( m_capacity );
+    m_active.resize( m_capacity );
+    m_normal.resize( m_num_cols * m_num_cols * m_capacity );
+    m_factor.resize( m_num_cols * m_num_cols * m_capacity );
+    m_rhs.resize( m_num_cols * m_capacity );
+    m_row.resize( m_num_cols * m_capacity );
+}
+
+size_t
+irls_batch::capacity() const
+{
+    return m_capacity;
+}
+
+size_t
+irls_batch::size() const
+{
+    return m_size;
+}
+
+void
+irls_batch::clear()
+{
+    m_size = 0;
+}
+
+size_t
+irls_batch::add(const mat &X, const uvec &missing)
+{
+    size_t index = m_size++;
+    size_t n = m_num_samples;
+    for(size_t j = 0; j < m_num_varying; j++)
+    {
+        const double *x = X.colptr( j );
+        double *dest = &m_varying[ j * n * m_capacity + index ];
+        for(size_t i = 0; i < n; i++)
+        {
+            dest[ i * m_capacity ] = x[ i ];
+        }
+    }
+    m_missing[ index ] = missing;
+    m_start[ index ] = vec( );
+
+    return index;
+}
+
+void
+irls_batch::set_start(size_t index, const vec &start)
+{
+    m_start[ index ] = start;
+}
+
+const vec &
+irls_batch::get_beta(size_t index) const
+{
+    return m_beta[ index ];
+}
+
+const glm_info &
+irls_batch::get_info(size_t index) const
+{
+    return m_info[ index ];
+}
+
+void
+irls_batch::get_row(size_t i, double *x) const
+{
+    size_t K = m_capacity;
+    for(size_t j = 0; j < m_num_varying; j++)
+    {
+        std::copy( &m_varying[ ( j * m_num_samples + i ) * K ], &m_varying[ ( j * m_num_samples + i ) * K ] + m_size, x + j * K );
+    }
+    for(size_t j = m_num_varying; j < m_num_cols; j++)
+    {
+        std::fill( x + j * K, x + j * K + m_size, m_shared( i, j - m_num_varying ) );
+    }
+}
+
+mat
+irls_batch::get_matrix(size_t index) const
+{
+    size_t n = m_num_samples;
+    mat X( n, m_num_cols );
+    for(size_t j = 0; j < m_num_varying; j++)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            X( i, j ) = m_varying[ ( j * n + i ) * m_capacity + index ];
+        }
+    }
+    for(size_t j = m_num_varying; j < m_num_cols; j++)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            X( i, j ) = m_shared( i, j - m_num_varying );
+        }
+    }
+
+    return X;
+}
+
+vec
+irls_batch::get_model(const vec &all, size_t index) const
+{
+    vec values( m_num_samples );
+    for(size_t i = 0; i < m_num_samples; i++)
+    {
+        values[ i ] = all[ i * m_capacity + index ];
+    }
+
+    return values;
+}
+
+void
+irls_batch::compute_eta(const std::vector<double> &b, vec &eta)
+{
+    size_t K = m_capacity;
+    size_t m = m_size;
+    double *x = &m_row[ 0 ];
+    std::vector<double> sum( K );
+    for(size_t i = 0; i < m_num_samples; i++)
+    {
+        get_row( i, x );
+        std::fill( sum.begin( ), sum.end( ), 0.0 );
+        for(size_t j = 0; j < m_num_cols; j++)
+        {
+            const double *xj = x + j * K;
+            const double *bj = &b[ j * K ];
+            for(size_t k = 0; k < m; k++)
+            {
+                sum[ k ] += xj[ k ] * bj[ k ];
+            }
+        }
+
+        for(size_t k = 0; k < m; k++)
+        {
+            if( m_active[ k ] )
+            {
+                eta[ i * K + k ] = sum[ k ];
+            }
+        }
+    }
+}
+
+void
+irls_batch::solve(const vec &w, const vec &z, std::vector<double> &b, std::vector<bool> &failed)
+{
+    size_t K = m_capacity;
+    size_t m = m_size;
+    size_t p = m_num_cols;
+    std::fill( m_normal.begin( ), m_normal.end( ), 0.0 );
+    std::fill( m_rhs.begin( ), m_rhs.end( ), 0.0 );
+
+    /* Lower triangle of X^T W X and X^T W z of all models in one pass */
+    double *x = &m_row[ 0 ];
+    for(size_t i = 0; i < m_num_samples; i++)
+    {
+        get_row( i, x );
+        const double *wi = w.memptr( ) + i * K;
+        const double *zi = z.memptr( ) + i * K;
+        for(size_t j = 0; j < p; j++)
+        {
+            const double *xj = x + j * K;
+            double *rhs = &m_rhs[ j * K ];
+            for(size_t k = 0; k < m; k++)
+            {
+                rhs[ k ] += wi[ k ] * xj[ k ] * zi[ k ];
+            }
+            for(size_t l = 0; l <= j; l++)
+            {
+                const double *xl = x + l * K;
+                double *normal = &m_normal[ ( j * p + l ) * K ];
+                for(size_t k = 0; k < m; k++)
+                {
+                    normal[ k ] += wi[ k ] * xj[ k ] * xl[ k ];
+                }
+            }
+        }
+    }
+
+    /* Cholesky factors of all models, see glm_workspace::factor */
+    for(size_t j = 0; j < p; j++)
+    {
+        double *ljj = &m_factor[ ( j * p + j ) * K ];
+        const double *gjj = &m_normal[ ( j * p + j ) * K ];
+        std::copy( gjj, gjj + m, ljj );
+        for(size_t l = 0; l < j; l++)
+        {
+            const double *ljl = &m_factor[ ( j * p + l ) * K ];
+            for(size_t k = 0; k < m; k++)
+            {
+                ljj[ k ] -= ljl[ k ] * ljl[ k ];
+            }
+        }
+        for(size_t k = 0; k < m; k++)
+        {
+            if( m_active[ k ] && !( ljj[ k ] > GLM_WORKSPACE_MIN_PIVOT * gjj[ k ] ) )
+            {
+                failed[ k ] = true;
+            }
+            ljj[ k ] = ljj[ k ] > 0.0 ? sqrt( ljj[ k ] ) : 1.0;
+        }
+
+        for(size_t i = j + 1; i < p; i++)
+        {
+            double *lij = &m_factor[ ( i * p + j ) * K ];
+            const double *gij = &m_normal[ ( i * p + j ) * K ];
+            std::copy( gij, gij + m, lij );
+            for(size_t l = 0; l < j; l++)
+            {
+                const double *lil = &m_factor[ ( i * p + l ) * K ];
+                const double *ljl = &m_factor[ ( j * p + l ) * K ];
+                for(size_t k = 0; k < m; k++)
+                {
+                    lij[ k ] -= lil[ k ] * ljl[ k ];
+                }
+            }
+            for(size_t k = 0; k < m; k++)
+            {
+                lij[ k ] /= ljj[ k ];
+            }
+        }
+    }
+
+    /* L L^T b = X^T W z */
+    for(size_t j = 0; j < p; j++)
+    {
+        double *bj = &b[ j * K ];
+        std::copy( &m_rhs[ j * K ], &m_rhs[ j * K ] + m, bj );
+        for(size_t l = 0; l < j; l++)
+        {
+            const double *ljl = &m_factor[ ( j * p + l ) * K ];
+            const double *bl = &b[ l * K ];
+            for(size_t k = 0; k < m; k++)
+            {
+                bj[ k ] -= ljl[ k ] * bl[ k ];
+            }
+        }
+        const double *ljj = &m_factor[ ( j * p + j ) * K ];
+        for(size_t k = 0; k < m; k++)
+        {
+            bj[ k ] /= ljj[ k ];
+        }
+    }
+    for(size_t j = p; j-- > 0; )
+    {
+        double *bj = &b[ j * K ];
+        for(size_t l = j + 1; l < p; l++)
+        {
+            const double *llj = &m_factor[ ( l * p + j ) * K ];
+            const double *bl = &b[ l * K ];
+            for(size_t k = 0; k < m; k++)
+            {
+                bj[ k ] -= llj[ k ] * bl[ k ];
+            }
+        }
+        const double *ljj = &m_factor[ ( j * p + j ) * K ];
+        for(size_t k = 0; k < m; k++)
+        {
+            bj[ k ] /= ljj[ k ];
+        }
+    }
+}
+
+void
+irls_batch::fit(const vec &y)
+{
+    const glm_link &link = m_model.get_link( );
+    size_t n = m_num_samples;
+    size_t K = m_capacity;
+    size_t m = m_size;
+    size_t p = m_num_cols;
+
+    /* The observations and prior weights of all models */
+    vec y_all = zeros<vec>( n * K );
+    vec prior = zeros<vec>( n * K );
+    for(size_t i = 0; i < n; i++)
+    {
+        for(size_t k = 0; k < m; k++)
+        {
+            y_all[ i * K + k ] = y[ i ];
+            prior[ i * K + k ] = m_missing[ k ][ i ] == 0 ? 1.0 : 0.0;
+        }
+    }
+
+    std::vector<double> b( p * K, 0.0 );
+    std::vector<double> b_new( p * K, 0.0 );
+    std::vector<bool> failed( K, false );
+    std::vector<bool> from_start( K, false );
+    std::vector<bool> invalid_mu( K, false );
+    std::vector<bool> first_attempt( K, true );
+    std::vector<unsigned int> num_iter( K, 0 );
+    std::vector<double> logl( K, 0.0 );
+    std::vector<double> old_logl( K, -DBL_MAX );
+
+    /* The given starting points that give a valid mean */
+    vec eta = zeros<vec>( n * K );
+    std::fill( m_active.begin( ), m_active.end( ), false );
+    for(size_t k = 0; k < m; k++)
+    {
+        const vec &start = m_start[ k ];
+        if( start.n_elem == p && start.is_finite( ) )
+        {
+            for(size_t j = 0; j < p; j++)
+            {
+                b[ j * K + k ] = start[ j ];
+            }
+            from_start[ k ] = true;
+            m_active[ k ] = true;
+        }
+    }
+    compute_eta( b, eta );
+    vec mu = link.mu( eta );
+    for(size_t k = 0; k < m; k++)
+    {
+        if( from_start[ k ] && !m_model.valid_mu( get_model( mu, k ) ) )
+        {
+            from_start[ k ] = false;
+        }
+        m_active[ k ] = !from_start[ k ];
+    }
+
+    /* The other models start from the regression of a transformation
+     * of the observations, as in irls */
+    if( std::find( m_active.begin( ), m_active.begin( ) + m, true ) != m_active.begin( ) + m )
+    {
+        vec y_eta = link.eta( ( y + 0.5 ) / 3.0 );
+        vec z( n * K );
+        for(size_t i = 0; i < n; i++)
+        {
+            std::fill( z.memptr( ) + i * K, z.memptr( ) + ( i + 1 ) * K, y_eta[ i ] );
+        }
+        solve( prior, z, b_new, failed );
+        for(size_t k = 0; k < m; k++)
+        {
+            for(size_t j = 0; m_active[ k ] && j < p; j++)
+            {
+                b[ j * K + k ] = b_new[ j * K + k ];
+            }
+        }
+        compute_eta( b, eta );
+        mu = link.mu( eta );
+    }
+
+    vec mu_eta = link.mu_eta( mu );
+    for(size_t k = 0; k < m; k++)
+    {
+        m_active[ k ] = !failed[ k ];
+        if( m_active[ k ] )
+        {
+            logl[ k ] = m_model.likelihood( get_model( mu, k ), y, m_missing[ k ] );
+        }
+    }
+
+    std::vector<double> b_old = b;
+    std::vector<bool> retry( K, false );
+    while( true )
+    {
+        bool any_active = false;
+        for(size_t k = 0; k < m; k++)
+        {
+            if( m_active[ k ] && ( num_iter[ k ] >= IRLS_MAX_ITERS || fabs( logl[ k ] - old_logl[ k ] ) / ( 0.1 + fabs( logl[ k ] ) ) < IRLS_TOLERANCE ) )
+            {
+                m_active[ k ] = false;
+            }
+            any_active = any_active || m_active[ k ];
+        }
+        if( !any_active )
+        {
+            break;
+        }
+
+        vec w = compute_w( m_model.var( mu ), mu_eta );
+        vec z = compute_z( eta, mu, mu_eta, y_all );
+        for(size_t i = 0; i < n; i++)
+        {
+            for(size_t k = 0; k < K; k++)
+            {
+                if( prior[ i * K + k ] == 0.0 || k >= m || !m_active[ k ] )
+                {
+                    w[ i * K + k ] = 0.0;
+                }
+            }
+        }
+
+        solve( w, z, b_new, failed );
+        for(size_t k = 0; k < m; k++)
+        {
+            if( failed[ k ] )
+            {
+                m_active[ k ] = false;
+            }
+            for(size_t j = 0; m_active[ k ] && j < p; j++)
+            {
+                b[ j * K + k ] = b_new[ j * K + k ];
+            }
+        }
+
+        compute_eta( b, eta );
+        mu = link.mu( eta );
+
+        /* Try a smaller step once for models with an invalid mean */
+        bool any_retry = false;
+        for(size_t k = 0; k < m; k++)
+        {
+            retry[ k ] = false;
+            if( !m_active[ k ] || m_model.valid_mu( get_model( mu, k ) ) )
+            {
+                continue;
+            }
+
+            if( first_attempt[ k ] )
+            {
+                for(size_t j = 0; j < p; j++)
+                {
+                    b[ j * K + k ] = 0.5 * b_old[ j * K + k ] + 0.5 * b[ j * K + k ];
+                }
+                first_attempt[ k ] = false;
+                retry[ k ] = true;
+                any_retry = true;
+            }
+            else
+            {
+                invalid_mu[ k ] = true;
+                m_active[ k ] = false;
+            }
+        }
+        if( any_retry )
+        {
+            std::vector<bool> active = m_active;
+            m_active = retry;
+            compute_eta( b, eta );
+            m_active = active;
+            mu = link.mu( eta );
+            for(size_t k = 0; k < m; k++)
+            {
+                if( retry[ k ] && !m_model.valid_mu( get_model( mu, k ) ) )
+                {
+                    invalid_mu[ k ] = true;
+                    m_active[ k ] = false;
+                }
+            }
+        }
+        mu_eta = link.mu_eta( mu );
+
+        for(size_t k = 0; k < m; k++)
+        {
+            if( !m_active[ k ] )
+            {
+                continue;
+            }
+
+            for(size_t j = 0; j < p; j++)
+            {
+                b_old[ j * K + k ] = b[ j * K + k ];
+            }
+            old_logl[ k ] = logl[ k ];
+            logl[ k ] = m_model.likelihood( get_model( mu, k ), y, m_missing[ k ] );
+            num_iter[ k ]++;
+        }
+    }
+
+    for(size_t k = 0; k < m; k++)
+    {
+        glm_info &info = m_info[ k ];
+        info.se_beta = vec( );
+        info.p_value = vec( );
+        bool success = !failed[ k ] && !invalid_mu[ k ] && num_iter[ k ] < IRLS_MAX_ITERS;
+        if( !success && ( failed[ k ] || from_start[ k ] ) )
+        {
+            /* irls solves badly conditioned problems by weighted least
+             * squares, and retries a failed start from the default */
+            vec start = failed[ k ] ? m_start[ k ] : vec( );
+            m_beta[ k ] = irls( get_matrix( k ), y, m_missing[ k ], m_model, info, m_workspace, start );
+            info.num_iters += num_iter[ k ];
+            continue;
+        }
+
+        m_beta[ k ].set_size( p );
+        for(size_t j = 0; j < p; j++)
+        {
+            m_beta[ k ][ j ] = b[ j * K + k ];
+        }
+        info.num_iters = num_iter[ k ];
+        info.converged = success;
+        info.success = success;
+        if( success )
+        {
+            vec mu_k = get_model( mu, k );
+            float dispersion = m_model.dispersion( mu_k, y, m_missing[ k ], p );
+            info.mu = mu_k;
+            info.logl = m_model.likelihood( mu_k, y, m_missing[ k ], dispersion );
+        }
+    }
+}
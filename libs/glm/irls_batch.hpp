@@ -0,0 +1,266 @@
+#ifndef __IRLS_BATCH_H__
+#define __IRLS_BATCH_H__
+
+#include <vector>
+
+#include <armadillo>
+
+#include <glm/glm_info.hpp>
+#include <glm/glm_workspace.hpp>
+#include <glm/models/glm_model.hpp>
+
+/**
+ * Largest number of models that are fitted together.
+ */
+const size_t IRLS_BATCH_SIZE = 16;
+
+/**
+ * Largest number of values of the varying columns that are stored
+ * for a batch, the number of models is reduced for large samples.
+ */
+const size_t IRLS_BATCH_MAX_VALUES = 1 << 22;
+
+/**
+ * Fits several glms of the same size with the iteratively reweighted
+ * least squares algorithm in lockstep, so that the small problems of
+ * the pairs are solved in loops over the models instead of through
+ * matrix routines whose overhead dominates at a few columns.
+ *
+ * The design matrices share their last columns, typically the intercept
+ * and the covariates, which are stored once. The first columns vary
+ * between the models and are stored interleaved, value i of column j
+ * of all models is contiguous, so that the means, weights and normal
+ * equations of all models are updated in the same loop. The p x p
+ * normal equations are solved by Cholesky factorizations of all models
+ * at once.
+ *
+ * Each model stops when it has converged or failed, and gives the
+ * same estimate as irls. Models whose normal equations are badly
+ * conditioned, and models that fail from their starting point, are
+ * fitted by irls instead.
+ */
+class irls_batch
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param model The GLM model to estimate.
+     * @param shared The last columns of all design matrices.
+     * @param num_varying The number of first columns that differ
+     *                    between the design matrices.
+     * @param max_models The largest number of models of a batch, it is
+     *                   reduced so that at most IRLS_BATCH_MAX_VALUES
+     *                   values are stored.
+     */
+    irls_batch(const glm_model &model, const arma::mat &shared, size_t num_varying, size_t max_models = IRLS_BATCH_SIZE);
+
+    /**
+     * Returns the largest number of models of a batch.
+     *
+     * @return The largest number of models.
+     */
+    size_t capacity() const;
+
+    /**
+     * Returns the number of models that have been added.
+     *
+     * @return The number of models.
+     */
+    size_t size() const;
+
+    /**
+     * Removes all models.
+     */
+    void clear();
+
+    /**
+     * Adds a model, only the varying columns of the design matrix are
+     * read, the others must equal the shared columns.
+     *
+     * @param X The design matrix.
+     * @param missing Identifies missing samples by 1 and non-missing by 0.
+     *
+     * @return The index of the model.
+     */
+    size_t add(const arma::mat &X, const arma::uvec &missing);
+
+    /**
+     * Sets the starting point of a model, see irls.
+     *
+     * @param index The index of the model.
+     * @param start The starting betas, may be empty.
+     */
+    void set_start(size_t index, const arma::vec &start);
+
+    /**
+     * Fits all models.
+     *
+     * @param y The observations.
+     */
+    void fit(const arma::vec &y);
+
+    /**
+     * Returns the estimated betas of a model.
+     *
+     * @param index The index of the model.
+     *
+     * @return The estimated betas.
+     */
+    const arma::vec &get_beta(size_t index) const;
+
+    /**
+     * Returns the output statistics of a model, only the log likelihood,
+     * the estimated mean values, the number of iterations and whether
+     * the fit succeeded are set.
+     *
+     * @param index The index of the model.
+     *
+     * @return The output statistics.
+     */
+    const glm_info &get_info(size_t index) const;
+
+private:
+    /**
+     * Stores the columns of all models at sample i, column j of model
+     * k at x[ j * m_capacity + k ].
+     *
+     * @param i The sample.
+     * @param x The columns will be stored here.
+     */
+    void get_row(size_t i, double *x) const;
+
+    /**
+     * Returns the design matrix of a model.
+     *
+     * @param index The index of the model.
+     *
+     * @return The design matrix.
+     */
+    arma::mat get_matrix(size_t index) const;
+
+    /**
+     * Computes the linear predictor of the active models.
+     *
+     * @param b The betas, beta j of model k at b[ j * m_capacity + k ].
+     * @param eta The linear predictor of sample i of model k will
+     *            be stored at eta[ i * m_capacity + k ].
+     */
+    void compute_eta(const std::vector<double> &b, arma::vec &eta);
+
+    /**
+     * Solves the weighted least squares problems of the active models.
+     * Models whose normal equations are not positive definite or badly
+     * conditioned, see GLM_WORKSPACE_MIN_PIVOT, are marked in failed.
+     *
+     * @param w The weights, interleaved as eta in compute_eta.
+     * @param z The right hand sides, interleaved as eta in compute_eta.
+     * @param b The solutions will be stored here, interleaved as in compute_eta.
+     * @param failed Set to true for the models that could not be solved.
+     */
+    void solve(const arma::vec &w, const arma::vec &z, std::vector<double> &b, std::vector<bool> &failed);
+
+    /**
+     * Copies the values of a model from interleaved storage.
+     *
+     * @param all The interleaved values.
+     * @param index The index of the model.
+     *
+     * @return The values of the model.
+     */
+    arma::vec get_model(const arma::vec &all, size_t index) const;
+
+    /**
+     * The GLM model.
+     */
+    const glm_model &m_model;
+
+    /**
+     * The last columns of all design matrices.
+     */
+    arma::mat m_shared;
+
+    /**
+     * The number of first columns that vary between models.
+     */
+    size_t m_num_varying;
+
+    /**
+     * The number of columns.
+     */
+    size_t m_num_cols;
+
+    /**
+     * The number of samples.
+     */
+    size_t m_num_samples;
+
+    /**
+     * The largest number of models.
+     */
+    size_t m_capacity;
+
+    /**
+     * The number of models that have been added.
+     */
+    size_t m_size;
+
+    /**
+     * Value i of varying column j of model k is stored at
+     * ( j * m_num_samples + i ) * m_capacity + k.
+     */
+    std::vector<double> m_varying;
+
+    /**
+     * The missing samples of each model.
+     */
+    std::vector<arma::uvec> m_missing;
+
+    /**
+     * The starting point of each model.
+     */
+    std::vector<arma::vec> m_start;
+
+    /**
+     * The estimated betas of each model.
+     */
+    std::vector<arma::vec> m_beta;
+
+    /**
+     * The output statistics of each model.
+     */
+    std::vector<glm_info> m_info;
+
+    /**
+     * True for the models that are still iterating.
+     */
+    std::vector<bool> m_active;
+
+    /**
+     * The lower triangle of the normal equations of all models,
+     * element ( j, l ) of model k at ( j * m_num_cols + l ) * m_capacity + k.
+     */
+    std::vector<double> m_normal;
+
+    /**
+     * The Cholesky factors, stored as m_normal.
+     */
+    std::vector<double> m_factor;
+
+    /**
+     * The right hand sides, element j of model k at j * m_capacity + k.
+     */
+    std::vector<double> m_rhs;
+
+    /**
+     * Buffer of one row of all models, see get_row.
+     */
+    std::vector<double> m_row;
+
+    /**
+     * Fits the models that are not fitted in the batch.
+     */
+    glm_workspace m_workspace;
+};
+
+#endif /* End of __IRLS_BATCH_H__ */
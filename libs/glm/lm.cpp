@@ -12,10 +12,22 @@ double loglikelihood(const vec &residuals, double sigma_square, double n)
 
 vec
 lm(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_info &output)
+{
+    glm_workspace workspace;
+    return lm( X, y, missing, model, output, workspace );
+}
+
+vec
+lm(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace)
 {
     vec w = ones<vec>( y.n_elem );
     set_missing_to_zero( missing, w );
-    vec beta = weighted_least_squares( X, y, w );
+    vec beta;
+    if( !workspace.solve( X, y, w, false, beta ) )
+    {
+        output.success = false;
+        return beta;
+    }
 
     double n = accu( w );
     double k = X.n_cols;
@@ -24,9 +36,8 @@ lm(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_
     vec residuals = y - mu;
     double sigma_square = as_scalar( trans( residuals ) * ( w % residuals ) / ( n - k ) );
 
-    mat cov = trans( X ) * ( diagmat( w ) * X );
     mat cov_inv;
-    if( !inv( cov_inv, cov ) )
+    if( !workspace.invert( cov_inv ) )
     {
         output.success = false;
         return beta;
@@ -35,11 +46,59 @@ lm(const mat &X, const vec &y, const uvec &missing, const glm_model &model, glm_
     vec sd = arma::sqrt( sigma_square * diagvec( cov_inv ) );
 
     output.se_beta = sd;
-    output.p_value = 1 - chi_square_cdf( beta % beta / ( sd % sd ), 1 );
+    output.p_value = chi_square_upper( beta % beta / ( sd % sd ), 1 );
     output.mu = mu;
     output.logl = loglikelihood( residuals % w, sigma_square, n );
     output.success = true;
     output.converged = true;
+    output.num_iters = 0;
+
+    return beta;
+}
+
+vec
+lm(const mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace)
+{
+    vec mean = zeros<vec>( groups.n.n_elem );
+    for(int i = 0; i < groups.n.n_elem; i++)
+    {
+        if( groups.n[ i ] > 0.0 )
+        {
+            mean[ i ] = groups.sum[ i ] / groups.n[ i ];
+        }
+    }
+
+    /* The weighted problem on the means has the same normal equations */
+    vec beta;
+    if( !workspace.solve( X, mean, groups.n, false, beta ) )
+    {
+        output.success = false;
+        return beta;
+    }
+
+    double n = accu( groups.n );
+    double k = X.n_cols;
+
+    vec mu = X * beta;
+    double sigma_square = model.grouped_dispersion( mu, groups, k );
+
+    mat cov_inv;
+    if( !workspace.invert( cov_inv ) )
+    {
+        output.success = false;
+        return beta;
+    }
+
+    vec sd = arma::sqrt( sigma_square * diagvec( cov_inv ) );
+
+    output.se_beta = sd;
+    output.p_value = chi_square_upper( beta % beta / ( sd % sd ), 1 );
+    output.mu = mu;
+    /* The residual sum of squares is sigma_square * ( n - k ) */
+    output.logl = -n/2*log(2*datum::pi) - n/2*log( sigma_square ) - ( n - k ) / 2;
+    output.success = true;
+    output.converged = true;
+    output.num_iters = 0;
 
     return beta;
 }
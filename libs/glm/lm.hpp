@@ -3,7 +3,9 @@
 
 #include <armadillo>
 
+#include <glm/glm_groups.hpp>
 #include <glm/glm_info.hpp>
+#include <glm/glm_workspace.hpp>
 #include <glm/models/glm_model.hpp>
 
 /**
@@ -30,4 +32,35 @@ double loglikelihood(const arma::vec &residuals, double sigma_square, double n);
  */
 arma::vec lm(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output);
 
+/**
+ * This function solves the linear least squares problem, with
+ * buffers that are reused between calls.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param y The observations.
+ * @param missing Identifies missing sampels by 1 and non-missing by 0.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the least squares problem.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec lm(const arma::mat &X, const arma::vec &y, const arma::uvec &missing, const glm_model &model, glm_info &output, glm_workspace &workspace);
+
+/**
+ * This function solves the linear least squares problem on
+ * grouped observations, with one row of the design matrix per
+ * group. The log likelihood is that of the observations of
+ * the groups.
+ *
+ * @param X The design matrix (caller is responsible for
+ *          adding an intercept).
+ * @param groups The grouped observations.
+ * @param output Output statistics of the estimated betas.
+ * @param workspace Solves the least squares problem.
+ *
+ * @return Estimated beta coefficients.
+ */
+arma::vec lm(const arma::mat &X, const glm_groups &groups, const glm_model &model, glm_info &output, glm_workspace &workspace);
+
 #endif /* End of __LM_H__ */
@@ -59,6 +59,28 @@ binomial::likelihood(const arma::vec &mu, const arma::vec &y, const arma::uvec &
     return loglikelihood;
 }
 
+double
+binomial::grouped_dispersion(const arma::vec &mu, const glm_groups &groups, float k) const
+{
+    return 1.0;
+}
+
+double
+binomial::grouped_likelihood(const arma::vec &mu, const glm_groups &groups, float dispersion) const
+{
+    /* The sum of a group is its number of cases */
+    double loglikelihood = 0.0;
+    for(int i = 0; i < mu.n_elem; i++)
+    {
+        if( groups.n[ i ] > 0.0 )
+        {
+            loglikelihood += groups.sum[ i ] * log( mu[ i ] ) + ( groups.n[ i ] - groups.sum[ i ] ) * log( 1 - mu[ i ] );
+        }
+    }
+
+    return loglikelihood;
+}
+
 bool
 binomial::is_binary() const
 {
@@ -49,6 +49,16 @@ public:
      */
     virtual double likelihood(const arma::vec &mu, const arma::vec &y, const arma::uvec &missing, float dispersion = 1.0) const;
 
+    /**
+     * @see glm_model.grouped_dispersion.
+     */
+    virtual double grouped_dispersion(const arma::vec &mu, const glm_groups &groups, float k) const;
+
+    /**
+     * @see glm_model.grouped_likelihood.
+     */
+    virtual double grouped_likelihood(const arma::vec &mu, const glm_groups &groups, float dispersion = 1.0) const;
+
     /**
      * @see glm_model.is_binary.
      */
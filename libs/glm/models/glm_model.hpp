@@ -3,6 +3,7 @@
 
 #include <armadillo>
 
+#include <glm/glm_groups.hpp>
 #include <glm/models/links/glm_link.hpp>
 
 /**
@@ -109,6 +110,31 @@ public:
      */
     virtual double likelihood(const arma::vec &mu, const arma::vec &y, const arma::uvec &missing, float dispersion = 1.0) const = 0;
 
+    /**
+     * Estimate the dispersion of the model from grouped observations,
+     * equal to dispersion on the observations of the groups.
+     *
+     * @param mu The mean value parameter of each group.
+     * @param groups The grouped observations.
+     * @param k The number of estimated betas.
+     *
+     * @return The estimated dispersion.
+     */
+    virtual double grouped_dispersion(const arma::vec &mu, const glm_groups &groups, float k) const = 0;
+
+    /**
+     * Compute the log likelihood for the parameters from grouped
+     * observations, equal to likelihood on the observations of
+     * the groups.
+     *
+     * @param mu The mean value parameter of each group.
+     * @param groups The grouped observations.
+     * @param dispersion Estimated dispersion (only used for final likelihood).
+     *
+     * @return The log likelihood.
+     */
+    virtual double grouped_likelihood(const arma::vec &mu, const glm_groups &groups, float dispersion = 1.0) const = 0;
+
     /**
      * Returns true if the phenotype is binary.
      *
@@ -43,6 +43,46 @@ normal::likelihood(const arma::vec &mu, const arma::vec &y, const arma::uvec &mi
     return arma::as_scalar( ( -0.5*log( 2 * datum::pi ) -0.5*log( sigma2 ) - (1.0/(2*sigma2))*arma::trans( ( ( y - mu ) % ( y - mu ) ) ) ) * ( 1 - missing ) );
 }
 
+/**
+ * Computes the residual sum of squares of grouped observations, which
+ * is the sum of squares within each group plus the weighted squared
+ * distance between the mean of each group and mu.
+ *
+ * @param mu The mean value parameter of each group.
+ * @param groups The grouped observations.
+ *
+ * @return The residual sum of squares.
+ */
+static double
+grouped_rss(const arma::vec &mu, const glm_groups &groups)
+{
+    double rss = 0.0;
+    for(int i = 0; i < mu.n_elem; i++)
+    {
+        if( groups.n[ i ] > 0.0 )
+        {
+            double mean = groups.sum[ i ] / groups.n[ i ];
+            rss += ( groups.sum_sq[ i ] - groups.sum[ i ] * mean ) + groups.n[ i ] * ( mean - mu[ i ] ) * ( mean - mu[ i ] );
+        }
+    }
+
+    return rss;
+}
+
+double
+normal::grouped_dispersion(const arma::vec &mu, const glm_groups &groups, float k) const
+{
+    return grouped_rss( mu, groups ) / ( arma::sum( groups.n ) - k );
+}
+
+double
+normal::grouped_likelihood(const arma::vec &mu, const glm_groups &groups, float dispersion) const
+{
+    float sigma2 = dispersion;
+    double n = arma::sum( groups.n );
+    return n * ( -0.5*log( 2 * datum::pi ) -0.5*log( sigma2 ) ) - (1.0/(2*sigma2))*grouped_rss( mu, groups );
+}
+
 bool
 normal::is_binary() const
 {
@@ -0,0 +1,198 @@
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/glm_workspace.hpp>
+#include <glm/irls.hpp>
+#include <glm/score_test.hpp>
+
+using namespace arma;
+
+score_test::score_test(const mat &Z, const vec &y, const uvec &missing, const glm_model &model)
+    : m_Z( Z ),
+      m_missing( missing ),
+      m_rwr( 0.0 ),
+      m_num_samples( 0.0 ),
+      m_fixed_dispersion( model.is_binary( ) )
+{
+    glm_info info;
+    glm_fit( Z, y, missing, model, info );
+    m_valid = info.success;
+    if( !m_valid )
+    {
+        return;
+    }
+
+    /* The working response z - eta is mu_eta * ( y - mu ) */
+    vec mu_eta = model.get_link( ).mu_eta( info.mu );
+    m_w = compute_w( model.var( info.mu ), mu_eta );
+    m_wr = zeros<vec>( y.n_elem );
+    for(size_t i = 0; i < y.n_elem; i++)
+    {
+        if( missing[ i ] != 0 )
+        {
+            m_w[ i ] = 0.0;
+            continue;
+        }
+
+        double r = mu_eta[ i ] * ( y[ i ] - info.mu[ i ] );
+        m_wr[ i ] = m_w[ i ] * r;
+        m_rwr += m_wr[ i ] * r;
+        m_num_samples += 1.0;
+    }
+
+    size_t q = Z.n_cols;
+    m_ZWZ.zeros( q, q );
+    m_Zwr.zeros( q );
+    for(size_t j = 0; j < q; j++)
+    {
+        for(size_t i = 0; i < y.n_elem; i++)
+        {
+            m_Zwr[ j ] += Z( i, j ) * m_wr[ i ];
+        }
+        for(size_t l = 0; l <= j; l++)
+        {
+            double sum = 0.0;
+            for(size_t i = 0; i < y.n_elem; i++)
+            {
+                sum += m_w[ i ] * Z( i, j ) * Z( i, l );
+            }
+            m_ZWZ( j, l ) = sum;
+            m_ZWZ( l, j ) = sum;
+        }
+    }
+}
+
+bool
+score_test::is_valid() const
+{
+    return m_valid;
+}
+
+unsigned int
+score_test::compute(const mat &X, size_t num_main, size_t num_tested, const uvec &missing, double &statistic) const
+{
+    size_t q = m_Z.n_cols;
+    size_t k = num_main + num_tested;
+    size_t p = q + k;
+
+    /* Lower triangle of the weighted Gram matrix of [ Z X ] and its
+     * product with the working residuals, the Z block is cached and
+     * only corrected for the samples that are missing in X */
+    mat G = zeros<mat>( p, p );
+    vec c = zeros<vec>( p );
+    for(size_t j = 0; j < q; j++)
+    {
+        c[ j ] = m_Zwr[ j ];
+        for(size_t l = 0; l <= j; l++)
+        {
+            G( j, l ) = m_ZWZ( j, l );
+        }
+    }
+
+    double rwr = m_rwr;
+    double num_samples = m_num_samples;
+    for(size_t i = 0; i < m_w.n_elem; i++)
+    {
+        double w = m_w[ i ];
+        if( w == 0.0 )
+        {
+            continue;
+        }
+
+        if( missing[ i ] != 0 )
+        {
+            for(size_t j = 0; j < q; j++)
+            {
+                c[ j ] -= m_Z( i, j ) * m_wr[ i ];
+                for(size_t l = 0; l <= j; l++)
+                {
+                    G( j, l ) -= w * m_Z( i, j ) * m_Z( i, l );
+                }
+            }
+            rwr -= m_wr[ i ] * m_wr[ i ] / w;
+            num_samples -= 1.0;
+            continue;
+        }
+
+        for(size_t j = 0; j < k; j++)
+        {
+            double xw = w * X( i, j );
+            c[ q + j ] += X( i, j ) * m_wr[ i ];
+            for(size_t l = 0; l < q; l++)
+            {
+                G( q + j, l ) += xw * m_Z( i, l );
+            }
+            for(size_t l = 0; l <= j; l++)
+            {
+                G( q + j, q + l ) += xw * X( i, l );
+            }
+        }
+    }
+
+    /* Solve L u = c with L L^T = G, then u_j^2 is the part of the
+     * residuals explained by column j after the preceding columns.
+     * Columns that are linear combinations of the preceding are
+     * skipped, like empty cells in the factor coding */
+    mat L = zeros<mat>( p, p );
+    vec u = zeros<vec>( p );
+    double explained_null = 0.0;
+    double explained_tested = 0.0;
+    unsigned int rank_null = 0;
+    unsigned int df = 0;
+    for(size_t j = 0; j < p; j++)
+    {
+        double d = G( j, j );
+        for(size_t l = 0; l < j; l++)
+        {
+            d -= L( j, l ) * L( j, l );
+        }
+        if( !( d > GLM_WORKSPACE_MIN_PIVOT * G( j, j ) ) )
+        {
+            continue;
+        }
+
+        L( j, j ) = sqrt( d );
+        for(size_t i = j + 1; i < p; i++)
+        {
+            double s = G( i, j );
+            for(size_t l = 0; l < j; l++)
+            {
+                s -= L( i, l ) * L( j, l );
+            }
+            L( i, j ) = s / L( j, j );
+        }
+
+        double s = c[ j ];
+        for(size_t l = 0; l < j; l++)
+        {
+            s -= L( j, l ) * u[ l ];
+        }
+        u[ j ] = s / L( j, j );
+
+        if( j < q + num_main )
+        {
+            explained_null += u[ j ] * u[ j ];
+            rank_null++;
+        }
+        else
+        {
+            explained_tested += u[ j ] * u[ j ];
+            df++;
+        }
+    }
+
+    double dispersion = 1.0;
+    if( !m_fixed_dispersion )
+    {
+        dispersion = ( rwr - explained_null ) / ( num_samples - rank_null );
+    }
+    if( df == 0 || !( dispersion > 0.0 ) )
+    {
+        return 0;
+    }
+
+    statistic = explained_tested / dispersion;
+
+    return df;
+}
@@ -0,0 +1,112 @@
+#ifndef __SCORE_TEST_H__
+#define __SCORE_TEST_H__
+
+#include <armadillo>
+
+#include <glm/models/glm_model.hpp>
+
+/**
+ * Score test of added columns in a generalized linear model, where
+ * the model of the base columns, typically an intercept and covariates,
+ * is fitted once and shared by all tests.
+ *
+ * The working weights and residuals of the base fit are cached, and
+ * each test projects the working residuals on the base columns, the
+ * main effect columns and the tested columns in one Cholesky
+ * factorization. The main effects are adjusted for by this projection,
+ * which is one scoring step from the base fit, so the statistic is
+ * exact for the linear model and an approximation for other models
+ * with strong main effects.
+ */
+class score_test
+{
+public:
+    /**
+     * Constructor, fits the base model.
+     *
+     * @param Z The base columns, including the intercept.
+     * @param y The observations.
+     * @param missing Identifies missing samples by 1 and non-missing by 0.
+     * @param model The GLM model.
+     */
+    score_test(const arma::mat &Z, const arma::vec &y, const arma::uvec &missing, const glm_model &model);
+
+    /**
+     * Returns true if the base model could be fitted.
+     *
+     * @return True if the base model could be fitted.
+     */
+    bool is_valid() const;
+
+    /**
+     * Computes the score statistic of the tested columns, adjusted for
+     * the base and main effect columns.
+     *
+     * @param X The main effect columns followed by the tested columns,
+     *          further columns are ignored.
+     * @param num_main The number of main effect columns.
+     * @param num_tested The number of tested columns.
+     * @param missing Identifies missing samples by 1, must include the
+     *                samples that were missing for the base model.
+     * @param statistic The chi-square statistic will be stored here.
+     *
+     * @return The degrees of freedom of the statistic, which is less than
+     *         num_tested if some tested columns are linear combinations of
+     *         the others, or 0 if nothing could be tested.
+     */
+    unsigned int compute(const arma::mat &X, size_t num_main, size_t num_tested, const arma::uvec &missing, double &statistic) const;
+
+private:
+    /**
+     * The base columns.
+     */
+    arma::mat m_Z;
+
+    /**
+     * Samples that were missing for the base model.
+     */
+    arma::uvec m_missing;
+
+    /**
+     * The working weight of each sample, 0 if missing.
+     */
+    arma::vec m_w;
+
+    /**
+     * The working residual of each sample multiplied by its weight.
+     */
+    arma::vec m_wr;
+
+    /**
+     * Z^T W Z of the non-missing samples.
+     */
+    arma::mat m_ZWZ;
+
+    /**
+     * Z^T W r of the non-missing samples.
+     */
+    arma::vec m_Zwr;
+
+    /**
+     * The weighted sum of squared working residuals.
+     */
+    double m_rwr;
+
+    /**
+     * The number of non-missing samples.
+     */
+    double m_num_samples;
+
+    /**
+     * True if the dispersion is fixed at 1, otherwise it is estimated
+     * for each test from the residuals of the main effects.
+     */
+    bool m_fixed_dispersion;
+
+    /**
+     * True if the base model could be fitted.
+     */
+    bool m_valid;
+};
+
+#endif /* End of __SCORE_TEST_H__ */
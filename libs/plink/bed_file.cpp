@@ -0,0 +1,299 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <plink/bed_file.hpp>
+
+/**
+ * Number of consecutive rows that a thread decodes at a time.
+ */
+const int BED_DECODE_CHUNK_SIZE = 64;
+
+mapped_file::mapped_file()
+    : m_data( NULL ),
+      m_size( 0 )
+{
+}
+
+mapped_file::~mapped_file()
+{
+    if( m_data != NULL )
+    {
+        munmap( m_data, m_size );
+    }
+}
+
+bool
+mapped_file::open(const std::string &path)
+{
+    int fd = ::open( path.c_str( ), O_RDONLY );
+    if( fd == -1 )
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if( fstat( fd, &file_stat ) != 0 || file_stat.st_size == 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    void *data = mmap( NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( data == MAP_FAILED )
+    {
+        return false;
+    }
+
+    m_data = data;
+    m_size = file_stat.st_size;
+
+    return true;
+}
+
+const unsigned char *
+mapped_file::data() const
+{
+    return (const unsigned char *) m_data;
+}
+
+size_t
+mapped_file::size() const
+{
+    return m_size;
+}
+
+plane_arena::plane_arena(size_t num_words)
+    : m_data( NULL )
+{
+    void *data = NULL;
+    if( num_words > 0 && posix_memalign( &data, PLANE_ROW_ALIGNMENT * sizeof( uint64_t ), num_words * sizeof( uint64_t ) ) == 0 )
+    {
+        m_data = (uint64_t *) data;
+    }
+}
+
+plane_arena::~plane_arena()
+{
+    free( m_data );
+}
+
+uint64_t *
+plane_arena::data()
+{
+    return m_data;
+}
+
+/**
+ * Moves the even bits of a word into the lower 32 bits.
+ *
+ * @param x The word.
+ *
+ * @return Bit i is bit 2 * i of x.
+ */
+static inline uint64_t
+compress_even_bits(uint64_t x)
+{
+    x &= 0x5555555555555555ULL;
+    x = ( x | ( x >> 1 ) ) & 0x3333333333333333ULL;
+    x = ( x | ( x >> 2 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+    x = ( x | ( x >> 4 ) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x | ( x >> 8 ) ) & 0x0000FFFF0000FFFFULL;
+    x = ( x | ( x >> 16 ) ) & 0x00000000FFFFFFFFULL;
+
+    return x;
+}
+
+void
+decode_bed_row(const unsigned char *bytes, size_t num_samples, uint64_t *planes)
+{
+    size_t num_words = snp_row::words_for_size( num_samples );
+    size_t num_bytes = ( num_samples + 3 ) / 4;
+
+    for(size_t w = 0; w < num_words; w++)
+    {
+        /* Each word of a plane holds 64 samples, i.e. 16 bytes of the row */
+        uint64_t low = 0;
+        uint64_t high = 0;
+        for(size_t half = 0; half < 2; half++)
+        {
+            size_t offset = w * 16 + half * 8;
+            uint64_t packed = 0;
+            for(size_t b = 0; b < 8 && offset + b < num_bytes; b++)
+            {
+                packed |= ( (uint64_t) bytes[ offset + b ] ) << ( 8 * b );
+            }
+
+            low |= compress_even_bits( packed ) << ( 32 * half );
+            high |= compress_even_bits( packed >> 1 ) << ( 32 * half );
+        }
+
+        uint64_t valid = ~0ULL;
+        if( w == num_words - 1 && num_samples % SNP_ROW_BITS_PER_WORD != 0 )
+        {
+            valid = ( 1ULL << ( num_samples % SNP_ROW_BITS_PER_WORD ) ) - 1;
+        }
+
+        /* The codes are 0 = hom, 1 = missing, 2 = het and 3 = other hom */
+        planes[ 0 * num_words + w ] = ~low & ~high & valid;
+        planes[ 1 * num_words + w ] = ~low & high & valid;
+        planes[ 2 * num_words + w ] = low & high & valid;
+        planes[ 3 * num_words + w ] = low & ~high & valid;
+    }
+}
+
+size_t
+aligned_row_words(size_t num_samples)
+{
+    size_t row_words = SNP_ROW_NUM_PLANES * snp_row::words_for_size( num_samples );
+
+    return ( row_words + PLANE_ROW_ALIGNMENT - 1 ) / PLANE_ROW_ALIGNMENT * PLANE_ROW_ALIGNMENT;
+}
+
+bool
+planes_need_flip(const uint64_t *planes, size_t num_words)
+{
+    uint64_t mac = 0;
+    uint64_t total = 0;
+    for(size_t w = 0; w < num_words; w++)
+    {
+        uint64_t num_het = __builtin_popcountll( planes[ 1 * num_words + w ] );
+        uint64_t num_hom = __builtin_popcountll( planes[ 2 * num_words + w ] );
+
+        mac += num_het + 2 * num_hom;
+        total += __builtin_popcountll( planes[ w ] ) + num_het + num_hom;
+    }
+
+    /* Same as mac / ( 2 * total ) > 0.5 */
+    return mac > total;
+}
+
+/**
+ * Maps the .bed file of a plink file and checks that it is a
+ * SNP-major file of the expected size.
+ *
+ * @param genotype_file The opened plink file.
+ *
+ * @return The mapped file, or an empty pointer if the .bed file
+ *         could not be mapped or is not SNP-major.
+ */
+static shared_ptr<mapped_file>
+map_bed_file(plink_file_ptr genotype_file)
+{
+    if( genotype_file->get_prefix( ).empty( ) )
+    {
+        return shared_ptr<mapped_file>( );
+    }
+
+    shared_ptr<mapped_file> bed( new mapped_file( ) );
+    if( !bed->open( genotype_file->get_prefix( ) + ".bed" ) )
+    {
+        return shared_ptr<mapped_file>( );
+    }
+
+    size_t row_bytes = ( genotype_file->get_samples( ).size( ) + 3 ) / 4;
+    const unsigned char *data = bed->data( );
+    if( bed->size( ) < BED_HEADER_SIZE + row_bytes * genotype_file->get_loci( ).size( ) ||
+        data[ 0 ] != 0x6c || data[ 1 ] != 0x1b || data[ 2 ] != 0x01 )
+    {
+        return shared_ptr<mapped_file>( );
+    }
+
+    return bed;
+}
+
+genotype_matrix_ptr
+create_mapped_genotype_matrix(plink_file_ptr genotype_file, const std::vector<bool> &include)
+{
+    size_t num_samples = genotype_file->get_samples( ).size( );
+    size_t num_loci = genotype_file->get_loci( ).size( );
+    if( !include.empty( ) && include.size( ) != num_loci )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    shared_ptr<mapped_file> bed = map_bed_file( genotype_file );
+    if( bed.get( ) == NULL )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    std::vector<std::string> locus_names = genotype_file->get_locus_names( );
+    std::vector<size_t> loci;
+    std::vector<std::string> names;
+    for(size_t i = 0; i < num_loci; i++)
+    {
+        if( include.empty( ) || include[ i ] )
+        {
+            loci.push_back( i );
+            names.push_back( locus_names[ i ] );
+        }
+    }
+
+    size_t row_bytes = ( num_samples + 3 ) / 4;
+    const unsigned char *data = bed->data( );
+    size_t num_words = snp_row::words_for_size( num_samples );
+    size_t row_words = aligned_row_words( num_samples );
+
+    shared_ptr<plane_arena> arena( new plane_arena( row_words * loci.size( ) ) );
+    if( arena->data( ) == NULL && row_words * loci.size( ) > 0 )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    shared_ptr< std::vector<snp_row> > rows( new std::vector<snp_row>( loci.size( ) ) );
+    std::vector<genotype_stats> stats( loci.size( ) );
+    bool mafflip = genotype_file->get_mafflip( );
+
+    /* Each row is decoded into its own part of the arena, so rows can be decoded in parallel */
+    #pragma omp parallel for schedule( dynamic, BED_DECODE_CHUNK_SIZE )
+    for(long i = 0; i < (long) loci.size( ); i++)
+    {
+        uint64_t *planes = arena->data( ) + i * row_words;
+        decode_bed_row( data + BED_HEADER_SIZE + loci[ i ] * row_bytes, num_samples, planes );
+
+        bool flip = mafflip && planes_need_flip( planes, num_words );
+        (*rows)[ i ] = snp_row( planes, num_samples, flip );
+        stats[ i ] = compute_genotype_stats( (*rows)[ i ] );
+    }
+
+    return genotype_matrix_ptr( new genotype_matrix( rows, names, arena, stats ) );
+}
+
+bool
+compute_mapped_genotype_stats(plink_file_ptr genotype_file, std::vector<genotype_stats> &stats)
+{
+    shared_ptr<mapped_file> bed = map_bed_file( genotype_file );
+    if( bed.get( ) == NULL )
+    {
+        return false;
+    }
+
+    size_t num_samples = genotype_file->get_samples( ).size( );
+    size_t num_loci = genotype_file->get_loci( ).size( );
+    size_t row_bytes = ( num_samples + 3 ) / 4;
+    size_t num_words = snp_row::words_for_size( num_samples );
+    const unsigned char *data = bed->data( );
+    bool mafflip = genotype_file->get_mafflip( );
+    stats.resize( num_loci );
+
+    #pragma omp parallel
+    {
+        /* Each thread decodes into its own row, which is reused for all its loci */
+        std::vector<uint64_t> planes( SNP_ROW_NUM_PLANES * num_words + 1 );
+
+        #pragma omp for schedule( dynamic, BED_DECODE_CHUNK_SIZE )
+        for(long i = 0; i < (long) num_loci; i++)
+        {
+            decode_bed_row( data + BED_HEADER_SIZE + i * row_bytes, num_samples, &planes[ 0 ] );
+
+            bool flip = mafflip && planes_need_flip( &planes[ 0 ], num_words );
+            stats[ i ] = compute_genotype_stats( snp_row( &planes[ 0 ], num_samples, flip ) );
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,187 @@
+#ifndef __BED_FILE_H__
+#define __BED_FILE_H__
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <plink/plink_file.hpp>
+
+/**
+ * Size in bytes of the header of a .bed file.
+ */
+const size_t BED_HEADER_SIZE = 3;
+
+/**
+ * Number of 64-bit words that rows of planes are aligned to in
+ * arenas and caches, i.e. rows start on a 64 byte boundary.
+ */
+const size_t PLANE_ROW_ALIGNMENT = 8;
+
+/**
+ * A read-only memory map of a file.
+ */
+class mapped_file
+: public genotype_storage
+{
+public:
+    /**
+     * Constructor.
+     */
+    mapped_file();
+
+    /**
+     * Destructor, unmaps the file.
+     */
+    ~mapped_file();
+
+    /**
+     * Maps the given file.
+     *
+     * @param path Path to the file.
+     *
+     * @return True if the file could be mapped, false otherwise.
+     */
+    bool open(const std::string &path);
+
+    /**
+     * Returns the start of the mapped file.
+     *
+     * @return The start of the mapped file, or NULL if not mapped.
+     */
+    const unsigned char *data() const;
+
+    /**
+     * Returns the size of the mapped file.
+     *
+     * @return The size of the mapped file in bytes.
+     */
+    size_t size() const;
+
+private:
+    /**
+     * Prevent copying, since the map is released in the destructor.
+     */
+    mapped_file(const mapped_file &other);
+    mapped_file &operator=(const mapped_file &other);
+
+    /**
+     * The mapped memory.
+     */
+    void *m_data;
+
+    /**
+     * The size of the mapped memory.
+     */
+    size_t m_size;
+};
+
+/**
+ * A single aligned allocation that holds the planes of many rows.
+ */
+class plane_arena
+: public genotype_storage
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param num_words The number of 64-bit words to allocate.
+     */
+    plane_arena(size_t num_words);
+
+    /**
+     * Destructor.
+     */
+    ~plane_arena();
+
+    /**
+     * Returns the allocated words.
+     *
+     * @return The allocated words, or NULL if the allocation failed.
+     */
+    uint64_t *data();
+
+private:
+    /**
+     * Prevent copying, since the memory is released in the destructor.
+     */
+    plane_arena(const plane_arena &other);
+    plane_arena &operator=(const plane_arena &other);
+
+    /**
+     * The allocated words.
+     */
+    uint64_t *m_data;
+};
+
+/**
+ * Decodes a SNP-major .bed row into the 4 planes of a snp_row,
+ * 32 samples at a time.
+ *
+ * @param bytes The packed row, (num_samples + 3) / 4 bytes.
+ * @param num_samples The number of samples in the row.
+ * @param planes The output planes, 4 * snp_row::words_for_size( num_samples ) words.
+ */
+void decode_bed_row(const unsigned char *bytes, size_t num_samples, uint64_t *planes);
+
+/**
+ * Returns the number of words between consecutive rows of planes
+ * when the rows are aligned to PLANE_ROW_ALIGNMENT.
+ *
+ * @param num_samples The number of samples in each row.
+ *
+ * @return The number of words used by each row.
+ */
+size_t aligned_row_words(size_t num_samples);
+
+/**
+ * Determines whether the planes should be flipped so that
+ * the minor allele is 2.
+ *
+ * @param planes The planes of a row.
+ * @param num_words The number of words in each plane.
+ *
+ * @return True if the allele frequency of 2 is above 0.5.
+ */
+bool planes_need_flip(const uint64_t *planes, size_t num_words);
+
+/**
+ * Creates a genotype matrix by decoding a memory mapped SNP-major
+ * .bed file into a single arena of planes. Minor allele flips are
+ * stored as a flag on each row.
+ *
+ * The rows are not views of the .bed file, since the 2-bit encoding
+ * can not be counted as planes. The map is released when the rows
+ * have been decoded, and the arena is private memory of the process
+ * of aligned_row_words( num_samples ) words per row, about twice the
+ * size of the .bed rows. Rows that are shared through the page cache
+ * are read from a genotype cache instead, see genotype_cache.
+ *
+ * @param genotype_file The opened plink file, which provides the
+ *                      path, samples, loci and mafflip setting.
+ * @param include True for each locus that should be decoded, all
+ *                loci are decoded if empty.
+ *
+ * @return The genotype matrix, or an empty pointer if the .bed file
+ *         could not be mapped or is not SNP-major.
+ */
+genotype_matrix_ptr create_mapped_genotype_matrix(plink_file_ptr genotype_file, const std::vector<bool> &include = std::vector<bool>( ));
+
+/**
+ * Computes the statistics of each locus of a memory mapped SNP-major
+ * .bed file without keeping the rows, each row is decoded into a
+ * buffer of the thread that decodes it.
+ *
+ * @param genotype_file The opened plink file, which provides the
+ *                      path, samples, loci and mafflip setting.
+ * @param stats The statistics of each locus in get_loci( ) will be
+ *              stored here.
+ *
+ * @return False if the .bed file could not be mapped or is not
+ *         SNP-major, in which case nothing is stored.
+ */
+bool compute_mapped_genotype_stats(plink_file_ptr genotype_file, std::vector<genotype_stats> &stats);
+
+#endif /* End of __BED_FILE_H__ */
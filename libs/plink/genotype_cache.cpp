@@ -0,0 +1,452 @@
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <plink/genotype_cache.hpp>
+
+/**
+ * Initial value of the FNV-1a checksums.
+ */
+const uint64_t CACHE_CHECKSUM_BASIS = 0xcbf29ce484222325ULL;
+
+/**
+ * Multiplier of the FNV-1a checksums.
+ */
+const uint64_t CACHE_CHECKSUM_PRIME = 0x100000001b3ULL;
+
+/**
+ * Updates a FNV-1a checksum with the given bytes.
+ *
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @param checksum The current checksum.
+ *
+ * @return The updated checksum.
+ */
+static uint64_t
+checksum_bytes(const void *data, size_t size, uint64_t checksum)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    for(size_t i = 0; i < size; i++)
+    {
+        checksum = ( checksum ^ bytes[ i ] ) * CACHE_CHECKSUM_PRIME;
+    }
+
+    return checksum;
+}
+
+/**
+ * Updates a FNV-1a style checksum one word at a time, which
+ * is fast enough for the planes.
+ *
+ * @param words The words.
+ * @param num_words The number of words.
+ * @param checksum The current checksum.
+ *
+ * @return The updated checksum.
+ */
+static uint64_t
+checksum_words(const uint64_t *words, size_t num_words, uint64_t checksum)
+{
+    for(size_t i = 0; i < num_words; i++)
+    {
+        checksum = ( checksum ^ words[ i ] ) * CACHE_CHECKSUM_PRIME;
+    }
+
+    return checksum;
+}
+
+genotype_cache::genotype_cache()
+    : m_header( NULL ),
+      m_samples( NULL ),
+      m_loci( NULL ),
+      m_strings( NULL ),
+      m_planes( NULL )
+{
+}
+
+bool
+genotype_cache::open(const std::string &path)
+{
+    if( !m_file.open( path ) || m_file.size( ) < sizeof( cache_header ) )
+    {
+        return false;
+    }
+
+    const unsigned char *data = m_file.data( );
+    size_t size = m_file.size( );
+    const cache_header *header = (const cache_header *) data;
+    if( memcmp( header->magic, GENOTYPE_CACHE_MAGIC, sizeof( GENOTYPE_CACHE_MAGIC ) ) != 0 ||
+        header->version != GENOTYPE_CACHE_VERSION ||
+        header->header_size != sizeof( cache_header ) )
+    {
+        return false;
+    }
+
+    /* Check that all tables are inside the file before using them */
+    if( header->row_words < aligned_row_words( header->num_samples ) ||
+        header->sample_offset + header->num_samples * sizeof( cache_sample ) > size ||
+        header->locus_offset + header->num_loci * sizeof( cache_locus ) > size ||
+        header->string_offset + header->string_size > size ||
+        header->plane_offset % ( PLANE_ROW_ALIGNMENT * sizeof( uint64_t ) ) != 0 ||
+        header->plane_offset + header->num_loci * header->row_words * sizeof( uint64_t ) > size )
+    {
+        return false;
+    }
+
+    if( header->string_size == 0 || data[ header->string_offset + header->string_size - 1 ] != '\0' )
+    {
+        return false;
+    }
+
+    uint64_t checksum = CACHE_CHECKSUM_BASIS;
+    checksum = checksum_bytes( data + header->sample_offset, header->num_samples * sizeof( cache_sample ), checksum );
+    checksum = checksum_bytes( data + header->locus_offset, header->num_loci * sizeof( cache_locus ), checksum );
+    checksum = checksum_bytes( data + header->string_offset, header->string_size, checksum );
+    if( checksum != header->table_checksum )
+    {
+        return false;
+    }
+
+    m_header = header;
+    m_samples = (const cache_sample *) ( data + header->sample_offset );
+    m_loci = (const cache_locus *) ( data + header->locus_offset );
+    m_strings = (const char *) ( data + header->string_offset );
+    m_planes = (const uint64_t *) ( data + header->plane_offset );
+
+    /* Strings must start inside the string table */
+    for(size_t i = 0; i < header->num_samples; i++)
+    {
+        const cache_sample &sample = m_samples[ i ];
+        if( sample.fid >= header->string_size || sample.iid >= header->string_size ||
+            sample.father_iid >= header->string_size || sample.mother_iid >= header->string_size )
+        {
+            m_header = NULL;
+            return false;
+        }
+    }
+    for(size_t i = 0; i < header->num_loci; i++)
+    {
+        const cache_locus &locus = m_loci[ i ];
+        if( locus.name >= header->string_size || locus.allele1 >= header->string_size ||
+            locus.allele2 >= header->string_size )
+        {
+            m_header = NULL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+genotype_cache::verify() const
+{
+    if( m_header == NULL )
+    {
+        return false;
+    }
+
+    uint64_t checksum = checksum_words( m_planes, m_header->num_loci * m_header->row_words, CACHE_CHECKSUM_BASIS );
+
+    return checksum == m_header->plane_checksum;
+}
+
+bool
+genotype_cache::is_stale(const std::string &bed_path) const
+{
+    struct stat bed_stat;
+    if( m_header == NULL || stat( bed_path.c_str( ), &bed_stat ) != 0 )
+    {
+        return false;
+    }
+
+    return (uint64_t) bed_stat.st_size != m_header->bed_size || (int64_t) bed_stat.st_mtime != m_header->bed_mtime;
+}
+
+char *
+genotype_cache::get_string(uint32_t offset) const
+{
+    /* libplinkio uses non-const strings, but they are never modified */
+    return const_cast<char *>( m_strings + offset );
+}
+
+std::vector<pio_sample_t>
+genotype_cache::get_samples() const
+{
+    std::vector<pio_sample_t> samples( num_samples( ) );
+    for(size_t i = 0; i < samples.size( ); i++)
+    {
+        const cache_sample &sample = m_samples[ i ];
+        samples[ i ].pio_id = i;
+        samples[ i ].fid = get_string( sample.fid );
+        samples[ i ].iid = get_string( sample.iid );
+        samples[ i ].father_iid = get_string( sample.father_iid );
+        samples[ i ].mother_iid = get_string( sample.mother_iid );
+        samples[ i ].sex = (enum sex_t) sample.sex;
+        samples[ i ].affection = (enum affection_t) sample.affection;
+        samples[ i ].phenotype = sample.phenotype;
+    }
+
+    return samples;
+}
+
+std::vector<pio_locus_t>
+genotype_cache::get_loci() const
+{
+    std::vector<pio_locus_t> loci( num_loci( ) );
+    for(size_t i = 0; i < loci.size( ); i++)
+    {
+        const cache_locus &locus = m_loci[ i ];
+        loci[ i ].pio_id = i;
+        loci[ i ].chromosome = locus.chromosome;
+        loci[ i ].name = get_string( locus.name );
+        loci[ i ].position = locus.position;
+        loci[ i ].bp_position = locus.bp_position;
+        loci[ i ].allele1 = get_string( locus.allele1 );
+        loci[ i ].allele2 = get_string( locus.allele2 );
+    }
+
+    return loci;
+}
+
+size_t
+genotype_cache::num_samples() const
+{
+    return m_header != NULL ? m_header->num_samples : 0;
+}
+
+size_t
+genotype_cache::num_loci() const
+{
+    return m_header != NULL ? m_header->num_loci : 0;
+}
+
+const uint64_t *
+genotype_cache::get_planes(size_t locus) const
+{
+    return m_planes + locus * m_header->row_words;
+}
+
+bool
+genotype_cache::is_flipped(size_t locus) const
+{
+    return m_loci[ locus ].flip != 0;
+}
+
+float
+genotype_cache::get_maf(size_t locus) const
+{
+    return m_loci[ locus ].maf;
+}
+
+size_t
+genotype_cache::get_num_missing(size_t locus) const
+{
+    return m_loci[ locus ].counts[ 3 ];
+}
+
+genotype_stats
+genotype_cache::get_stats(size_t locus, bool flip) const
+{
+    genotype_stats stats;
+    for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
+    {
+        stats.counts[ g ] = m_loci[ locus ].counts[ g ];
+    }
+    if( flip )
+    {
+        std::swap( stats.counts[ 0 ], stats.counts[ 2 ] );
+    }
+    stats.maf = m_loci[ locus ].maf;
+
+    return stats;
+}
+
+/**
+ * Appends a string to the string table.
+ *
+ * @param strings The string table.
+ * @param str The string to append, NULL is stored as an empty string.
+ *
+ * @return The offset of the string in the table.
+ */
+static uint32_t
+add_string(std::string &strings, const char *str)
+{
+    uint32_t offset = strings.size( );
+    if( str != NULL )
+    {
+        strings.append( str );
+    }
+    strings.push_back( '\0' );
+
+    return offset;
+}
+
+/**
+ * Rounds an offset up to the alignment of the planes.
+ *
+ * @param offset The offset.
+ *
+ * @return The aligned offset.
+ */
+static uint64_t
+align_plane_offset(uint64_t offset)
+{
+    uint64_t alignment = PLANE_ROW_ALIGNMENT * sizeof( uint64_t );
+
+    return ( offset + alignment - 1 ) / alignment * alignment;
+}
+
+bool
+write_genotype_cache(plink_file_ptr genotype_file, const std::string &path)
+{
+    const std::vector<pio_sample_t> &samples = genotype_file->get_samples( );
+    const std::vector<pio_locus_t> &loci = genotype_file->get_loci( );
+    genotype_matrix_ptr genotypes = create_genotype_matrix( genotype_file );
+    if( genotypes->size( ) != loci.size( ) )
+    {
+        return false;
+    }
+
+    cache_header header;
+    memset( &header, 0, sizeof( cache_header ) );
+    memcpy( header.magic, GENOTYPE_CACHE_MAGIC, sizeof( GENOTYPE_CACHE_MAGIC ) );
+    header.version = GENOTYPE_CACHE_VERSION;
+    header.header_size = sizeof( cache_header );
+    header.num_samples = samples.size( );
+    header.num_loci = loci.size( );
+    header.row_words = aligned_row_words( samples.size( ) );
+
+    struct stat bed_stat;
+    if( stat( ( genotype_file->get_prefix( ) + ".bed" ).c_str( ), &bed_stat ) == 0 )
+    {
+        header.bed_size = bed_stat.st_size;
+        header.bed_mtime = bed_stat.st_mtime;
+    }
+
+    std::string strings;
+    std::vector<cache_sample> sample_table( samples.size( ) );
+    for(size_t i = 0; i < samples.size( ); i++)
+    {
+        memset( &sample_table[ i ], 0, sizeof( cache_sample ) );
+        sample_table[ i ].fid = add_string( strings, samples[ i ].fid );
+        sample_table[ i ].iid = add_string( strings, samples[ i ].iid );
+        sample_table[ i ].father_iid = add_string( strings, samples[ i ].father_iid );
+        sample_table[ i ].mother_iid = add_string( strings, samples[ i ].mother_iid );
+        sample_table[ i ].sex = samples[ i ].sex;
+        sample_table[ i ].affection = samples[ i ].affection;
+        sample_table[ i ].phenotype = samples[ i ].phenotype;
+    }
+
+    /* Rows are stored unflipped, the flip and statistics are stored per locus */
+    std::vector<cache_locus> locus_table( loci.size( ) );
+    for(size_t i = 0; i < loci.size( ); i++)
+    {
+        snp_row row = genotypes->get_row( i );
+        row.set_flipped( false );
+        genotype_stats stats = compute_genotype_stats( row );
+
+        cache_locus &locus = locus_table[ i ];
+        memset( &locus, 0, sizeof( cache_locus ) );
+        locus.bp_position = loci[ i ].bp_position;
+        locus.name = add_string( strings, loci[ i ].name );
+        locus.allele1 = add_string( strings, loci[ i ].allele1 );
+        locus.allele2 = add_string( strings, loci[ i ].allele2 );
+        locus.position = loci[ i ].position;
+        locus.maf = stats.maf;
+        for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
+        {
+            locus.counts[ g ] = stats.counts[ g ];
+        }
+        locus.chromosome = loci[ i ].chromosome;
+        locus.flip = planes_need_flip( row.get_plane( 0 ), row.num_words( ) );
+    }
+
+    header.sample_offset = sizeof( cache_header );
+    header.locus_offset = header.sample_offset + sample_table.size( ) * sizeof( cache_sample );
+    header.string_offset = header.locus_offset + locus_table.size( ) * sizeof( cache_locus );
+    header.string_size = strings.size( );
+    header.plane_offset = align_plane_offset( header.string_offset + header.string_size );
+
+    uint64_t checksum = CACHE_CHECKSUM_BASIS;
+    checksum = checksum_bytes( sample_table.empty( ) ? NULL : &sample_table[ 0 ], sample_table.size( ) * sizeof( cache_sample ), checksum );
+    checksum = checksum_bytes( locus_table.empty( ) ? NULL : &locus_table[ 0 ], locus_table.size( ) * sizeof( cache_locus ), checksum );
+    checksum = checksum_bytes( strings.data( ), strings.size( ), checksum );
+    header.table_checksum = checksum;
+
+    std::string tmp_path = path + ".tmp";
+    FILE *fp = fopen( tmp_path.c_str( ), "wb" );
+    if( fp == NULL )
+    {
+        return false;
+    }
+
+    std::vector<char> padding( header.plane_offset - header.string_offset - header.string_size, 0 );
+    bool ok = fwrite( &header, sizeof( cache_header ), 1, fp ) == 1;
+    ok = ok && ( sample_table.empty( ) || fwrite( &sample_table[ 0 ], sizeof( cache_sample ), sample_table.size( ), fp ) == sample_table.size( ) );
+    ok = ok && ( locus_table.empty( ) || fwrite( &locus_table[ 0 ], sizeof( cache_locus ), locus_table.size( ), fp ) == locus_table.size( ) );
+    ok = ok && fwrite( strings.data( ), 1, strings.size( ), fp ) == strings.size( );
+    ok = ok && ( padding.empty( ) || fwrite( &padding[ 0 ], 1, padding.size( ), fp ) == padding.size( ) );
+
+    std::vector<uint64_t> row_buffer( header.row_words, 0 );
+    uint64_t plane_checksum = CACHE_CHECKSUM_BASIS;
+    for(size_t i = 0; i < loci.size( ) && ok; i++)
+    {
+        snp_row row = genotypes->get_row( i );
+        row.set_flipped( false );
+
+        size_t num_words = row.num_words( );
+        for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
+        {
+            memcpy( &row_buffer[ g * num_words ], row.get_plane( g ), num_words * sizeof( uint64_t ) );
+        }
+
+        plane_checksum = checksum_words( &row_buffer[ 0 ], row_buffer.size( ), plane_checksum );
+        ok = fwrite( &row_buffer[ 0 ], sizeof( uint64_t ), row_buffer.size( ), fp ) == row_buffer.size( );
+    }
+
+    /* The plane checksum is only known at the end */
+    header.plane_checksum = plane_checksum;
+    ok = ok && fseek( fp, 0L, SEEK_SET ) == 0;
+    ok = ok && fwrite( &header, sizeof( cache_header ), 1, fp ) == 1;
+    ok = ( fclose( fp ) == 0 ) && ok;
+
+    if( !ok || rename( tmp_path.c_str( ), path.c_str( ) ) != 0 )
+    {
+        remove( tmp_path.c_str( ) );
+        return false;
+    }
+
+    return true;
+}
+
+genotype_matrix_ptr
+create_cached_genotype_matrix(plink_file_ptr genotype_file, const std::vector<bool> &include)
+{
+    genotype_cache_ptr cache = genotype_file->get_cache( );
+    if( cache.get( ) == NULL || ( !include.empty( ) && include.size( ) != cache->num_loci( ) ) )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    shared_ptr< std::vector<snp_row> > rows( new std::vector<snp_row>( ) );
+    std::vector<std::string> names;
+    std::vector<genotype_stats> stats;
+    rows->reserve( cache->num_loci( ) );
+    for(size_t i = 0; i < cache->num_loci( ); i++)
+    {
+        if( include.empty( ) || include[ i ] )
+        {
+            bool flip = genotype_file->get_mafflip( ) && cache->is_flipped( i );
+            rows->push_back( snp_row( cache->get_planes( i ), cache->num_samples( ), flip ) );
+            names.push_back( genotype_file->get_loci( )[ i ].name );
+            stats.push_back( cache->get_stats( i, flip ) );
+        }
+    }
+
+    return genotype_matrix_ptr( new genotype_matrix( rows, names, cache, stats ) );
+}
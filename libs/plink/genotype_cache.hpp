@@ -0,0 +1,340 @@
+#ifndef __GENOTYPE_CACHE_H__
+#define __GENOTYPE_CACHE_H__
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <plink/bed_file.hpp>
+#include <plink/plink_file.hpp>
+
+/**
+ * Extension of genotype cache files, the cache of a plink file
+ * is stored next to it as prefix + GENOTYPE_CACHE_EXTENSION.
+ */
+const std::string GENOTYPE_CACHE_EXTENSION = ".bcache";
+
+/**
+ * Identifies genotype cache files.
+ */
+const char GENOTYPE_CACHE_MAGIC[ 8 ] = { 'B', 'E', 'S', 'I', 'Q', 'G', 'C', '\0' };
+
+/**
+ * Version of the cache format, caches with another version
+ * are ignored.
+ */
+const uint32_t GENOTYPE_CACHE_VERSION = 2;
+
+/**
+ * Header of a genotype cache file. All offsets are in bytes from
+ * the start of the file, and strings are offsets into the string
+ * table.
+ */
+#pragma pack(push, 1)
+struct cache_header
+{
+    /**
+     * Equal to GENOTYPE_CACHE_MAGIC.
+     */
+    char magic[ 8 ];
+
+    /**
+     * Equal to GENOTYPE_CACHE_VERSION.
+     */
+    uint32_t version;
+
+    /**
+     * Size of this header, to detect incompatible builds.
+     */
+    uint32_t header_size;
+
+    /**
+     * Number of samples in each row.
+     */
+    uint64_t num_samples;
+
+    /**
+     * Number of loci, i.e. rows.
+     */
+    uint64_t num_loci;
+
+    /**
+     * Number of words between consecutive rows of planes.
+     */
+    uint64_t row_words;
+
+    /**
+     * Offset of the cache_sample table.
+     */
+    uint64_t sample_offset;
+
+    /**
+     * Offset of the cache_locus table.
+     */
+    uint64_t locus_offset;
+
+    /**
+     * Offset and size of the string table.
+     */
+    uint64_t string_offset;
+    uint64_t string_size;
+
+    /**
+     * Offset of the planes of the first row, aligned to 64 bytes.
+     */
+    uint64_t plane_offset;
+
+    /**
+     * Size and modification time of the .bed file that the
+     * cache was created from, used to detect stale caches.
+     */
+    uint64_t bed_size;
+    int64_t bed_mtime;
+
+    /**
+     * Checksum of the sample, locus and string tables.
+     */
+    uint64_t table_checksum;
+
+    /**
+     * Checksum of all planes.
+     */
+    uint64_t plane_checksum;
+};
+
+/**
+ * A sample in the cache.
+ */
+struct cache_sample
+{
+    uint32_t fid;
+    uint32_t iid;
+    uint32_t father_iid;
+    uint32_t mother_iid;
+    int32_t sex;
+    int32_t affection;
+    float phenotype;
+    uint32_t reserved;
+};
+
+/**
+ * A locus in the cache, together with statistics that are
+ * computed when the cache is created.
+ */
+struct cache_locus
+{
+    int64_t bp_position;
+    uint32_t name;
+    uint32_t allele1;
+    uint32_t allele2;
+    float position;
+
+    /**
+     * Minor allele frequency, i.e. at most 0.5.
+     */
+    float maf;
+
+    /**
+     * Number of samples with genotype 0, 1, 2 and 3 (missing)
+     * before any flip.
+     */
+    uint32_t counts[ 4 ];
+
+    uint8_t chromosome;
+
+    /**
+     * 1 if the allele coded as 2 is the major allele, so that the row
+     * should be flipped when the minor allele is requested.
+     */
+    uint8_t flip;
+    uint8_t reserved[ 2 ];
+};
+#pragma pack(pop)
+
+/**
+ * A memory mapped genotype cache. The rows are stored as the
+ * planes of snp_row without any flips, so that rows can refer
+ * directly to the mapped memory.
+ */
+class genotype_cache
+: public genotype_storage
+{
+public:
+    /**
+     * Constructor.
+     */
+    genotype_cache();
+
+    /**
+     * Maps the given cache and validates its header and tables.
+     *
+     * @param path Path to the cache.
+     *
+     * @return True if the cache could be mapped and is valid,
+     *         false otherwise.
+     */
+    bool open(const std::string &path);
+
+    /**
+     * Verifies the checksum of all planes, this reads the
+     * whole cache.
+     *
+     * @return True if the planes are intact, false otherwise.
+     */
+    bool verify() const;
+
+    /**
+     * Determines whether the given .bed file has changed since the
+     * cache was created.
+     *
+     * @param bed_path Path to the .bed file.
+     *
+     * @return True if the .bed file exists and has another size or
+     *         modification time than when the cache was created.
+     */
+    bool is_stale(const std::string &bed_path) const;
+
+    /**
+     * Returns the samples, the strings refer to the cache.
+     *
+     * @return The samples in the cache.
+     */
+    std::vector<pio_sample_t> get_samples() const;
+
+    /**
+     * Returns the loci, the strings refer to the cache.
+     *
+     * @return The loci in the cache.
+     */
+    std::vector<pio_locus_t> get_loci() const;
+
+    /**
+     * Returns the number of samples.
+     *
+     * @return The number of samples.
+     */
+    size_t num_samples() const;
+
+    /**
+     * Returns the number of loci.
+     *
+     * @return The number of loci.
+     */
+    size_t num_loci() const;
+
+    /**
+     * Returns the unflipped planes of a locus.
+     *
+     * @param locus The index of the locus.
+     *
+     * @return The planes of the locus.
+     */
+    const uint64_t *get_planes(size_t locus) const;
+
+    /**
+     * Returns true if the locus should be flipped so that
+     * the minor allele is 2.
+     *
+     * @param locus The index of the locus.
+     *
+     * @return True if the locus should be flipped.
+     */
+    bool is_flipped(size_t locus) const;
+
+    /**
+     * Returns the minor allele frequency of a locus.
+     *
+     * @param locus The index of the locus.
+     *
+     * @return The minor allele frequency, NaN if all samples are missing.
+     */
+    float get_maf(size_t locus) const;
+
+    /**
+     * Returns the number of missing genotypes of a locus.
+     *
+     * @param locus The index of the locus.
+     *
+     * @return The number of missing genotypes.
+     */
+    size_t get_num_missing(size_t locus) const;
+
+    /**
+     * Returns the genotype counts and minor allele frequency
+     * of a locus.
+     *
+     * @param locus The index of the locus.
+     * @param flip If true, the counts of genotype 0 and 2 are swapped.
+     *
+     * @return The statistics of the locus.
+     */
+    genotype_stats get_stats(size_t locus, bool flip) const;
+
+private:
+    /**
+     * Prevent copying, the pointers refer to the map.
+     */
+    genotype_cache(const genotype_cache &other);
+    genotype_cache &operator=(const genotype_cache &other);
+
+    /**
+     * Returns a string from the string table.
+     *
+     * @param offset Offset of the string.
+     *
+     * @return The string.
+     */
+    char *get_string(uint32_t offset) const;
+
+    /**
+     * The mapped cache file.
+     */
+    mapped_file m_file;
+
+    /**
+     * The header, NULL if not opened.
+     */
+    const cache_header *m_header;
+
+    /**
+     * The tables in the mapped file.
+     */
+    const cache_sample *m_samples;
+    const cache_locus *m_loci;
+    const char *m_strings;
+
+    /**
+     * The planes of the first row.
+     */
+    const uint64_t *m_planes;
+};
+
+typedef shared_ptr<genotype_cache> genotype_cache_ptr;
+
+/**
+ * Writes a genotype cache for an opened plink file. The cache is
+ * first written to a temporary file that is then renamed, so that
+ * jobs that map an existing cache are not affected.
+ *
+ * @param genotype_file The plink file, should be opened without mafflip.
+ * @param path Path to the cache.
+ *
+ * @return True if the cache could be written, false otherwise.
+ */
+bool write_genotype_cache(plink_file_ptr genotype_file, const std::string &path);
+
+/**
+ * Creates a genotype matrix where the rows refer directly to the
+ * planes in the cache of the given plink file.
+ *
+ * @param genotype_file A plink file that was opened from a cache.
+ * @param include True for each locus that should be part of the
+ *                matrix, all loci are included if empty.
+ *
+ * @return The genotype matrix, or an empty pointer if the plink
+ *         file has no cache.
+ */
+genotype_matrix_ptr create_cached_genotype_matrix(plink_file_ptr genotype_file, const std::vector<bool> &include = std::vector<bool>( ));
+
+#endif /* End of __GENOTYPE_CACHE_H__ */
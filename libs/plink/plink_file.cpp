@@ -1,14 +1,33 @@
+#include <algorithm>
+#include <iostream>
+
 #include <plink/plink_file.hpp>
+#include <plink/bed_file.hpp>
+#include <plink/genotype_cache.hpp>
 
-plink_file::plink_file(const pio_file_t &file, const std::vector<pio_sample_t> &samples, const std::vector<pio_locus_t> &loci, bool mafflip)
+plink_file::plink_file(const pio_file_t &file, const std::vector<pio_sample_t> &samples, const std::vector<pio_locus_t> &loci, bool mafflip, const std::string &prefix)
     : m_file( file ),
       m_samples( samples ),
       m_loci( loci ),
-      m_mafflip( mafflip )
+      m_mafflip( mafflip ),
+      m_prefix( prefix ),
+      m_next_locus( 0 )
 {
     m_row_buffer = (snp_t *) malloc( sizeof( snp_t ) * samples.size( ) );
 }
 
+plink_file::plink_file(shared_ptr<genotype_cache> cache, bool mafflip, const std::string &prefix)
+    : m_file( ),
+      m_samples( cache->get_samples( ) ),
+      m_loci( cache->get_loci( ) ),
+      m_row_buffer( NULL ),
+      m_mafflip( mafflip ),
+      m_prefix( prefix ),
+      m_cache( cache ),
+      m_next_locus( 0 )
+{
+}
+
 const std::vector<pio_sample_t> &
 plink_file::get_samples() const
 {
@@ -57,6 +76,24 @@ plink_file::get_locus_names() const
     return loci_names;
 }
 
+const std::string &
+plink_file::get_prefix() const
+{
+    return m_prefix;
+}
+
+bool
+plink_file::get_mafflip() const
+{
+    return m_mafflip;
+}
+
+shared_ptr<genotype_cache>
+plink_file::get_cache() const
+{
+    return m_cache;
+}
+
 float compute_maf(snp_t *row, size_t length)
 {
     int mac = 0;
@@ -73,43 +110,56 @@ float compute_maf(snp_t *row, size_t length)
     return ((float) mac) / ( 2 * total );
 }
 
-float compute_real_maf(snp_row &row)
+genotype_stats
+compute_genotype_stats(const snp_row &row)
 {
-    int mac = 0;
-    int total = 0;
-    for(int i = 0; i < row.size( ); i++)
+    genotype_stats stats;
+    for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
     {
-        if( row[ i ] != 3 )
+        const uint64_t *plane = row.get_plane( g );
+        stats.counts[ g ] = 0;
+        for(size_t w = 0; w < row.num_words( ); w++)
         {
-            mac += row[ i ];
-            total++;
+            stats.counts[ g ] += __builtin_popcountll( plane[ w ] );
         }
     }
 
+    int mac = stats.counts[ 1 ] + 2 * stats.counts[ 2 ];
+    int total = stats.counts[ 0 ] + stats.counts[ 1 ] + stats.counts[ 2 ];
     float maf = ((float) mac) / ( 2 * total );
+    stats.maf = std::min( maf, 1 - maf );
 
-    return std::min( maf, 1 - maf );
+    return stats;
 }
 
 bool
 plink_file::next_row(snp_row &row)
 {
+    if( m_cache.get( ) != NULL )
+    {
+        if( m_next_locus >= m_cache->num_loci( ) )
+        {
+            return false;
+        }
+
+        bool flip = m_mafflip && m_cache->is_flipped( m_next_locus );
+        row = snp_row( m_cache->get_planes( m_next_locus ), m_cache->num_samples( ), flip );
+        m_next_locus++;
+
+        return true;
+    }
+
     if( pio_next_row( &m_file, m_row_buffer ) == PIO_OK )
     {
         row.resize( pio_row_size( &m_file ) );
-        float maf = compute_maf( m_row_buffer, row.size( ) );
-        bool flip = m_mafflip && maf > 0.5;
         for(int i = 0; i < row.size( ); i++)
         {
-            if( flip && m_row_buffer[ i ] != 3 )
-            {
-                row.assign( i, 2 - m_row_buffer[ i ] );
-            }
-            else
-            {
-                row.assign( i, m_row_buffer[ i ] );
-            }
+            row.assign( i, m_row_buffer[ i ] );
         }
+
+        float maf = compute_maf( m_row_buffer, row.size( ) );
+        row.set_flipped( m_mafflip && maf > 0.5 );
+
         return true;
     }
     else
@@ -121,12 +171,39 @@ plink_file::next_row(snp_row &row)
 plink_file::~plink_file()
 {
     free( m_row_buffer );
-    pio_close( &m_file );
+    if( m_cache.get( ) == NULL )
+    {
+        pio_close( &m_file );
+    }
 }
 
 plink_file_ptr
 open_plink_file(const std::string &plink_prefix, bool mafflip)
 {
+    std::string cache_path = plink_prefix + GENOTYPE_CACHE_EXTENSION;
+    std::string prefix = plink_prefix;
+    if( plink_prefix.size( ) > GENOTYPE_CACHE_EXTENSION.size( ) &&
+        plink_prefix.compare( plink_prefix.size( ) - GENOTYPE_CACHE_EXTENSION.size( ), GENOTYPE_CACHE_EXTENSION.size( ), GENOTYPE_CACHE_EXTENSION ) == 0 )
+    {
+        cache_path = plink_prefix;
+        prefix = plink_prefix.substr( 0, plink_prefix.size( ) - GENOTYPE_CACHE_EXTENSION.size( ) );
+    }
+
+    genotype_cache_ptr cache( new genotype_cache( ) );
+    if( cache->open( cache_path ) )
+    {
+        if( !cache->is_stale( prefix + ".bed" ) )
+        {
+            return plink_file_ptr( new plink_file( cache, mafflip, prefix ) );
+        }
+
+        std::cerr << "besiq: warning: Ignoring genotype cache " << cache_path << " since " << prefix << ".bed has changed." << std::endl;
+    }
+    else if( cache_path == plink_prefix )
+    {
+        throw plink_error( "Couldn't open genotype cache " + plink_prefix );
+    }
+
     pio_file_t file;
     if( pio_open( &file, plink_prefix.c_str( ) ) != PIO_OK )
     {
@@ -145,7 +222,7 @@ open_plink_file(const std::string &plink_prefix, bool mafflip)
         loci.push_back( *pio_get_locus( &file, i ) );
     }
 
-    return plink_file_ptr( new plink_file( file, samples, loci, mafflip ) );
+    return plink_file_ptr( new plink_file( file, samples, loci, mafflip, plink_prefix ) );
 }
 
 bool
@@ -154,47 +231,193 @@ get_snp_row(plink_file *file, snp_row &row)
     return file->next_row( row );
 }
 
+/**
+ * Creates a matrix where the rows are views into a memory mapped
+ * genotype cache, or into a private arena that the memory mapped .bed
+ * file is decoded into, see create_mapped_genotype_matrix.
+ *
+ * @param genotype_file A plink file.
+ * @param include True for each locus that should be part of the
+ *                matrix, all loci are included if empty.
+ *
+ * @return The matrix, or an empty pointer if neither the cache nor the
+ *         memory map could be used.
+ */
+static genotype_matrix_ptr
+create_view_genotype_matrix(plink_file_ptr genotype_file, const std::vector<bool> &include)
+{
+    genotype_matrix_ptr cached = create_cached_genotype_matrix( genotype_file, include );
+    if( cached.get( ) != NULL )
+    {
+        return cached;
+    }
+
+    return create_mapped_genotype_matrix( genotype_file, include );
+}
+
 genotype_matrix_ptr
 create_genotype_matrix(plink_file_ptr genotype_file)
 {
+    return create_genotype_matrix( genotype_file, std::vector<bool>( ) );
+}
+
+genotype_matrix_ptr
+create_genotype_matrix(plink_file_ptr genotype_file, const std::vector<bool> &include)
+{
+    genotype_matrix_ptr mapped = create_view_genotype_matrix( genotype_file, include );
+    if( mapped.get( ) != NULL )
+    {
+        return mapped;
+    }
+
     shared_ptr< std::vector<snp_row> > genotypes( new std::vector<snp_row>( ) );
+    std::vector<std::string> locus_names;
+    std::vector<genotype_stats> stats;
+    genotypes->reserve( genotype_file->get_loci( ).size( ) );
+    snp_row row;
+    size_t i = 0;
+    while( genotype_file->next_row( row ) )
+    {
+        if( include.empty( ) || ( i < include.size( ) && include[ i ] ) )
+        {
+            genotypes->push_back( row );
+            locus_names.push_back( genotype_file->get_loci( )[ i ].name );
+            stats.push_back( compute_genotype_stats( row ) );
+        }
+        i++;
+    }
+
+    return genotype_matrix_ptr( new genotype_matrix( genotypes, locus_names, genotype_storage_ptr( ), stats ) );
+}
+
+/**
+ * Computes the statistics of each locus from a genotype cache or a
+ * memory map of the .bed file, without keeping the rows.
+ *
+ * @param genotype_file A plink file.
+ * @param stats The statistics of each locus will be stored here.
+ *
+ * @return False if neither the cache nor the memory map could be
+ *         used, in which case the rows must be streamed.
+ */
+static bool
+compute_view_stats(plink_file_ptr genotype_file, std::vector<genotype_stats> &stats)
+{
+    genotype_cache_ptr cache = genotype_file->get_cache( );
+    if( cache.get( ) != NULL )
+    {
+        stats.resize( cache->num_loci( ) );
+        for(size_t i = 0; i < cache->num_loci( ); i++)
+        {
+            stats[ i ] = cache->get_stats( i, genotype_file->get_mafflip( ) && cache->is_flipped( i ) );
+        }
+
+        return true;
+    }
+
+    return compute_mapped_genotype_stats( genotype_file, stats );
+}
+
+std::vector<genotype_stats>
+compute_locus_stats(plink_file_ptr genotype_file)
+{
+    std::vector<genotype_stats> stats;
+    if( compute_view_stats( genotype_file, stats ) )
+    {
+        return stats;
+    }
+
     snp_row row;
+    stats.reserve( genotype_file->get_loci( ).size( ) );
     while( genotype_file->next_row( row ) )
     {
-        genotypes->push_back( row );
+        stats.push_back( compute_genotype_stats( row ) );
     }
 
-    return genotype_matrix_ptr( new genotype_matrix( genotypes, genotype_file->get_locus_names( ) ) );
+    return stats;
 }
 
 genotype_matrix_ptr
 create_filtered_genotype_matrix(plink_file_ptr genotype_file, float maf_threshold)
 {
+    /* Cached and mapped rows can be decoded again, so only the rows that pass are decoded */
+    std::vector<genotype_stats> all_stats;
+    if( compute_view_stats( genotype_file, all_stats ) )
+    {
+        std::vector<bool> include( all_stats.size( ) );
+        for(size_t i = 0; i < all_stats.size( ); i++)
+        {
+            include[ i ] = all_stats[ i ].maf >= maf_threshold;
+        }
+
+        return create_genotype_matrix( genotype_file, include );
+    }
+
+    /* Otherwise the rows are streamed, and only the rows that pass are kept */
     shared_ptr< std::vector<snp_row> > genotypes( new std::vector<snp_row>( ) );
     std::vector<std::string> locus_names;
+    std::vector<genotype_stats> stats;
     snp_row row;
-    int i = 0;
+    size_t i = 0;
     while( genotype_file->next_row( row ) )
     {
-        float maf = compute_real_maf( row );
-        if( maf >= maf_threshold )
+        genotype_stats row_stats = compute_genotype_stats( row );
+        if( row_stats.maf >= maf_threshold )
         {
             genotypes->push_back( row );
             locus_names.push_back( genotype_file->get_loci( )[ i ].name );
+            stats.push_back( row_stats );
         }
         i++;
     }
 
-    return genotype_matrix_ptr( new genotype_matrix( genotypes, locus_names ) );
+    return genotype_matrix_ptr( new genotype_matrix( genotypes, locus_names, genotype_storage_ptr( ), stats ) );
 }
 
 genotype_matrix::genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names) 
     : m_matrix( matrix ),
     m_snp_names( snp_names )
 {
-    for(int i = 0; i < snp_names.size( ); i++)
+    init( );
+}
+
+genotype_matrix::genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, genotype_storage_ptr storage)
+    : m_matrix( matrix ),
+    m_storage( storage ),
+    m_snp_names( snp_names )
+{
+    init( );
+}
+
+genotype_matrix::genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, genotype_storage_ptr storage, const std::vector<genotype_stats> &stats)
+    : m_matrix( matrix ),
+    m_storage( storage ),
+    m_stats( stats ),
+    m_snp_names( snp_names )
+{
+    init( );
+}
+
+void
+genotype_matrix::init()
+{
+    for(int i = 0; i < m_snp_names.size( ); i++)
+    {
+        m_snp_to_index[ m_snp_names[ i ] ] = i;
+    }
+
+    for(size_t i = 0; i < m_matrix->size( ); i++)
     {
-        m_snp_to_index[ snp_names[ i ] ] = i;
+        (*m_matrix)[ i ].set_index( i );
+    }
+
+    if( m_stats.size( ) != m_matrix->size( ) )
+    {
+        m_stats.resize( m_matrix->size( ) );
+        for(size_t i = 0; i < m_matrix->size( ); i++)
+        {
+            m_stats[ i ] = compute_genotype_stats( (*m_matrix)[ i ] );
+        }
     }
 }
 
@@ -217,12 +440,95 @@ genotype_matrix::get_row(size_t index) const
     return (*m_matrix)[ index ];
 }
 
+class_counts_ptr
+genotype_matrix::get_class_counts(const std::vector< std::vector<uint64_t> > &masks)
+{
+    for(size_t k = 0; k < m_class_counts.size( ); k++)
+    {
+        if( m_class_counts[ k ].first == masks )
+        {
+            return m_class_counts[ k ].second;
+        }
+    }
+
+    class_counts_ptr counts( new std::vector<genotype_class_counts>( m_matrix->size( ) ) );
+    size_t num_classes = std::min( masks.size( ), GENOTYPE_MAX_CLASSES );
+    #pragma omp parallel for
+    for(long r = 0; r < (long) m_matrix->size( ); r++)
+    {
+        const snp_row &row = (*m_matrix)[ r ];
+        genotype_class_counts &row_counts = (*counts)[ r ];
+        for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
+        {
+            const uint64_t *plane = row.get_plane( g );
+            for(size_t c = 0; c < GENOTYPE_MAX_CLASSES; c++)
+            {
+                row_counts.n[ g ][ c ] = 0;
+                if( c >= num_classes )
+                {
+                    continue;
+                }
+
+                size_t num_words = std::min( row.num_words( ), masks[ c ].size( ) );
+                for(size_t w = 0; w < num_words; w++)
+                {
+                    row_counts.n[ g ][ c ] += __builtin_popcountll( plane[ w ] & masks[ c ][ w ] );
+                }
+            }
+        }
+    }
+
+    m_class_counts.push_back( std::make_pair( masks, counts ) );
+
+    return counts;
+}
+
+size_t
+genotype_matrix::get_index(const snp_row &row) const
+{
+    size_t index = row.get_index( );
+    if( index < m_matrix->size( ) && &(*m_matrix)[ index ] == &row )
+    {
+        return index;
+    }
+
+    return GENOTYPE_MISSING_INDEX;
+}
+
+std::vector<size_t>
+genotype_matrix::get_indices(const std::vector<std::string> &names) const
+{
+    std::vector<size_t> indices( names.size( ), GENOTYPE_MISSING_INDEX );
+    for(int i = 0; i < names.size( ); i++)
+    {
+        std::map<std::string, size_t>::const_iterator it = m_snp_to_index.find( names[ i ] );
+        if( it != m_snp_to_index.end( ) )
+        {
+            indices[ i ] = it->second;
+        }
+    }
+
+    return indices;
+}
+
 const std::vector<std::string> &
 genotype_matrix::get_snp_names() const
 {
     return m_snp_names;
 }
 
+genotype_storage_ptr
+genotype_matrix::get_storage() const
+{
+    return m_storage;
+}
+
+const genotype_stats &
+genotype_matrix::get_stats(size_t index) const
+{
+    return m_stats[ index ];
+}
+
 size_t 
 genotype_matrix::size() const
 {
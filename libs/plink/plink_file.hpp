@@ -10,6 +10,12 @@
 #include <plink/snp_row.hpp>
 #include <plinkio/plinkio.h>
 
+/**
+ * Index returned by genotype_matrix::get_indices for names that
+ * are not in the matrix.
+ */
+const size_t GENOTYPE_MISSING_INDEX = (size_t) -1;
+
 /**
  * General exception class when dealing with plink files.
  */
@@ -23,6 +29,71 @@ public:
     }
 };
 
+/**
+ * Statistics of a snp that are computed when the genotypes
+ * are loaded, so that they do not have to be recomputed.
+ */
+struct genotype_stats
+{
+    /**
+     * Number of samples with genotype 0, 1, 2 and 3 (missing),
+     * after any minor allele flip.
+     */
+    size_t counts[ 4 ];
+
+    /**
+     * Minor allele frequency, at most 0.5, NaN if all
+     * samples are missing.
+     */
+    float maf;
+};
+
+/**
+ * Computes the genotype counts and minor allele frequency of a snp.
+ *
+ * @param row The genotypes of the snp.
+ *
+ * @return The statistics of the snp.
+ */
+genotype_stats compute_genotype_stats(const snp_row &row);
+
+/**
+ * Largest number of sample classes that are counted by
+ * genotype_matrix::get_class_counts.
+ */
+const size_t GENOTYPE_MAX_CLASSES = 3;
+
+/**
+ * Number of samples in each class, for example controls and cases,
+ * with genotype 0, 1, 2 and 3 (missing) of a snp.
+ */
+struct genotype_class_counts
+{
+    /**
+     * The number of samples of class c with genotype g is n[ g ][ c ].
+     */
+    unsigned int n[ SNP_ROW_NUM_PLANES ][ GENOTYPE_MAX_CLASSES ];
+};
+
+typedef shared_ptr< std::vector<genotype_class_counts> > class_counts_ptr;
+
+/**
+ * Memory that backs the rows of a genotype matrix when the rows
+ * are views, such as decoded planes or a memory mapped file. It is
+ * kept alive for as long as the matrix is.
+ */
+class genotype_storage
+{
+public:
+    virtual ~genotype_storage()
+    {
+    }
+};
+
+typedef shared_ptr<genotype_storage> genotype_storage_ptr;
+
+class genotype_cache;
+
 /**
  * Class that represents an opened plink file.
  */
@@ -36,8 +107,18 @@ public:
      * @param samples List of samples in opened file.
      * @param loci List of loci in opened file.
      * @param mafflip If true, all snps will be flipped so that minor allele is 2.
+     * @param prefix The path to the plink file without extension.
+     */
+    plink_file(const pio_file_t &file, const std::vector<pio_sample_t> &samples, const std::vector<pio_locus_t> &loci, bool mafflip = false, const std::string &prefix = "");
+
+    /**
+     * Constructor for plink files that are read from a genotype cache.
+     *
+     * @param cache The opened cache.
+     * @param mafflip If true, all snps will be flipped so that minor allele is 2.
+     * @param prefix The path to the plink file without extension.
      */
-    plink_file(const pio_file_t &file, const std::vector<pio_sample_t> &samples, const std::vector<pio_locus_t> &loci, bool mafflip = false);
+    plink_file(shared_ptr<genotype_cache> cache, bool mafflip, const std::string &prefix);
 
     /**
      * Returns a vector that contains information about the
@@ -74,7 +155,9 @@ public:
 
     /**
      * Reads a row from the underlying plink file, and writes
-     * it in the given snp_row.
+     * it in the given snp_row. If the file was opened from a cache
+     * the row refers to the cache, and is only valid while this
+     * file is.
      *
      * @param row Row to write genotypes in.
      *
@@ -91,6 +174,28 @@ public:
      */
     const std::vector<pio_locus_t> & get_loci() const;
 
+    /**
+     * Returns the path to the plink file without extension.
+     *
+     * @return The path to the plink file, empty if not known.
+     */
+    const std::string &get_prefix() const;
+
+    /**
+     * Returns true if snps are flipped so that the minor allele is 2.
+     *
+     * @return True if snps are flipped according to the minor allele.
+     */
+    bool get_mafflip() const;
+
+    /**
+     * Returns the genotype cache that the file was opened from.
+     *
+     * @return The genotype cache, or an empty pointer if the file
+     *         is read with libplinkio.
+     */
+    shared_ptr<genotype_cache> get_cache() const;
+
     /**
      * Destructor.
      *
@@ -124,6 +229,21 @@ private:
      * the minor allele.
      */
     bool m_mafflip;
+
+    /**
+     * The path to the plink file without extension.
+     */
+    std::string m_prefix;
+
+    /**
+     * The genotype cache that rows are read from, if any.
+     */
+    shared_ptr<genotype_cache> m_cache;
+
+    /**
+     * The next row to read from the cache.
+     */
+    size_t m_next_locus;
 };
 
 class genotype_matrix
@@ -137,6 +257,28 @@ public:
      */
     genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names);
 
+    /**
+     * Constructor for matrices where the rows are views.
+     *
+     * @param matrix The genotypes. This class now takes responsibility
+     *               of the matrix.
+     * @param snp_names Name of each row.
+     * @param storage The memory that the rows refer to.
+     */
+    genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, genotype_storage_ptr storage);
+
+    /**
+     * Constructor for matrices where the statistics of each row
+     * were computed while loading.
+     *
+     * @param matrix The genotypes. This class now takes responsibility
+     *               of the matrix.
+     * @param snp_names Name of each row.
+     * @param storage The memory that the rows refer to, may be empty.
+     * @param stats The statistics of each row.
+     */
+    genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, genotype_storage_ptr storage, const std::vector<genotype_stats> &stats);
+
     /**
      * Returns the genotypes for the given name.
      *
@@ -156,6 +298,17 @@ public:
      */
     snp_row &get_row(size_t index) const;
 
+    /**
+     * Returns the row index of each of the given names, so that
+     * rows can be retrieved without a lookup by name.
+     *
+     * @param names Names of the variants.
+     *
+     * @return The index of each name, or GENOTYPE_MISSING_INDEX
+     *         if the name is not in the matrix.
+     */
+    std::vector<size_t> get_indices(const std::vector<std::string> &names) const;
+
     /**
      * Returns a list of snp names.
      *
@@ -163,17 +316,82 @@ public:
      */
     const std::vector<std::string> &get_snp_names() const;
 
+    /**
+     * Returns the memory that the rows refer to.
+     *
+     * @return The memory that the rows refer to, empty if the rows
+     *         own their genotypes.
+     */
+    genotype_storage_ptr get_storage() const;
+
+    /**
+     * Returns the genotype counts and minor allele frequency of a row.
+     *
+     * @param index Index of the row.
+     *
+     * @return The statistics of the row.
+     */
+    const genotype_stats &get_stats(size_t index) const;
+
+    /**
+     * Returns the number of samples in each class with each genotype
+     * of every row. The counts are computed once for each set of
+     * classes and kept with the matrix, so that all methods of a run
+     * share them. Not thread safe, the counts should be requested
+     * before the rows are used by several threads.
+     *
+     * @param masks Bit i of mask c is set if sample i is in class c,
+     *              laid out as the planes of the rows. At most
+     *              GENOTYPE_MAX_CLASSES masks.
+     *
+     * @return The counts of each row by index, the counts of classes
+     *         beyond the given masks are zero.
+     */
+    class_counts_ptr get_class_counts(const std::vector< std::vector<uint64_t> > &masks);
+
+    /**
+     * Returns the index of a row of this matrix.
+     *
+     * @param row A row.
+     *
+     * @return The index of the row, or GENOTYPE_MISSING_INDEX if the
+     *         row is not stored in this matrix, for example a copy.
+     */
+    size_t get_index(const snp_row &row) const;
+
     /**
      * Returns the size of the matrix.
      */
     size_t size() const;
 
 private:
+    /**
+     * Builds the name index, and computes the statistics
+     * if they were not given.
+     */
+    void init();
+
     /**
      * The underlying matrix.
      */
     shared_ptr< std::vector<snp_row> > m_matrix;
 
+    /**
+     * The memory that the rows refer to, if they are views.
+     */
+    genotype_storage_ptr m_storage;
+
+    /**
+     * Statistics of each row.
+     */
+    std::vector<genotype_stats> m_stats;
+
+    /**
+     * The class masks given to get_class_counts, and the counts
+     * that were computed for them.
+     */
+    std::vector< std::pair< std::vector< std::vector<uint64_t> >, class_counts_ptr > > m_class_counts;
+
     /**
      * List of snp names for each row.
      */
@@ -189,7 +407,10 @@ typedef shared_ptr<genotype_matrix> genotype_matrix_ptr;
 typedef shared_ptr<plink_file> plink_file_ptr;
 
 /**
- * Opens the given plink file and returns it.
+ * Opens the given plink file and returns it. If a genotype cache
+ * exists for the plink file, i.e. plink_prefix + ".bcache", and it
+ * is valid and up to date, the file is read from the cache instead.
+ * The path to a cache can also be given directly.
  *
  * @param plink_prefix The path to the plink file.
  * @param mafflip If true the alleles are coded according to the minor allele.
@@ -210,7 +431,10 @@ bool get_snp_row(plink_file *file, snp_row &row);
 
 /**
  * Creates a matrix of genotypes by reading the genotypes
- * from the given plink file.
+ * from the given plink file. Files opened from a genotype cache
+ * refer directly to the cache, SNP-major .bed files are decoded
+ * from a memory map into memory of the process, otherwise rows are
+ * read with libplinkio.
  *
  * @param genotype_file A plink file.
  *
@@ -219,10 +443,36 @@ bool get_snp_row(plink_file *file, snp_row &row);
 genotype_matrix_ptr create_genotype_matrix(plink_file_ptr genotype_file);
 
 /**
- * Creates a matrix of genotypes by reading the genotypes
- * from the given plink file but filtering on maf.
+ * Creates a matrix of genotypes that only contains the given
+ * loci. Rows that are not included are never decoded when the
+ * .bed file can be memory mapped.
  *
  * @param genotype_file A plink file.
+ * @param include True for each locus in get_loci( ) that should
+ *                be part of the matrix, all loci are included if empty.
+ *
+ * @return A matrix of genotypes for the included loci.
+ */
+genotype_matrix_ptr create_genotype_matrix(plink_file_ptr genotype_file, const std::vector<bool> &include);
+
+/**
+ * Computes the statistics of each locus without keeping the rows
+ * in memory. Cached statistics are used when the file was opened
+ * from a genotype cache, SNP-major .bed files are decoded from a
+ * memory map in parallel, otherwise the rows are read one at a time.
+ *
+ * @param genotype_file A plink file, no rows may have been read.
+ *
+ * @return The statistics of each locus in get_loci( ).
+ */
+std::vector<genotype_stats> compute_locus_stats(plink_file_ptr genotype_file);
+
+/**
+ * Creates a matrix of genotypes by reading the genotypes
+ * from the given plink file but filtering on maf. Only the
+ * rows that pass the filter are kept in memory.
+ *
+ * @param genotype_file A plink file, no rows may have been read.
  * @param maf Minor allele frequency threshold.
  *
  * @return A matrix of genotypes.
@@ -1,19 +1,79 @@
 #include <plink/snp_row.hpp>
 
 snp_row::snp_row()
+    : m_size( 0 ),
+      m_num_words( 0 ),
+      m_data( NULL ),
+      m_flip( false ),
+      m_index( SNP_ROW_NO_INDEX )
 {
 
 }
 
+snp_row::snp_row(const uint64_t *planes, size_t size, bool flip)
+    : m_size( size ),
+      m_num_words( words_for_size( size ) ),
+      m_data( planes ),
+      m_flip( flip ),
+      m_index( SNP_ROW_NO_INDEX )
+{
+
+}
+
+snp_row::snp_row(const snp_row &other)
+    : m_size( other.m_size ),
+      m_num_words( other.m_num_words ),
+      m_planes( other.m_planes ),
+      m_data( other.m_data ),
+      m_flip( other.m_flip ),
+      m_index( other.m_index )
+{
+    if( !m_planes.empty( ) )
+    {
+        m_data = &m_planes[ 0 ];
+    }
+}
+
+snp_row &
+snp_row::operator=(const snp_row &other)
+{
+    if( this != &other )
+    {
+        m_size = other.m_size;
+        m_num_words = other.m_num_words;
+        m_planes = other.m_planes;
+        m_data = m_planes.empty( ) ? other.m_data : &m_planes[ 0 ];
+        m_flip = other.m_flip;
+        m_index = other.m_index;
+    }
+
+    return *this;
+}
+
+size_t
+snp_row::words_for_size(size_t size)
+{
+    return ( size + SNP_ROW_BITS_PER_WORD - 1 ) / SNP_ROW_BITS_PER_WORD;
+}
+
 void
 snp_row::resize(size_t new_size)
 {
-    unsigned int total_number_of_bits = new_size * 2;
-    unsigned int bits_per_element = 8 * sizeof( int );
-    unsigned int elements_required = (total_number_of_bits + bits_per_element - 1) / bits_per_element;
-
     m_size = new_size;
-    m_genotypes.resize( elements_required );
+    m_num_words = words_for_size( new_size );
+    m_planes.assign( SNP_ROW_NUM_PLANES * m_num_words, 0 );
+    m_data = m_planes.empty( ) ? NULL : &m_planes[ 0 ];
+    m_flip = false;
+
+    /* All samples start as genotype 0, padding bits stay cleared */
+    for(size_t i = 0; i < m_num_words; i++)
+    {
+        m_planes[ i ] = ~0ULL;
+    }
+    if( new_size % SNP_ROW_BITS_PER_WORD != 0 )
+    {
+        m_planes[ m_num_words - 1 ] = ( 1ULL << ( new_size % SNP_ROW_BITS_PER_WORD ) ) - 1;
+    }
 }
 
 size_t
@@ -22,23 +82,92 @@ snp_row::size() const
     return m_size;
 }
 
+unsigned char
+snp_row::stored_plane(unsigned char genotype) const
+{
+    if( m_flip && ( genotype == 0 || genotype == 2 ) )
+    {
+        return 2 - genotype;
+    }
+
+    return genotype;
+}
+
 unsigned char
 snp_row::operator[](size_t index) const
 {
-    size_t element = ( index * 2 ) / ( 8 * sizeof( unsigned int ) );
-    unsigned int element_index = ( index * 2 ) - element * ( 8 * sizeof( unsigned int ) );
-    unsigned int element_mask = 0x3 << element_index;
-    
-    return ( m_genotypes[ element ] & element_mask ) >> element_index;
+    size_t word = index / SNP_ROW_BITS_PER_WORD;
+    uint64_t bit = 1ULL << ( index % SNP_ROW_BITS_PER_WORD );
+
+    for(unsigned char g = 1; g < SNP_ROW_NUM_PLANES; g++)
+    {
+        if( m_data[ g * m_num_words + word ] & bit )
+        {
+            return stored_plane( g );
+        }
+    }
+
+    return stored_plane( 0 );
 }
 
 void
 snp_row::assign(size_t index, unsigned char value)
 {
-    size_t element = ( index * 2 ) / ( 8 * sizeof( unsigned int ) );
-    unsigned int element_index = ( index * 2 ) - element * ( 8 * sizeof( int ) );
-    unsigned int element_mask = ~( 0x3 << element_index );
-    unsigned int positioned_value = ( value & 0x3 ) << element_index;
+    /* Views are copied before they are modified */
+    if( m_planes.empty( ) && m_data != NULL )
+    {
+        m_planes.assign( m_data, m_data + SNP_ROW_NUM_PLANES * m_num_words );
+        m_data = &m_planes[ 0 ];
+    }
+
+    size_t word = index / SNP_ROW_BITS_PER_WORD;
+    uint64_t bit = 1ULL << ( index % SNP_ROW_BITS_PER_WORD );
 
-    m_genotypes[ element ] = ( m_genotypes[ element ] & element_mask ) | positioned_value;
+    for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
+    {
+        m_planes[ g * m_num_words + word ] &= ~bit;
+    }
+
+    m_planes[ stored_plane( value & 0x3 ) * m_num_words + word ] |= bit;
+}
+
+size_t
+snp_row::num_words() const
+{
+    return m_num_words;
+}
+
+const uint64_t *
+snp_row::get_plane(unsigned char genotype) const
+{
+    if( m_data == NULL )
+    {
+        return NULL;
+    }
+
+    return m_data + stored_plane( genotype ) * m_num_words;
+}
+
+bool
+snp_row::is_flipped() const
+{
+    return m_flip;
+}
+
+void
+snp_row::set_flipped(bool flip)
+{
+    m_flip = flip;
+}
+
+size_t
+snp_row::get_index() const
+{
+    return m_index;
+}
+
+void
+snp_row::set_index(size_t index)
+{
+    m_index = index;
 }
@@ -4,6 +4,35 @@
 #include <string>
 #include <vector>
 
+#include <stdint.h>
+
+/**
+ * Number of distinct genotype values, 0, 1, 2 and 3 (missing).
+ */
+const unsigned int SNP_ROW_NUM_PLANES = 4;
+
+/**
+ * Number of samples that are stored in each word of a bit plane.
+ */
+const unsigned int SNP_ROW_BITS_PER_WORD = 64;
+
+/**
+ * Index of a row that is not part of a genotype matrix.
+ */
+const size_t SNP_ROW_NO_INDEX = (size_t) -1;
+
+/**
+ * A row of genotypes stored in a bit-sliced layout. For each
+ * genotype value (0, 1, 2 and 3 for missing) there is one plane
+ * of 64-bit words where bit i is set if sample i has that value.
+ * Bits beyond the last sample are always zero in all planes, so
+ * joint counts can be computed by AND and popcount over whole words.
+ *
+ * A row either owns its planes, or is a view of planes that are
+ * stored elsewhere, for example in a memory mapped file. A row can
+ * also be flipped, in which case genotypes 0 and 2 are swapped when
+ * accessed, which is done by exchanging the planes in get_plane.
+ */
 class snp_row
 {
 public:
@@ -13,7 +42,35 @@ public:
     snp_row();
 
     /**
-     * Resizes the row to be able to hold the given size.
+     * Creates a view of planes stored elsewhere, the planes must
+     * outlive the row. Assigning to a view copies the planes.
+     *
+     * @param planes The 4 planes stored one after another, each
+     *               with enough words to hold size samples.
+     * @param size The number of samples.
+     * @param flip If true, genotypes 0 and 2 are swapped.
+     */
+    snp_row(const uint64_t *planes, size_t size, bool flip = false);
+
+    /**
+     * Copy constructor.
+     *
+     * @param other The row to copy.
+     */
+    snp_row(const snp_row &other);
+
+    /**
+     * Assignment operator.
+     *
+     * @param other The row to copy.
+     *
+     * @return This row.
+     */
+    snp_row &operator=(const snp_row &other);
+
+    /**
+     * Resizes the row to be able to hold the given size. All
+     * samples are set to genotype 0 and the row is not flipped.
      *
      * @param new_size The new size of the row.
      */
@@ -30,7 +87,7 @@ public:
      * Access operator, not checked for bounds.
      *
      * @param index Index of the SNP to retrive.
-     * 
+     *
      * @return Return the SNP at the given index.
      */
     unsigned char operator[](size_t index) const;
@@ -43,16 +100,105 @@ public:
      */
     void assign(size_t index, unsigned char value);
 
+    /**
+     * Returns the number of 64-bit words in each bit plane.
+     *
+     * @return The number of words in each bit plane.
+     */
+    size_t num_words() const;
+
+    /**
+     * Returns the bit plane for the given genotype, bit i in the
+     * plane is set if sample i has this genotype.
+     *
+     * @param genotype The genotype 0, 1, 2 or 3 (missing).
+     *
+     * @return A pointer to num_words() words.
+     */
+    const uint64_t *get_plane(unsigned char genotype) const;
+
+    /**
+     * Returns true if genotypes 0 and 2 are swapped.
+     *
+     * @return True if the row is flipped.
+     */
+    bool is_flipped() const;
+
+    /**
+     * Sets whether genotypes 0 and 2 should be swapped, the
+     * stored planes are not changed.
+     *
+     * @param flip If true, genotypes 0 and 2 are swapped.
+     */
+    void set_flipped(bool flip);
+
+    /**
+     * Returns the index of the row in the genotype matrix that it
+     * was created for, copies of the row keep the index.
+     *
+     * @return The index, or SNP_ROW_NO_INDEX if the row was not
+     *         created for a matrix.
+     */
+    size_t get_index() const;
+
+    /**
+     * Sets the index of the row in its genotype matrix.
+     *
+     * @param index The index of the row.
+     */
+    void set_index(size_t index);
+
+    /**
+     * Returns the number of words needed for each plane
+     * of a row with the given number of samples.
+     *
+     * @param size The number of samples.
+     *
+     * @return The number of words in each plane.
+     */
+    static size_t words_for_size(size_t size);
+
 private:
     /**
-     * Size of the row.
+     * Returns the stored plane that holds the given genotype,
+     * taking flipping into account.
+     *
+     * @param genotype The genotype 0, 1, 2 or 3 (missing).
+     *
+     * @return The index of the stored plane.
      */
+    unsigned char stored_plane(unsigned char genotype) const;
 
+    /**
+     * Size of the row.
+     */
     size_t m_size;
+
+    /**
+     * Number of words in each plane.
+     */
+    size_t m_num_words;
+
+    /**
+     * The bit planes stored one after another, i.e. plane g
+     * starts at g * m_num_words. Empty if the row is a view.
+     */
+    std::vector<uint64_t> m_planes;
+
+    /**
+     * The planes of the row, either m_planes or the viewed planes.
+     */
+    const uint64_t *m_data;
+
+    /**
+     * If true, genotypes 0 and 2 are swapped.
+     */
+    bool m_flip;
+
     /**
-     * Internal data structure, as a vector.
+     * The index of the row in its genotype matrix.
      */
-    std::vector<unsigned int> m_genotypes;
+    size_t m_index;
 };
 
 #endif /* End of __SNP_ROW_H__ */
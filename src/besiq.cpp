@@ -18,6 +18,7 @@ struct command
 struct command g_commands[] =
 {
     { "pairs", "Generate a set of pairs for a gene-gene analysis." },
+    { "cache", "Preprocess genotypes into a cache for fast startup." },
     { "view", "Display a binary result file" },
     { "correct", "Multiple testing correction." },
     { "glm", "Run a GLM model possibly with covariates." },
@@ -26,6 +27,7 @@ struct command g_commands[] =
     { "scaleinv", "Run multiple link functions." },
     { "loglinear", "Run the log-linear method without main effects." },
     { "caseonly", "Run tests based on LD in case/control data." },
+    { "multi", "Run several closed form tests from one count of each pair." },
     { "separate", "Code variants as recessive and/or dominant prior to interaction analysis." },
     { "bayes", "Run a stage-wise method." },
     { "imputed", "Perform scaleinv test on imputed data from impute2." },
@@ -39,7 +39,14 @@ main(int argc, char *argv[])
         exit( 1 );
     }
 
-    shared_ptr<common_options> parsed_data = parse_common_options( options, parser.args( ) );
+    if( (bool) options.get( "log_p" ) )
+    {
+        std::cerr << "besiq: error: --log-p is only available for methods that compute p-values." << std::endl;
+        exit( 1 );
+    }
+
+    /* Prior estimation samples pairs from all snps */
+    shared_ptr<common_options> parsed_data = parse_common_options( options, parser.args( ), options.is_set( "estimate_prior_params" ) );
 
     /* Read prior parameters */
     arma::vec alpha = arma::ones<arma::vec>( 2 );
@@ -65,6 +72,7 @@ main(int argc, char *argv[])
         m = new besiq_fine_method( parsed_data->data, (int) options.get( "mc_iterations" ), alpha );
     }
     
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <string>
+
+#include <plink/plink_file.hpp>
+#include <plink/genotype_cache.hpp>
+#include <cpp-argparse/OptionParser.h>
+
+using namespace optparse;
+
+const std::string USAGE = "besiq-cache [OPTIONS] genotype_plink_prefix";
+const std::string VERSION = "besiq-cache 1.0.0";
+const std::string DESCRIPTION = "Writes a preprocessed genotype cache that the other commands memory map instead of reading the plink file.";
+const std::string EPILOG = "The cache is written to genotype_plink_prefix.bcache by default, where it is found automatically by all commands that are given genotype_plink_prefix. A cache is ignored if the .bed file changes.";
+
+int
+main(int argc, char *argv[])
+{
+    OptionParser parser = OptionParser( ).usage( USAGE )
+                                         .version( VERSION )
+                                         .description( DESCRIPTION )
+                                         .epilog( EPILOG );
+
+    parser.add_option( "-o", "--out" ).help( "Path to the cache (default = genotype_plink_prefix.bcache)." );
+    parser.add_option( "--verify" ).action( "store_true" ).help( "Verify the checksums of an existing cache instead of creating one." );
+
+    Values options = parser.parse_args( argc, argv );
+    std::vector<std::string> args = parser.args( );
+    if( args.size( ) != 1 )
+    {
+        std::cerr << "besiq-cache: error: Genotypes are missing." << std::endl;
+        parser.print_help( );
+        exit( 1 );
+    }
+
+    std::string cache_path = args[ 0 ] + GENOTYPE_CACHE_EXTENSION;
+    if( options.is_set( "out" ) )
+    {
+        cache_path = options[ "out" ];
+    }
+
+    if( options.is_set( "verify" ) )
+    {
+        genotype_cache cache;
+        if( !cache.open( cache_path ) || !cache.verify( ) )
+        {
+            std::cerr << "besiq-cache: error: The cache " << cache_path << " is corrupt." << std::endl;
+            exit( 1 );
+        }
+        if( cache.is_stale( args[ 0 ] + ".bed" ) )
+        {
+            std::cerr << "besiq-cache: error: The cache " << cache_path << " is out of date." << std::endl;
+            exit( 1 );
+        }
+
+        return 0;
+    }
+
+    /* Rows are stored unflipped, the flips are stored per snp */
+    plink_file_ptr genotype_file = open_plink_file( args[ 0 ], false );
+    if( !write_genotype_cache( genotype_file, cache_path ) )
+    {
+        std::cerr << "besiq-cache: error: Could not write cache " << cache_path << "." << std::endl;
+        exit( 1 );
+    }
+
+    return 0;
+}
@@ -41,6 +41,7 @@ main(int argc, char *argv[])
         m = new peer_method( parsed_data->data );
     }
     
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
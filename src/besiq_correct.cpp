@@ -1,3 +1,4 @@
+#include <fstream>
 #include <iostream>
 #include <iomanip>
 
@@ -75,6 +76,55 @@ std::vector<float> parse_weight(const std::string &weight_string, float default_
     }
 }
 
+std::vector<double> parse_null(const std::string &null_paths)
+{
+    std::vector<double> null_min;
+    std::istringstream paths( null_paths );
+    std::string path;
+    while( std::getline( paths, path, ',' ) )
+    {
+        std::ifstream null_file( path.c_str( ) );
+        if( !null_file )
+        {
+            std::cerr << "besiq-correct: error: Could not open null distribution " << path << "." << std::endl;
+            exit( 1 );
+        }
+
+        std::vector<double> split_min;
+        double statistic;
+        while( null_file >> statistic )
+        {
+            split_min.push_back( statistic );
+        }
+
+        /* The splits of a run share the permutations, so their minimums are combined */
+        if( null_min.empty( ) )
+        {
+            null_min = split_min;
+        }
+        else if( split_min.size( ) != null_min.size( ) )
+        {
+            std::cerr << "besiq-correct: error: Null distributions have different numbers of permutations." << std::endl;
+            exit( 1 );
+        }
+        else
+        {
+            for(size_t i = 0; i < null_min.size( ); i++)
+            {
+                null_min[ i ] = std::min( null_min[ i ], split_min[ i ] );
+            }
+        }
+    }
+
+    if( null_min.empty( ) )
+    {
+        std::cerr << "besiq-correct: error: The null distribution is empty." << std::endl;
+        exit( 1 );
+    }
+
+    return null_min;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -83,9 +133,9 @@ main(int argc, char *argv[])
                                          .description( DESCRIPTION )
                                          .epilog( EPILOG ); 
 
-    char const * const methods[] = { "bonferroni", "static", "adaptive", "top" };
+    char const * const methods[] = { "bonferroni", "static", "adaptive", "top", "permutation" };
     char const * const models[] = { "binomial", "normal" };
-    parser.add_option( "-m", "--method" ).set_default( "none" ).choices( &methods[ 0 ], &methods[ 4 ] ).help( "The multiple testing correction to use 'bonferroni', 'static', 'adaptive' or 'top' (default = bonferroni)." );
+    parser.add_option( "-m", "--method" ).set_default( "none" ).choices( &methods[ 0 ], &methods[ 5 ] ).help( "The multiple testing correction to use 'bonferroni', 'static', 'adaptive', 'top' or 'permutation' (default = bonferroni)." );
     parser.add_option( "-b", "--bfile" ).help( "Plink prefix, needed for static and adaptive." );
     parser.add_option( "-e", "--model" ).set_default( "binomial" ).choices( &models[ 0 ], &models[ 2 ] ).help( "Type of model, binomial or normal (default = binomial)." );
     parser.add_option( "-p", "--pheno" ).help( "Phenotype file, only needed for static and adaptive." );
@@ -94,6 +144,7 @@ main(int argc, char *argv[])
     parser.add_option( "-f", "--field" ).set_default( 1 ).help( "For 'bonferroni', the column that contains the p-value, the first column after the snp names is 0 (default = 1)." );
     parser.add_option( "-n", "--num-tests" ).set_default( "0" ).help( "The number of tests to perform, if multiple, separate by ',' and 0 indicates let the program decide, typically the number of pairs." );
     parser.add_option( "-t", "--num-top" ).set_default( 100 ).help( "The number of top pairs to keep." );
+    parser.add_option( "--null" ).help( "For 'permutation', the <out>.null files written with --permutations, if multiple, separate by ','." );
     parser.add_option( "-w", "--weight" ).help( "Used in 'static' and 'adaptive', 4 weights that sum to 1 separated by ','." );
     parser.add_option( "-o", "--output-prefix" ).help( "The output prefix, must be set for non-bonferroni methods!" );
     
@@ -130,6 +181,22 @@ main(int argc, char *argv[])
 
         run_bonferroni( meta_result_file, correct.alpha, correct.num_tests[ 0 ], field, output_path );
     }
+    else if( method == "permutation" )
+    {
+        if( !options.is_set( "null" ) )
+        {
+            std::cerr << "besiq-correct: error: Need to supply the null distribution with --null." << std::endl;
+            exit( 1 );
+        }
+
+        std::string output_path = "-";
+        if( options.is_set( "output_prefix" ) )
+        {
+            output_path = output_prefix;
+        }
+
+        run_permutation( meta_result_file, parse_null( options[ "null" ] ), correct.alpha, field, output_path );
+    }
     else if( method == "top" )
     {
         std::string output_path = "-";
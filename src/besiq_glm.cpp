@@ -31,6 +31,8 @@ main(int argc, char *argv[])
     group.add_option( "-l", "--link-function" ).choices( &link_choices[ 0 ], &link_choices[ 5 ] ).metavar( "link" ).help( "The link function, or scale, that is used for the penetrance: 'logit' log(p/(1-p)), 'logc' log(1 - p), 'odds' p/(1-p), 'identity' p, 'log' log(p)." );
     group.add_option( "-f", "--factor" ).choices( &factor_choices[ 0 ], &factor_choices[ 4 ] ).help( "Determines how to code the SNPs, in 'factor' no order of the alleles is assumed, in 'additive' the SNPs are coded as the number of minor alleles, in 'tukey' the coding is the same as factor except that a single parameter for the interaction is used, 'noia' the model is divided into additive and dominance interactions." ).set_default( "factor" );
     group.add_option( "--fast" ).help( "Faster but less robust matrix inversion, generally a speedup of 2 can be expected." ).action( "store_true" );
+    group.add_option( "--score" ).help( "Test the interaction with a score test, where the model of the covariates is only fitted once, instead of fitting both models for each pair. The score statistic and p-value are written in the columns SCORE and P_SCORE, and the score p-value is used for --top and --threshold." ).action( "store_true" );
+    group.add_option( "--score-threshold" ).help( "With --score, also run the likelihood ratio test for pairs with a score test p-value below this (default = 0, never)." ).set_default( 0.0 );
     parser.add_option_group( group );
 
     Values options = parser.parse_args( argc, argv );
@@ -45,7 +47,7 @@ main(int argc, char *argv[])
 
     model_matrix *model_matrix = make_model_matrix( options[ "factor" ], parsed_data->data->covariate_matrix, parsed_data->data->phenotype.n_elem );
 
-    method_type *m = NULL;
+    glm_method *m = NULL;
     if( options[ "model" ] == "binomial" )
     {
         std::string link = "logit";
@@ -69,6 +71,13 @@ main(int argc, char *argv[])
         m = new glm_method( parsed_data->data, *model, *model_matrix );
     }
 
+    if( options.is_set( "score" ) && !m->use_score_test( (double) options.get( "score_threshold" ) ) )
+    {
+        std::cerr << "besiq: error: Could not fit the model of the covariates for --score." << std::endl;
+        exit( 1 );
+    }
+
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
@@ -30,6 +30,7 @@ main(int argc, char *argv[])
 
     method_type *m = new loglinear_method( parsed_data->data );
     
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
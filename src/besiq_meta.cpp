@@ -8,9 +8,11 @@
 #include <besiq/method/wald_lm_method.hpp>
 #include <besiq/method/wald_separate_method.hpp>
 #include <besiq/method/method.hpp>
+#include <besiq/stats/wald_kernels.hpp>
 #include <besiq/logp_grid.hpp>
 
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 
 #include "common_options.hpp"
 
@@ -144,29 +146,36 @@ main(int argc, char *argv[])
     float meta_output[ header.size( ) ];
     while( pairs->read( pair ) )
     {
-        /* Compute betas and covariances */
-        std::vector<arma::vec> betas( methods.size( ), arma::zeros<arma::vec>( 4 ) );
-        std::vector<arma::mat> weights( methods.size( ), arma::zeros<arma::mat>( 4, 4 ) );
+        /* Compute the weighted betas C^-1 beta and weights C^-1 */
+        double weighted_beta[ WALD_MAX_TERMS ] = { 0.0 };
+        double Csum[ WALD_MAX_TERMS * WALD_MAX_TERMS ] = { 0.0 };
         size_t N = 0;
         bool all_valid = true;
-        for(int i = 0; i < methods.size( ); i++)
+        for(int i = 0; i < methods.size( ) && all_valid; i++)
         {
             snp_row const *row1 = genotypes[ i ]->get_row( pair.first );
             snp_row const *row2 = genotypes[ i ]->get_row( pair.second );
 
             methods[ i ]->run( *row1, *row2, output );
 
-            betas[ i ] = methods[ i ]->get_last_beta( );
-
-            arma::mat C = methods[ i ]->get_last_C( );
-            arma::mat Cinv;
-
-            if( C.n_cols != 4 || C.n_rows != 4 || !arma::inv( Cinv, C ) )
+            double beta[ WALD_MAX_TERMS ];
+            double C[ WALD_MAX_TERMS * WALD_MAX_TERMS ];
+            double Cinv[ WALD_MAX_TERMS * WALD_MAX_TERMS ];
+            if( methods[ i ]->get_last_estimate( beta, C ) != WALD_MAX_TERMS ||
+                !wald_invert( C, WALD_MAX_TERMS, Cinv ) )
             {
                 all_valid = false;
+                continue;
+            }
+
+            for(int j = 0; j < WALD_MAX_TERMS; j++)
+            {
+                for(int k = 0; k < WALD_MAX_TERMS; k++)
+                {
+                    Csum[ j * WALD_MAX_TERMS + k ] += Cinv[ j * WALD_MAX_TERMS + k ];
+                    weighted_beta[ j ] += Cinv[ j * WALD_MAX_TERMS + k ] * beta[ k ];
+                }
             }
-            
-            weights[ i ] = Cinv;
 
             N += methods[ i ]->num_ok_samples( *row1, *row2 );
         }
@@ -176,34 +185,15 @@ main(int argc, char *argv[])
             continue;
         }
 
-        /* Computed weighted average of betas (fixed effect assumption) */
-        arma::mat Csum = arma::zeros<arma::mat>( 4, 4 );
-        for(int i = 0; i < weights.size( ); i++)
-        {
-            Csum += weights[ i ];
-        }
-        arma::mat Csum_inv;
-        if( !arma::inv( Csum_inv, Csum ) )
-        {
-            continue;
-        }
-
-        arma::vec final_beta = arma::zeros<arma::vec>( 4 );
-        arma::mat final_C = Csum_inv;
-        for(int i = 0; i < weights.size( ); i++)
-        {
-            final_beta += weights[ i ] * betas[ i ];
-        }
-        final_beta = Csum_inv * final_beta;
-
-        arma::mat final_C_inv;
-        if( !arma::inv( final_C_inv, final_C ) )
+        /* The fixed effect estimate is Csum^-1 weighted_beta with covariance
+         * Csum^-1, so its wald statistic is weighted_beta^T Csum^-1 weighted_beta */
+        double chi = 0.0;
+        if( !wald_statistic( Csum, weighted_beta, WALD_MAX_TERMS, &chi ) )
         {
             continue;
         }
 
-        double chi = dot( final_beta, final_C_inv * final_beta );
-        double final_p = 1.0 - chi_square_cdf( chi, 4 );
+        double final_p = chi_square_upper( chi, 4 );
         
         grid.add_pvalue( pair.first, pair.second, final_p );
 
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include <armadillo>
+
+#include <cpp-argparse/OptionParser.h>
+
+#include <besiq/method/caseonly_method.hpp>
+#include <besiq/method/loglinear_method.hpp>
+#include <besiq/method/method.hpp>
+#include <besiq/method/multi_method.hpp>
+#include <besiq/method/peer_method.hpp>
+#include <besiq/method/stagewise_method.hpp>
+#include <besiq/method/wald_lm_method.hpp>
+#include <besiq/method/wald_method.hpp>
+
+#include "common_options.hpp"
+
+using namespace arma;
+using namespace optparse;
+
+const std::string USAGE = "besiq-multi [OPTIONS] pairs genotype_plink_prefix";
+const std::string DESCRIPTION = "Runs several closed form tests for genetic interactions, and counts each pair only once for all of them.";
+
+/**
+ * Creates a method that can be run from the counts of a pair.
+ *
+ * @param data The method data.
+ * @param name The name of the method.
+ * @param model The model of the phenotype, 'binomial' or 'normal'.
+ *
+ * @return The method, or NULL if there is no such method for the model.
+ */
+method_type *
+create_method(method_data_ptr data, const std::string &name, const std::string &model)
+{
+    if( name == "wald" )
+    {
+        if( model == "normal" )
+        {
+            return new wald_lm_method( data );
+        }
+
+        return new wald_method( data );
+    }
+    else if( name == "stagewise" )
+    {
+        return new stagewise_method( data, model );
+    }
+    else if( model == "normal" )
+    {
+        return NULL;
+    }
+    else if( name == "loglinear" )
+    {
+        return new loglinear_method( data );
+    }
+    else if( name == "css" || name == "r2" || name == "contrast" )
+    {
+        return new caseonly_method( data, name );
+    }
+    else if( name == "peer" )
+    {
+        return new peer_method( data );
+    }
+
+    return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    OptionParser parser = create_common_options( USAGE, DESCRIPTION, false );
+
+    char const* const model_choices[] = { "binomial", "normal" };
+    parser.add_option( "-m", "--model" ).choices( &model_choices[ 0 ], &model_choices[ 2 ] ).metavar( "model" ).help( "The model to use for the phenotype, 'binomial' or 'normal', default = 'binomial'." ).set_default( "binomial" );
+    parser.add_option( "--methods" ).metavar( "methods" ).help( "Comma separated list of the methods to run, wald, stagewise, loglinear, css, r2, contrast and peer for binomial phenotypes, and wald and stagewise for normal phenotypes. The threshold and top pairs apply to the first method (default = wald,stagewise)." ).set_default( "wald,stagewise" );
+    parser.add_option( "--per-method" ).action( "store_true" ).help( "Write the results of each method to <out>.<method> instead of one combined file." ).set_default( false );
+
+    Values options = parser.parse_args( argc, argv );
+    if( parser.args( ).size( ) != 2 )
+    {
+        parser.print_help( );
+        exit( 1 );
+    }
+
+    bool per_method = (bool) options.get( "per_method" );
+    if( per_method && !options.is_set( "out" ) )
+    {
+        std::cerr << "besiq: error: --per-method requires an output file." << std::endl;
+        exit( 1 );
+    }
+    shared_ptr<common_options> parsed_data = parse_common_options( options, parser.args( ), false, !per_method );
+
+    std::vector<method_type *> methods;
+    std::vector<std::string> names;
+    std::istringstream method_list( options[ "methods" ] );
+    std::string name;
+    while( std::getline( method_list, name, ',' ) )
+    {
+        method_type *m = create_method( parsed_data->data, name, options[ "model" ] );
+        if( m == NULL || std::find( names.begin( ), names.end( ), name ) != names.end( ) )
+        {
+            std::cerr << "besiq: error: Unknown or repeated method '" << name << "' for a " << options[ "model" ] << " phenotype." << std::endl;
+            exit( 1 );
+        }
+
+        methods.push_back( m );
+        names.push_back( name );
+    }
+    if( methods.empty( ) )
+    {
+        std::cerr << "besiq: error: No methods to run." << std::endl;
+        exit( 1 );
+    }
+
+    shared_ptr<resultfile> result_file = parsed_data->result_file;
+    if( per_method )
+    {
+        std::vector<resultfile *> files;
+        std::vector<std::string> prefixes;
+        for(int i = 0; i < names.size( ); i++)
+        {
+            files.push_back( new bresultfile( options[ "out" ] + "." + names[ i ], parsed_data->genotype_file->get_locus_names( ) ) );
+            prefixes.push_back( names[ i ] + "_" );
+        }
+
+        result_file = shared_ptr<resultfile>( new split_resultfile( files, prefixes ) );
+        if( !result_file->open( ) )
+        {
+            std::cerr << "besiq: error: Can not open result file." << std::endl;
+            exit( 1 );
+        }
+    }
+
+    multi_method m( parsed_data->data, methods, names );
+    check_permutations( m );
+
+    run_method( m, parsed_data->genotypes, *parsed_data->pairs, *result_file );
+
+    return 0;
+}
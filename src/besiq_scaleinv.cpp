@@ -76,6 +76,7 @@ main(int argc, char *argv[])
         }
     }
     
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
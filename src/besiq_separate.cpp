@@ -62,6 +62,7 @@ main(int argc, char *argv[])
         m = new separate_method( parsed_data->data, model );
     }
 
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
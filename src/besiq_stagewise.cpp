@@ -33,6 +33,7 @@ main(int argc, char *argv[])
 
     method_type *m = new stagewise_method( parsed_data->data, options[ "model" ] );
 
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
@@ -7,6 +7,7 @@
 
 #include <plink/plink_file.hpp>
 #include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
 
 using namespace arma;
 using namespace optparse;
@@ -84,7 +85,7 @@ compute_brown_forsythe(const snp_row &row, const arma::vec &pheno, const arma::u
     double numerator = dot( medians.col( 1 ), pow( z_i - z, 2 ) );
 
     *W = ( (*N - k) * numerator ) / ( ( k - 1 ) * W_sq );
-    *p = 1 - f_cdf( *W, k - 1, *N - k );
+    *p = f_upper( *W, k - 1, *N - k );
 
     return true;
 }
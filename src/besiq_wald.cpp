@@ -50,6 +50,7 @@ main(int argc, char *argv[])
         m = new wald_lm_method( parsed_data->data, (bool) options.get( "unequal_var" ) );
     }
     
+    check_permutations( *m );
     run_method( *m, parsed_data->genotypes, *parsed_data->pairs, *parsed_data->result_file );
 
     delete m;
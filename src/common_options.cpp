@@ -1,9 +1,18 @@
+#include <set>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <armadillo>
 
+#include <besiq/io/pair_generator.hpp>
+#include <besiq/stats/snp_count.hpp>
+
 #include "common_options.hpp"
 
 const std::string VERSION = "Bayesic 0.5.9";
-const std::string EPILOG = "";
+const std::string EPILOG = "Instead of a pair file, the pairs can be generated on the fly with a specification such as all:maf=0.05,dist=1e6, see besiq-pairs for the available modes (all, within, between, set and set-no-ignore) and filters (maf, combined and dist). Gene and set files are given with file=<path> and restrict=<path>, and tile=<n> traverses the pairs in cache-friendly tiles of n snps.";
 
 using namespace optparse;
 using namespace arma;
@@ -21,15 +30,65 @@ create_common_options(const std::string &usage, const std::string &description,
     parser.add_option( "-o", "--out" ).help( "The output file that will contain the results (binary)." );
     parser.add_option( "-c", "--cov" ).action( "store" ).type( "string" ).metavar( "filename" ).help( "Performs the analysis by including the covariates in this file." );
     parser.add_option( "-t", "--threshold" ).help( "Only output pairs with a p-value less than this." ).set_default( -9 );
+    parser.add_option( "--top" ).help( "Only output the pairs with the smallest p-values, and write a summary of all p-values to <out>.summary or standard error (default = all pairs)." ).set_default( 0 );
     parser.add_option( "--split" ).help( "Runs the analysis on a part of the pair file, and this is part X of 1-<num_splits> parts (default = 1)." ).set_default( 1 );
     parser.add_option( "--num-splits" ).help( "Sets the number of parts to split the pair file in (default = 1)." ).set_default( 1 );
+    parser.add_option( "--threads" ).help( "Number of threads used to run the analysis (default = 1)." ).set_default( 1 );
+    parser.add_option( "--log-p" ).action( "store_true" ).set_default( 0 ).help( "Also write -log10 of the p-value in the column LOG10P, computed from the test statistic so that it is finite also for p-values that are too small for the P column." );
+    parser.add_option( "--permutations" ).help( "Permute the phenotype this many times, write the empirical p-value of each pair in the column PERM_P, and the smallest p-value of each permutation to <out>.null for besiq-correct (default = 0)." ).set_default( 0 );
+    parser.add_option( "--permutation-seed" ).help( "Seed of the permutations, must be the same for all splits (default = 1)." ).set_default( 1 );
     parser.add_option( "--print-params" ).action( "store_true" ).set_default( 0 ).help( "Print parameter estimates in result file." );
     
     return parser;
 }
 
+/**
+ * Determines which loci in the plink file are part of a pair in
+ * the given split, so that only those rows have to be loaded.
+ *
+ * @param pairs The binary pair file.
+ * @param locus_names The names of the loci in the plink file.
+ * @param split The split that will be run.
+ * @param num_splits The number of splits.
+ *
+ * @return True for each locus that is part of a pair, or an empty
+ *         vector if the pair file could not be read.
+ */
+static std::vector<bool>
+find_used_loci(bpairfile &pairs, const std::vector<std::string> &locus_names, size_t split, size_t num_splits)
+{
+    std::vector<bool> used_snps = find_split_snps( pairs, split, num_splits );
+    if( used_snps.empty( ) )
+    {
+        return used_snps;
+    }
+
+    const std::vector<std::string> &snp_names = pairs.get_snp_names( );
+    if( snp_names == locus_names )
+    {
+        return used_snps;
+    }
+
+    std::set<std::string> used_names;
+    for(size_t i = 0; i < snp_names.size( ); i++)
+    {
+        if( used_snps[ i ] )
+        {
+            used_names.insert( snp_names[ i ] );
+        }
+    }
+
+    std::vector<bool> used_loci( locus_names.size( ), false );
+    for(size_t i = 0; i < locus_names.size( ); i++)
+    {
+        used_loci[ i ] = used_names.count( locus_names[ i ] ) > 0;
+    }
+
+    return used_loci;
+}
+
 shared_ptr<common_options>
-parse_common_options(optparse::Values &options, const std::vector<std::string> &args)
+parse_common_options(optparse::Values &options, const std::vector<std::string> &args, bool load_all_snps, bool open_result)
 {
     shared_ptr<common_options> result;
     if( args.size( ) != 2 )
@@ -37,10 +96,19 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
         std::cerr << "besiq: error: Pairs or genetypes is missing." << std::endl;
         exit( 1 );
     }
-    /* Read all genotypes */
     plink_file_ptr genotype_file = open_plink_file( args[ 1 ], true );
-    genotype_matrix_ptr genotypes = create_genotype_matrix( genotype_file );
     
+    int num_threads = (int) options.get( "threads" );
+    if( num_threads <= 0 )
+    {
+        std::cerr << "besiq: error: Number of threads must be > 0." << std::endl;
+        exit( 1 );
+    }
+#ifdef _OPENMP
+    /* The genotypes are also decoded with this many threads */
+    omp_set_num_threads( num_threads );
+#endif
+
     /* Create pair iterator */
     size_t split = (size_t) options.get( "split" );
     size_t num_splits = (size_t) options.get( "num_splits" );
@@ -50,7 +118,42 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
         exit( 1 );
     }
     
-    pairfile *pairs = open_pair_file( args[ 0 ].c_str( ), genotype_file->get_locus_names( ) );
+    pairfile *pairs = NULL;
+    genotype_matrix_ptr genotypes;
+    if( is_pair_spec( args[ 0 ] ) )
+    {
+        /* The filters of the specification need all snps */
+        genotypes = create_genotype_matrix( genotype_file );
+
+        std::vector<double> maf( genotypes->size( ) );
+        for(size_t i = 0; i < genotypes->size( ); i++)
+        {
+            maf[ i ] = genotypes->get_stats( i ).maf;
+        }
+
+        pairs = create_pair_generator( args[ 0 ], genotype_file->get_locus_names( ), genotype_file->get_loci( ), maf );
+    }
+    else
+    {
+        pairs = open_pair_file( args[ 0 ].c_str( ), genotype_file->get_locus_names( ) );
+
+        /* Only read the genotypes of snps in this split of a binary pair file */
+        bpairfile *binary_pairs = dynamic_cast<bpairfile *>( pairs );
+        std::vector<bool> used_loci;
+        if( binary_pairs != NULL && !load_all_snps )
+        {
+            used_loci = find_used_loci( *binary_pairs, genotype_file->get_locus_names( ), split, num_splits );
+        }
+
+        if( !used_loci.empty( ) )
+        {
+            genotypes = create_genotype_matrix( genotype_file, used_loci );
+        }
+        else
+        {
+            genotypes = create_genotype_matrix( genotype_file );
+        }
+    }
     if( pairs == NULL || !pairs->open( split, num_splits ) )
     {
         std::cerr << "besiq: error: Could not open pair file." << std::endl;
@@ -61,8 +164,38 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
     method_data_ptr data( new method_data( ) );
     data->threshold = (double) options.get( "threshold" );
     data->print_params = (bool) options.get( "print_params" );
+    data->log_p = (bool) options.get( "log_p" );
     data->missing = zeros<uvec>( genotype_file->get_samples( ).size( ) );
     data->fast_inversion = false;
+    data->num_threads = num_threads;
+    int top = (int) options.get( "top" );
+    if( top < 0 )
+    {
+        std::cerr << "besiq: error: Number of top pairs must be >= 0." << std::endl;
+        exit( 1 );
+    }
+    data->top = top;
+    if( data->top > 0 && options.is_set( "out" ) )
+    {
+        data->summary_path = options[ "out" ] + ".summary";
+    }
+    int num_permutations = (int) options.get( "permutations" );
+    if( num_permutations < 0 )
+    {
+        std::cerr << "besiq: error: Number of permutations must be >= 0." << std::endl;
+        exit( 1 );
+    }
+    else if( num_permutations > 0 && !options.is_set( "out" ) )
+    {
+        std::cerr << "besiq: error: --permutations needs --out, the null distribution is written to <out>.null." << std::endl;
+        exit( 1 );
+    }
+    data->num_permutations = num_permutations;
+    data->permutation_seed = (unsigned long) options.get( "permutation_seed" );
+    if( data->num_permutations > 0 )
+    {
+        data->null_path = options[ "out" ] + ".null";
+    }
     std::vector<std::string> order = genotype_file->get_sample_iids( );
     if( options.is_set( "pheno" ) )
     {
@@ -85,14 +218,18 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
     
     /* Open results. */
     resultfile *result_file = NULL;
-    if( options.is_set( "out" ) )
+    if( !open_result )
+    {
+        return shared_ptr<common_options>( new common_options( genotype_file, genotypes, data, pairs, result_file ) );
+    }
+    else if( options.is_set( "out" ) )
     {
         result_file = new bresultfile( options[ "out" ], genotype_file->get_locus_names( ) );
     }
     else
     {
         std::ios_base::sync_with_stdio( false );
-        result_file = new tresultfile( "-", "w" );
+        result_file = new tresultfile( "-", "w", genotype_file->get_locus_names( ) );
     }
     if( result_file == NULL || !result_file->open( ) )
     {
@@ -103,3 +240,12 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
     return shared_ptr<common_options>( new common_options( genotype_file, genotypes, data, pairs, result_file ) );
 }
 
+void
+check_permutations(method_type &method)
+{
+    if( method.get_data( )->num_permutations > 0 && method.get_count_type( ) != COUNT_TYPE_BINARY )
+    {
+        std::cerr << "besiq: error: --permutations is only available for methods that run from case/control counts." << std::endl;
+        exit( 1 );
+    }
+}
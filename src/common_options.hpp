@@ -35,6 +35,29 @@ struct common_options
 
 optparse::OptionParser create_common_options(const std::string &usage, const std::string &description, bool support_cov);
 
-shared_ptr<common_options> parse_common_options(optparse::Values &options, const std::vector<std::string> &args);
+/**
+ * Opens the genotypes, pairs, phenotypes and result file given by
+ * the common options. For binary pair files only the genotypes of
+ * snps in the selected split are loaded.
+ *
+ * @param options The parsed options.
+ * @param args The pair file and the plink file.
+ * @param load_all_snps If true, all genotypes are loaded even if
+ *                      the pairs only refer to some of them.
+ * @param open_result If false, the result file is not opened and
+ *                    left to the caller.
+ *
+ * @return The opened data.
+ */
+shared_ptr<common_options> parse_common_options(optparse::Values &options, const std::vector<std::string> &args, bool load_all_snps = false, bool open_result = true);
+
+/**
+ * Exits with an error if --permutations was given for a method that
+ * can not be run from case/control counts, since only the case labels
+ * are permuted.
+ *
+ * @param method The method selected by the options.
+ */
+void check_permutations(method_type &method);
 
 #endif /* End of __COMMON_OPTION_H__ */
@@ -87,6 +87,377 @@ TEST_F(snp_count_test, joint_count2)
     ASSERT_NEAR( count( 8, 1 ), 0.0, 0.00001 );
 }
 
+TEST_F(snp_count_test, joint_count_mask)
+{
+    pheno_mask mask;
+    ASSERT_TRUE( make_pheno_mask( phenotype, weight, mask ) );
+
+    arma::mat count = joint_count( row1, row2, mask );
+    arma::mat expected = joint_count( row1, row2, phenotype, weight );
+    for(int i = 0; i < 9; i++)
+    {
+        ASSERT_NEAR( count( i, 0 ), expected( i, 0 ), 0.00001 );
+        ASSERT_NEAR( count( i, 1 ), expected( i, 1 ), 0.00001 );
+    }
+
+    weight[ 1 ] = 0.5;
+    ASSERT_FALSE( make_pheno_mask( phenotype, weight, mask ) );
+}
+
+TEST_F(snp_count_test, count_engine)
+{
+    arma::uvec missing = arma::zeros<arma::uvec>( 5 );
+    missing[ 3 ] = 1;
+    arma::vec present_weight = weight;
+    present_weight[ 3 ] = 0.0;
+
+    count_engine counter( phenotype, missing );
+    ASSERT_TRUE( counter.has_unit_weights( ) );
+
+    binary_table binary;
+    counter.count( row1, row2, binary );
+    arma::mat expected = joint_count( row1, row2, phenotype, present_weight );
+    for(int i = 0; i < 9; i++)
+    {
+        ASSERT_NEAR( binary( i, 0 ), expected( i, 0 ), 0.00001 );
+        ASSERT_NEAR( binary( i, 1 ), expected( i, 1 ), 0.00001 );
+    }
+
+    cont_table cont;
+    counter.count( row1, row2, cont );
+    arma::mat expected_cont = joint_count_cont( row1, row2, phenotype, present_weight );
+    for(int i = 0; i < 9; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            ASSERT_NEAR( cont( i, j ), expected_cont( i, j ), 0.00001 );
+        }
+    }
+
+    /* Non-unit weights take the per sample path */
+    present_weight[ 1 ] = 0.5;
+    count_engine weighted_counter( phenotype, missing, present_weight );
+    ASSERT_FALSE( weighted_counter.has_unit_weights( ) );
+
+    weighted_counter.count( row1, row2, binary );
+    expected = joint_count( row1, row2, phenotype, present_weight );
+    for(int i = 0; i < 9; i++)
+    {
+        ASSERT_NEAR( binary( i, 0 ), expected( i, 0 ), 0.00001 );
+        ASSERT_NEAR( binary( i, 1 ), expected( i, 1 ), 0.00001 );
+    }
+
+    weighted_counter.count( row1, row2, cont );
+    expected_cont = joint_count_cont( row1, row2, phenotype, present_weight );
+    for(int i = 0; i < 9; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            ASSERT_NEAR( cont( i, j ), expected_cont( i, j ), 0.00001 );
+        }
+    }
+}
+
+TEST(snp_count_isa_test, count_engine_isa)
+{
+    /* Spans several words and a partial last word, the values are
+     * integers or halves so that all summation orders are exact */
+    size_t num_samples = 1000;
+    snp_row row1;
+    snp_row row2;
+    row1.resize( num_samples );
+    row2.resize( num_samples );
+    arma::vec phenotype = arma::zeros<arma::vec>( num_samples );
+    arma::vec weight = arma::ones<arma::vec>( num_samples );
+    arma::uvec missing = arma::zeros<arma::uvec>( num_samples );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 13 ) % 4 );
+        row2.assign( i, ( i * 5 + i / 3 ) % 4 );
+        phenotype[ i ] = ( i * 11 ) % 3 == 0;
+        missing[ i ] = i % 17 == 0;
+        weight[ i ] = 0.5 * ( 1 + i % 3 );
+    }
+
+    count_engine scalar_counter( phenotype, missing );
+    count_engine scalar_weighted( phenotype, missing, weight );
+    ASSERT_TRUE( scalar_counter.set_isa( COUNT_ISA_SCALAR ) );
+    ASSERT_TRUE( scalar_weighted.set_isa( COUNT_ISA_SCALAR ) );
+
+    binary_table expected_binary;
+    binary_table expected_weighted;
+    cont_table expected_cont;
+    scalar_counter.count( row1, row2, expected_binary );
+    scalar_weighted.count( row1, row2, expected_weighted );
+    scalar_weighted.count( row1, row2, expected_cont );
+
+    for(size_t isa = 0; isa < COUNT_ISA_NUM; isa++)
+    {
+        count_engine counter( phenotype, missing );
+        count_engine weighted( phenotype, missing, weight );
+        if( !counter.set_isa( (count_isa) isa ) || !weighted.set_isa( (count_isa) isa ) )
+        {
+            continue;
+        }
+
+        binary_table binary;
+        binary_table binary_weighted;
+        cont_table cont;
+        counter.count( row1, row2, binary );
+        weighted.count( row1, row2, binary_weighted );
+        weighted.count( row1, row2, cont );
+        for(int i = 0; i < 9; i++)
+        {
+            for(int j = 0; j < 2; j++)
+            {
+                ASSERT_EQ( binary( i, j ), expected_binary( i, j ) ) << get_count_isa_name( (count_isa) isa );
+                ASSERT_EQ( binary_weighted( i, j ), expected_weighted( i, j ) ) << get_count_isa_name( (count_isa) isa );
+            }
+            for(int j = 0; j < 3; j++)
+            {
+                ASSERT_EQ( cont( i, j ), expected_cont( i, j ) ) << get_count_isa_name( (count_isa) isa );
+            }
+        }
+    }
+
+    /* The scalar reference agrees with the per sample counts */
+    arma::vec present_weight = weight;
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        present_weight[ i ] = missing[ i ] ? 0.0 : weight[ i ];
+    }
+    arma::mat reference = joint_count_cont( row1, row2, phenotype, present_weight );
+    for(int i = 0; i < 9; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            ASSERT_EQ( expected_cont( i, j ), reference( i, j ) );
+        }
+    }
+}
+
+TEST(snp_count_isa_test, count_planes_masks)
+{
+    /* A number of masks that is not a multiple of the vector width */
+    size_t num_words = 5;
+    size_t num_masks = 13;
+    std::vector<uint64_t> planes( 4 * num_words );
+    std::vector<uint64_t> masks( num_words * num_masks );
+    uint64_t x = 88172645463325252ULL;
+    for(size_t i = 0; i < planes.size( ); i++)
+    {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        planes[ i ] = i % 7 == 0 ? 0 : x;
+    }
+    for(size_t i = 0; i < masks.size( ); i++)
+    {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        masks[ i ] = x;
+    }
+
+    const uint64_t *a[] = { &planes[ 0 ], &planes[ num_words ], &planes[ 0 ] };
+    const uint64_t *b[] = { &planes[ 2 * num_words ], &planes[ 3 * num_words ], &planes[ num_words ] };
+    std::vector<uint64_t> expected( 3 * num_masks, 0 );
+    for(size_t k = 0; k < 3; k++)
+    {
+        for(size_t m = 0; m < num_masks; m++)
+        {
+            for(size_t w = 0; w < num_words; w++)
+            {
+                expected[ k * num_masks + m ] += __builtin_popcountll( a[ k ][ w ] & b[ k ][ w ] & masks[ w * num_masks + m ] );
+            }
+        }
+    }
+
+    for(size_t isa = 0; isa < COUNT_ISA_NUM; isa++)
+    {
+        if( !is_count_isa_supported( (count_isa) isa ) )
+        {
+            continue;
+        }
+
+        std::vector<uint64_t> n( 3 * num_masks, 1 );
+        count_planes_masks( a, b, 3, &masks[ 0 ], num_masks, num_words, (count_isa) isa, &n[ 0 ] );
+        for(size_t i = 0; i < n.size( ); i++)
+        {
+            ASSERT_EQ( n[ i ], expected[ i ] + 1 ) << get_count_isa_name( (count_isa) isa );
+        }
+    }
+}
+
+TEST(snp_count_marginal_test, count_engine_rows)
+{
+    /* Rows without missing genotypes, with missing genotypes, and
+     * with all samples missing */
+    size_t num_samples = 300;
+    shared_ptr< std::vector<snp_row> > row_ptr( new std::vector<snp_row>( 4 ) );
+    std::vector<snp_row> &rows = *row_ptr;
+    for(size_t r = 0; r < rows.size( ); r++)
+    {
+        rows[ r ].resize( num_samples );
+    }
+    arma::vec phenotype = arma::zeros<arma::vec>( num_samples );
+    arma::uvec missing = arma::zeros<arma::uvec>( num_samples );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        rows[ 0 ].assign( i, ( i * 7 + i / 5 ) % 3 );
+        rows[ 1 ].assign( i, ( i * 3 + i / 7 ) % 4 );
+        rows[ 2 ].assign( i, ( i * 5 + i / 11 ) % 4 );
+        rows[ 3 ].assign( i, 3 );
+        phenotype[ i ] = ( i % 7 ) % 3;
+        missing[ i ] = i % 13 == 0;
+    }
+
+    genotype_matrix_ptr genotypes( new genotype_matrix( row_ptr, std::vector<std::string>( rows.size( ) ) ) );
+    count_engine counter( phenotype, missing );
+    count_engine row_counter( phenotype, missing );
+    row_counter.set_genotypes( genotypes );
+    for(size_t i = 0; i < rows.size( ); i++)
+    {
+        for(size_t j = 0; j < rows.size( ); j++)
+        {
+            binary_table expected;
+            binary_table table;
+            counter.count( rows[ i ], rows[ j ], expected );
+            row_counter.count( rows[ i ], rows[ j ], table );
+            for(int c = 0; c < 9; c++)
+            {
+                ASSERT_EQ( table( c, 0 ), expected( c, 0 ) );
+                ASSERT_EQ( table( c, 1 ), expected( c, 1 ) );
+            }
+
+            /* Bounds hold and the number of samples is exact */
+            binary_table bound;
+            double num_samples = 0.0;
+            ASSERT_TRUE( row_counter.bound( rows[ i ], rows[ j ], bound, num_samples ) );
+            ASSERT_EQ( num_samples, expected.sum( 0 ) + expected.sum( 1 ) );
+            for(int c = 0; c < 9; c++)
+            {
+                ASSERT_GE( bound( c, 0 ), expected( c, 0 ) );
+                ASSERT_GE( bound( c, 1 ), expected( c, 1 ) );
+            }
+
+            cont_table cont;
+            size_table size_bound;
+            counter.count( rows[ i ], rows[ j ], cont );
+            ASSERT_TRUE( row_counter.bound( rows[ i ], rows[ j ], size_bound, num_samples ) );
+            ASSERT_EQ( num_samples, cont.sum( 1 ) );
+            for(int c = 0; c < 9; c++)
+            {
+                ASSERT_GE( size_bound( c, 0 ), cont( c, 1 ) );
+            }
+        }
+    }
+
+    /* Rows that are not stored in the matrix are counted directly,
+     * also when they have the index of a row of the matrix */
+    snp_row copy = rows[ 1 ];
+    binary_table expected;
+    binary_table table;
+    counter.count( copy, rows[ 2 ], expected );
+    row_counter.count( copy, rows[ 2 ], table );
+    double num_bounded = 0.0;
+    ASSERT_EQ( copy.get_index( ), 1 );
+    ASSERT_FALSE( row_counter.bound( copy, rows[ 2 ], table, num_bounded ) );
+    for(int c = 0; c < 9; c++)
+    {
+        ASSERT_EQ( table( c, 0 ), expected( c, 0 ) );
+        ASSERT_EQ( table( c, 1 ), expected( c, 1 ) );
+    }
+
+    /* The marginals are computed once for each set of classes */
+    std::vector< std::vector<uint64_t> > masks( 1, std::vector<uint64_t>( rows[ 0 ].num_words( ), ~0ULL ) );
+    class_counts_ptr marginals = genotypes->get_class_counts( masks );
+    ASSERT_EQ( marginals.get( ), genotypes->get_class_counts( masks ).get( ) );
+    for(size_t r = 0; r < rows.size( ); r++)
+    {
+        for(unsigned char g = 0; g < SNP_ROW_NUM_PLANES; g++)
+        {
+            ASSERT_EQ( ( *marginals )[ r ].n[ g ][ 0 ], genotypes->get_stats( r ).counts[ g ] );
+            ASSERT_EQ( ( *marginals )[ r ].n[ g ][ 1 ], 0 );
+        }
+    }
+
+    /* Batches give the same tables, whether or not two tables fit
+     * in one call of the kernel */
+    const snp_row *partners[] = { &rows[ 0 ], &rows[ 0 ], &rows[ 1 ], &copy, &rows[ 0 ], &rows[ 3 ], &rows[ 2 ] };
+    size_t num_partners = sizeof( partners ) / sizeof( partners[ 0 ] );
+    for(size_t i = 0; i < rows.size( ); i++)
+    {
+        std::vector<binary_table> tables( num_partners );
+        row_counter.count( rows[ i ], partners, num_partners, &tables[ 0 ] );
+        for(size_t k = 0; k < num_partners; k++)
+        {
+            counter.count( rows[ i ], *partners[ k ], expected );
+            for(int c = 0; c < 9; c++)
+            {
+                ASSERT_EQ( tables[ k ]( c, 0 ), expected( c, 0 ) );
+                ASSERT_EQ( tables[ k ]( c, 1 ), expected( c, 1 ) );
+            }
+        }
+    }
+}
+
+TEST(snp_count_marginal_test, count_engine_single_column)
+{
+    /* Only cases or only controls, counted with a single mask */
+    size_t num_samples = 700;
+    shared_ptr< std::vector<snp_row> > row_ptr( new std::vector<snp_row>( 3 ) );
+    std::vector<snp_row> &rows = *row_ptr;
+    for(size_t r = 0; r < rows.size( ); r++)
+    {
+        rows[ r ].resize( num_samples );
+    }
+    arma::vec weight = arma::ones<arma::vec>( num_samples );
+    arma::uvec missing = arma::zeros<arma::uvec>( num_samples );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        rows[ 0 ].assign( i, ( i * 7 + i / 5 ) % 3 );
+        rows[ 1 ].assign( i, ( i * 3 + i / 7 ) % 4 );
+        rows[ 2 ].assign( i, ( i * 5 + i / 11 ) % 4 );
+        missing[ i ] = i % 13 == 0;
+        weight[ i ] = missing[ i ] ? 0.0 : 1.0;
+    }
+
+    genotype_matrix_ptr genotypes( new genotype_matrix( row_ptr, std::vector<std::string>( rows.size( ) ) ) );
+    const snp_row *partners[] = { &rows[ 0 ], &rows[ 1 ], &rows[ 2 ], &rows[ 1 ] };
+    size_t num_partners = sizeof( partners ) / sizeof( partners[ 0 ] );
+    for(int column = 0; column <= 1; column++)
+    {
+        arma::vec phenotype = arma::zeros<arma::vec>( num_samples );
+        phenotype.fill( column );
+        for(size_t isa = 0; isa < COUNT_ISA_NUM; isa++)
+        {
+            count_engine counter( phenotype, missing );
+            count_engine row_counter( phenotype, missing );
+            if( !counter.set_isa( (count_isa) isa ) || !row_counter.set_isa( (count_isa) isa ) )
+            {
+                continue;
+            }
+            row_counter.set_genotypes( genotypes );
+
+            for(size_t i = 0; i < rows.size( ); i++)
+            {
+                std::vector<binary_table> tables( num_partners );
+                row_counter.count( rows[ i ], partners, num_partners, &tables[ 0 ] );
+                for(size_t k = 0; k < num_partners; k++)
+                {
+                    arma::mat expected = joint_count( rows[ i ], *partners[ k ], phenotype, weight );
+                    binary_table table;
+                    counter.count( rows[ i ], *partners[ k ], table );
+                    for(int c = 0; c < 9; c++)
+                    {
+                        ASSERT_EQ( table( c, 0 ), expected( c, 0 ) ) << get_count_isa_name( (count_isa) isa );
+                        ASSERT_EQ( table( c, 1 ), expected( c, 1 ) ) << get_count_isa_name( (count_isa) isa );
+                        ASSERT_EQ( tables[ k ]( c, 0 ), expected( c, 0 ) ) << get_count_isa_name( (count_isa) isa );
+                        ASSERT_EQ( tables[ k ]( c, 1 ), expected( c, 1 ) ) << get_count_isa_name( (count_isa) isa );
+                    }
+                }
+            }
+        }
+    }
+}
+
 TEST_F(snp_count_test, pheno_count)
 {
     arma::vec count = pheno_count( row1, row2, phenotype, weight );
@@ -0,0 +1,317 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+#include <vector>
+
+#include <dcdflib/tail.hpp>
+#include <glm/models/binomial.hpp>
+#include <glm/models/normal.hpp>
+#include <besiq/method/glm_method.hpp>
+#include <besiq/method/scaleinv_method.hpp>
+
+/**
+ * Fits the model on the samples from the default starting point,
+ * the way glm_method does when the model matrix has covariates.
+ * The iterations of both fits are added to num_iters if given.
+ */
+static double
+sample_lr(method_data_ptr data, const glm_model &model, model_matrix &matrix, const snp_row &row1, const snp_row &row2, size_t *num_iters = NULL)
+{
+    arma::uvec missing = data->missing;
+    matrix.update_matrix( row1, row2, missing );
+
+    glm_info null_info;
+    glm_fit( matrix.get_null( ), data->phenotype, missing, model, null_info );
+    glm_info alt_info;
+    glm_fit( matrix.get_alt( ), data->phenotype, missing, model, alt_info );
+    if( num_iters != NULL )
+    {
+        *num_iters += null_info.num_iters + alt_info.num_iters;
+    }
+
+    return -2 * ( null_info.logl - alt_info.logl );
+}
+
+TEST(glm_method_test, grouped_same_as_samples)
+{
+    size_t num_samples = 500;
+    snp_row row1;
+    snp_row row2;
+    row1.resize( num_samples );
+    row2.resize( num_samples );
+
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( num_samples );
+    data->missing = arma::zeros<arma::uvec>( num_samples );
+    arma::vec quantitative( num_samples );
+    size_t num_ok = 0;
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 5 ) % 3 );
+        row2.assign( i, ( i * 3 + i / 7 ) % 4 );
+        data->phenotype[ i ] = ( i * 5 + i / 3 ) % 2;
+        data->missing[ i ] = i % 17 == 0;
+        quantitative[ i ] = row1[ i ] * 0.3 + ( row2[ i ] % 3 ) * 0.2 + ( row1[ i ] * row2[ i ] == 4 ) * 0.5 + sin( 0.37 * i );
+        num_ok += data->missing[ i ] == 0 && row2[ i ] != 3;
+    }
+
+    std::vector<std::string> types;
+    types.push_back( "factor" );
+    types.push_back( "additive" );
+    types.push_back( "tukey" );
+    types.push_back( "noia" );
+    binomial logit_model( "logit" );
+    binomial log_model( "log" );
+    for(size_t t = 0; t < types.size( ); t++)
+    {
+        model_matrix *matrix = make_model_matrix( types[ t ], data->covariate_matrix, num_samples );
+        const glm_model *models[] = { &logit_model, &log_model };
+        for(int m = 0; m < 2; m++)
+        {
+            glm_method method( data, *models[ m ], *matrix );
+            ASSERT_EQ( method.get_count_type( ), COUNT_TYPE_CONT );
+
+            std::vector<float> output( method.init( ).size( ), -9.0f );
+            ASSERT_NE( method.run( row1, row2, &output[ 0 ] ), -9 );
+            double expected = sample_lr( data, *models[ m ], *matrix, row1, row2 );
+            EXPECT_NEAR( output[ 0 ], expected, 1e-4 * ( 1.0 + expected ) );
+            EXPECT_EQ( method.num_ok_samples( row1, row2 ), num_ok );
+        }
+        delete matrix;
+    }
+
+    /* The normal model */
+    data->phenotype = quantitative;
+    factor_matrix matrix( data->covariate_matrix, num_samples );
+    normal identity_model( "identity" );
+    scaleinv_method method( data, matrix, true );
+    ASSERT_EQ( method.get_count_type( ), COUNT_TYPE_CONT );
+    std::vector<float> output( method.init( ).size( ), -9.0f );
+    double p = method.run( row1, row2, &output[ 0 ] );
+    ASSERT_NE( p, -9 );
+    double expected = sample_lr( data, identity_model, matrix, row1, row2 );
+    EXPECT_NEAR( p, chi_square_upper( expected, matrix.num_df( ) ), 1e-6 );
+}
+
+TEST(glm_method_test, covariates_are_not_grouped)
+{
+    size_t num_samples = 50;
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( num_samples );
+    data->missing = arma::zeros<arma::uvec>( num_samples );
+    data->covariate_matrix = arma::ones<arma::mat>( num_samples, 1 );
+
+    factor_matrix matrix( data->covariate_matrix, num_samples );
+    binomial model( "logit" );
+    glm_method method( data, model, matrix );
+    EXPECT_EQ( method.get_count_type( ), COUNT_TYPE_NONE );
+}
+
+TEST(glm_method_test, score_test)
+{
+    size_t num_samples = 400;
+    snp_row row1;
+    snp_row row2;
+    row1.resize( num_samples );
+    row2.resize( num_samples );
+
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( num_samples );
+    data->missing = arma::zeros<arma::uvec>( num_samples );
+    data->covariate_matrix = arma::zeros<arma::mat>( num_samples, 2 );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 5 ) % 3 );
+        row2.assign( i, ( i * 3 + i / 7 ) % 4 );
+        data->missing[ i ] = i % 17 == 0;
+        data->covariate_matrix( i, 0 ) = cos( 0.21 * i );
+        data->covariate_matrix( i, 1 ) = ( i % 5 ) * 0.5;
+        data->phenotype[ i ] = 0.4 * data->covariate_matrix( i, 0 ) + row1[ i ] * 0.3 + ( row1[ i ] * row2[ i ] == 2 ) * 0.4 + sin( 0.37 * i );
+    }
+
+    /* Exact for the linear model, the explained sum of squares
+     * over the variance of the null model */
+    factor_matrix matrix( data->covariate_matrix, num_samples );
+    normal identity_model( "identity" );
+    glm_method method( data, identity_model, matrix );
+    ASSERT_TRUE( method.use_score_test( 0.0 ) );
+    ASSERT_EQ( method.get_count_type( ), COUNT_TYPE_NONE );
+    std::vector<std::string> header = method.init( );
+    ASSERT_EQ( header.size( ), 4 );
+    EXPECT_EQ( header[ 0 ], "SCORE" );
+    EXPECT_EQ( header[ 3 ], "P" );
+
+    std::vector<float> output( header.size( ), -9.0f );
+    double p = method.run( row1, row2, &output[ 0 ] );
+    ASSERT_NE( p, -9 );
+    EXPECT_EQ( output[ 2 ], -9.0f );
+
+    arma::uvec missing = data->missing;
+    matrix.update_matrix( row1, row2, missing );
+    glm_info null_info;
+    glm_fit( matrix.get_null( ), data->phenotype, missing, identity_model, null_info );
+    glm_info alt_info;
+    glm_fit( matrix.get_alt( ), data->phenotype, missing, identity_model, alt_info );
+    double rss_null = 0.0;
+    double rss_alt = 0.0;
+    double num_ok = 0.0;
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        if( missing[ i ] == 0 )
+        {
+            rss_null += ( data->phenotype[ i ] - null_info.mu[ i ] ) * ( data->phenotype[ i ] - null_info.mu[ i ] );
+            rss_alt += ( data->phenotype[ i ] - alt_info.mu[ i ] ) * ( data->phenotype[ i ] - alt_info.mu[ i ] );
+            num_ok += 1.0;
+        }
+    }
+    double expected = ( rss_null - rss_alt ) / ( rss_null / ( num_ok - matrix.num_null( ) - 2 ) );
+    EXPECT_NEAR( output[ 0 ], expected, 1e-4 * expected );
+    EXPECT_NEAR( p, chi_square_upper( expected, matrix.num_df( ) ), 1e-6 );
+
+    /* The likelihood ratio test is run below the threshold */
+    binomial logit_model( "logit" );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        data->phenotype[ i ] = ( i * 5 + i / 3 + row1[ i ] * row2[ i ] ) % 2;
+    }
+    glm_method lr_method( data, logit_model, matrix );
+    std::vector<float> lr_output( lr_method.init( ).size( ), -9.0f );
+    double lr_p = lr_method.run( row1, row2, &lr_output[ 0 ] );
+    ASSERT_NE( lr_p, -9 );
+
+    glm_method score_method( data, logit_model, matrix );
+    ASSERT_TRUE( score_method.use_score_test( 1.0 ) );
+    std::vector<float> score_output( score_method.init( ).size( ), -9.0f );
+    double score_p = score_method.run( row1, row2, &score_output[ 0 ] );
+    ASSERT_NE( score_p, -9 );
+    EXPECT_FLOAT_EQ( score_output[ 1 ], score_p );
+    EXPECT_NEAR( score_method.get_log10_p( ), -log10( score_p ), 1e-6 );
+    EXPECT_GT( score_output[ 0 ], 0.0f );
+    EXPECT_EQ( score_output[ 2 ], lr_output[ 0 ] );
+    EXPECT_EQ( score_output[ 3 ], lr_output[ 1 ] );
+}
+
+TEST(glm_method_test, warm_start)
+{
+    size_t num_samples = 400;
+    size_t num_snps = 6;
+    std::vector<snp_row> rows( num_snps );
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( num_samples );
+    data->missing = arma::zeros<arma::uvec>( num_samples );
+    data->covariate_matrix = arma::zeros<arma::mat>( num_samples, 1 );
+    for(size_t s = 0; s < num_snps; s++)
+    {
+        rows[ s ].resize( num_samples );
+        for(size_t i = 0; i < num_samples; i++)
+        {
+            rows[ s ].assign( i, ( i * ( 2 * s + 3 ) + i / ( s + 5 ) ) % 3 );
+        }
+    }
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        data->missing[ i ] = i % 19 == 0;
+        data->covariate_matrix( i, 0 ) = cos( 0.21 * i );
+        double eta = -2.0 + 2.5 * data->covariate_matrix( i, 0 ) + 0.8 * rows[ 0 ][ i ] + 0.5 * rows[ 1 ][ i ];
+        data->phenotype[ i ] = ( ( i * 37 ) % 101 ) / 101.0 < 1.0 / ( 1.0 + exp( -eta ) );
+    }
+
+    binomial model( "logit" );
+    factor_matrix matrix( data->covariate_matrix, num_samples );
+    factor_matrix cold_matrix( data->covariate_matrix, num_samples );
+    glm_method method( data, model, matrix );
+    std::vector<float> output( method.init( ).size( ), -9.0f );
+    size_t num_pairs = 0;
+    size_t cold_iters = 0;
+    for(size_t s1 = 0; s1 < num_snps; s1++)
+    {
+        for(size_t s2 = s1 + 1; s2 < num_snps; s2++)
+        {
+            ASSERT_NE( method.run( rows[ s1 ], rows[ s2 ], &output[ 0 ] ), -9 );
+            double expected = sample_lr( data, model, cold_matrix, rows[ s1 ], rows[ s2 ], &cold_iters );
+            EXPECT_NEAR( output[ 0 ], expected, 1e-3 * ( 1.0 + expected ) );
+            num_pairs++;
+        }
+    }
+
+    ASSERT_EQ( method.num_fits( ), 2 * num_pairs );
+    EXPECT_LT( method.num_iterations( ), cold_iters );
+}
+
+TEST(glm_method_test, batch_same_as_pairs)
+{
+    size_t num_samples = 300;
+    size_t num_pairs = IRLS_BATCH_SIZE + 5;
+    snp_row row1;
+    row1.resize( num_samples );
+    std::vector<snp_row> rows( num_pairs );
+    std::vector<const snp_row *> rows2( num_pairs );
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( num_samples );
+    data->missing = arma::zeros<arma::uvec>( num_samples );
+    data->covariate_matrix = arma::zeros<arma::mat>( num_samples, 1 );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 5 ) % 4 );
+        data->missing[ i ] = i % 23 == 0;
+        data->covariate_matrix( i, 0 ) = cos( 0.21 * i );
+    }
+    for(size_t s = 0; s < num_pairs; s++)
+    {
+        rows[ s ].resize( num_samples );
+        for(size_t i = 0; i < num_samples; i++)
+        {
+            /* The last snp is monomorphic, so its main effects can not be estimated */
+            rows[ s ].assign( i, s + 1 < num_pairs ? ( i * ( 2 * s + 3 ) + i / ( s + 5 ) ) % 3 : 0 );
+        }
+        rows2[ s ] = &rows[ s ];
+    }
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        double eta = -1.5 + 1.5 * data->covariate_matrix( i, 0 ) + 0.4 * ( row1[ i ] % 3 ) + 0.5 * ( row1[ i ] * rows[ 0 ][ i ] == 2 );
+        data->phenotype[ i ] = ( ( i * 37 ) % 101 ) / 101.0 < 1.0 / ( 1.0 + exp( -eta ) );
+    }
+
+    std::vector<std::string> types;
+    types.push_back( "factor" );
+    types.push_back( "additive" );
+    binomial logit_model( "logit" );
+    binomial log_model( "log" );
+    for(size_t t = 0; t < types.size( ); t++)
+    {
+        model_matrix *matrix = make_model_matrix( types[ t ], data->covariate_matrix, num_samples );
+        model_matrix *pair_matrix = make_model_matrix( types[ t ], data->covariate_matrix, num_samples );
+        const glm_model *models[] = { &logit_model, &log_model };
+        for(int m = 0; m < 2; m++)
+        {
+            glm_method method( data, *models[ m ], *matrix );
+            size_t num_columns = method.init( ).size( );
+            std::vector<float> outputs( num_pairs * num_columns, -9.0f );
+            std::vector<double> statistics( num_pairs );
+            std::vector<size_t> num_ok( num_pairs );
+            std::vector<double> log10_p( num_pairs );
+            method.run_batch( row1, &rows2[ 0 ], num_pairs, &outputs[ 0 ], num_columns, &statistics[ 0 ], &num_ok[ 0 ], &log10_p[ 0 ] );
+
+            glm_method pair_method( data, *models[ m ], *pair_matrix );
+            for(size_t s = 0; s < num_pairs; s++)
+            {
+                std::vector<float> output( num_columns, -9.0f );
+                double p = pair_method.run( row1, rows[ s ], &output[ 0 ] );
+                EXPECT_EQ( num_ok[ s ], pair_method.num_ok_samples( row1, rows[ s ] ) );
+                if( p == -9 )
+                {
+                    EXPECT_EQ( statistics[ s ], -9 );
+                    continue;
+                }
+
+                ASSERT_NE( statistics[ s ], -9 );
+                EXPECT_NEAR( outputs[ s * num_columns ], output[ 0 ], 1e-3 * ( 1.0 + output[ 0 ] ) );
+                EXPECT_NEAR( statistics[ s ], p, 1e-3 * ( p + 1e-3 ) );
+                EXPECT_NEAR( log10_p[ s ], pair_method.get_log10_p( ), 1e-3 * ( 1.0 + log10_p[ s ] ) );
+            }
+            EXPECT_EQ( method.num_fits( ), pair_method.num_fits( ) );
+        }
+        delete matrix;
+        delete pair_matrix;
+    }
+}
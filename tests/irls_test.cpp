@@ -1,8 +1,11 @@
 #include <armadillo>
 #include <gtest/gtest.h>
 
+#include <glm/glm.hpp>
 #include <glm/irls.hpp>
+#include <glm/irls_batch.hpp>
 #include <glm/models/binomial.hpp>
+#include <glm/models/normal.hpp>
 
 using namespace arma;
 
@@ -23,3 +26,212 @@ TEST(IRLSTest, Simple)
     ASSERT_NEAR( b[ 0 ], 2.0, 0.01 ); 
     ASSERT_NEAR( b[ 1 ], 3.5, 0.01 ); 
 }
+
+TEST(IRLSTest, Start)
+{
+    double A_aux[] = { 1.0, 1.0, 1.0, 1.0,
+                       -1.160, -0.655, 0.4156, -1.740 };
+
+    double y_aux[] = { 0.1131, 0.4271, 0.9694, 0.0164 };
+
+    mat A( A_aux, 4, 2 );
+    vec y( y_aux, 4 );
+    uvec missing = zeros<uvec>( 4 );
+    binomial binomial_model( "logit" );
+    glm_workspace workspace;
+
+    glm_info cold;
+    vec b = irls( A, y, missing, binomial_model, cold, workspace );
+    ASSERT_TRUE( cold.success );
+
+    /* From the estimate */
+    glm_info warm;
+    vec b_warm = irls( A, y, missing, binomial_model, warm, workspace, b );
+    ASSERT_TRUE( warm.success );
+    EXPECT_LT( warm.num_iters, cold.num_iters );
+    EXPECT_NEAR( b_warm[ 0 ], b[ 0 ], 1e-4 );
+    EXPECT_NEAR( b_warm[ 1 ], b[ 1 ], 1e-4 );
+    EXPECT_NEAR( warm.logl, cold.logl, 1e-6 );
+
+    /* A start of the wrong size is not used */
+    glm_info wrong;
+    irls( A, y, missing, binomial_model, wrong, workspace, ones<vec>( 3 ) );
+    EXPECT_TRUE( wrong.success );
+    EXPECT_EQ( wrong.num_iters, cold.num_iters );
+}
+
+TEST(IRLSTest, Workspace)
+{
+    /* More rows than a block, the last block is partial */
+    size_t n = GLM_WORKSPACE_BLOCK_ROWS * 3 + 17;
+    size_t p = 4;
+    mat X( n, p );
+    vec y( n );
+    vec w( n );
+    for(size_t i = 0; i < n; i++)
+    {
+        X( i, 0 ) = 1.0;
+        X( i, 1 ) = ( i * 7 ) % 3;
+        X( i, 2 ) = 40.0 + ( i * 13 ) % 29;
+        X( i, 3 ) = sin( 0.1 * i );
+        y[ i ] = 0.5 * X( i, 1 ) - 0.02 * X( i, 2 ) + cos( 0.3 * i );
+        w[ i ] = i % 11 == 0 ? 0.0 : 0.5 + ( i % 5 ) * 0.25;
+    }
+
+    glm_workspace workspace;
+    vec beta;
+    for(int attempt = 0; attempt < 2; attempt++)
+    {
+        ASSERT_TRUE( workspace.solve( X, y, w, false, beta ) );
+        vec expected = weighted_least_squares( X, y, w );
+        for(size_t j = 0; j < p; j++)
+        {
+            EXPECT_NEAR( beta[ j ], expected[ j ], 1e-8 * ( 1.0 + fabs( expected[ j ] ) ) );
+        }
+    }
+
+    /* The inverse of X^T W X */
+    mat I( p, p );
+    for(size_t j = 0; j < p; j++)
+    {
+        for(size_t k = 0; k < p; k++)
+        {
+            I( j, k ) = 0.0;
+            for(size_t i = 0; i < n; i++)
+            {
+                I( j, k ) += X( i, j ) * w[ i ] * X( i, k );
+            }
+        }
+    }
+    mat expected_C;
+    mat C;
+    ASSERT_TRUE( inv( expected_C, I ) );
+    ASSERT_TRUE( workspace.invert( C ) );
+    for(size_t j = 0; j < p; j++)
+    {
+        for(size_t k = 0; k < p; k++)
+        {
+            EXPECT_NEAR( C( j, k ), expected_C( j, k ), 1e-8 * fabs( expected_C( j, j ) ) );
+        }
+    }
+
+    /* Collinear columns are solved as before */
+    for(size_t i = 0; i < n; i++)
+    {
+        X( i, 3 ) = 2.0 * X( i, 1 );
+    }
+    vec expected = weighted_least_squares( X, y, w );
+    workspace.solve( X, y, w, false, beta );
+    ASSERT_EQ( beta.n_elem, expected.n_elem );
+    for(size_t j = 0; j < beta.n_elem; j++)
+    {
+        EXPECT_EQ( beta[ j ], expected[ j ] );
+    }
+}
+
+TEST(IRLSTest, Grouped)
+{
+    /* Three groups of samples that share a row */
+    double rows_aux[] = { 1.0, 1.0, 1.0,
+                          0.0, 1.0, 2.0 };
+    mat rows( rows_aux, 3, 2 );
+    size_t n = 60;
+    mat X( n, 2 );
+    vec binary( n );
+    vec quantitative( n );
+    uvec missing = zeros<uvec>( n );
+    glm_groups binary_groups;
+    glm_groups quantitative_groups;
+    binary_groups.n = binary_groups.sum = binary_groups.sum_sq = zeros<vec>( 3 );
+    quantitative_groups.n = quantitative_groups.sum = quantitative_groups.sum_sq = zeros<vec>( 3 );
+    for(size_t i = 0; i < n; i++)
+    {
+        size_t g = ( i * 7 ) % 3;
+        X( i, 0 ) = rows( g, 0 );
+        X( i, 1 ) = rows( g, 1 );
+        binary[ i ] = ( i / 2 + g ) % 3 == 0;
+        quantitative[ i ] = 2.0 + 0.5 * g + sin( 0.7 * i );
+        missing[ i ] = i % 13 == 0;
+        if( missing[ i ] == 0 )
+        {
+            binary_groups.n[ g ] += 1.0;
+            binary_groups.sum[ g ] += binary[ i ];
+            binary_groups.sum_sq[ g ] += binary[ i ] * binary[ i ];
+            quantitative_groups.n[ g ] += 1.0;
+            quantitative_groups.sum[ g ] += quantitative[ i ];
+            quantitative_groups.sum_sq[ g ] += quantitative[ i ] * quantitative[ i ];
+        }
+    }
+
+    binomial logit_model( "logit" );
+    binomial log_model( "log" );
+    normal identity_model( "identity" );
+    normal normal_log_model( "log" );
+    const glm_model *models[] = { &logit_model, &log_model, &identity_model, &normal_log_model };
+    const vec *y[] = { &binary, &binary, &quantitative, &quantitative };
+    const glm_groups *groups[] = { &binary_groups, &binary_groups, &quantitative_groups, &quantitative_groups };
+    glm_workspace workspace;
+    for(int m = 0; m < 4; m++)
+    {
+        glm_info sample_info;
+        vec sample_beta = glm_fit( X, *y[ m ], missing, *models[ m ], sample_info, workspace );
+        glm_info group_info;
+        vec group_beta = glm_fit( rows, *groups[ m ], *models[ m ], group_info, workspace );
+
+        ASSERT_TRUE( sample_info.success );
+        ASSERT_TRUE( group_info.success );
+        EXPECT_NEAR( group_info.logl, sample_info.logl, 1e-6 * fabs( sample_info.logl ) );
+        for(int j = 0; j < 2; j++)
+        {
+            EXPECT_NEAR( group_beta[ j ], sample_beta[ j ], 1e-4 );
+            EXPECT_NEAR( group_info.se_beta[ j ], sample_info.se_beta[ j ], 1e-4 );
+        }
+    }
+}
+
+TEST(IRLSTest, Batch)
+{
+    size_t n = 200;
+    size_t num_models = 5;
+    mat shared( n, 2 );
+    vec y( n );
+    uvec missing = zeros<uvec>( n );
+    for(size_t i = 0; i < n; i++)
+    {
+        shared( i, 0 ) = 1.0;
+        shared( i, 1 ) = sin( 0.3 * i );
+        y[ i ] = exp( 0.5 + 0.3 * shared( i, 1 ) + 0.2 * ( i % 3 ) ) + cos( 0.7 * i );
+        missing[ i ] = i % 13 == 0;
+    }
+
+    normal log_model( "log" );
+    irls_batch batch( log_model, shared, 2 );
+    std::vector<mat> X( num_models, mat( n, 4 ) );
+    for(size_t k = 0; k < num_models; k++)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            X[ k ]( i, 0 ) = ( i * ( k + 2 ) + i / 7 ) % 3;
+            X[ k ]( i, 1 ) = ( i / ( k + 1 ) ) % 2;
+            X[ k ]( i, 2 ) = shared( i, 0 );
+            X[ k ]( i, 3 ) = shared( i, 1 );
+        }
+        ASSERT_EQ( batch.add( X[ k ], missing ), k );
+    }
+    batch.fit( y );
+
+    for(size_t k = 0; k < num_models; k++)
+    {
+        glm_info expected_info;
+        vec expected = irls( X[ k ], y, missing, log_model, expected_info );
+        const glm_info &info = batch.get_info( k );
+        ASSERT_TRUE( expected_info.success );
+        ASSERT_TRUE( info.success );
+        EXPECT_EQ( info.num_iters, expected_info.num_iters );
+        EXPECT_NEAR( info.logl, expected_info.logl, 1e-8 * fabs( expected_info.logl ) );
+        for(size_t j = 0; j < expected.n_elem; j++)
+        {
+            EXPECT_NEAR( batch.get_beta( k )[ j ], expected[ j ], 1e-6 );
+        }
+    }
+}
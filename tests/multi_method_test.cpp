@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+#include <vector>
+
+#include <besiq/method/caseonly_method.hpp>
+#include <besiq/method/loglinear_method.hpp>
+#include <besiq/method/multi_method.hpp>
+#include <besiq/method/peer_method.hpp>
+
+TEST(multi_method_test, same_as_separate)
+{
+    size_t num_samples = 400;
+    snp_row row1;
+    snp_row row2;
+    row1.resize( num_samples );
+    row2.resize( num_samples );
+
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( num_samples );
+    data->missing = arma::zeros<arma::uvec>( num_samples );
+    data->threshold = -9;
+    data->top = 0;
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 5 ) % 3 );
+        row2.assign( i, ( i * 3 + i / 7 ) % 4 );
+        data->phenotype[ i ] = ( i * 5 + i / 3 ) % 2;
+        data->missing[ i ] = i % 17 == 0;
+    }
+
+    std::vector<method_type *> methods;
+    methods.push_back( new caseonly_method( data, "contrast" ) );
+    methods.push_back( new peer_method( data ) );
+    methods.push_back( new loglinear_method( data ) );
+    std::vector<std::string> names;
+    names.push_back( "contrast" );
+    names.push_back( "peer" );
+    names.push_back( "loglinear" );
+    multi_method multi( data, methods, names );
+
+    std::vector<std::string> header = multi.init( );
+    ASSERT_EQ( header.size( ), 3 + 9 + 2 );
+    EXPECT_EQ( header[ 0 ], "contrast_LDdiff" );
+    EXPECT_EQ( header[ 2 ], "contrast_N" );
+    EXPECT_EQ( header[ 13 ], "loglinear_N" );
+
+    std::vector<float> output( header.size( ), -9.0f );
+    double statistic = multi.run( row1, row2, &output[ 0 ] );
+    EXPECT_NE( statistic, -9 );
+    EXPECT_NE( output[ 4 ], -9 );
+    EXPECT_NE( output[ 12 ], -9 );
+
+    caseonly_method contrast( data, "contrast" );
+    peer_method peer( data );
+    loglinear_method loglinear( data );
+    method_type *separate[] = { &contrast, &peer, &loglinear };
+    size_t offset = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        std::vector<float> expected( separate[ i ]->init( ).size( ), -9.0f );
+        double expected_statistic = separate[ i ]->run( row1, row2, &expected[ 0 ] );
+        if( i == 0 )
+        {
+            EXPECT_EQ( statistic, expected_statistic );
+            EXPECT_EQ( multi.num_ok_samples( row1, row2 ), contrast.num_ok_samples( row1, row2 ) );
+        }
+
+        for(size_t j = 0; j < expected.size( ); j++)
+        {
+            EXPECT_EQ( output[ offset + j ], expected[ j ] );
+        }
+        offset += expected.size( );
+        EXPECT_EQ( output[ offset ], separate[ i ]->num_ok_samples( row1, row2 ) );
+        offset++;
+    }
+}
+
+TEST(multi_method_test, num_ok_samples_of_skipped_pair)
+{
+    size_t num_samples = 400;
+    snp_row row1;
+    snp_row row2;
+    snp_row rare;
+    row1.resize( num_samples );
+    row2.resize( num_samples );
+    rare.resize( num_samples );
+
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( num_samples );
+    data->missing = arma::zeros<arma::uvec>( num_samples );
+    data->threshold = -9;
+    data->top = 0;
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 5 ) % 3 );
+        row2.assign( i, ( i * 3 + i / 7 ) % 4 );
+        rare.assign( i, i < 3 ? 1 : ( i % 11 == 0 ? 3 : 0 ) );
+        data->phenotype[ i ] = ( i * 5 + i / 3 ) % 2;
+        data->missing[ i ] = i % 17 == 0;
+    }
+
+    binary_table counts;
+    count_engine counter( data->phenotype, data->missing );
+    counter.count( row1, rare, counts );
+    size_t expected = (size_t) ( counts.sum( 0 ) + counts.sum( 1 ) );
+
+    /* A pair that fails the cell size after one that passes reports its own number of samples */
+    caseonly_method css( data, "css" );
+    caseonly_method contrast( data, "contrast" );
+    peer_method peer( data );
+    method_type *methods[] = { &css, &contrast, &peer };
+    for(int i = 0; i < 3; i++)
+    {
+        std::vector<float> output( methods[ i ]->init( ).size( ), -9.0f );
+        EXPECT_NE( methods[ i ]->run( row1, row2, &output[ 0 ] ), -9 );
+        EXPECT_EQ( methods[ i ]->run( row1, rare, &output[ 0 ] ), -9 );
+        EXPECT_EQ( methods[ i ]->num_ok_samples( row1, rare ), expected );
+    }
+}
+
+TEST(multi_method_test, log10_p_of_underflowed_pair)
+{
+    method_data_ptr data( new method_data( ) );
+    data->threshold = -9;
+    data->top = 0;
+
+    /* Two snps in almost complete linkage, the p-values underflow */
+    binary_table counts;
+    for(int i = 0; i < 9; i++)
+    {
+        counts( i, 0 ) = i % 4 == 0 ? 30000 : 5;
+        counts( i, 1 ) = i % 4 == 0 ? 30000 : 5;
+    }
+
+    caseonly_method r2( data, "r2" );
+    caseonly_method css( data, "css" );
+    method_type *methods[] = { &r2, &css };
+    for(int i = 0; i < 2; i++)
+    {
+        std::vector<float> output( methods[ i ]->init( ).size( ), -9.0f );
+        double p = methods[ i ]->run_from_counts( counts, &output[ 0 ] );
+        double log10_p = methods[ i ]->get_log10_p( );
+        EXPECT_GE( p, 0.0 );
+        EXPECT_LT( p, 1e-300 );
+        EXPECT_GT( log10_p, 1000.0 );
+        EXPECT_LT( log10_p, 1e10 );
+    }
+
+    /* A moderate p-value gives the same value as its logarithm */
+    for(int i = 0; i < 9; i++)
+    {
+        counts( i, 0 ) = 20 + ( i * 7 ) % 5;
+        counts( i, 1 ) = 20 + ( i * 3 ) % 4;
+    }
+    std::vector<float> output( r2.init( ).size( ), -9.0f );
+    double p = r2.run_from_counts( counts, &output[ 0 ] );
+    ASSERT_GT( p, 0.0 );
+    EXPECT_NEAR( r2.get_log10_p( ), -log10( p ), 1e-9 * ( 1.0 - log10( p ) ) );
+}
+
+TEST(multi_method_test, case_only_data)
+{
+    size_t num_samples = 400;
+    snp_row row1;
+    snp_row row2;
+    row1.resize( num_samples );
+    row2.resize( num_samples );
+
+    method_data_ptr cases( new method_data( ) );
+    cases->phenotype = arma::ones<arma::vec>( num_samples );
+    cases->missing = arma::zeros<arma::uvec>( num_samples );
+    cases->threshold = -9;
+    cases->top = 0;
+    method_data_ptr both( new method_data( *cases ) );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 5 ) % 3 );
+        row2.assign( i, ( i * 3 + i / 7 ) % 3 );
+        both->phenotype[ i ] = ( i * 5 + i / 3 ) % 2;
+    }
+
+    /* The pooled tests give the same statistic with only cases */
+    const char *tests[] = { "r2", "css" };
+    for(int i = 0; i < 2; i++)
+    {
+        caseonly_method case_only( cases, tests[ i ] );
+        caseonly_method case_control( both, tests[ i ] );
+        std::vector<float> output( case_only.init( ).size( ), -9.0f );
+        std::vector<float> expected( case_control.init( ).size( ), -9.0f );
+        double p = case_only.run( row1, row2, &output[ 0 ] );
+        double expected_p = case_control.run( row1, row2, &expected[ 0 ] );
+        ASSERT_NE( expected_p, -9 );
+        EXPECT_NEAR( p, expected_p, 1e-12 );
+        EXPECT_NEAR( output[ 0 ], expected[ 0 ], 1e-4 );
+        EXPECT_EQ( case_only.num_ok_samples( row1, row2 ), num_samples );
+    }
+
+    /* The tests that compare cases and controls can not be run */
+    caseonly_method contrast( cases, "contrast" );
+    peer_method peer( cases );
+    method_type *methods[] = { &contrast, &peer };
+    for(int i = 0; i < 2; i++)
+    {
+        std::vector<float> output( methods[ i ]->init( ).size( ), -9.0f );
+        EXPECT_EQ( methods[ i ]->run( row1, row2, &output[ 0 ] ), -9 );
+    }
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+
+#include <besiq/io/pair_generator.hpp>
+#include <besiq/io/pairfile.hpp>
+#include <plink/plink_file.hpp>
+
+class pair_generator_test : public testing::Test
+{
+protected:
+    void SetUp()
+    {
+        for(int i = 0; i < 6; i++)
+        {
+            std::ostringstream name;
+            name << "snp" << i;
+            m_names.push_back( name.str( ) );
+
+            pio_locus_t locus;
+            locus.chromosome = 1 + i / 3;
+            locus.bp_position = 100 * i;
+            m_loci.push_back( locus );
+        }
+
+        double maf[] = { 0.1, 0.4, 0.01, 0.3, 0.2, 0.5 };
+        m_maf = std::vector<double>( maf, maf + 6 );
+    }
+
+    std::vector< std::pair<size_t, size_t> > read_all(pair_generator &generator, size_t num_splits)
+    {
+        std::vector< std::pair<size_t, size_t> > pairs;
+        for(size_t split = 1; split <= num_splits; split++)
+        {
+            EXPECT_TRUE( generator.open( split, num_splits ) );
+            std::pair<size_t, size_t> pair;
+            while( generator.read( pair ) )
+            {
+                pairs.push_back( pair );
+            }
+        }
+
+        return pairs;
+    }
+
+    std::vector<std::string> m_names;
+    std::vector<pio_locus_t> m_loci;
+    std::vector<double> m_maf;
+};
+
+TEST_F(pair_generator_test, all)
+{
+    pair_generator generator( m_names, m_loci, m_maf, pair_filter( ) );
+    generator.set_all( );
+
+    std::vector< std::pair<size_t, size_t> > pairs = read_all( generator, 1 );
+    ASSERT_EQ( pairs.size( ), 15 );
+    ASSERT_EQ( pairs[ 0 ], std::make_pair( (size_t) 0, (size_t) 1 ) );
+    ASSERT_EQ( pairs[ 14 ], std::make_pair( (size_t) 4, (size_t) 5 ) );
+
+    for(size_t num_splits = 2; num_splits <= 20; num_splits++)
+    {
+        ASSERT_EQ( read_all( generator, num_splits ), pairs );
+    }
+}
+
+TEST_F(pair_generator_test, tiles)
+{
+    pair_generator generator( m_names, m_loci, m_maf, pair_filter( ) );
+    generator.set_all( );
+    std::vector< std::pair<size_t, size_t> > pairs = read_all( generator, 1 );
+
+    pair_filter filter;
+    filter.tile_size = 4;
+    pair_generator tiled( m_names, m_loci, m_maf, filter );
+    tiled.set_all( );
+    std::vector< std::pair<size_t, size_t> > tiled_pairs = read_all( tiled, 1 );
+
+    /* The second tile of the first row (0, 4) comes before the diagonal tile of (4, 5) */
+    ASSERT_EQ( tiled_pairs[ 6 ], std::make_pair( (size_t) 0, (size_t) 4 ) );
+    ASSERT_EQ( tiled_pairs[ 14 ], std::make_pair( (size_t) 4, (size_t) 5 ) );
+    for(size_t num_splits = 2; num_splits <= 20; num_splits++)
+    {
+        ASSERT_EQ( read_all( tiled, num_splits ), tiled_pairs );
+    }
+
+    std::sort( tiled_pairs.begin( ), tiled_pairs.end( ) );
+    ASSERT_EQ( tiled_pairs, pairs );
+}
+
+TEST_F(pair_generator_test, filters)
+{
+    pair_filter filter;
+    filter.maf_threshold = 0.05;
+    filter.pos_threshold = 150;
+    pair_generator generator( m_names, m_loci, m_maf, filter );
+    generator.set_all( );
+
+    std::vector< std::pair<size_t, size_t> > pairs = read_all( generator, 3 );
+    for(size_t i = 0; i < pairs.size( ); i++)
+    {
+        size_t snp1 = pairs[ i ].first;
+        size_t snp2 = pairs[ i ].second;
+        ASSERT_NE( snp1, 2 );
+        ASSERT_NE( snp2, 2 );
+        ASSERT_FALSE( m_loci[ snp1 ].chromosome == m_loci[ snp2 ].chromosome && snp2 - snp1 < 2 );
+    }
+    ASSERT_EQ( pairs.size( ), 7 );
+}
+
+TEST_F(pair_generator_test, set)
+{
+    std::set<size_t> snp_set;
+    snp_set.insert( 1 );
+    snp_set.insert( 4 );
+
+    pair_generator generator( m_names, m_loci, m_maf, pair_filter( ) );
+    generator.set_set( snp_set, true );
+    ASSERT_EQ( read_all( generator, 2 ).size( ), 8 );
+
+    generator.set_set( snp_set, false );
+    ASSERT_EQ( read_all( generator, 2 ).size( ), 9 );
+}
+
+TEST_F(pair_generator_test, spec)
+{
+    ASSERT_TRUE( is_pair_spec( "all:maf=0.05,dist=1e6" ) );
+    ASSERT_FALSE( is_pair_spec( "pairs.bin" ) );
+
+    pair_generator *generator = create_pair_generator( "all:maf=0.05,dist=150", m_names, m_loci, m_maf );
+    ASSERT_TRUE( generator != NULL );
+    ASSERT_EQ( read_all( *generator, 1 ).size( ), 7 );
+    delete generator;
+
+    ASSERT_TRUE( create_pair_generator( "all:unknown=1", m_names, m_loci, m_maf ) == NULL );
+    ASSERT_TRUE( create_pair_generator( "within", m_names, m_loci, m_maf ) == NULL );
+}
+
+TEST_F(pair_generator_test, all_missing_snp)
+{
+    /* The mafs as computed by besiq-pairs and for a specification,
+     * snp 2 has no genotypes */
+    std::vector<double> maf;
+    for(size_t i = 0; i < m_names.size( ); i++)
+    {
+        snp_row row;
+        row.resize( 20 );
+        for(size_t j = 0; j < 20; j++)
+        {
+            row.assign( j, i == 2 ? 3 : ( i + j ) % 3 );
+        }
+        maf.push_back( compute_genotype_stats( row ).maf );
+    }
+    ASSERT_TRUE( maf[ 2 ] != maf[ 2 ] );
+
+    /* A pair file written by besiq-pairs with the default filters */
+    const char *path = "pair_generator_test.bin";
+    pair_generator generator( m_names, m_loci, maf, pair_filter( ) );
+    generator.set_all( );
+    std::vector< std::pair<size_t, size_t> > generated = read_all( generator, 1 );
+    bpairfile output( path, m_names );
+    ASSERT_TRUE( output.open( ) );
+    for(size_t i = 0; i < generated.size( ); i++)
+    {
+        output.write( generated[ i ].first, generated[ i ].second );
+    }
+    output.close( );
+
+    std::vector< std::pair<size_t, size_t> > from_file;
+    bpairfile input( path );
+    ASSERT_TRUE( input.open( ) );
+    std::pair<size_t, size_t> pair;
+    while( input.read( pair ) )
+    {
+        from_file.push_back( pair );
+    }
+    input.close( );
+    remove( path );
+
+    pair_generator *spec = create_pair_generator( "all", m_names, m_loci, maf );
+    ASSERT_TRUE( spec != NULL );
+    std::vector< std::pair<size_t, size_t> > from_spec = read_all( *spec, 1 );
+    delete spec;
+
+    ASSERT_EQ( from_file.size( ), 10 );
+    std::sort( from_file.begin( ), from_file.end( ) );
+    std::sort( from_spec.begin( ), from_spec.end( ) );
+    EXPECT_EQ( from_file, from_spec );
+    for(size_t i = 0; i < from_file.size( ); i++)
+    {
+        EXPECT_NE( from_file[ i ].first, 2 );
+        EXPECT_NE( from_file[ i ].second, 2 );
+    }
+}
@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <besiq/io/pairfile.hpp>
+
+TEST(pairfile_test, find_split_snps)
+{
+    const char *path = "pairfile_test.bin";
+    std::vector<std::string> names;
+    names.push_back( "a" );
+    names.push_back( "b" );
+    names.push_back( "c" );
+    names.push_back( "d" );
+    names.push_back( "e" );
+
+    bpairfile output( path, names );
+    ASSERT_TRUE( output.open( ) );
+    output.write( 0, 1 );
+    output.write( 3, 1 );
+    output.write( 0, 4 );
+    output.write( 2, 4 );
+    output.close( );
+
+    bpairfile input( path );
+    std::vector<bool> first = find_split_snps( input, 1, 2 );
+    std::vector<bool> second = find_split_snps( input, 2, 2 );
+    remove( path );
+
+    bool expected_first[] = { true, true, false, true, false };
+    bool expected_second[] = { true, false, true, false, true };
+    ASSERT_EQ( first, std::vector<bool>( expected_first, expected_first + 5 ) );
+    ASSERT_EQ( second, std::vector<bool>( expected_second, expected_second + 5 ) );
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+#include <vector>
+
+#include <besiq/stats/permutation.hpp>
+#include <besiq/stats/snp_count.hpp>
+
+class permutation_test
+: public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        num_samples = 500;
+        row1.resize( num_samples );
+        row2.resize( num_samples );
+        phenotype = arma::zeros<arma::vec>( num_samples );
+        missing = arma::zeros<arma::uvec>( num_samples );
+        for(size_t i = 0; i < num_samples; i++)
+        {
+            row1.assign( i, ( i * 7 + i / 5 ) % 3 );
+            row2.assign( i, ( i * 3 + i / 7 ) % 4 );
+            phenotype[ i ] = ( i % 5 ) < 2;
+            missing[ i ] = i % 19 == 0;
+        }
+    }
+
+    size_t num_samples;
+    snp_row row1;
+    snp_row row2;
+    arma::vec phenotype;
+    arma::uvec missing;
+};
+
+TEST_F(permutation_test, keeps_cells_and_cases)
+{
+    /* More than one block, the last one partial */
+    size_t num_permutations = PERMUTATION_BLOCK_SIZE + 6;
+    permutation_engine permutations( phenotype, missing, num_permutations, 1 );
+    ASSERT_EQ( permutations.size( ), num_permutations );
+
+    binary_table observed;
+    count_engine counter( phenotype, missing );
+    counter.count( row1, row2, observed );
+
+    binary_table observed_single;
+    counter.count( row1, row1, observed_single );
+
+    std::vector<binary_table> tables( num_permutations );
+    std::vector<binary_table> single_tables( num_permutations );
+    permutations.count( row1, row2, &tables[ 0 ] );
+    permutations.count( row1, row1, &single_tables[ 0 ] );
+    size_t num_changed = 0;
+    for(size_t p = 0; p < num_permutations; p++)
+    {
+        bool changed = false;
+        for(int c = 0; c < 9; c++)
+        {
+            ASSERT_EQ( tables[ p ]( c, 0 ) + tables[ p ]( c, 1 ), observed( c, 0 ) + observed( c, 1 ) );
+            changed = changed || tables[ p ]( c, 1 ) != observed( c, 1 );
+        }
+        num_changed += changed;
+
+        /* Without missing genotypes all cases are counted */
+        ASSERT_EQ( single_tables[ p ].sum( 1 ), observed_single.sum( 1 ) );
+        ASSERT_EQ( single_tables[ p ].sum( 0 ), observed_single.sum( 0 ) );
+    }
+    EXPECT_GT( num_changed, num_permutations / 2 );
+}
+
+TEST_F(permutation_test, same_seed)
+{
+    size_t num_permutations = 10;
+    permutation_engine permutations( phenotype, missing, num_permutations, 7 );
+    permutation_engine same( phenotype, missing, num_permutations, 7 );
+    permutation_engine other( phenotype, missing, num_permutations, 8 );
+
+    std::vector<binary_table> tables( num_permutations );
+    std::vector<binary_table> same_tables( num_permutations );
+    std::vector<binary_table> other_tables( num_permutations );
+    permutations.count( row1, row2, &tables[ 0 ] );
+    same.count( row1, row2, &same_tables[ 0 ] );
+    other.count( row1, row2, &other_tables[ 0 ] );
+
+    size_t num_different = 0;
+    for(size_t p = 0; p < num_permutations; p++)
+    {
+        for(int c = 0; c < 9; c++)
+        {
+            ASSERT_EQ( tables[ p ]( c, 1 ), same_tables[ p ]( c, 1 ) );
+            num_different += tables[ p ]( c, 1 ) != other_tables[ p ]( c, 1 );
+        }
+    }
+    EXPECT_GT( num_different, 0 );
+}
+
+TEST(permutation_uniform_test, case_is_uniform)
+{
+    /* One case among three samples with different genotypes, so
+     * the cell of the case identifies the sample it was given to */
+    snp_row row1;
+    snp_row row2;
+    row1.resize( 3 );
+    row2.resize( 3 );
+    arma::vec phenotype = arma::zeros<arma::vec>( 3 );
+    arma::uvec missing = arma::zeros<arma::uvec>( 3 );
+    for(size_t i = 0; i < 3; i++)
+    {
+        row1.assign( i, i );
+        row2.assign( i, 0 );
+    }
+    phenotype[ 0 ] = 1.0;
+
+    size_t num_permutations = 3000;
+    permutation_engine permutations( phenotype, missing, num_permutations, 3 );
+    std::vector<binary_table> tables( num_permutations );
+    permutations.count( row1, row2, &tables[ 0 ] );
+
+    size_t num_case[ 3 ] = { 0, 0, 0 };
+    for(size_t p = 0; p < num_permutations; p++)
+    {
+        ASSERT_EQ( tables[ p ].sum( 1 ), 1.0 );
+        for(size_t i = 0; i < 3; i++)
+        {
+            num_case[ i ] += tables[ p ]( 3 * i, 1 ) == 1.0;
+        }
+    }
+
+    for(size_t i = 0; i < 3; i++)
+    {
+        EXPECT_NEAR( num_case[ i ], num_permutations / 3.0, 150.0 );
+    }
+}
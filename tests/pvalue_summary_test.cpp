@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <besiq/stats/pvalue_summary.hpp>
+
+TEST(pvalue_summary_test, test_uniform)
+{
+    pvalue_summary summary;
+    size_t n = 100000;
+    for(size_t i = 0; i < n; i++)
+    {
+        summary.add( ( i + 0.5 ) / n );
+    }
+
+    ASSERT_EQ( summary.num_pairs( ), n );
+    ASSERT_EQ( summary.num_tested( ), n );
+    ASSERT_NEAR( summary.median( ), 0.5, 1e-4 );
+    ASSERT_NEAR( summary.lambda( ), 1.0, 1e-3 );
+
+    std::vector<uint64_t> histogram = summary.get_histogram( );
+    ASSERT_EQ( histogram.size( ), PVALUE_SUMMARY_NUM_BINS );
+    for(size_t i = 0; i < histogram.size( ); i++)
+    {
+        ASSERT_EQ( histogram[ i ], n / PVALUE_SUMMARY_NUM_BINS );
+    }
+}
+
+TEST(pvalue_summary_test, test_merge)
+{
+    pvalue_summary summary1;
+    pvalue_summary summary2;
+    summary1.add( 0.01 );
+    summary1.add( -9 );
+    summary2.add( 0.02 );
+    summary2.add( 0.03 );
+    summary2.add( 1.0 );
+
+    summary1.merge( summary2 );
+    ASSERT_EQ( summary1.num_pairs( ), 5 );
+    ASSERT_EQ( summary1.num_tested( ), 4 );
+
+    std::vector<uint64_t> histogram = summary1.get_histogram( );
+    ASSERT_EQ( histogram[ 0 ], 3 );
+    ASSERT_EQ( histogram[ PVALUE_SUMMARY_NUM_BINS - 1 ], 1 );
+
+    /* Small p-values give an inflation factor above 1 */
+    ASSERT_GT( summary1.lambda( ), 1.0 );
+}
+
+TEST(pvalue_summary_test, test_empty)
+{
+    pvalue_summary summary;
+    summary.add( -9 );
+
+    ASSERT_EQ( summary.num_tested( ), 0 );
+    ASSERT_EQ( summary.median( ), -9 );
+    ASSERT_EQ( summary.lambda( ), -9 );
+}
@@ -4,6 +4,7 @@
 #include <stdexcept>
 
 #include <plink/snp_row.hpp>
+#include <plink/bed_file.hpp>
 
 TEST(snp_row_test, test_assign)
 {
@@ -20,3 +21,81 @@ TEST(snp_row_test, test_assign)
         ASSERT_EQ( row[ i ], i % 4 );
     }
 }
+
+TEST(snp_row_test, test_planes)
+{
+    snp_row row;
+    row.resize( 130 );
+
+    for(int i = 0; i < 130; i++)
+    {
+        row.assign( i, ( i * 7 ) % 4 );
+    }
+    row.assign( 5, 2 );
+
+    ASSERT_EQ( row.num_words( ), 3 );
+    for(int i = 0; i < 130; i++)
+    {
+        for(unsigned char g = 0; g < 4; g++)
+        {
+            bool is_set = ( row.get_plane( g )[ i / 64 ] >> ( i % 64 ) ) & 1;
+            ASSERT_EQ( is_set, row[ i ] == g );
+        }
+    }
+
+    /* Padding bits must be cleared in all planes */
+    for(unsigned char g = 0; g < 4; g++)
+    {
+        ASSERT_EQ( row.get_plane( g )[ 2 ] >> 2, 0 );
+    }
+}
+
+TEST(snp_row_test, test_view_flip)
+{
+    snp_row row;
+    row.resize( 70 );
+    for(int i = 0; i < 70; i++)
+    {
+        row.assign( i, i % 4 );
+    }
+
+    snp_row view( row.get_plane( 0 ), 70, true );
+    for(int i = 0; i < 70; i++)
+    {
+        unsigned char expected = ( i % 4 == 3 ) ? 3 : 2 - i % 4;
+        ASSERT_EQ( view[ i ], expected );
+    }
+    ASSERT_EQ( view.get_plane( 2 ), row.get_plane( 0 ) );
+
+    /* Writing to a view copies it and leaves the original intact */
+    view.assign( 0, 1 );
+    ASSERT_EQ( view[ 0 ], 1 );
+    ASSERT_EQ( row[ 0 ], 0 );
+    ASSERT_EQ( view[ 1 ], 1 );
+    ASSERT_EQ( view[ 2 ], 0 );
+}
+
+TEST(snp_row_test, test_decode_bed_row)
+{
+    /* 0 = hom, 1 = missing, 2 = het, 3 = other hom in the .bed encoding */
+    unsigned char bed_to_genotype[] = { 0, 3, 1, 2 };
+    size_t num_samples = 133;
+    std::vector<unsigned char> bytes( ( num_samples + 3 ) / 4, 0 );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        bytes[ i / 4 ] |= ( ( i * 5 ) % 4 ) << ( 2 * ( i % 4 ) );
+    }
+
+    std::vector<uint64_t> planes( 4 * snp_row::words_for_size( num_samples ) );
+    decode_bed_row( &bytes[ 0 ], num_samples, &planes[ 0 ] );
+
+    snp_row row( &planes[ 0 ], num_samples );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        ASSERT_EQ( row[ i ], bed_to_genotype[ ( i * 5 ) % 4 ] );
+    }
+    for(unsigned char g = 0; g < 4; g++)
+    {
+        ASSERT_EQ( row.get_plane( g )[ 2 ] >> 5, 0 );
+    }
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <dcdflib/libdcdf.hpp>
+#include <dcdflib/tail.hpp>
+
+TEST(tail_test, chi_square_same_as_dcdflib)
+{
+    double x[] = { 0.0, 0.01, 0.5, 1.0, 3.84, 7.5, 15.0, 30.0 };
+    for(unsigned int df = 1; df <= 9; df++)
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            double expected = 1.0 - chi_square_cdf( x[ i ], df );
+            EXPECT_NEAR( chi_square_upper( x[ i ], df ), expected, 1e-12 );
+            EXPECT_NEAR( chi_square_upper( x[ i ], df ) / expected, 1.0, 1e-8 );
+        }
+    }
+}
+
+TEST(tail_test, chi_square_small_p)
+{
+    /* Pr[ X > 100 ] with 1 df is erfc( sqrt( 50 ) ) */
+    EXPECT_NEAR( chi_square_upper( 100.0, 1 ) / 1.5239706048321e-23, 1.0, 1e-10 );
+    EXPECT_NEAR( chi_square_upper_log10( 100.0, 1 ), 22.8170234, 1e-6 );
+
+    /* Pr[ X > x ] with 4 df is exp( -x/2 ) ( 1 + x/2 ), far below the smallest double */
+    double expected = ( 1000.0 - log( 1001.0 ) ) / log( 10.0 );
+    EXPECT_NEAR( chi_square_upper_log10( 2000.0, 4 ), expected, 1e-9 * expected );
+    EXPECT_EQ( chi_square_upper( 2000.0, 4 ), 0.0 );
+    EXPECT_GT( chi_square_upper_log10( 5000.0, 3 ), chi_square_upper_log10( 5000.0, 5 ) );
+
+    EXPECT_EQ( chi_square_upper( 0.0, 3 ), 1.0 );
+    EXPECT_EQ( chi_square_upper_log10( 0.0, 3 ), 0.0 );
+    EXPECT_THROW( chi_square_upper( -1.0, 2 ), bad_domain_value );
+}
+
+TEST(tail_test, chi_square_batch)
+{
+    double x[] = { 0.3, 4.2, 20.0, 900.0 };
+    double p[ 4 ];
+    double log10_p[ 4 ];
+    chi_square_upper( x, 4, 3, p, log10_p );
+    for(int i = 0; i < 4; i++)
+    {
+        EXPECT_EQ( p[ i ], chi_square_upper( x[ i ], 3 ) );
+        EXPECT_EQ( log10_p[ i ], chi_square_upper_log10( x[ i ], 3 ) );
+    }
+}
+
+TEST(tail_test, norm_and_f)
+{
+    double z[] = { -3.0, -0.5, 0.0, 1.0, 2.5, 6.0 };
+    for(int i = 0; i < 6; i++)
+    {
+        /* The reference 1 - cdf is only accurate to about 1e-16 */
+        double expected = 1.0 - norm_cdf( z[ i ], 0.0, 1.0 );
+        EXPECT_NEAR( norm_upper( z[ i ], 0.0, 1.0 ), expected, 1e-15 );
+        EXPECT_NEAR( norm_upper_log10( z[ i ], 0.0, 1.0 ), -log10( norm_upper( z[ i ], 0.0, 1.0 ) ), 1e-12 );
+    }
+    EXPECT_NEAR( norm_upper_log10( 40.0, 0.0, 1.0 ), 349.437006, 1e-5 );
+
+    double f[] = { 0.1, 1.0, 2.0, 5.0, 20.0 };
+    for(int i = 0; i < 5; i++)
+    {
+        double expected = 1.0 - f_cdf( f[ i ], 3, 120 );
+        EXPECT_NEAR( f_upper( f[ i ], 3, 120 ), expected, 1e-14 );
+    }
+    EXPECT_EQ( f_upper( 0.0, 3, 120 ), 1.0 );
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+
+#include <besiq/stats/wald_kernels.hpp>
+
+TEST(wald_kernels_test, same_as_inverse)
+{
+    double beta[] = { 0.3, -1.2, 0.7, 2.1 };
+    for(size_t n = 1; n <= WALD_MAX_TERMS; n++)
+    {
+        /* A covariance matrix with the structure of the wald tests */
+        double C[ WALD_MAX_TERMS * WALD_MAX_TERMS ] = { 0.0 };
+        arma::mat C_arma( n, n );
+        for(size_t i = 0; i < n; i++)
+        {
+            for(size_t j = 0; j < n; j++)
+            {
+                C[ i * WALD_MAX_TERMS + j ] = 0.1 + ( i == j ? 0.05 * ( i + 1 ) : 0.0 ) + ( i % 2 == j % 2 ? 0.02 : 0.0 );
+                C_arma( i, j ) = C[ i * WALD_MAX_TERMS + j ];
+            }
+        }
+
+        arma::mat Cinv_arma;
+        ASSERT_TRUE( arma::inv( Cinv_arma, C_arma ) );
+        double expected_chi = 0.0;
+        for(size_t i = 0; i < n; i++)
+        {
+            for(size_t j = 0; j < n; j++)
+            {
+                expected_chi += beta[ i ] * Cinv_arma( i, j ) * beta[ j ];
+            }
+        }
+
+        double chi = 0.0;
+        ASSERT_TRUE( wald_statistic( C, beta, n, &chi ) );
+        EXPECT_NEAR( chi, expected_chi, 1e-9 * expected_chi );
+
+        double Cinv[ WALD_MAX_TERMS * WALD_MAX_TERMS ];
+        ASSERT_TRUE( wald_invert( C, n, Cinv ) );
+        for(size_t i = 0; i < n; i++)
+        {
+            for(size_t j = 0; j < n; j++)
+            {
+                EXPECT_NEAR( Cinv[ i * WALD_MAX_TERMS + j ], Cinv_arma( i, j ), 1e-9 );
+            }
+        }
+    }
+}
+
+TEST(wald_kernels_test, not_positive_definite)
+{
+    double C[ WALD_MAX_TERMS * WALD_MAX_TERMS ] = { 0.0 };
+    double beta[ WALD_MAX_TERMS ] = { 1.0, 1.0, 1.0, 1.0 };
+    double Cinv[ WALD_MAX_TERMS * WALD_MAX_TERMS ];
+    double chi = 0.0;
+    for(size_t i = 0; i < WALD_MAX_TERMS; i++)
+    {
+        for(size_t j = 0; j < WALD_MAX_TERMS; j++)
+        {
+            C[ i * WALD_MAX_TERMS + j ] = 1.0;
+        }
+    }
+
+    EXPECT_TRUE( wald_statistic( C, beta, 1, &chi ) );
+    EXPECT_FALSE( wald_statistic( C, beta, 2, &chi ) );
+    EXPECT_FALSE( wald_invert( C, 4, Cinv ) );
+}